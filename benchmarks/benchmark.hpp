@@ -0,0 +1,41 @@
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono> // std::chrono
+#include <cstdio> // std::printf
+#include <cstddef> // std::size_t
+
+// Minimal harness shared by the CPU microbenchmarks, reporting results in the same format as Google Benchmark (name/N, time per iteration, iterations, items per second)
+// Kept dependency-free so that the benchmarks build alongside the samples without fetching additional libraries
+
+inline void print_benchmark_header() {
+    std::printf("%-41s %17s %12s %22s\n", "Benchmark", "Time", "Iterations", "Throughput");
+}
+
+// Calls 'fn' repeatedly, 'count' is the number of items processed per call and 'fn' returns the size of its result
+// 'items' and 'result' label the throughput and result columns (e.g. "items/s" and "visible")
+template <typename Fn>
+void run_benchmark(const char* name, std::size_t count, const char* items, const char* result, Fn&& fn) {
+    using clock = std::chrono::high_resolution_clock;
+
+    // Run for at least 0.5s of wall time (same as Google Benchmark's default minimum time)
+    const double minimum_time = 0.5;
+
+    std::size_t iterations = 0;
+    std::size_t output = 0;
+    double elapsed = 0.0;
+
+    clock::time_point start = clock::now();
+    while (elapsed < minimum_time) {
+        output = fn();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    double ns = elapsed * 1e9 / (double) iterations;
+    double items_per_second = (double) count * (double) iterations / elapsed;
+    std::printf("%-32s/%-8zu %14.0f ns %12zu %12.3fM %s   (%zu %s)\n", name, count, ns, iterations, items_per_second / 1e6, items, output, result);
+}
+
+#endif // BENCHMARK_HPP
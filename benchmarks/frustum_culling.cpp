@@ -0,0 +1,66 @@
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE // Camera projections match the samples (frustum planes are extracted assuming a [0, 1] depth range)
+#include "frustum_culling.hpp"
+#include "benchmark.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random> // std::mt19937
+#include <vector> // std::vector
+#include <cstdio> // std::printf
+#include <cstdlib> // EXIT_FAILURE
+#include <cstddef> // std::size_t
+
+// Microbenchmark for FrustumCuller, comparing the SIMD implementation against the scalar reference (see benchmark.hpp for the output format)
+
+namespace {
+
+    // Objects are scattered uniformly in a cube around the camera, so roughly 10-15% of them end up inside the frustum
+    void populate(FrustumCuller& culler, std::size_t count) {
+        std::mt19937 rng(1337u);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> scale(0.1f, 2.0f);
+
+        culler.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng)));
+            transform = glm::scale(transform, glm::vec3(scale(rng)));
+            culler.add(glm::vec3(-0.5f), glm::vec3(0.5f), transform);
+        }
+    }
+
+}
+
+int main() {
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.01f, 100.0f);
+    projection[1][1] *= -1.0f;
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = extract_frustum_planes(projection * view);
+
+    FrustumCuller culler { };
+    std::vector<unsigned> visible { };
+
+    print_benchmark_header();
+    // 1K to 1M objects
+    for (std::size_t count = 1024; count <= (1u << 20); count *= 4) {
+        populate(culler, count);
+        visible.reserve(count);
+
+        // SIMD results must match the reference implementation before either is timed
+        std::vector<unsigned> expected { };
+        culler.cull_scalar(frustum, expected);
+        culler.cull(frustum, visible);
+        if (visible != expected) {
+            std::printf("FrustumCuller::cull returned a different visible set than FrustumCuller::cull_scalar (%zu objects, %zu visible, %zu expected)\n", count, visible.size(), expected.size());
+            return EXIT_FAILURE;
+        }
+
+        run_benchmark("BM_FrustumCuller_Scalar", count, "items/s", "visible", [&]() {
+            return culler.cull_scalar(frustum, visible);
+        });
+        run_benchmark("BM_FrustumCuller_SIMD", count, "items/s", "visible", [&]() {
+            return culler.cull(frustum, visible);
+        });
+    }
+
+    return 0;
+}
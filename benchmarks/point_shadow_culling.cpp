@@ -0,0 +1,92 @@
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE // Light projections match the samples (frustum planes are extracted assuming a [0, 1] depth range)
+#include "frustum_culling.hpp"
+#include "benchmark.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <array> // std::array
+#include <random> // std::mt19937
+#include <vector> // std::vector
+#include <cstddef> // std::size_t
+
+// Microbenchmark for point light (cube map) shadow culling (see benchmark.hpp for the output format)
+// Compares routing every object near a light to all six faces of its cube map (what a geometry shader that emits each triangle to every face renders) with culling objects per face
+// Face instances is the number of (object, face) pairs that are drawn, which is proportional to the number of triangles rasterized by the shadow pass
+
+namespace {
+
+    const float light_range = 10.0f;
+
+    struct PointLight {
+        glm::mat4 range; // Box around the light, containing all six faces
+        std::array<glm::mat4, 6> faces;
+    };
+
+    // Objects are scattered uniformly in a cube, lights are scattered in the same volume
+    void populate(FrustumCuller& culler, std::size_t count, std::vector<PointLight>& lights, std::size_t light_count) {
+        std::mt19937 rng(1337u);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> scale(0.1f, 2.0f);
+
+        culler.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng)));
+            transform = glm::scale(transform, glm::vec3(scale(rng)));
+            culler.add(glm::vec3(-0.5f), glm::vec3(0.5f), transform);
+        }
+
+        // Same face orientation as omnidirectional_shadow_mapping.cpp
+        const glm::vec3 directions[6] { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+        const glm::vec3 up_vectors[6] { glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.01f, light_range);
+
+        lights.clear();
+        for (std::size_t i = 0; i < light_count; ++i) {
+            glm::vec3 center = glm::vec3(position(rng), position(rng), position(rng));
+
+            PointLight& light = lights.emplace_back();
+            light.range = glm::ortho(-light_range, light_range, -light_range, light_range, -light_range, light_range) * glm::translate(glm::mat4(1.0f), -center);
+            for (int face = 0; face < 6; ++face) {
+                light.faces[face] = projection * glm::lookAt(center, center + directions[face], up_vectors[face]);
+            }
+        }
+    }
+
+}
+
+int main() {
+    const std::size_t object_count = 16384;
+
+    FrustumCuller culler { };
+    std::vector<PointLight> lights { };
+    std::vector<unsigned> visible { };
+    visible.reserve(object_count);
+
+    print_benchmark_header();
+    // 16 to 1024 point lights
+    for (std::size_t light_count = 16; light_count <= 1024; light_count *= 4) {
+        populate(culler, object_count, lights, light_count);
+
+        // Every object within range of the light is rendered to all six faces
+        run_benchmark("BM_PointShadow_AllFaces", light_count, "lights/s", "face instances", [&]() {
+            std::size_t instances = 0;
+            for (const PointLight& light : lights) {
+                instances += culler.cull(light.range, visible) * 6;
+            }
+            return instances;
+        });
+
+        // Objects are only rendered to the faces whose frustum they intersect
+        run_benchmark("BM_PointShadow_PerFace", light_count, "lights/s", "face instances", [&]() {
+            std::size_t instances = 0;
+            for (const PointLight& light : lights) {
+                for (const glm::mat4& face : light.faces) {
+                    instances += culler.cull(face, visible);
+                }
+            }
+            return instances;
+        });
+    }
+
+    return 0;
+}
@@ -27,12 +27,21 @@ class Camera {
         glm::mat4 get_view_matrix();
         glm::mat4 get_projection_matrix();
         
+        // Matrices of the previous frame, for reprojecting data from the previous frame (temporal effects)
+        // Equal to the current matrices until end_frame() has been called once
+        glm::mat4 get_previous_view_matrix();
+        glm::mat4 get_previous_projection_matrix();
+        
+        // Stores the current matrices as the matrices of the previous frame, called by Sample at the end of every frame
+        void end_frame();
+        
         bool is_dirty() const;
         
     private:
         void recalculate();
         
         bool dirty;
+        bool has_previous;
         
         float near;
         float far;
@@ -43,6 +52,9 @@ class Camera {
         
         glm::mat4 view;
         glm::mat4 projection;
+        
+        glm::mat4 previous_view;
+        glm::mat4 previous_projection;
 };
 
 class OrbitCamera {
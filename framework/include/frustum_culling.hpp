@@ -0,0 +1,132 @@
+
+#ifndef FRUSTUM_CULLING_HPP
+#define FRUSTUM_CULLING_HPP
+
+#include <glm/glm.hpp>
+#include <vector> // std::vector
+#include <utility> // std::pair
+#include <limits> // std::numeric_limits
+#include <cstddef> // std::size_t
+
+// Frustum planes are stored as (a, b, c, d), where (a, b, c) is the plane normal pointing towards the inside of the frustum
+// A point p is inside the plane if dot(vec3(a, b, c), p) + d >= 0
+struct Frustum {
+    enum Plane {
+        LEFT_PLANE = 0,
+        RIGHT_PLANE,
+        BOTTOM_PLANE,
+        TOP_PLANE,
+        NEAR_PLANE,
+        FAR_PLANE,
+        PLANE_COUNT
+    };
+
+    glm::vec4 planes[PLANE_COUNT];
+};
+
+// Extracts the planes of the view frustum from a camera matrix (projection * view), as described by Gribb & Hartmann
+// Assumes a [0, 1] depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE, see camera.hpp)
+// Planes are normalized so that sphere tests can compare signed distances against a radius directly
+Frustum extract_frustum_planes(const glm::mat4& camera);
+
+// CPU frustum culler for scene objects
+// Bounding volumes are stored in structure-of-arrays form so that 8 (AVX2) or 4 (SSE) objects can be tested against a plane in one iteration
+// Each object stores a world-space bounding sphere (coarse test) and a world-space AABB (precise test for objects that pass the sphere test)
+class FrustumCuller {
+    public:
+        FrustumCuller();
+        ~FrustumCuller();
+
+        // Bounds are given in model space (Mesh::min / Mesh::max) and transformed into world space by 'transform' (Transform::get_matrix())
+        // Returns the index of the object, which is the value written out by cull() if the object is visible
+        unsigned add(glm::vec3 min, glm::vec3 max, const glm::mat4& transform = glm::mat4(1.0f));
+
+        // Updates the world-space bounds of an existing object (for objects with dirty transforms)
+        void update(unsigned index, glm::vec3 min, glm::vec3 max, const glm::mat4& transform);
+
+        void clear();
+        std::size_t size() const;
+
+        // Appends the indices of all objects that intersect the frustum to 'visible' (in ascending order), returns the number of visible objects
+        // 'visible' is cleared before culling
+        std::size_t cull(const Frustum& frustum, std::vector<unsigned>& visible) const;
+        std::size_t cull(const glm::mat4& camera, std::vector<unsigned>& visible) const;
+
+        // Reference implementation without SIMD (for validation / benchmarking)
+        std::size_t cull_scalar(const Frustum& frustum, std::vector<unsigned>& visible) const;
+
+        // Helpers for scenes of objects that reference a model ('Object::model') and have a 'Object::transform' (Transform)
+        // 'model_bounds' holds the model-space bounds of each model (see compute_model_bounds)
+
+        // Replaces the contents of the culler with 'objects', object indices match indices into 'objects'
+        template <typename Object>
+        void add_objects(std::vector<Object>& objects, const std::vector<std::pair<glm::vec3, glm::vec3>>& model_bounds);
+
+        // Bounding volumes only need to be recomputed for objects that have moved, must be called before anything else calls Transform::get_matrix() (which clears the dirty flag)
+        // Indices of objects that moved are written to 'moved' (if given), which is cleared first
+        template <typename Object>
+        void update_objects(std::vector<Object>& objects, const std::vector<std::pair<glm::vec3, glm::vec3>>& model_bounds, std::vector<unsigned>* moved = nullptr);
+
+    private:
+        void resize(std::size_t capacity);
+
+        std::size_t count;
+
+        // Arrays are padded to a multiple of 8 elements so that the last iteration can use full-width loads (padding lanes are masked out)
+
+        // Bounding spheres
+        std::vector<float> sphere_x;
+        std::vector<float> sphere_y;
+        std::vector<float> sphere_z;
+        std::vector<float> sphere_radius;
+
+        // AABBs (center + half extents)
+        std::vector<float> center_x;
+        std::vector<float> center_y;
+        std::vector<float> center_z;
+        std::vector<float> extent_x;
+        std::vector<float> extent_y;
+        std::vector<float> extent_z;
+};
+
+// Model-space bounds (min, max) of the vertices of a model
+template <typename Model>
+std::pair<glm::vec3, glm::vec3> compute_model_bounds(const Model& model) {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : model.vertices) {
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+    }
+    return std::make_pair(min, max);
+}
+
+template <typename Object>
+void FrustumCuller::add_objects(std::vector<Object>& objects, const std::vector<std::pair<glm::vec3, glm::vec3>>& model_bounds) {
+    clear();
+    for (Object& object : objects) {
+        const std::pair<glm::vec3, glm::vec3>& bounds = model_bounds[object.model];
+        add(bounds.first, bounds.second, object.transform.get_matrix());
+    }
+}
+
+template <typename Object>
+void FrustumCuller::update_objects(std::vector<Object>& objects, const std::vector<std::pair<glm::vec3, glm::vec3>>& model_bounds, std::vector<unsigned>* moved) {
+    if (moved) {
+        moved->clear();
+    }
+
+    for (std::size_t i = 0u; i < objects.size(); ++i) {
+        Object& object = objects[i];
+        if (object.transform.is_dirty()) {
+            const std::pair<glm::vec3, glm::vec3>& bounds = model_bounds[object.model];
+            update((unsigned) i, bounds.first, bounds.second, object.transform.get_matrix());
+
+            if (moved) {
+                moved->emplace_back((unsigned) i);
+            }
+        }
+    }
+}
+
+#endif // FRUSTUM_CULLING_HPP
@@ -0,0 +1,26 @@
+
+#ifndef GEOMETRY_BUFFER_HPP
+#define GEOMETRY_BUFFER_HPP
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+// Compact geometry buffer layout, shared by the deferred samples (encoding / decoding functions are in shaders/common/geometry_buffer.glsl)
+// Positions are not stored, they are reconstructed from depth and the inverse camera projection
+//   - normal: RG16 octahedral encoded unit normal (4 bytes)
+//   - material: RGBA8 diffuse color + material index (4 bytes)
+//   - depth: depth buffer (4 bytes)
+// 12 bytes per pixel, compared to 32 bytes for storing position, normal, ambient, diffuse, and specular attachments separately
+constexpr VkFormat GEOMETRY_BUFFER_NORMAL_FORMAT = VK_FORMAT_R16G16_SNORM;
+constexpr VkFormat GEOMETRY_BUFFER_MATERIAL_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+// Material indices are stored in 8 bits
+constexpr unsigned MAX_GEOMETRY_BUFFER_MATERIALS = 256u;
+
+// Matches Material in shaders/common/geometry_buffer.glsl (std140)
+struct GeometryBufferMaterial {
+    glm::vec4 ambient; // (r, g, b, unused)
+    glm::vec4 specular; // (r, g, b, exponent)
+};
+
+#endif // GEOMETRY_BUFFER_HPP
@@ -9,6 +9,14 @@
 void create_image_view(VkDevice device, VkImage image, VkImageViewType type, VkFormat format, VkImageAspectFlags aspect, unsigned base_mip_level, unsigned num_mip_levels, unsigned layer_count, VkImageView& image_view);
 void create_image(VkPhysicalDevice physical_device, VkDevice device, unsigned image_width, unsigned image_height, unsigned mip_levels, unsigned layers, VkSampleCountFlagBits samples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImageCreateFlags flags, VkMemoryPropertyFlags desired_memory_properties, VkImage& image, VkDeviceMemory& memory);
 
+// Creates an image without allocating any memory for it (memory is bound separately, for example when multiple images alias the same allocation)
+void create_image(VkDevice device, unsigned image_width, unsigned image_height, unsigned mip_levels, unsigned layers, VkSampleCountFlagBits samples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImageCreateFlags flags, VkImage& image);
+
+unsigned get_memory_type_index(VkPhysicalDevice physical_device, VkMemoryRequirements memory_requirements, VkMemoryPropertyFlags desired_memory_properties);
+
+// Returns true if the physical device has a memory type with the desired properties that is compatible with the given memory requirements
+bool is_memory_type_supported(VkPhysicalDevice physical_device, VkMemoryRequirements memory_requirements, VkMemoryPropertyFlags desired_memory_properties);
+
 void create_buffer(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize allocation_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags desired_properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory);
 
 void copy_buffer(VkCommandBuffer command_buffer, VkBuffer src, VkDeviceSize src_offset, VkBuffer dst,  VkDeviceSize dst_offset, VkDeviceSize size);
@@ -21,9 +29,24 @@ VkDescriptorSetLayoutBinding create_descriptor_set_layout_binding(VkDescriptorTy
 
 std::size_t align_to_device_boundary(VkPhysicalDevice physical_device, std::size_t size);
 
-// TODO: determine access masks from src/dsk pipeline stage
 void transition_image(VkCommandBuffer command_buffer, VkImage image, VkImageLayout src, VkImageLayout dst, VkImageSubresourceRange subresource_range, VkAccessFlags src_access_mask, VkPipelineStageFlags src_stage_mask, VkAccessFlags dst_access_mask, VkPipelineStageFlags dst_stage_mask);
 
+// Access masks are derived from the image layouts and the pipeline stages they are accessed in
+// The source access mask only contains write accesses (read accesses do not need to be made available, only an execution dependency is required for write-after-read hazards)
+void transition_image(VkCommandBuffer command_buffer, VkImage image, VkImageLayout src, VkImageLayout dst, VkImageSubresourceRange subresource_range, VkPipelineStageFlags src_stage_mask, VkPipelineStageFlags dst_stage_mask);
+
+// Returns the memory accesses that can be performed on an image in the given layout, restricted to the accesses supported by the given pipeline stages
+VkAccessFlags get_image_layout_access_mask(VkImageLayout layout, VkPipelineStageFlags stages);
+
+// Returns the subset of the given accesses that are supported by the given pipeline stages
+VkAccessFlags get_supported_access_mask(VkAccessFlags access, VkPipelineStageFlags stages);
+
+// Returns only the write accesses of the given access mask
+VkAccessFlags get_write_access_mask(VkAccessFlags access);
+
+bool is_depth_format(VkFormat format);
+bool has_stencil_component(VkFormat format);
+
 
 
 
@@ -0,0 +1,300 @@
+
+#ifndef RENDER_GRAPH_HPP
+#define RENDER_GRAPH_HPP
+
+#include <vulkan/vulkan.h>
+#include <vector> // std::vector
+#include <string> // std::string
+#include <functional> // std::function
+#include <map> // std::map
+#include <cstddef> // std::size_t
+
+// The render graph is a layer on top of render passes, framebuffers, and pipeline barriers
+// Instead of creating these by hand, passes declare which (named) resources they read and write, and the graph:
+//   - culls passes whose results are never used (by a later pass, or an imported resource)
+//   - allocates the images it owns, with usage flags derived from how passes use them
+//   - aliases the memory of images whose lifetimes within a frame do not overlap, and uses lazily allocated memory for images that only live within a single render pass
+//     (only images created by the graph, imported images and images samples allocate themselves keep their own memory)
+//   - merges consecutive graphics passes that only communicate through attachments (same pixel) into subpasses of a single render pass
+//   - derives attachment load / store operations, image layouts, and subpass dependencies
+//   - inserts the minimal set of pipeline barriers between render passes (one per hazard, access masks derived from the stages + layouts involved)
+//
+// Passes are executed in the order they were added (a pass can only read resources written by passes added before it)
+// The schedule is static: compile() is called once (after all passes are added), and execute() records the entire graph into a command buffer every frame
+// Barriers computed by compile() account for the state resources are left in by the previous frame, as the graph is executed with the same schedule every frame
+class RenderGraph {
+    public:
+        typedef unsigned Resource;
+        typedef unsigned Pass;
+
+        static constexpr unsigned INVALID = ~0u;
+
+        // Memory of render targets owned by the graph (valid after compile())
+        struct MemoryReport {
+            std::size_t image_count = 0u;
+            std::size_t transient_count = 0u;
+            std::size_t allocation_count = 0u;
+
+            VkDeviceSize dedicated_size = 0u; // Memory required if every image had its own allocation
+            VkDeviceSize allocated_size = 0u; // Memory actually allocated (aliased), not including lazily allocated memory
+            VkDeviceSize lazily_allocated_size = 0u; // Lazily allocated memory is (potentially) never committed, so it does not count towards the peak
+        };
+
+        struct ImageDescription {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+
+            // A width / height of 0 uses the extent of the graph
+            unsigned width = 0u;
+            unsigned height = 0u;
+
+            VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+            // Usage flags that cannot be derived from the passes (for example, VK_IMAGE_USAGE_TRANSFER_SRC_BIT for taking screenshots)
+            VkImageUsageFlags usage = 0;
+        };
+
+        // Passed to the setup function of a pass to declare the resources the pass uses
+        class PassBuilder {
+            public:
+                // Attachments
+                // Clearing / discarding (load operations CLEAR / DONT_CARE) signal that the previous contents of the resource are not needed
+                void write_color(Resource resource, VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_CLEAR, VkClearColorValue clear = {{ 0.0f, 0.0f, 0.0f, 1.0f }});
+                void write_depth(Resource resource, VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_CLEAR, VkClearDepthStencilValue clear = { 1.0f, 0 });
+                void read_depth(Resource resource); // Depth testing against a read-only depth attachment
+
+                // Reading an attachment written by a previous pass at the same pixel location (subpassInput)
+                // Passes that only read their inputs this way can be merged into the same render pass as the pass that wrote them
+                void read_input_attachment(Resource resource);
+
+                // Shader resources
+                void read_texture(Resource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                void read_storage_image(Resource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                // Passes that write every texel of a storage image can discard its previous contents (VK_ATTACHMENT_LOAD_OP_DONT_CARE), which allows the image to share memory with other images
+                void write_storage_image(Resource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_LOAD);
+
+                // Passes with side effects (such as writing to buffers or presenting) are never culled
+                void set_side_effects();
+
+                // Passes that record their draws into secondary command buffers must set VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                void set_subpass_contents(VkSubpassContents contents);
+
+            private:
+                friend class RenderGraph;
+                PassBuilder(RenderGraph& graph, Pass pass);
+
+                RenderGraph& graph;
+                Pass pass;
+        };
+
+        RenderGraph(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent);
+        ~RenderGraph();
+
+        RenderGraph(const RenderGraph&) = delete;
+        RenderGraph& operator=(const RenderGraph&) = delete;
+
+        // Images owned by the graph are created by compile()
+        Resource create_image(const char* name, const ImageDescription& description);
+
+        // Images owned outside the graph (such as swapchain images) are always treated as outputs of the graph
+        // 'initial_layout' / 'initial_stages' describe the state of the image at the start of every frame (for swapchain images, this is VK_IMAGE_LAYOUT_UNDEFINED and the stage the image acquisition semaphore is waited on)
+        // Any writes to the image in 'initial_stages' before the graph (for example, images written by the graph in the previous frame) are made visible to the first use of the image
+        // The image is transitioned to 'final_layout' at the end of the graph (VK_IMAGE_LAYOUT_UNDEFINED leaves the image in the layout of its last use)
+        Resource import_image(const char* name, VkImage image, VkImageView image_view, VkFormat format, VkExtent2D extent, VkImageLayout initial_layout, VkPipelineStageFlags initial_stages, VkImageLayout final_layout);
+
+        // Updates the image backing an imported resource (for example, the swapchain image acquired for this frame)
+        void set_imported_image(Resource resource, VkImage image, VkImageView image_view);
+
+        Pass add_graphics_pass(const char* name, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute);
+        Pass add_compute_pass(const char* name, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute);
+
+        void compile();
+
+        // Records all passes (and the barriers between them) into the given command buffer, which must be in the recording state
+        void execute(VkCommandBuffer command_buffer);
+
+        // Records the passes in [first, last] (and the barriers before them) into the given command buffer
+        // Used to split one frame across several submissions (for example, to run compute passes on an async compute queue), ranges must be recorded in order and synchronized with semaphores
+        // Barriers between passes of different ranges are recorded with the later range, so all ranges must be submitted to queues of the same queue family
+        void execute(VkCommandBuffer command_buffer, Pass first, Pass last);
+
+        // Pipelines must be created against the render pass / subpass their pass was scheduled into (valid after compile())
+        VkRenderPass get_render_pass(Pass pass) const;
+        unsigned get_subpass(Pass pass) const;
+        bool is_culled(Pass pass) const;
+
+        VkImage get_image(Resource resource) const;
+        VkImageView get_image_view(Resource resource) const;
+
+        MemoryReport report_memory() const;
+
+        // Prints a one-line summary of report_memory()
+        void print_memory() const;
+
+        // Prints the compiled schedule (render passes, subpasses, barriers, culled passes) and the memory used by render targets owned by the graph, for debugging
+        void print() const;
+
+    private:
+        enum class Usage {
+            COLOR_ATTACHMENT,
+            DEPTH_ATTACHMENT,
+            DEPTH_READ,
+            INPUT_ATTACHMENT,
+            TEXTURE,
+            STORAGE_READ,
+            STORAGE_WRITE
+        };
+
+        struct ResourceUsage {
+            Resource resource;
+            Usage usage;
+            VkAttachmentLoadOp load;
+            VkClearValue clear;
+            VkPipelineStageFlags stages;
+        };
+
+        struct PassData {
+            std::string name;
+            bool compute;
+            bool side_effects;
+            VkSubpassContents contents;
+
+            std::vector<ResourceUsage> usages;
+            std::function<void(VkCommandBuffer)> execute;
+
+            bool culled;
+            unsigned group; // Index of the physical pass (render pass / compute dispatch) this pass is scheduled into
+            unsigned subpass;
+        };
+
+        // Resource state used for barrier generation
+        struct ResourceState {
+            VkImageLayout layout;
+
+            // Stages + accesses of the last write (including layout transitions)
+            VkPipelineStageFlags write_stages;
+            VkAccessFlags write_access;
+
+            // Stages that have read the resource since the last write (for write-after-read hazards)
+            VkPipelineStageFlags read_stages;
+
+            // Stages + accesses the last write has already been made visible to
+            VkPipelineStageFlags visible_stages;
+            VkAccessFlags visible_access;
+        };
+
+        struct ImageResource {
+            std::string name;
+            ImageDescription description;
+            VkExtent2D extent;
+
+            bool imported;
+            VkImageLayout initial_layout; // Imported resources only
+            VkPipelineStageFlags initial_stages;
+            VkImageLayout final_layout;
+
+            VkImage image;
+            VkDeviceMemory memory;
+            VkImageView image_view;
+            VkImageAspectFlags aspect;
+            VkImageUsageFlags usage;
+            VkMemoryRequirements memory_requirements;
+
+            bool used; // Referenced by at least one pass that was not culled
+            bool transient; // Only used as an attachment within a single render pass (VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+
+            // Lifetime within a frame (indices of the first / last physical pass that uses the resource)
+            unsigned first_group;
+            unsigned last_group;
+
+            unsigned allocation; // Index of the allocation backing the resource (possibly shared with other resources)
+
+            ResourceState state;
+        };
+
+        struct Barrier {
+            Resource resource;
+            VkImageLayout old_layout;
+            VkImageLayout new_layout;
+            VkPipelineStageFlags src_stages;
+            VkAccessFlags src_access;
+            VkPipelineStageFlags dst_stages;
+            VkAccessFlags dst_access;
+        };
+
+        // A physical pass is either a render pass (one or more graphics passes as subpasses) or a single compute pass
+        struct Group {
+            bool compute;
+            std::vector<Pass> passes;
+
+            std::vector<Barrier> barriers; // Recorded before the group begins
+
+            VkRenderPass render_pass;
+            VkExtent2D extent;
+            std::vector<Resource> attachments;
+            std::vector<VkClearValue> clear_values;
+
+            // Imported attachments can change every frame, framebuffers are created on demand for each unique set of image views
+            std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+        };
+
+        // Memory shared by one or more images with non-overlapping lifetimes (all bound at offset 0)
+        struct Allocation {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize size = 0u;
+            VkDeviceSize alignment = 0u;
+            unsigned memory_type_bits = 0u;
+            bool lazy = false; // VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+            std::vector<Resource> resources;
+        };
+
+        Pass add_pass(const char* name, bool compute, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute);
+        void add_usage(Pass pass, Resource resource, Usage usage, VkAttachmentLoadOp load, VkClearValue clear, VkPipelineStageFlags stages);
+
+        void cull_passes();
+        void schedule_passes();
+        bool can_merge(const Group& group, const PassData& pass) const;
+        void allocate_resources();
+        void create_render_pass(Group& group);
+
+        // Simulates one frame worth of resource accesses, generating barriers into each group
+        void generate_barriers();
+        void simulate_frame(bool record);
+
+        // Records barriers, batched into one vkCmdPipelineBarrier per unique pair of source / destination stages
+        void record_barriers(VkCommandBuffer command_buffer, const std::vector<Barrier>& barriers) const;
+
+        VkFramebuffer get_framebuffer(Group& group);
+
+        void destroy();
+
+        // Layout / stages / accesses a resource is used with
+        VkImageLayout get_layout(const ImageResource& resource, const ResourceUsage& usage) const;
+        VkPipelineStageFlags get_stages(const ResourceUsage& usage) const;
+        VkAccessFlags get_access(const ResourceUsage& usage) const;
+        static bool is_attachment(Usage usage);
+        bool is_aliased(const ImageResource& resource) const; // Shares memory with other resources
+        static bool is_write(const ResourceUsage& usage);
+
+        // Returns true if the pass needs the previous contents of the resource
+        static bool reads_contents(const ResourceUsage& usage);
+
+        VkPhysicalDevice physical_device;
+        VkDevice device;
+        VkExtent2D extent;
+
+        std::vector<ImageResource> resources;
+        std::vector<PassData> passes;
+        std::vector<Group> groups;
+        std::vector<Allocation> allocations;
+
+        std::vector<Barrier> final_barriers; // Transitions imported resources into their final layouts
+
+        // Resources owned by the graph start out in VK_IMAGE_LAYOUT_UNDEFINED, but barriers assume the state resources are left in by the previous frame
+        // These barriers are recorded once (by the first execute()) to bring resources into that state
+        std::vector<Barrier> initial_barriers;
+
+        bool compiled;
+        bool executed;
+};
+
+#endif // RENDER_GRAPH_HPP
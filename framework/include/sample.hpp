@@ -5,6 +5,7 @@
 #include "camera.hpp"
 #include "model.hpp"
 #include "transform.hpp"
+#include "thread_pool.hpp"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -13,6 +14,8 @@
 #include <vector> // std::vector
 #include <array> // std::array
 #include <unordered_map> // std::unordered_map
+#include <functional> // std::function
+#include <memory> // std::unique_ptr
 #include <stdexcept> // std::runtime_error
 #include <iostream> // std::cout, std::endl
 
@@ -28,6 +31,7 @@
 //   - Allocating command buffers, one per swapchain image, to record final rendering commands to
 //   - Creating and initializing the scene depth buffer
 //   - Allocating basic synchronization primitives to aid in presentation
+//   - (Optional) Creating worker threads + per-thread command pools for recording secondary command buffers in parallel
 
 
 class Sample {
@@ -70,10 +74,26 @@ class Sample {
         VkCommandBuffer begin_transient_command_buffer();
         void submit_transient_command_buffer(VkCommandBuffer command_buffer); // Automatically calls vkEndCommandBuffer
         
-        void initialize_descriptor_pool(unsigned buffer_count, unsigned sampler_count);
+        void initialize_descriptor_pool(unsigned buffer_count, unsigned sampler_count, unsigned input_attachment_count = 0, unsigned storage_buffer_count = 0, unsigned storage_image_count = 0);
         
         void take_screenshot(VkImage image, VkFormat format, VkImageLayout layout, const char* filepath);
         
+        // Parallel command buffer recording (requires 'worker_thread_count' to be set during sample construction)
+        // Secondary command buffers are allocated from per-thread command pools for the current frame in flight, and are only valid until the frame is recorded again
+        // The returned command buffers have already been ended and must be executed from a primary command buffer with vkCmdExecuteCommands
+        // Inheritance info with a valid render pass records the secondary command buffers with VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT (the render pass must be started with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+        
+        // Splits the range [0, count) into contiguous chunks, one secondary command buffer per chunk, and invokes 'record(command_buffer, begin, end)' for each chunk on a worker thread
+        // Command buffers are returned in range order, so draw order is preserved when they are executed in sequence
+        std::vector<VkCommandBuffer> record_secondary_command_buffers(const VkCommandBufferInheritanceInfo& inheritance, std::size_t count, const std::function<void(VkCommandBuffer, std::size_t, std::size_t)>& record);
+        
+        // Records each task into its own secondary command buffer on a worker thread (for example, one task per pass)
+        struct SecondaryCommandBufferTask {
+            VkCommandBufferInheritanceInfo inheritance;
+            std::function<void(VkCommandBuffer)> record;
+        };
+        std::vector<VkCommandBuffer> record_secondary_command_buffers(const std::vector<SecondaryCommandBufferTask>& tasks);
+        
         int NUM_FRAMES_IN_FLIGHT = 3; // Increasing this number increases rendering latency by that many frames
         
         // May not correspond 1:1 with the resolution of swapchain internals due to display properties (the resolution of high-density displays does not necessarily match pixel data)
@@ -103,6 +123,10 @@ class Sample {
         // Any physical device features required by the sample must be toggled during sample construction
         VkPhysicalDeviceFeatures enabled_physical_device_features;
         
+        // Vulkan 1.2 core features (timeline semaphores, descriptor indexing, etc.) are toggled the same way
+        // The structure is only chained into device creation if any feature is requested, device creation fails if a requested feature is not supported
+        VkPhysicalDeviceVulkan12Features enabled_vulkan_12_features;
+        
         VkDevice device;
         
         // Any device extensions required by the sample must be added to this list during sample construction
@@ -115,6 +139,16 @@ class Sample {
         unsigned queue_family_index;
         VkQueue queue;
         
+        // Samples that submit compute work asynchronously to graphics work request a second queue during sample construction
+        // A second queue from the graphics queue family is preferred (resources do not need queue family ownership transfers), otherwise a queue from a compute-only family is used
+        // 'compute_queue' is null if no additional queue is available, in which case compute work should be submitted to 'queue'
+        bool async_compute_requested;
+        
+        unsigned compute_queue_family_index;
+        VkQueue compute_queue;
+        VkCommandPool compute_command_pool;
+        std::vector<VkCommandBuffer> compute_command_buffers; // One per frame in flight
+        
         VkSurfaceKHR surface;
         VkSurfaceFormatKHR surface_format;
         VkSurfaceCapabilitiesKHR surface_capabilities;
@@ -141,6 +175,14 @@ class Sample {
         
         VkDescriptorPool descriptor_pool;
         
+        // Number of worker threads for parallel command buffer recording (0 disables parallel recording)
+        // Should be set during sample construction
+        unsigned worker_thread_count;
+        
+        // Minimum number of elements recorded into one secondary command buffer when splitting by range
+        // Avoids spreading small scenes over many secondary command buffers, which costs more to execute than it saves in recording
+        std::size_t minimum_secondary_command_buffer_size;
+        
         struct Settings {
             Settings();
             
@@ -191,6 +233,15 @@ class Sample {
         void allocate_command_buffers();
         void destroy_command_pool();
         
+        // One command pool per worker thread per frame in flight (command pools must be externally synchronized, so each thread records from its own)
+        void create_thread_command_pools();
+        void reset_thread_command_pools(); // Resets all command buffers allocated for the current frame in flight
+        void destroy_thread_command_pools();
+        
+        // Retrieves a secondary command buffer in the initial state from the command pool of the given worker thread for the current frame in flight
+        // Called from worker threads, so errors are returned instead of thrown
+        VkResult acquire_secondary_command_buffer(unsigned thread_index, VkCommandBuffer& command_buffer);
+        
         void create_synchronization_objects();
         void destroy_synchronization_objects();
         
@@ -211,6 +262,15 @@ class Sample {
         // Invoking sample rendering and presenting the results to the screen is handled by the base
         virtual void render();
         
+        std::unique_ptr<ThreadPool> thread_pool;
+        
+        struct ThreadCommandPool {
+            VkCommandPool command_pool;
+            std::vector<VkCommandBuffer> command_buffers; // Secondary command buffers are reused across frames
+            std::size_t used; // Number of command buffers handed out since the last reset
+        };
+        std::vector<std::vector<ThreadCommandPool>> thread_command_pools; // Indexed by [frame in flight][worker thread]
+        
         // Sample data
         bool initialized;
         bool running;
@@ -0,0 +1,57 @@
+
+#ifndef SHADOW_ATLAS_HPP
+#define SHADOW_ATLAS_HPP
+
+#include <vector> // std::vector
+
+// Allocates square regions (slots) of a single shadow map texture (the atlas) for shadows of different resolutions
+// The atlas is recursively subdivided into quadrants (quadtree), a slot occupies exactly one node of the tree, so slot sizes are powers of two
+// Lights request one slot per shadow map (one per directional cascade / spot light, six per point light)
+class ShadowAtlas {
+    public:
+        struct Slot {
+            unsigned x;
+            unsigned y;
+            unsigned size; // 0 if the request could not be allocated
+        };
+
+        // 'size' and 'min_slot_size' must be powers of two
+        ShadowAtlas(unsigned size, unsigned min_slot_size);
+        ~ShadowAtlas();
+
+        // Returns false if there is no free node of the requested size (rounded down to a power of two)
+        bool allocate(unsigned size, Slot& slot);
+
+        // Frees all slots
+        void clear();
+
+        // Clears the atlas and allocates slots for all requested sizes, in order of decreasing size (ties are resolved by request order so that packing is stable between frames)
+        // If the requests do not fit, the largest requests are halved until they do, later requests first (down to the minimum slot size, after which the last requests are dropped)
+        // Sizes of 0 do not request a slot
+        // Returns one slot per request, in the order of requests
+        std::vector<Slot> pack(const std::vector<unsigned>& sizes);
+
+        unsigned get_size() const;
+        unsigned get_min_slot_size() const;
+
+        // Rounds down to the nearest slot size ([min slot size, atlas size]), 0 stays 0
+        unsigned get_slot_size(unsigned size) const;
+
+    private:
+        struct Node {
+            unsigned x;
+            unsigned y;
+            unsigned size;
+            unsigned children; // Index of the first of four children, or 0 for leaf nodes (the root is never a child)
+            bool occupied;
+            unsigned free_area; // Area of all unoccupied leaf nodes in this subtree, for early-outs when searching for space
+        };
+
+        bool allocate(unsigned node, unsigned size, Slot& slot);
+
+        unsigned size;
+        unsigned min_slot_size;
+        std::vector<Node> nodes;
+};
+
+#endif // SHADOW_ATLAS_HPP
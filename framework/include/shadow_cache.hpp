@@ -0,0 +1,98 @@
+
+#ifndef SHADOW_CACHE_HPP
+#define SHADOW_CACHE_HPP
+
+#include <vulkan/vulkan.h>
+#include <vector> // std::vector
+#include <functional> // std::function
+#include <cstddef> // std::size_t
+
+// Caches the shadows of static casters across frames
+// A shadow map is made up of layers (directional light cascades, cube map faces, ...), each rendered with its own light transform
+// Static casters are rendered into a separate shadow map (the shadow cache), a layer of the cache is only re-rendered when its contents change
+// Layers with dynamic casters copy their cached contents into the shadow map and render only the dynamic casters on top of it
+// Objects become dynamic the first time they move, and are rendered into the shadow map (instead of the shadow cache) from then on
+class ShadowCache {
+    public:
+        // Objects are drawn once with one instance per (dirty) layer that can see them
+        // 'first_instance' offsets into the per-instance layer indices written by end_update()
+        struct Draw {
+            unsigned object;
+            unsigned first_instance;
+            unsigned instance_count;
+        };
+
+        // Resources used to record the shadow pass
+        // The shadow map and the shadow cache share the same render pass, which loads its attachment (only the layers whose shadows changed are updated)
+        struct Pass {
+            VkRenderPass render_pass;
+            VkRect2D render_area;
+
+            VkFramebuffer framebuffer;
+            VkImage image;
+
+            VkFramebuffer cache_framebuffer;
+            VkImage cache_image;
+
+            unsigned layer_count; // Array layers of both images
+
+            VkPipeline pipeline;
+            VkPipelineLayout pipeline_layout;
+            VkDescriptorSet descriptor_set; // Bound to set 0
+        };
+
+        ShadowCache();
+        ~ShadowCache();
+
+        // All layers are rendered on the next update
+        void initialize(std::size_t object_count, std::size_t layer_count);
+
+        // Contents of the shadow map / cache are undefined (all layers are rendered on the next update)
+        void invalidate();
+
+        // Layers are updated once per frame: begin_update(), then update_layer() or skip_layer() for every layer, then end_update()
+        // 'moved_objects' holds the objects with a dirty transform this frame (see FrustumCuller::update_objects)
+        void begin_update(const std::vector<unsigned>& moved_objects);
+
+        // 'casters' holds the objects inside of the light frustum of the layer (ascending, see FrustumCuller::cull)
+        // The cached layer is invalidated if 'layer_moved' is set (the light transform or the region of the layer changed since the last update), or its set of static casters shrinks
+        void update_layer(unsigned layer, const std::vector<unsigned>& casters, bool layer_moved);
+
+        // Layers that are not rendered this frame are fully re-rendered once they are updated again
+        void skip_layer(unsigned layer);
+
+        // Writes the layer index of every instance to 'instances', static casters to the first half, dynamic casters to the second
+        // 'instances' must hold 2 * objects * layers indices, 'first_instance' is the index of its first element in the instance buffer
+        void end_update(unsigned* instances, unsigned first_instance);
+
+        // Re-renders the invalidated layers of the shadow cache, copies the dirty layers into the shadow map, and renders dynamic casters on top of them
+        // 'get_region' returns the region of the images that holds a layer, 'record_draws' records the given draws (the pipeline and descriptor set 0 are bound)
+        // Both images are expected to be (and are left) in VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL
+        void record(VkCommandBuffer command_buffer, const Pass& pass, const std::function<VkClearRect(unsigned)>& get_region, const std::function<void(VkCommandBuffer, const std::vector<Draw>&)>& record_draws) const;
+
+        // Layer of the shadow cache is re-rendered this frame
+        bool is_cache_dirty(unsigned layer) const;
+
+        // Layer of the shadow map is re-composited (copied from the shadow cache + dynamic casters) this frame
+        bool is_dirty(unsigned layer) const;
+
+    private:
+        void build_draws(const std::vector<bool>& layers, const std::vector<std::vector<unsigned>>& casters, unsigned* instances, unsigned first_instance, std::vector<Draw>& output) const;
+
+        std::vector<bool> dynamic_objects;
+        std::vector<unsigned> moved_objects; // Objects with a dirty transform this frame
+        std::vector<unsigned> new_dynamic_objects; // Objects that moved for the first time this frame
+
+        std::vector<std::vector<unsigned>> static_casters; // Indices of the static objects inside the frustum of each layer (ascending), as of the last update
+        std::vector<std::vector<unsigned>> dynamic_casters; // Indices of the dynamic objects inside the frustum of each layer (ascending), as of the last update
+
+        std::vector<bool> cache_dirty;
+        std::vector<bool> dirty;
+        std::vector<bool> skipped; // Layers that were not rendered by the last update
+        bool invalidated;
+
+        std::vector<Draw> cache_draws; // Static objects drawn into the shadow cache this frame
+        std::vector<Draw> draws; // Dynamic objects drawn into the shadow map this frame
+};
+
+#endif // SHADOW_CACHE_HPP
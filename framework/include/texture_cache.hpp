@@ -0,0 +1,59 @@
+
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <filesystem> // std::filesystem::path
+#include <vector> // std::vector
+#include <cstdint> // std::uint64_t
+#include <cstddef> // std::size_t
+
+// Texel data of a texture (all mip levels and array layers) in host memory
+// Mip levels are stored in order of decreasing size, all layers of a mip level are consecutive, and texels are tightly packed (matches vkCmdCopyImageToBuffer / vkCmdCopyBufferToImage with one region per mip level)
+struct CachedTexture {
+    unsigned format; // VkFormat
+    unsigned width; // Of mip level 0
+    unsigned height;
+    unsigned layers;
+    unsigned levels;
+    unsigned texel_size; // Bytes
+    std::vector<unsigned char> data;
+
+    unsigned get_level_width(unsigned level) const;
+    unsigned get_level_height(unsigned level) const;
+
+    // Offset / size of the data of a mip level (all layers), in bytes
+    std::size_t get_level_offset(unsigned level) const;
+    std::size_t get_level_size(unsigned level) const;
+
+    // Size of all mip levels, in bytes
+    std::size_t get_size() const;
+};
+
+// On-disk cache for textures that are expensive to generate at startup (for example, precomputed image-based lighting)
+// Each texture is stored in its own file as a raw container: a header (magic, container version, key, texture description) followed by the texel data of all mip levels
+// Entries are looked up by name and are only loaded if their key matches, so keys should hash all inputs used to generate the texture (source files, parameters, shaders)
+// Stale entries are replaced the next time the texture is generated and saved
+class TextureCache {
+    public:
+        // Relative directories are relative to the working directory
+        explicit TextureCache(const std::filesystem::path& directory);
+        ~TextureCache();
+
+        // 64-bit FNV-1a, 'seed' chains multiple inputs into a single key
+        static std::uint64_t hash(const void* data, std::size_t size, std::uint64_t seed = 14695981039346656037ull);
+        static std::uint64_t hash_file(const std::filesystem::path& filepath, std::uint64_t seed = 14695981039346656037ull);
+
+        // Returns false if there is no valid entry for 'name' with the given key (missing, stale, truncated, or written by a different container version)
+        bool load(const char* name, std::uint64_t key, CachedTexture& texture) const;
+
+        // Returns false if the entry could not be written (the cache is an optimization, failing to write an entry is not an error)
+        // Entries are written to a temporary file first so that an interrupted write never leaves a truncated entry behind
+        bool save(const char* name, std::uint64_t key, const CachedTexture& texture) const;
+
+    private:
+        std::filesystem::path get_filepath(const char* name) const;
+
+        std::filesystem::path directory;
+};
+
+#endif // TEXTURE_CACHE_HPP
@@ -0,0 +1,50 @@
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector> // std::vector
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <functional> // std::function
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+
+// Fixed-size pool of worker threads for fork-join style work (such as recording secondary command buffers in parallel)
+// Each worker has a stable index in [0, size()), which allows per-thread resources (command pools, scratch memory) to be accessed without locking
+class ThreadPool {
+    public:
+        // A thread count of 0 uses std::thread::hardware_concurrency()
+        explicit ThreadPool(unsigned thread_count = 0u);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned size() const;
+
+        // Invokes 'task(thread_index, task_index)' for every task_index in [0, task_count) across all worker threads, and blocks until all tasks have completed
+        // Tasks are distributed dynamically, so a worker may execute more than one task (always sequentially)
+        // Must not be called from within a task
+        void dispatch(std::size_t task_count, const std::function<void(unsigned, std::size_t)>& task);
+
+    private:
+        void worker(unsigned thread_index);
+
+        std::vector<std::thread> threads;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable work_complete;
+
+        // State of the current dispatch (guarded by 'mutex', except for 'next_task', which workers claim atomically)
+        const std::function<void(unsigned, std::size_t)>* task;
+        std::size_t task_count;
+        std::atomic<std::size_t> next_task;
+        unsigned active_workers;
+        std::size_t generation; // Incremented for every dispatch so that workers do not run the same dispatch twice
+
+        bool running;
+};
+
+#endif // THREAD_POOL_HPP
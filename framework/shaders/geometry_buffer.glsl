@@ -0,0 +1,52 @@
+
+// Compact geometry buffer layout, shared by the deferred samples (see geometry_buffer.hpp)
+//   - depth (D32): positions are reconstructed from depth and the inverse projection
+//   - normal (RG16_SNORM): unit normal, octahedral encoded
+//   - material (RGBA8_UNORM): diffuse color (rgb) + material index (a)
+// Material terms that are constant across a surface (ambient, specular color, specular exponent) are looked up from a table of materials by index
+
+#ifndef GEOMETRY_BUFFER_GLSL
+#define GEOMETRY_BUFFER_GLSL
+
+struct Material {
+    vec4 ambient; // (r, g, b, unused)
+    vec4 specular; // (r, g, b, exponent)
+};
+
+// Octahedral normal encoding: the unit sphere is projected onto an octahedron, which is unfolded onto the [-1, 1] square
+// https://jcgt.org/published/0003/02/01/
+vec2 sign_not_zero(vec2 v) {
+    return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+vec2 encode_normal(vec3 n) {
+    vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+
+    // Lower hemisphere is folded over the diagonals
+    return n.z >= 0.0f ? p : (1.0f - abs(p.yx)) * sign_not_zero(p);
+}
+
+vec3 decode_normal(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f) {
+        n.xy = (1.0f - abs(n.yx)) * sign_not_zero(n.xy);
+    }
+    return normalize(n);
+}
+
+vec4 encode_material(vec3 diffuse, uint index) {
+    return vec4(diffuse, float(index) / 255.0f);
+}
+
+uint decode_material_index(vec4 material) {
+    return uint(material.a * 255.0f + 0.5f);
+}
+
+// The space of the result depends on the given matrix (inverse projection - view space, inverse projection * view - world space)
+// Assumes a [0, 1] depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE, see camera.hpp)
+vec3 reconstruct_position(vec2 uv, float depth, mat4 inverse_projection) {
+    vec4 position = inverse_projection * vec4(uv * 2.0f - 1.0f, depth, 1.0f);
+    return position.xyz / position.w;
+}
+
+#endif // GEOMETRY_BUFFER_GLSL
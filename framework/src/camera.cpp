@@ -4,11 +4,14 @@
 #include <glm/gtx/transform.hpp>
 
 Camera::Camera(glm::vec3 position) : dirty(true),
+                                     has_previous(false),
                                      eye(position),
                                      look_at(glm::normalize(glm::vec3(0.0f) - eye)),
                                      up(glm::vec3(0.0f, 1.0f, 0.0f)),
                                      view(),
                                      projection(),
+                                     previous_view(),
+                                     previous_projection(),
                                      near(0.01f),
                                      far(100.0f) {
 }
@@ -48,6 +51,26 @@ glm::mat4 Camera::get_projection_matrix() {
     return projection;
 }
 
+glm::mat4 Camera::get_previous_view_matrix() {
+    if (!has_previous) {
+        return get_view_matrix();
+    }
+    return previous_view;
+}
+
+glm::mat4 Camera::get_previous_projection_matrix() {
+    if (!has_previous) {
+        return get_projection_matrix();
+    }
+    return previous_projection;
+}
+
+void Camera::end_frame() {
+    previous_view = get_view_matrix();
+    previous_projection = get_projection_matrix();
+    has_previous = true;
+}
+
 void Camera::recalculate() {
     view = glm::lookAt(eye, look_at, up);
     
@@ -0,0 +1,308 @@
+
+#include "frustum_culling.hpp"
+#include <cmath> // std::abs, std::sqrt
+#include <algorithm> // std::max
+
+// The 8-wide path only requires AVX float operations, which are enabled by the ENABLE_AVX2 option (framework/CMakeLists.txt)
+// SSE2 is part of the x86-64 baseline and is used as a 4-wide fallback
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define FRUSTUM_CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define FRUSTUM_CULLING_SSE
+#endif
+
+namespace {
+    constexpr std::size_t block_size = 8; // Arrays are padded to the widest supported SIMD width
+
+    std::size_t round_up(std::size_t value, std::size_t multiple) {
+        return ((value + multiple - 1) / multiple) * multiple;
+    }
+
+    glm::vec4 normalize_plane(glm::vec4 plane) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        return plane / length;
+    }
+}
+
+Frustum extract_frustum_planes(const glm::mat4& camera) {
+    // GLM matrices are column-major (camera[column][row])
+    glm::vec4 row0 = glm::vec4(camera[0][0], camera[1][0], camera[2][0], camera[3][0]);
+    glm::vec4 row1 = glm::vec4(camera[0][1], camera[1][1], camera[2][1], camera[3][1]);
+    glm::vec4 row2 = glm::vec4(camera[0][2], camera[1][2], camera[2][2], camera[3][2]);
+    glm::vec4 row3 = glm::vec4(camera[0][3], camera[1][3], camera[2][3], camera[3][3]);
+
+    // A point is inside the frustum if -w <= x <= w, -w <= y <= w, and 0 <= z <= w in clip space
+    // Note: the camera flips the y axis of the projection matrix for Vulkan, which swaps which plane is the top / bottom plane (the set of planes remains the same)
+    Frustum frustum { };
+    frustum.planes[Frustum::LEFT_PLANE] = normalize_plane(row3 + row0);
+    frustum.planes[Frustum::RIGHT_PLANE] = normalize_plane(row3 - row0);
+    frustum.planes[Frustum::BOTTOM_PLANE] = normalize_plane(row3 + row1);
+    frustum.planes[Frustum::TOP_PLANE] = normalize_plane(row3 - row1);
+    frustum.planes[Frustum::NEAR_PLANE] = normalize_plane(row2); // [0, 1] depth range
+    frustum.planes[Frustum::FAR_PLANE] = normalize_plane(row3 - row2);
+    return frustum;
+}
+
+FrustumCuller::FrustumCuller() : count(0u) {
+}
+
+FrustumCuller::~FrustumCuller() {
+}
+
+unsigned FrustumCuller::add(glm::vec3 min, glm::vec3 max, const glm::mat4& transform) {
+    unsigned index = static_cast<unsigned>(count);
+    if (count + 1 > sphere_x.size()) {
+        resize(round_up(std::max(count + 1, count * 2), block_size));
+    }
+    ++count;
+
+    update(index, min, max, transform);
+    return index;
+}
+
+void FrustumCuller::update(unsigned index, glm::vec3 min, glm::vec3 max, const glm::mat4& transform) {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+
+    // Transform the AABB into world space (Arvo's method)
+    // The world-space extents are the absolute values of the transform's upper 3x3 applied to the model-space extents
+    glm::vec3 world_center = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 world_extent;
+    for (int row = 0; row < 3; ++row) {
+        world_extent[row] = std::abs(transform[0][row]) * extent.x + std::abs(transform[1][row]) * extent.y + std::abs(transform[2][row]) * extent.z;
+    }
+
+    center_x[index] = world_center.x;
+    center_y[index] = world_center.y;
+    center_z[index] = world_center.z;
+    extent_x[index] = world_extent.x;
+    extent_y[index] = world_extent.y;
+    extent_z[index] = world_extent.z;
+
+    // Bounding sphere of the model-space AABB, scaled by the largest axis scale of the transform
+    // For rotated objects this is tighter than the sphere around the world-space AABB
+    float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+    sphere_x[index] = world_center.x;
+    sphere_y[index] = world_center.y;
+    sphere_z[index] = world_center.z;
+    sphere_radius[index] = glm::length(extent) * scale;
+}
+
+void FrustumCuller::clear() {
+    count = 0u;
+}
+
+std::size_t FrustumCuller::size() const {
+    return count;
+}
+
+void FrustumCuller::resize(std::size_t capacity) {
+    sphere_x.resize(capacity, 0.0f);
+    sphere_y.resize(capacity, 0.0f);
+    sphere_z.resize(capacity, 0.0f);
+    sphere_radius.resize(capacity, 0.0f);
+
+    center_x.resize(capacity, 0.0f);
+    center_y.resize(capacity, 0.0f);
+    center_z.resize(capacity, 0.0f);
+    extent_x.resize(capacity, 0.0f);
+    extent_y.resize(capacity, 0.0f);
+    extent_z.resize(capacity, 0.0f);
+}
+
+std::size_t FrustumCuller::cull(const glm::mat4& camera, std::vector<unsigned>& visible) const {
+    return cull(extract_frustum_planes(camera), visible);
+}
+
+#if defined(FRUSTUM_CULLING_AVX)
+
+std::size_t FrustumCuller::cull(const Frustum& frustum, std::vector<unsigned>& visible) const {
+    visible.clear();
+    visible.reserve(count);
+
+    // Broadcast plane components once, outside of the main loop
+    __m256 nx[Frustum::PLANE_COUNT];
+    __m256 ny[Frustum::PLANE_COUNT];
+    __m256 nz[Frustum::PLANE_COUNT];
+    __m256 nw[Frustum::PLANE_COUNT];
+
+    // Absolute values of the plane normals, for projecting AABB extents onto the plane normal
+    __m256 ax[Frustum::PLANE_COUNT];
+    __m256 ay[Frustum::PLANE_COUNT];
+    __m256 az[Frustum::PLANE_COUNT];
+
+    for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        nx[p] = _mm256_set1_ps(plane.x);
+        ny[p] = _mm256_set1_ps(plane.y);
+        nz[p] = _mm256_set1_ps(plane.z);
+        nw[p] = _mm256_set1_ps(plane.w);
+        ax[p] = _mm256_set1_ps(std::abs(plane.x));
+        ay[p] = _mm256_set1_ps(std::abs(plane.y));
+        az[p] = _mm256_set1_ps(std::abs(plane.z));
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (std::size_t base = 0u; base < count; base += 8) {
+        // Sphere test: signed distance from every plane must be greater than -radius
+        __m256 x = _mm256_loadu_ps(&sphere_x[base]);
+        __m256 y = _mm256_loadu_ps(&sphere_y[base]);
+        __m256 z = _mm256_loadu_ps(&sphere_z[base]);
+        __m256 r = _mm256_loadu_ps(&sphere_radius[base]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)), _mm256_add_ps(_mm256_mul_ps(nz[p], z), nw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+        }
+
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+        if (count - base < 8) {
+            // Mask out padding lanes
+            mask &= (1u << (count - base)) - 1u;
+        }
+
+        if (mask == 0u) {
+            // All 8 objects are outside the frustum, skip the more expensive AABB test
+            continue;
+        }
+
+        // AABB test: the projected radius of the box onto the plane normal is dot(abs(n), extent)
+        __m256 cx = _mm256_loadu_ps(&center_x[base]);
+        __m256 cy = _mm256_loadu_ps(&center_y[base]);
+        __m256 cz = _mm256_loadu_ps(&center_z[base]);
+        __m256 ex = _mm256_loadu_ps(&extent_x[base]);
+        __m256 ey = _mm256_loadu_ps(&extent_y[base]);
+        __m256 ez = _mm256_loadu_ps(&extent_z[base]);
+
+        inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)), _mm256_add_ps(_mm256_mul_ps(nz[p], cz), nw[p]));
+            __m256 projected = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, projected), zero, _CMP_GE_OQ));
+        }
+        mask &= static_cast<unsigned>(_mm256_movemask_ps(inside));
+
+        for (unsigned lane = 0u; mask != 0u; ++lane, mask >>= 1u) {
+            if (mask & 1u) {
+                visible.emplace_back(static_cast<unsigned>(base + lane));
+            }
+        }
+    }
+
+    return visible.size();
+}
+
+#elif defined(FRUSTUM_CULLING_SSE)
+
+std::size_t FrustumCuller::cull(const Frustum& frustum, std::vector<unsigned>& visible) const {
+    visible.clear();
+    visible.reserve(count);
+
+    __m128 nx[Frustum::PLANE_COUNT];
+    __m128 ny[Frustum::PLANE_COUNT];
+    __m128 nz[Frustum::PLANE_COUNT];
+    __m128 nw[Frustum::PLANE_COUNT];
+    __m128 ax[Frustum::PLANE_COUNT];
+    __m128 ay[Frustum::PLANE_COUNT];
+    __m128 az[Frustum::PLANE_COUNT];
+
+    for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        nx[p] = _mm_set1_ps(plane.x);
+        ny[p] = _mm_set1_ps(plane.y);
+        nz[p] = _mm_set1_ps(plane.z);
+        nw[p] = _mm_set1_ps(plane.w);
+        ax[p] = _mm_set1_ps(std::abs(plane.x));
+        ay[p] = _mm_set1_ps(std::abs(plane.y));
+        az[p] = _mm_set1_ps(std::abs(plane.z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+
+    for (std::size_t base = 0u; base < count; base += 4) {
+        __m128 x = _mm_loadu_ps(&sphere_x[base]);
+        __m128 y = _mm_loadu_ps(&sphere_y[base]);
+        __m128 z = _mm_loadu_ps(&sphere_z[base]);
+        __m128 r = _mm_loadu_ps(&sphere_radius[base]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)), _mm_add_ps(_mm_mul_ps(nz[p], z), nw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+        }
+
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(inside));
+        if (count - base < 4) {
+            mask &= (1u << (count - base)) - 1u;
+        }
+
+        if (mask == 0u) {
+            continue;
+        }
+
+        __m128 cx = _mm_loadu_ps(&center_x[base]);
+        __m128 cy = _mm_loadu_ps(&center_y[base]);
+        __m128 cz = _mm_loadu_ps(&center_z[base]);
+        __m128 ex = _mm_loadu_ps(&extent_x[base]);
+        __m128 ey = _mm_loadu_ps(&extent_y[base]);
+        __m128 ez = _mm_loadu_ps(&extent_z[base]);
+
+        inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+            __m128 projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, projected), zero));
+        }
+        mask &= static_cast<unsigned>(_mm_movemask_ps(inside));
+
+        for (unsigned lane = 0u; mask != 0u; ++lane, mask >>= 1u) {
+            if (mask & 1u) {
+                visible.emplace_back(static_cast<unsigned>(base + lane));
+            }
+        }
+    }
+
+    return visible.size();
+}
+
+#else
+
+std::size_t FrustumCuller::cull(const Frustum& frustum, std::vector<unsigned>& visible) const {
+    // No SIMD support for the target architecture
+    return cull_scalar(frustum, visible);
+}
+
+#endif
+
+std::size_t FrustumCuller::cull_scalar(const Frustum& frustum, std::vector<unsigned>& visible) const {
+    visible.clear();
+    visible.reserve(count);
+
+    for (std::size_t i = 0u; i < count; ++i) {
+        bool inside = true;
+
+        for (int p = 0; inside && p < Frustum::PLANE_COUNT; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            float d = plane.x * sphere_x[i] + plane.y * sphere_y[i] + plane.z * sphere_z[i] + plane.w;
+            inside = d + sphere_radius[i] >= 0.0f;
+        }
+
+        for (int p = 0; inside && p < Frustum::PLANE_COUNT; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            float d = plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w;
+            float projected = std::abs(plane.x) * extent_x[i] + std::abs(plane.y) * extent_y[i] + std::abs(plane.z) * extent_z[i];
+            inside = d + projected >= 0.0f;
+        }
+
+        if (inside) {
+            visible.emplace_back(static_cast<unsigned>(i));
+        }
+    }
+
+    return visible.size();
+}
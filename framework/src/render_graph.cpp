@@ -0,0 +1,1206 @@
+
+#include "render_graph.hpp"
+#include "helpers.hpp"
+#include "vulkan_initializers.hpp"
+#include <stdexcept> // std::runtime_error
+#include <iostream> // std::cout, std::endl
+#include <algorithm> // std::find, std::stable_sort, std::max
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, Pass pass) : graph(graph),
+                                                                       pass(pass) {
+}
+
+void RenderGraph::PassBuilder::write_color(Resource resource, VkAttachmentLoadOp load, VkClearColorValue clear) {
+    VkClearValue clear_value { };
+    clear_value.color = clear;
+    graph.add_usage(pass, resource, Usage::COLOR_ATTACHMENT, load, clear_value, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+}
+
+void RenderGraph::PassBuilder::write_depth(Resource resource, VkAttachmentLoadOp load, VkClearDepthStencilValue clear) {
+    VkClearValue clear_value { };
+    clear_value.depthStencil = clear;
+    graph.add_usage(pass, resource, Usage::DEPTH_ATTACHMENT, load, clear_value, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+}
+
+void RenderGraph::PassBuilder::read_depth(Resource resource) {
+    graph.add_usage(pass, resource, Usage::DEPTH_READ, VK_ATTACHMENT_LOAD_OP_LOAD, { }, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+}
+
+void RenderGraph::PassBuilder::read_input_attachment(Resource resource) {
+    graph.add_usage(pass, resource, Usage::INPUT_ATTACHMENT, VK_ATTACHMENT_LOAD_OP_LOAD, { }, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+void RenderGraph::PassBuilder::read_texture(Resource resource, VkPipelineStageFlags stages) {
+    graph.add_usage(pass, resource, Usage::TEXTURE, VK_ATTACHMENT_LOAD_OP_LOAD, { }, stages);
+}
+
+void RenderGraph::PassBuilder::read_storage_image(Resource resource, VkPipelineStageFlags stages) {
+    graph.add_usage(pass, resource, Usage::STORAGE_READ, VK_ATTACHMENT_LOAD_OP_LOAD, { }, stages);
+}
+
+void RenderGraph::PassBuilder::write_storage_image(Resource resource, VkPipelineStageFlags stages, VkAttachmentLoadOp load) {
+    graph.add_usage(pass, resource, Usage::STORAGE_WRITE, load, { }, stages);
+}
+
+void RenderGraph::PassBuilder::set_side_effects() {
+    graph.passes[pass].side_effects = true;
+}
+
+void RenderGraph::PassBuilder::set_subpass_contents(VkSubpassContents contents) {
+    graph.passes[pass].contents = contents;
+}
+
+RenderGraph::RenderGraph(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent) : physical_device(physical_device),
+                                                                                                 device(device),
+                                                                                                 extent(extent),
+                                                                                                 resources(),
+                                                                                                 passes(),
+                                                                                                 groups(),
+                                                                                                 allocations(),
+                                                                                                 final_barriers(),
+                                                                                                 initial_barriers(),
+                                                                                                 compiled(false),
+                                                                                                 executed(false) {
+}
+
+RenderGraph::~RenderGraph() {
+    destroy();
+}
+
+RenderGraph::Resource RenderGraph::create_image(const char* name, const ImageDescription& description) {
+    if (compiled) {
+        throw std::runtime_error("render graph resources must be created before the graph is compiled!");
+    }
+
+    ImageResource& resource = resources.emplace_back();
+    resource.name = name;
+    resource.description = description;
+    resource.extent.width = description.width ? description.width : extent.width;
+    resource.extent.height = description.height ? description.height : extent.height;
+    resource.imported = false;
+    resource.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.initial_stages = 0;
+    resource.final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.image = VK_NULL_HANDLE;
+    resource.memory = VK_NULL_HANDLE;
+    resource.image_view = VK_NULL_HANDLE;
+    resource.aspect = is_depth_format(description.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    resource.usage = description.usage;
+    resource.memory_requirements = { };
+    resource.used = false;
+    resource.transient = false;
+    resource.first_group = INVALID;
+    resource.last_group = INVALID;
+    resource.allocation = INVALID;
+    resource.state = { };
+
+    return (Resource) (resources.size() - 1u);
+}
+
+RenderGraph::Resource RenderGraph::import_image(const char* name, VkImage image, VkImageView image_view, VkFormat format, VkExtent2D image_extent, VkImageLayout initial_layout, VkPipelineStageFlags initial_stages, VkImageLayout final_layout) {
+    if (compiled) {
+        throw std::runtime_error("render graph resources must be imported before the graph is compiled!");
+    }
+
+    ImageResource& resource = resources.emplace_back();
+    resource.name = name;
+    resource.description.format = format;
+    resource.description.width = image_extent.width;
+    resource.description.height = image_extent.height;
+    resource.extent = image_extent;
+    resource.imported = true;
+    resource.initial_layout = initial_layout;
+    resource.initial_stages = initial_stages;
+    resource.final_layout = final_layout;
+    resource.image = image;
+    resource.memory = VK_NULL_HANDLE;
+    resource.image_view = image_view;
+    resource.aspect = is_depth_format(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    resource.usage = 0;
+    resource.memory_requirements = { };
+    resource.used = false;
+    resource.transient = false;
+    resource.first_group = INVALID;
+    resource.last_group = INVALID;
+    resource.allocation = INVALID;
+    resource.state = { };
+
+    return (Resource) (resources.size() - 1u);
+}
+
+void RenderGraph::set_imported_image(Resource resource, VkImage image, VkImageView image_view) {
+    if (resource >= resources.size() || !resources[resource].imported) {
+        throw std::runtime_error("render graph resource is not an imported resource!");
+    }
+
+    resources[resource].image = image;
+    resources[resource].image_view = image_view;
+}
+
+RenderGraph::Pass RenderGraph::add_graphics_pass(const char* name, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute) {
+    return add_pass(name, false, setup, execute);
+}
+
+RenderGraph::Pass RenderGraph::add_compute_pass(const char* name, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute) {
+    return add_pass(name, true, setup, execute);
+}
+
+RenderGraph::Pass RenderGraph::add_pass(const char* name, bool compute, const std::function<void(PassBuilder&)>& setup, const std::function<void(VkCommandBuffer)>& execute) {
+    if (compiled) {
+        throw std::runtime_error("render graph passes must be added before the graph is compiled!");
+    }
+
+    Pass pass = (Pass) passes.size();
+
+    PassData& data = passes.emplace_back();
+    data.name = name;
+    data.compute = compute;
+    data.side_effects = false;
+    data.contents = VK_SUBPASS_CONTENTS_INLINE;
+    data.execute = execute;
+    data.culled = false;
+    data.group = INVALID;
+    data.subpass = 0u;
+
+    PassBuilder builder(*this, pass);
+    setup(builder);
+
+    return pass;
+}
+
+void RenderGraph::add_usage(Pass pass, Resource resource, Usage usage, VkAttachmentLoadOp load, VkClearValue clear, VkPipelineStageFlags stages) {
+    if (resource >= resources.size()) {
+        throw std::runtime_error("invalid render graph resource used by pass '" + passes[pass].name + "'!");
+    }
+
+    if (passes[pass].compute && is_attachment(usage)) {
+        throw std::runtime_error("compute pass '" + passes[pass].name + "' cannot use '" + resources[resource].name + "' as an attachment!");
+    }
+
+    passes[pass].usages.push_back({ resource, usage, load, clear, stages });
+}
+
+void RenderGraph::compile() {
+    if (compiled) {
+        return;
+    }
+
+    cull_passes();
+    schedule_passes();
+    allocate_resources();
+
+    for (Group& group : groups) {
+        if (!group.compute) {
+            create_render_pass(group);
+        }
+    }
+
+    generate_barriers();
+
+    compiled = true;
+}
+
+void RenderGraph::cull_passes() {
+    // Walk passes backwards, keeping track of which resources still have consumers
+    // A pass is only kept if it writes a resource that is consumed by a later pass (or is an output of the graph)
+    // Writing a resource without reading its contents (clearing) satisfies all consumers after it, so passes before it that write the same resource are culled
+    std::vector<bool> needed(resources.size(), false);
+    for (std::size_t i = 0u; i < resources.size(); ++i) {
+        needed[i] = resources[i].imported;
+    }
+
+    for (std::size_t i = passes.size(); i-- > 0u; ) {
+        PassData& pass = passes[i];
+
+        bool keep = pass.side_effects;
+        for (const ResourceUsage& usage : pass.usages) {
+            if (is_write(usage) && needed[usage.resource]) {
+                keep = true;
+            }
+        }
+
+        pass.culled = !keep;
+        if (pass.culled) {
+            continue;
+        }
+
+        for (const ResourceUsage& usage : pass.usages) {
+            if (is_write(usage) && !reads_contents(usage)) {
+                needed[usage.resource] = false;
+            }
+        }
+
+        for (const ResourceUsage& usage : pass.usages) {
+            if (reads_contents(usage)) {
+                needed[usage.resource] = true;
+            }
+        }
+    }
+
+    for (const PassData& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        for (const ResourceUsage& usage : pass.usages) {
+            resources[usage.resource].used = true;
+        }
+    }
+}
+
+void RenderGraph::schedule_passes() {
+    for (std::size_t i = 0u; i < passes.size(); ++i) {
+        PassData& pass = passes[i];
+        if (pass.culled) {
+            continue;
+        }
+
+        if (groups.empty() || !can_merge(groups.back(), pass)) {
+            Group& group = groups.emplace_back();
+            group.compute = pass.compute;
+            group.render_pass = VK_NULL_HANDLE;
+            group.extent = extent;
+
+            // Render area is determined by the attachments of the first pass
+            for (const ResourceUsage& usage : pass.usages) {
+                if (is_attachment(usage.usage)) {
+                    group.extent = resources[usage.resource].extent;
+                    break;
+                }
+            }
+        }
+
+        Group& group = groups.back();
+        pass.group = (unsigned) (groups.size() - 1u);
+        pass.subpass = (unsigned) group.passes.size();
+        group.passes.push_back((Pass) i);
+    }
+}
+
+bool RenderGraph::can_merge(const Group& group, const PassData& pass) const {
+    if (group.compute || pass.compute) {
+        return false;
+    }
+
+    bool has_attachments = false;
+
+    for (const ResourceUsage& usage : pass.usages) {
+        const ImageResource& resource = resources[usage.resource];
+
+        if (is_attachment(usage.usage)) {
+            has_attachments = true;
+
+            // All attachments of a render pass must have the same dimensions
+            if (resource.extent.width != group.extent.width || resource.extent.height != group.extent.height) {
+                return false;
+            }
+        }
+
+        for (Pass other : group.passes) {
+            for (const ResourceUsage& other_usage : passes[other].usages) {
+                if (other_usage.resource != usage.resource) {
+                    continue;
+                }
+
+                // Resources that are accessed outside of the current pixel (sampled / storage) require a pipeline barrier between the passes, which cannot be expressed within a render pass
+                if (!is_attachment(usage.usage) || !is_attachment(other_usage.usage)) {
+                    return false;
+                }
+
+                // Load operations only apply to the first use of an attachment in a render pass, so clearing an attachment that has already been used requires a new render pass
+                if (is_write(usage) && !reads_contents(usage)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return has_attachments;
+}
+
+void RenderGraph::allocate_resources() {
+    for (const PassData& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        for (const ResourceUsage& usage : pass.usages) {
+            ImageResource& resource = resources[usage.resource];
+            switch (usage.usage) {
+                case Usage::COLOR_ATTACHMENT:
+                    resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                    break;
+                case Usage::DEPTH_ATTACHMENT:
+                case Usage::DEPTH_READ:
+                    resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                    break;
+                case Usage::INPUT_ATTACHMENT:
+                    resource.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+                    break;
+                case Usage::TEXTURE:
+                    resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                    break;
+                case Usage::STORAGE_READ:
+                case Usage::STORAGE_WRITE:
+                    resource.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+                    break;
+            }
+        }
+    }
+
+    // Lifetime of each resource within a frame, in physical passes
+    std::vector<bool> attachment_only(resources.size(), true);
+    std::vector<bool> first_use(resources.size(), true);
+    std::vector<bool> reads_previous_frame(resources.size(), false);
+
+    for (const PassData& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        for (const ResourceUsage& usage : pass.usages) {
+            ImageResource& resource = resources[usage.resource];
+
+            if (first_use[usage.resource]) {
+                resource.first_group = pass.group;
+                reads_previous_frame[usage.resource] = reads_contents(usage);
+                first_use[usage.resource] = false;
+            }
+            resource.last_group = pass.group;
+            attachment_only[usage.resource] = attachment_only[usage.resource] && is_attachment(usage.usage);
+        }
+    }
+
+    // Images that are only ever accessed as attachments of a single render pass never need to be backed by memory outside of that render pass
+    // These are created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, and use lazily allocated memory where supported (tile-based GPUs can keep them entirely in on-chip tile memory)
+    for (std::size_t i = 0u; i < resources.size(); ++i) {
+        ImageResource& resource = resources[i];
+        if (resource.imported || !resource.used) {
+            continue;
+        }
+
+        VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        resource.transient = attachment_only[i] && resource.first_group == resource.last_group && !reads_previous_frame[i] && (resource.usage & ~attachment_usage) == 0;
+        if (resource.transient) {
+            resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+
+        ::create_image(device, resource.extent.width, resource.extent.height, 1, 1, resource.description.samples, resource.description.format, VK_IMAGE_TILING_OPTIMAL, resource.usage, 0, resource.image);
+        vkGetImageMemoryRequirements(device, resource.image, &resource.memory_requirements);
+    }
+
+    // Images whose lifetimes do not overlap within a frame can share the same memory
+    // Only images that do not need their contents from the previous frame can be aliased, as the contents of aliased memory are undefined after another image uses it
+    // Images are assigned largest first to the first allocation that has no overlapping lifetimes (and a compatible memory type), which keeps the number of allocations (and the peak memory) low
+    std::vector<Resource> candidates;
+    for (std::size_t i = 0u; i < resources.size(); ++i) {
+        const ImageResource& resource = resources[i];
+        if (!resource.imported && resource.used && !resource.transient) {
+            candidates.push_back((Resource) i);
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [this](Resource a, Resource b) {
+        return resources[a].memory_requirements.size > resources[b].memory_requirements.size;
+    });
+
+    for (Resource r : candidates) {
+        ImageResource& resource = resources[r];
+
+        resource.allocation = INVALID;
+        if (!reads_previous_frame[r]) {
+            for (std::size_t a = 0u; a < allocations.size() && resource.allocation == INVALID; ++a) {
+                Allocation& allocation = allocations[a];
+                if (allocation.lazy || (allocation.memory_type_bits & resource.memory_requirements.memoryTypeBits) == 0) {
+                    continue;
+                }
+
+                bool overlaps = false;
+                for (Resource other : allocation.resources) {
+                    const ImageResource& alias = resources[other];
+                    if (reads_previous_frame[other] || (resource.first_group <= alias.last_group && alias.first_group <= resource.last_group)) {
+                        overlaps = true;
+                        break;
+                    }
+                }
+
+                if (!overlaps) {
+                    resource.allocation = (unsigned) a;
+                }
+            }
+        }
+
+        if (resource.allocation == INVALID) {
+            resource.allocation = (unsigned) allocations.size();
+            allocations.emplace_back();
+            allocations.back().memory_type_bits = resource.memory_requirements.memoryTypeBits;
+        }
+
+        Allocation& allocation = allocations[resource.allocation];
+        allocation.size = std::max(allocation.size, resource.memory_requirements.size);
+        allocation.alignment = std::max(allocation.alignment, resource.memory_requirements.alignment);
+        allocation.memory_type_bits &= resource.memory_requirements.memoryTypeBits;
+        allocation.resources.push_back(r);
+    }
+
+    // Transient images get their own (lazily allocated) memory, as lazily allocated memory is only committed when a render pass actually requires it
+    for (std::size_t i = 0u; i < resources.size(); ++i) {
+        ImageResource& resource = resources[i];
+        if (resource.imported || !resource.used || !resource.transient) {
+            continue;
+        }
+
+        resource.allocation = (unsigned) allocations.size();
+
+        Allocation& allocation = allocations.emplace_back();
+        allocation.size = resource.memory_requirements.size;
+        allocation.alignment = resource.memory_requirements.alignment;
+        allocation.memory_type_bits = resource.memory_requirements.memoryTypeBits;
+        allocation.lazy = is_memory_type_supported(physical_device, resource.memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        allocation.resources.push_back((Resource) i);
+    }
+
+    for (Allocation& allocation : allocations) {
+        VkMemoryRequirements memory_requirements { };
+        memory_requirements.size = allocation.size;
+        memory_requirements.alignment = allocation.alignment;
+        memory_requirements.memoryTypeBits = allocation.memory_type_bits;
+
+        VkMemoryAllocateInfo memory_allocate_info { };
+        memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memory_allocate_info.allocationSize = allocation.size;
+        memory_allocate_info.memoryTypeIndex = get_memory_type_index(physical_device, memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | (allocation.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0));
+        if (vkAllocateMemory(device, &memory_allocate_info, nullptr, &allocation.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate memory for render graph resources!");
+        }
+
+        for (Resource r : allocation.resources) {
+            ImageResource& resource = resources[r];
+            resource.memory = allocation.memory;
+            vkBindImageMemory(device, resource.image, allocation.memory, 0);
+            create_image_view(device, resource.image, VK_IMAGE_VIEW_TYPE_2D, resource.description.format, resource.aspect, 0, 1, 1, resource.image_view);
+        }
+    }
+}
+
+void RenderGraph::create_render_pass(Group& group) {
+    // Attachments are ordered by first use within the render pass
+    for (Pass pass : group.passes) {
+        for (const ResourceUsage& usage : passes[pass].usages) {
+            if (is_attachment(usage.usage) && std::find(group.attachments.begin(), group.attachments.end(), usage.resource) == group.attachments.end()) {
+                group.attachments.push_back(usage.resource);
+            }
+        }
+    }
+
+    unsigned group_index = passes[group.passes.front()].group;
+
+    std::vector<VkAttachmentDescription> attachment_descriptions;
+    attachment_descriptions.reserve(group.attachments.size());
+    group.clear_values.resize(group.attachments.size());
+
+    for (std::size_t a = 0u; a < group.attachments.size(); ++a) {
+        Resource resource = group.attachments[a];
+        const ImageResource& image = resources[resource];
+
+        const ResourceUsage* first = nullptr;
+        const ResourceUsage* last = nullptr;
+        for (Pass pass : group.passes) {
+            for (const ResourceUsage& usage : passes[pass].usages) {
+                if (usage.resource == resource) {
+                    if (!first) {
+                        first = &usage;
+                    }
+                    last = &usage;
+                }
+            }
+        }
+
+        // Contents only need to be stored if they are consumed after this render pass, either later in the frame or by the next frame (resources that are read before they are written)
+        bool store = image.imported;
+        bool first_use_in_frame = true;
+        for (const PassData& pass : passes) {
+            if (pass.culled) {
+                continue;
+            }
+
+            for (const ResourceUsage& usage : pass.usages) {
+                if (usage.resource != resource) {
+                    continue;
+                }
+
+                if (pass.group > group_index || (first_use_in_frame && reads_contents(usage))) {
+                    store = true;
+                }
+                first_use_in_frame = false;
+            }
+        }
+
+        VkAttachmentLoadOp load = reads_contents(*first) ? VK_ATTACHMENT_LOAD_OP_LOAD : first->load;
+        VkAttachmentStoreOp store_op = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        bool stencil = has_stencil_component(image.description.format);
+        attachment_descriptions.push_back(create_attachment_description(image.description.format, image.description.samples, load, store_op, stencil ? load : VK_ATTACHMENT_LOAD_OP_DONT_CARE, stencil ? store_op : VK_ATTACHMENT_STORE_OP_DONT_CARE, get_layout(image, *first), get_layout(image, *last)));
+
+        group.clear_values[a] = first->clear;
+    }
+
+    // Subpasses
+    std::vector<std::vector<VkAttachmentReference>> color_references(group.passes.size());
+    std::vector<std::vector<VkAttachmentReference>> input_references(group.passes.size());
+    std::vector<VkAttachmentReference> depth_references(group.passes.size());
+    std::vector<std::vector<unsigned>> preserve_attachments(group.passes.size());
+    std::vector<VkSubpassDescription> subpass_descriptions(group.passes.size());
+
+    auto attachment_index = [&group](Resource resource) -> unsigned {
+        return (unsigned) (std::find(group.attachments.begin(), group.attachments.end(), resource) - group.attachments.begin());
+    };
+
+    auto uses = [this](Pass pass, Resource resource) -> bool {
+        for (const ResourceUsage& usage : passes[pass].usages) {
+            if (usage.resource == resource) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (std::size_t s = 0u; s < group.passes.size(); ++s) {
+        const PassData& pass = passes[group.passes[s]];
+
+        bool has_depth = false;
+        for (const ResourceUsage& usage : pass.usages) {
+            const ImageResource& image = resources[usage.resource];
+            unsigned index = attachment_index(usage.resource);
+
+            switch (usage.usage) {
+                case Usage::COLOR_ATTACHMENT:
+                    // Color attachment locations in the fragment shader follow the order write_color() was called in
+                    color_references[s].push_back(create_attachment_reference(index, get_layout(image, usage)));
+                    break;
+                case Usage::DEPTH_ATTACHMENT:
+                case Usage::DEPTH_READ:
+                    depth_references[s] = create_attachment_reference(index, get_layout(image, usage));
+                    has_depth = true;
+                    break;
+                case Usage::INPUT_ATTACHMENT:
+                    // Input attachment indices (layout (input_attachment_index = ...)) follow the order read_input_attachment() was called in
+                    input_references[s].push_back(create_attachment_reference(index, get_layout(image, usage)));
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Attachments used before and after this subpass (but not by it) must be preserved
+        for (Resource resource : group.attachments) {
+            if (uses(group.passes[s], resource)) {
+                continue;
+            }
+
+            bool used_before = false;
+            bool used_after = false;
+            for (std::size_t other = 0u; other < group.passes.size(); ++other) {
+                if (uses(group.passes[other], resource)) {
+                    used_before |= other < s;
+                    used_after |= other > s;
+                }
+            }
+
+            if (used_before && used_after) {
+                preserve_attachments[s].push_back(attachment_index(resource));
+            }
+        }
+
+        VkSubpassDescription& subpass_description = subpass_descriptions[s];
+        subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass_description.colorAttachmentCount = (unsigned) color_references[s].size();
+        subpass_description.pColorAttachments = color_references[s].data();
+        subpass_description.pDepthStencilAttachment = has_depth ? &depth_references[s] : nullptr;
+        subpass_description.inputAttachmentCount = (unsigned) input_references[s].size();
+        subpass_description.pInputAttachments = input_references[s].data();
+        subpass_description.preserveAttachmentCount = (unsigned) preserve_attachments[s].size();
+        subpass_description.pPreserveAttachments = preserve_attachments[s].data();
+        subpass_description.pResolveAttachments = nullptr;
+    }
+
+    // Subpass dependencies are only required between subpasses that access the same attachment, where at least one of the accesses is a write
+    // All accesses within a render pass are attachment accesses at the same pixel, so dependencies can be framebuffer-local (VK_DEPENDENCY_BY_REGION_BIT)
+    // Dependencies with passes outside the render pass are handled by pipeline barriers recorded before the render pass begins
+    std::vector<VkSubpassDependency> subpass_dependencies;
+    for (std::size_t dst = 1u; dst < group.passes.size(); ++dst) {
+        for (std::size_t src = 0u; src < dst; ++src) {
+            VkSubpassDependency dependency = create_subpass_dependency((unsigned) src, 0, 0, (unsigned) dst, 0, 0);
+            dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+            for (const ResourceUsage& src_usage : passes[group.passes[src]].usages) {
+                for (const ResourceUsage& dst_usage : passes[group.passes[dst]].usages) {
+                    if (src_usage.resource != dst_usage.resource || !(is_write(src_usage) || is_write(dst_usage))) {
+                        continue;
+                    }
+
+                    dependency.srcStageMask |= get_stages(src_usage);
+                    dependency.srcAccessMask |= get_write_access_mask(get_access(src_usage));
+                    dependency.dstStageMask |= get_stages(dst_usage);
+                    dependency.dstAccessMask |= get_access(dst_usage);
+                }
+            }
+
+            if (dependency.srcStageMask != 0) {
+                subpass_dependencies.push_back(dependency);
+            }
+        }
+    }
+
+    VkRenderPassCreateInfo render_pass_create_info { };
+    render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_create_info.attachmentCount = (unsigned) attachment_descriptions.size();
+    render_pass_create_info.pAttachments = attachment_descriptions.data();
+    render_pass_create_info.subpassCount = (unsigned) subpass_descriptions.size();
+    render_pass_create_info.pSubpasses = subpass_descriptions.data();
+    render_pass_create_info.dependencyCount = (unsigned) subpass_dependencies.size();
+    render_pass_create_info.pDependencies = subpass_dependencies.data();
+    if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &group.render_pass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass for render graph pass '" + passes[group.passes.front()].name + "'!");
+    }
+}
+
+void RenderGraph::generate_barriers() {
+    // Resources owned by the graph are left in the state of their last use in the previous frame, which is the state they are in at the start of the current frame
+    // The first simulation determines this state, the second records the barriers starting from it
+    for (ImageResource& resource : resources) {
+        resource.state = { };
+        resource.state.layout = resource.imported ? resource.initial_layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        resource.state.write_stages = resource.imported ? resource.initial_stages : 0;
+        resource.state.write_access = resource.imported && resource.initial_stages != 0 ? VK_ACCESS_MEMORY_WRITE_BIT : 0;
+    }
+
+    simulate_frame(false);
+
+    for (std::size_t i = 0u; i < resources.size(); ++i) {
+        ImageResource& resource = resources[i];
+
+        if (resource.imported) {
+            resource.state = { };
+            resource.state.layout = resource.initial_layout;
+            resource.state.write_stages = resource.initial_stages;
+            resource.state.write_access = resource.initial_stages != 0 ? VK_ACCESS_MEMORY_WRITE_BIT : 0; // Writes to the image before the graph (such as by the previous frame) must be made available to its first use
+        }
+        else if (resource.used && !is_aliased(resource) && resource.state.layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+            // On the very first frame, resources are still in VK_IMAGE_LAYOUT_UNDEFINED
+            Barrier barrier { };
+            barrier.resource = (Resource) i;
+            barrier.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.new_layout = resource.state.layout;
+            barrier.src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            barrier.src_access = 0;
+            barrier.dst_stages = resource.state.write_stages | resource.state.read_stages;
+            barrier.dst_access = 0;
+            if (barrier.dst_stages == 0) {
+                barrier.dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            }
+            initial_barriers.push_back(barrier);
+        }
+    }
+
+    simulate_frame(true);
+}
+
+void RenderGraph::simulate_frame(bool record) {
+    for (std::size_t group_index = 0u; group_index < groups.size(); ++group_index) {
+        Group& group = groups[group_index];
+        if (record) {
+            group.barriers.clear();
+        }
+
+        // Resources in the order they are first used within the group
+        std::vector<Resource> group_resources;
+        for (Pass pass : group.passes) {
+            for (const ResourceUsage& usage : passes[pass].usages) {
+                if (std::find(group_resources.begin(), group_resources.end(), usage.resource) == group_resources.end()) {
+                    group_resources.push_back(usage.resource);
+                }
+            }
+        }
+
+        for (Resource r : group_resources) {
+            ImageResource& resource = resources[r];
+            ResourceState& state = resource.state;
+
+            // Accesses of the first pass in the group that uses the resource determine the barrier (later subpasses are synchronized with subpass dependencies)
+            const PassData* first_pass = nullptr;
+            for (Pass pass : group.passes) {
+                for (const ResourceUsage& usage : passes[pass].usages) {
+                    if (usage.resource == r) {
+                        first_pass = &passes[pass];
+                        break;
+                    }
+                }
+                if (first_pass) {
+                    break;
+                }
+            }
+
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags stages = 0;
+            VkAccessFlags access = 0;
+            bool writes = false;
+            bool discards = true;
+            for (const ResourceUsage& usage : first_pass->usages) {
+                if (usage.resource != r) {
+                    continue;
+                }
+
+                layout = get_layout(resource, usage);
+                stages |= get_stages(usage);
+                access |= get_access(usage);
+                writes |= is_write(usage);
+                discards &= !reads_contents(usage);
+            }
+
+            // Memory shared with other images has been overwritten since this image was last used, so its first use in the frame must re-initialize it from VK_IMAGE_LAYOUT_UNDEFINED
+            bool aliased = is_aliased(resource) && resource.first_group == group_index;
+            bool transition = aliased || state.layout != layout;
+
+            Barrier barrier { };
+            barrier.resource = r;
+            barrier.old_layout = discards ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout; // Transitioning from VK_IMAGE_LAYOUT_UNDEFINED allows the implementation to discard the contents
+            barrier.new_layout = layout;
+            barrier.dst_stages = stages;
+            barrier.dst_access = access;
+
+            bool emit = false;
+
+            if (transition || writes) {
+                // Layout transitions and writes must happen after all previous reads (write-after-read, execution dependency only) and writes (write-after-write, memory dependency)
+                barrier.src_stages = state.write_stages | state.read_stages;
+                barrier.src_access = state.write_access;
+                emit = transition || barrier.src_stages != 0;
+
+                if (aliased) {
+                    // Accesses to the other images sharing the memory must complete before the memory is reused (write-after-write / write-after-read)
+                    for (Resource other : allocations[resource.allocation].resources) {
+                        if (other != r) {
+                            barrier.src_stages |= resources[other].state.write_stages | resources[other].state.read_stages;
+                            barrier.src_access |= resources[other].state.write_access;
+                        }
+                    }
+                }
+            }
+            else if (state.write_stages != 0 && ((state.visible_stages & stages) != stages || (state.visible_access & access) != access)) {
+                // Read-after-write, unless the write has already been made visible to these stages / accesses by a previous barrier
+                barrier.src_stages = state.write_stages;
+                barrier.src_access = state.write_access;
+                emit = true;
+            }
+
+            if (emit) {
+                if (barrier.src_stages == 0) {
+                    barrier.src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT; // No previous accesses
+                }
+
+                if (!transition) {
+                    // Layout is not changing, keep the contents
+                    barrier.old_layout = barrier.new_layout;
+                }
+
+                if (record) {
+                    group.barriers.push_back(barrier);
+                }
+
+                if (transition) {
+                    // Layout transitions are writes, and complete before the destination stages of the barrier
+                    state.layout = layout;
+                    state.write_stages = stages;
+                    state.write_access = 0;
+                    state.read_stages = 0;
+                    state.visible_stages = stages;
+                    state.visible_access = access;
+                }
+                else {
+                    state.visible_stages |= stages;
+                    state.visible_access |= access;
+                }
+            }
+
+            // Apply all accesses within the group
+            for (Pass pass : group.passes) {
+                for (const ResourceUsage& usage : passes[pass].usages) {
+                    if (usage.resource != r) {
+                        continue;
+                    }
+
+                    VkImageLayout usage_layout = get_layout(resource, usage);
+                    VkPipelineStageFlags usage_stages = get_stages(usage);
+
+                    if (is_write(usage)) {
+                        state.write_stages = usage_stages;
+                        state.write_access = get_write_access_mask(get_access(usage));
+                        state.read_stages = 0;
+                        state.visible_stages = 0;
+                        state.visible_access = 0;
+                    }
+                    else {
+                        if (usage_layout != state.layout) {
+                            // Layout transition between subpasses (ordered by the subpass dependency) completes before this access
+                            state.write_stages |= usage_stages;
+                        }
+                        state.read_stages |= usage_stages;
+                    }
+
+                    state.layout = usage_layout;
+                }
+            }
+        }
+    }
+
+    // Transition imported resources into their final layouts
+    if (record) {
+        final_barriers.clear();
+    }
+
+    for (std::size_t i = 0u; i < resources.size(); ++i) {
+        ImageResource& resource = resources[i];
+        if (!resource.imported || !resource.used || resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || resource.final_layout == resource.state.layout) {
+            continue;
+        }
+
+        Barrier barrier { };
+        barrier.resource = (Resource) i;
+        barrier.old_layout = resource.state.layout;
+        barrier.new_layout = resource.final_layout;
+        barrier.src_stages = resource.state.write_stages | resource.state.read_stages;
+        barrier.src_access = resource.state.write_access;
+        barrier.dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT; // Accesses after the graph (such as presentation) are synchronized with semaphores
+        barrier.dst_access = 0;
+        if (barrier.src_stages == 0) {
+            barrier.src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+
+        if (record) {
+            final_barriers.push_back(barrier);
+        }
+
+        resource.state.layout = resource.final_layout;
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer) {
+    execute(command_buffer, 0u, (Pass) passes.size() - 1u);
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer, Pass first, Pass last) {
+    if (!compiled) {
+        throw std::runtime_error("render graph must be compiled before it is executed!");
+    }
+
+    if (!executed) {
+        record_barriers(command_buffer, initial_barriers);
+        executed = true;
+    }
+
+    for (Group& group : groups) {
+        if (group.passes.front() > last || group.passes.back() < first) {
+            // Group lies entirely outside of the execution range
+            continue;
+        }
+
+        if (group.passes.front() < first || group.passes.back() > last) {
+            // Groups are recorded as a whole (subpasses of one render pass cannot be split across command buffers)
+            throw std::runtime_error("render graph execution range must not split a render pass!");
+        }
+
+        record_barriers(command_buffer, group.barriers);
+
+        if (group.compute) {
+            passes[group.passes.front()].execute(command_buffer);
+            continue;
+        }
+
+        VkRenderPassBeginInfo render_pass_info { };
+        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_info.renderPass = group.render_pass;
+        render_pass_info.framebuffer = get_framebuffer(group);
+        render_pass_info.renderArea = create_region(0, 0, group.extent.width, group.extent.height);
+        render_pass_info.clearValueCount = (unsigned) group.clear_values.size();
+        render_pass_info.pClearValues = group.clear_values.data();
+
+        vkCmdBeginRenderPass(command_buffer, &render_pass_info, passes[group.passes.front()].contents);
+            for (std::size_t s = 0u; s < group.passes.size(); ++s) {
+                const PassData& pass = passes[group.passes[s]];
+                if (s > 0u) {
+                    vkCmdNextSubpass(command_buffer, pass.contents);
+                }
+                pass.execute(command_buffer);
+            }
+        vkCmdEndRenderPass(command_buffer);
+    }
+
+    if (!groups.empty() && groups.back().passes.back() <= last) {
+        record_barriers(command_buffer, final_barriers);
+    }
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer command_buffer, const std::vector<Barrier>& barriers) const {
+    std::vector<bool> recorded(barriers.size(), false);
+    std::vector<VkImageMemoryBarrier> image_memory_barriers;
+
+    for (std::size_t i = 0u; i < barriers.size(); ++i) {
+        if (recorded[i]) {
+            continue;
+        }
+
+        // Merging barriers with different stage masks would over-synchronize, so only barriers with identical stage masks are batched
+        image_memory_barriers.clear();
+        for (std::size_t j = i; j < barriers.size(); ++j) {
+            if (recorded[j] || barriers[j].src_stages != barriers[i].src_stages || barriers[j].dst_stages != barriers[i].dst_stages) {
+                continue;
+            }
+
+            const Barrier& barrier = barriers[j];
+            const ImageResource& resource = resources[barrier.resource];
+
+            VkImageMemoryBarrier image_memory_barrier { };
+            image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            image_memory_barrier.oldLayout = barrier.old_layout;
+            image_memory_barrier.newLayout = barrier.new_layout;
+            image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_memory_barrier.image = resource.image;
+            image_memory_barrier.subresourceRange.aspectMask = resource.aspect | (has_stencil_component(resource.description.format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+            image_memory_barrier.subresourceRange.baseMipLevel = 0;
+            image_memory_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            image_memory_barrier.subresourceRange.baseArrayLayer = 0;
+            image_memory_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            image_memory_barrier.srcAccessMask = barrier.src_access;
+            image_memory_barrier.dstAccessMask = barrier.dst_access;
+            image_memory_barriers.push_back(image_memory_barrier);
+
+            recorded[j] = true;
+        }
+
+        vkCmdPipelineBarrier(command_buffer, barriers[i].src_stages, barriers[i].dst_stages, 0, 0, nullptr, 0, nullptr, (unsigned) image_memory_barriers.size(), image_memory_barriers.data());
+    }
+}
+
+VkFramebuffer RenderGraph::get_framebuffer(Group& group) {
+    std::vector<VkImageView> attachments;
+    attachments.reserve(group.attachments.size());
+    for (Resource resource : group.attachments) {
+        attachments.push_back(resources[resource].image_view);
+    }
+
+    auto it = group.framebuffers.find(attachments);
+    if (it != group.framebuffers.end()) {
+        return it->second;
+    }
+
+    VkFramebufferCreateInfo framebuffer_create_info { };
+    framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_create_info.renderPass = group.render_pass;
+    framebuffer_create_info.attachmentCount = (unsigned) attachments.size();
+    framebuffer_create_info.pAttachments = attachments.data();
+    framebuffer_create_info.width = group.extent.width;
+    framebuffer_create_info.height = group.extent.height;
+    framebuffer_create_info.layers = 1;
+
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer for render graph pass '" + passes[group.passes.front()].name + "'!");
+    }
+
+    group.framebuffers.emplace(std::move(attachments), framebuffer);
+    return framebuffer;
+}
+
+VkRenderPass RenderGraph::get_render_pass(Pass pass) const {
+    if (pass >= passes.size() || passes[pass].group == INVALID) {
+        return VK_NULL_HANDLE;
+    }
+    return groups[passes[pass].group].render_pass;
+}
+
+unsigned RenderGraph::get_subpass(Pass pass) const {
+    return passes[pass].subpass;
+}
+
+bool RenderGraph::is_culled(Pass pass) const {
+    return passes[pass].culled;
+}
+
+VkImage RenderGraph::get_image(Resource resource) const {
+    return resources[resource].image;
+}
+
+VkImageView RenderGraph::get_image_view(Resource resource) const {
+    return resources[resource].image_view;
+}
+
+RenderGraph::MemoryReport RenderGraph::report_memory() const {
+    // Memory of render targets owned by the graph, compared to giving every image a dedicated allocation
+    MemoryReport report { };
+    report.allocation_count = allocations.size();
+
+    for (const Allocation& allocation : allocations) {
+        for (Resource r : allocation.resources) {
+            report.dedicated_size += resources[r].memory_requirements.size;
+            ++report.image_count;
+        }
+
+        if (allocation.lazy) {
+            report.lazily_allocated_size += allocation.size;
+        }
+        else {
+            report.allocated_size += allocation.size;
+        }
+
+        if (resources[allocation.resources.front()].transient) {
+            ++report.transient_count;
+        }
+    }
+
+    return report;
+}
+
+void RenderGraph::print_memory() const {
+    MemoryReport report = report_memory();
+
+    const double MiB = 1024.0 * 1024.0;
+    std::cout << "render target memory: " << report.image_count << " image(s) (" << report.transient_count << " transient) in " << report.allocation_count << " allocation(s), "
+              << (double) report.dedicated_size / MiB << " MiB -> " << (double) report.allocated_size / MiB << " MiB (+ " << (double) report.lazily_allocated_size / MiB << " MiB lazily allocated), saved " << (double) (report.dedicated_size - report.allocated_size) / MiB << " MiB" << std::endl;
+}
+
+void RenderGraph::print() const {
+    for (std::size_t g = 0u; g < groups.size(); ++g) {
+        const Group& group = groups[g];
+
+        for (const Barrier& barrier : group.barriers) {
+            std::cout << "  barrier '" << resources[barrier.resource].name << "' (layout " << barrier.old_layout << " -> " << barrier.new_layout << ", stages 0x" << std::hex << barrier.src_stages << " -> 0x" << barrier.dst_stages << std::dec << ")" << std::endl;
+        }
+
+        if (group.compute) {
+            std::cout << "compute pass '" << passes[group.passes.front()].name << "'" << std::endl;
+            continue;
+        }
+
+        std::cout << "render pass " << g << " (" << group.extent.width << "x" << group.extent.height << ")" << std::endl;
+        for (std::size_t s = 0u; s < group.passes.size(); ++s) {
+            std::cout << "  subpass " << s << ": '" << passes[group.passes[s]].name << "'" << std::endl;
+        }
+    }
+
+    for (const Barrier& barrier : final_barriers) {
+        std::cout << "  barrier '" << resources[barrier.resource].name << "' (layout " << barrier.old_layout << " -> " << barrier.new_layout << ")" << std::endl;
+    }
+
+    for (const PassData& pass : passes) {
+        if (pass.culled) {
+            std::cout << "culled pass '" << pass.name << "'" << std::endl;
+        }
+    }
+
+    print_memory();
+}
+
+void RenderGraph::destroy() {
+    for (Group& group : groups) {
+        for (auto& [views, framebuffer] : group.framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        group.framebuffers.clear();
+
+        if (group.render_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device, group.render_pass, nullptr);
+        }
+    }
+    groups.clear();
+
+    for (ImageResource& resource : resources) {
+        if (resource.imported) {
+            continue;
+        }
+
+        if (resource.image_view != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, resource.image_view, nullptr);
+        }
+        if (resource.image != VK_NULL_HANDLE) {
+            vkDestroyImage(device, resource.image, nullptr);
+        }
+    }
+    resources.clear();
+
+    // Memory is freed after all images that alias it have been destroyed
+    for (Allocation& allocation : allocations) {
+        vkFreeMemory(device, allocation.memory, nullptr);
+    }
+    allocations.clear();
+    passes.clear();
+}
+
+VkImageLayout RenderGraph::get_layout(const ImageResource& resource, const ResourceUsage& usage) const {
+    bool depth = is_depth_format(resource.description.format);
+
+    switch (usage.usage) {
+        case Usage::COLOR_ATTACHMENT:
+            return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case Usage::DEPTH_ATTACHMENT:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        case Usage::DEPTH_READ:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        case Usage::INPUT_ATTACHMENT:
+        case Usage::TEXTURE:
+            // Depth can be read as a read-only depth attachment and sampled / read as an input attachment in the same layout
+            return depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        case Usage::STORAGE_READ:
+        case Usage::STORAGE_WRITE:
+            return VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    return VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+bool RenderGraph::is_aliased(const ImageResource& resource) const {
+    return resource.allocation != INVALID && allocations[resource.allocation].resources.size() > 1u;
+}
+
+VkPipelineStageFlags RenderGraph::get_stages(const ResourceUsage& usage) const {
+    return usage.stages;
+}
+
+VkAccessFlags RenderGraph::get_access(const ResourceUsage& usage) const {
+    switch (usage.usage) {
+        case Usage::COLOR_ATTACHMENT:
+            // Clearing / discarding is a write, loading is a read
+            return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (usage.load == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+        case Usage::DEPTH_ATTACHMENT:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        case Usage::DEPTH_READ:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        case Usage::INPUT_ATTACHMENT:
+            return VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        case Usage::TEXTURE:
+        case Usage::STORAGE_READ:
+            return VK_ACCESS_SHADER_READ_BIT;
+        case Usage::STORAGE_WRITE:
+            return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    }
+
+    return 0;
+}
+
+bool RenderGraph::is_attachment(Usage usage) {
+    return usage == Usage::COLOR_ATTACHMENT || usage == Usage::DEPTH_ATTACHMENT || usage == Usage::DEPTH_READ || usage == Usage::INPUT_ATTACHMENT;
+}
+
+bool RenderGraph::is_write(const ResourceUsage& usage) {
+    return usage.usage == Usage::COLOR_ATTACHMENT || usage.usage == Usage::DEPTH_ATTACHMENT || usage.usage == Usage::STORAGE_WRITE;
+}
+
+bool RenderGraph::reads_contents(const ResourceUsage& usage) {
+    // Storage image writes may only write part of the image, unless the pass discards the previous contents
+    if (usage.usage == Usage::COLOR_ATTACHMENT || usage.usage == Usage::DEPTH_ATTACHMENT || usage.usage == Usage::STORAGE_WRITE) {
+        return usage.load == VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
+
+    return true;
+}
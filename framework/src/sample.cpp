@@ -10,6 +10,8 @@
 #include <filesystem> // std::filesystem
 #include <iostream> // std::cout, std::endl;
 #include <fstream> // std::ifstream
+#include <algorithm> // std::min
+#include <cstddef> // offsetof
 
 Sample::Settings::Settings() : fullscreen(false),
                                headless(false),
@@ -29,11 +31,21 @@ Sample::Sample(const char* name) : instance(nullptr),
                                    physical_device_properties({ }),
                                    physical_device_features({ }),
                                    enabled_physical_device_features({ }),
+                                   enabled_vulkan_12_features({ }),
                                    device(nullptr),
                                    command_pool(nullptr),
                                    command_buffers({ }),
+                                   worker_thread_count(0u),
+                                   minimum_secondary_command_buffer_size(32u),
+                                   thread_pool(nullptr),
+                                   thread_command_pools({ }),
                                    queue_family_index(-1),
                                    queue(nullptr),
+                                   async_compute_requested(false),
+                                   compute_queue_family_index(-1),
+                                   compute_queue(nullptr),
+                                   compute_command_pool(nullptr),
+                                   compute_command_buffers({ }),
                                    width(1920),
                                    height(1080),
                                    window(nullptr),
@@ -121,6 +133,11 @@ void Sample::initialize() {
     create_command_pools();
     allocate_command_buffers();
     
+    // Parallel command buffer recording is opt-in
+    if (worker_thread_count > 0u) {
+        create_thread_command_pools();
+    }
+    
     // Some samples do not require the use of the depth buffer
     if (settings.use_depth_buffer) {
         create_depth_buffer();
@@ -160,6 +177,9 @@ void Sample::run() {
     vkWaitForFences(device, 1, &is_frame_in_flight[frame_index], VK_TRUE, std::numeric_limits<std::uint64_t>::max()); // Blocks CPU execution (fence is created in the signaled state so that the first pass through this function doesn't block execution indefinitely)
     vkResetFences(device, 1, &is_frame_in_flight[frame_index]);
     
+    // Secondary command buffers recorded for this frame in flight are no longer in use by the GPU
+    reset_thread_command_pools();
+    
     update();
     render();
     
@@ -175,6 +195,9 @@ void Sample::run() {
     // Presentation queue family is mixed in with graphics / compute / transfer families
     vkQueuePresentKHR(queue, &present_info);
     
+    // Matrices used for this frame become the previous matrices for the next frame
+    camera.end_frame();
+    
     // Advance frame
     frame_index = (frame_index + 1) % NUM_FRAMES_IN_FLIGHT;
 }
@@ -200,6 +223,7 @@ void Sample::shutdown() {
     }
     
     // deallocate_command_buffers();
+    destroy_thread_command_pools();
     destroy_command_pool(); // Command buffers are automatically deallocated with the destruction of the command pool they were allocated from
     
     destroy_synchronization_objects();
@@ -489,6 +513,42 @@ void Sample::create_logical_device() {
     // Select enabled device features
     device_create_info.pEnabledFeatures = &enabled_physical_device_features;
     
+    // Vulkan 1.2 features are only chained if the sample requested any of them
+    // Once VkPhysicalDeviceVulkan12Features is chained, features of promoted extensions (e.g. shaderOutputLayer for VK_EXT_shader_viewport_index_layer) must also be enabled through it, which samples that only enable the extension do not do
+    VkPhysicalDeviceVulkan12Features supported_vulkan_12_features { };
+    supported_vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    
+    // Features are laid out as consecutive VkBool32 members following 'sType' and 'pNext'
+    constexpr std::size_t vulkan_12_feature_count = (sizeof(VkPhysicalDeviceVulkan12Features) - offsetof(VkPhysicalDeviceVulkan12Features, samplerMirrorClampToEdge)) / sizeof(VkBool32);
+    const VkBool32* requested_features = &enabled_vulkan_12_features.samplerMirrorClampToEdge;
+    const VkBool32* supported_features = &supported_vulkan_12_features.samplerMirrorClampToEdge;
+    
+    bool vulkan_12_features_requested = false;
+    for (std::size_t i = 0u; i < vulkan_12_feature_count; ++i) {
+        vulkan_12_features_requested |= requested_features[i] == VK_TRUE;
+    }
+    
+    if (vulkan_12_features_requested) {
+        if (physical_device_properties.apiVersion < VK_API_VERSION_1_2) {
+            throw std::runtime_error("sample requires Vulkan 1.2 features, but the selected device does not support Vulkan 1.2!");
+        }
+        
+        VkPhysicalDeviceFeatures2 physical_device_features { };
+        physical_device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        physical_device_features.pNext = &supported_vulkan_12_features;
+        vkGetPhysicalDeviceFeatures2(physical_device, &physical_device_features);
+        
+        for (std::size_t i = 0u; i < vulkan_12_feature_count; ++i) {
+            if (requested_features[i] == VK_TRUE && supported_features[i] != VK_TRUE) {
+                throw std::runtime_error("sample requires Vulkan 1.2 features that are not supported by the selected device!");
+            }
+        }
+        
+        enabled_vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        enabled_vulkan_12_features.pNext = nullptr;
+        device_create_info.pNext = &enabled_vulkan_12_features;
+    }
+    
     // Device extensions
     device_create_info.enabledExtensionCount = static_cast<unsigned>(enabled_device_extensions.size());
     device_create_info.ppEnabledExtensionNames = enabled_device_extensions.data();
@@ -512,6 +572,11 @@ void Sample::create_logical_device() {
     
     queue_family_index = queue_family_count; // Invalid index
     
+    // Priority influences scheduling command buffer execution for queues of the same family
+    // Graphics and async compute queues are given the same priority, compute work is expected to fill gaps in graphics work rather than preempt it
+    // Declared outside of the loop, as queue create infos point to these values until the logical device is created
+    float queue_priorities[2] = { 1.0f, 1.0f };
+    
     for (unsigned i = 0u; i < queue_family_count; ++i) {
         bool has_graphics_support = queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT;
         bool has_compute_support = queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT;
@@ -542,11 +607,7 @@ void Sample::create_logical_device() {
             queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             queue_create_info.queueFamilyIndex = queue_family_index;
             queue_create_info.queueCount = 1;
-    
-            // Priority influences scheduling command buffer execution for this queue family
-            // Since this framework only uses one queue, this value does not matter
-            float queuePriority = 1.0f;
-            queue_create_info.pQueuePriorities = &queuePriority;
+            queue_create_info.pQueuePriorities = queue_priorities;
             
             break;
         }
@@ -556,6 +617,34 @@ void Sample::create_logical_device() {
         throw std::runtime_error("unable to find queue family that satisfies application requirements");
     }
     
+    compute_queue_family_index = queue_family_count; // Invalid index
+    unsigned compute_queue_index = 0u;
+    
+    if (async_compute_requested) {
+        if ((queue_families[queue_family_index].queueFlags & VK_QUEUE_COMPUTE_BIT) && queue_families[queue_family_index].queueCount > 1u) {
+            // Prefer a second queue from the graphics queue family, as resources can be shared between both queues without ownership transfers
+            compute_queue_family_index = queue_family_index;
+            compute_queue_index = 1u;
+            queue_create_infos[0].queueCount = 2;
+        }
+        else {
+            // Fall back to a queue from a dedicated compute queue family
+            for (unsigned i = 0u; i < queue_family_count; ++i) {
+                if (i != queue_family_index && (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                    compute_queue_family_index = i;
+                    
+                    VkDeviceQueueCreateInfo& queue_create_info = queue_create_infos.emplace_back();
+                    queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+                    queue_create_info.queueFamilyIndex = compute_queue_family_index;
+                    queue_create_info.queueCount = 1;
+                    queue_create_info.pQueuePriorities = queue_priorities;
+                    
+                    break;
+                }
+            }
+        }
+    }
+    
     device_create_info.queueCreateInfoCount = static_cast<unsigned>(queue_create_infos.size());
     device_create_info.pQueueCreateInfos = queue_create_infos.data();
     
@@ -566,6 +655,10 @@ void Sample::create_logical_device() {
     // Retrieve device queues
     vkGetDeviceQueue(device, queue_family_index, 0u, &queue);
     
+    if (compute_queue_family_index != queue_family_count) {
+        vkGetDeviceQueue(device, compute_queue_family_index, compute_queue_index, &compute_queue);
+    }
+    
     // Command pools are used to allocate / store command buffers
     VkCommandPoolCreateInfo command_pool_create_info { };
     command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -1135,6 +1228,14 @@ void Sample::create_command_pools() {
     if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &transient_command_pool) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate transient command pool!");
     }
+    
+    if (compute_queue) {
+        command_pool_create_info.queueFamilyIndex = compute_queue_family_index;
+        command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &compute_command_pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate compute command pool!");
+        }
+    }
 }
 
 void Sample::allocate_command_buffers() {
@@ -1157,6 +1258,160 @@ void Sample::allocate_command_buffers() {
     if (vkAllocateCommandBuffers(device, &command_buffer_ai, command_buffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
+    
+    if (compute_queue) {
+        compute_command_buffers.resize(NUM_FRAMES_IN_FLIGHT);
+        command_buffer_ai.commandPool = compute_command_pool;
+        
+        if (vkAllocateCommandBuffers(device, &command_buffer_ai, compute_command_buffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate compute command buffers!");
+        }
+    }
+}
+
+void Sample::create_thread_command_pools() {
+    thread_pool = std::make_unique<ThreadPool>(worker_thread_count);
+    
+    VkCommandPoolCreateInfo command_pool_create_info { };
+    command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.queueFamilyIndex = queue_family_index;
+    
+    // Command buffers allocated from these pools are reset all at once with vkResetCommandPool at the start of every frame, which is cheaper than resetting each command buffer individually
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    
+    thread_command_pools.resize(NUM_FRAMES_IN_FLIGHT);
+    for (std::vector<ThreadCommandPool>& pools : thread_command_pools) {
+        pools.resize(thread_pool->size());
+        
+        for (ThreadCommandPool& pool : pools) {
+            pool.used = 0u;
+            if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &pool.command_pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create worker thread command pool!");
+            }
+        }
+    }
+}
+
+void Sample::reset_thread_command_pools() {
+    if (thread_command_pools.empty()) {
+        return;
+    }
+    
+    for (ThreadCommandPool& pool : thread_command_pools[frame_index]) {
+        if (pool.used > 0u) {
+            vkResetCommandPool(device, pool.command_pool, 0);
+            pool.used = 0u;
+        }
+    }
+}
+
+void Sample::destroy_thread_command_pools() {
+    // Worker threads must be joined before the command pools they record from are destroyed
+    thread_pool.reset();
+    
+    for (std::vector<ThreadCommandPool>& pools : thread_command_pools) {
+        for (ThreadCommandPool& pool : pools) {
+            vkDestroyCommandPool(device, pool.command_pool, nullptr); // Secondary command buffers are freed with the pool
+        }
+    }
+    thread_command_pools.clear();
+}
+
+VkResult Sample::acquire_secondary_command_buffer(unsigned thread_index, VkCommandBuffer& command_buffer) {
+    ThreadCommandPool& pool = thread_command_pools[frame_index][thread_index];
+    
+    if (pool.used == pool.command_buffers.size()) {
+        VkCommandBufferAllocateInfo command_buffer_ai { };
+        command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_ai.commandPool = pool.command_pool;
+        command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        command_buffer_ai.commandBufferCount = 1;
+        
+        VkResult result = vkAllocateCommandBuffers(device, &command_buffer_ai, &command_buffer);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        pool.command_buffers.emplace_back(command_buffer);
+    }
+    
+    command_buffer = pool.command_buffers[pool.used++];
+    return VK_SUCCESS;
+}
+
+std::vector<VkCommandBuffer> Sample::record_secondary_command_buffers(const VkCommandBufferInheritanceInfo& inheritance, std::size_t count, const std::function<void(VkCommandBuffer, std::size_t, std::size_t)>& record) {
+    if (!thread_pool) {
+        throw std::runtime_error("parallel command buffer recording requires worker_thread_count to be set during sample construction!");
+    }
+    
+    if (count == 0u) {
+        return { };
+    }
+    
+    // One chunk per worker thread, unless the range is too small to be worth splitting that many ways
+    std::size_t minimum_chunk_size = std::max(minimum_secondary_command_buffer_size, (std::size_t) 1u);
+    std::size_t chunk_count = std::min((std::size_t) thread_pool->size(), (count + minimum_chunk_size - 1u) / minimum_chunk_size);
+    std::size_t chunk_size = (count + chunk_count - 1u) / chunk_count;
+    chunk_count = (count + chunk_size - 1u) / chunk_size;
+    
+    std::vector<SecondaryCommandBufferTask> tasks(chunk_count);
+    for (std::size_t i = 0u; i < chunk_count; ++i) {
+        std::size_t begin = i * chunk_size;
+        std::size_t end = std::min(begin + chunk_size, count);
+        
+        tasks[i].inheritance = inheritance;
+        tasks[i].record = [&record, begin, end](VkCommandBuffer command_buffer) {
+            record(command_buffer, begin, end);
+        };
+    }
+    
+    return record_secondary_command_buffers(tasks);
+}
+
+std::vector<VkCommandBuffer> Sample::record_secondary_command_buffers(const std::vector<SecondaryCommandBufferTask>& tasks) {
+    if (!thread_pool) {
+        throw std::runtime_error("parallel command buffer recording requires worker_thread_count to be set during sample construction!");
+    }
+    
+    std::vector<VkCommandBuffer> secondary_command_buffers(tasks.size());
+    std::vector<VkResult> results(tasks.size(), VK_SUCCESS);
+    
+    // Exceptions cannot cross thread boundaries, so failures are recorded per task and reported on the calling thread
+    thread_pool->dispatch(tasks.size(), [&](unsigned thread_index, std::size_t task_index) {
+        const SecondaryCommandBufferTask& task = tasks[task_index];
+        
+        VkCommandBuffer command_buffer;
+        results[task_index] = acquire_secondary_command_buffer(thread_index, command_buffer);
+        if (results[task_index] != VK_SUCCESS) {
+            return;
+        }
+        
+        VkCommandBufferBeginInfo command_buffer_begin_info { };
+        command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (task.inheritance.renderPass != VK_NULL_HANDLE) {
+            // Secondary command buffer will be executed entirely inside a render pass
+            command_buffer_begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        }
+        command_buffer_begin_info.pInheritanceInfo = &task.inheritance;
+        
+        results[task_index] = vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+        if (results[task_index] != VK_SUCCESS) {
+            return;
+        }
+        
+        task.record(command_buffer);
+        
+        results[task_index] = vkEndCommandBuffer(command_buffer);
+        secondary_command_buffers[task_index] = command_buffer;
+    });
+    
+    for (VkResult result : results) {
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer!");
+        }
+    }
+    
+    return secondary_command_buffers;
 }
 
 void Sample::destroy_vulkan_instance() {
@@ -1200,6 +1455,9 @@ void Sample::destroy_swapchain() {
 }
 
 void Sample::destroy_command_pool() {
+    if (compute_command_pool) {
+        vkDestroyCommandPool(device, compute_command_pool, nullptr);
+    }
     vkDestroyCommandPool(device, transient_command_pool, nullptr);
     vkDestroyCommandPool(device, command_pool, nullptr);
 }
@@ -1293,27 +1551,49 @@ void Sample::destroy_descriptor_pool() {
     vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
 }
 
-void Sample::initialize_descriptor_pool(unsigned buffer_count, unsigned sampler_count) {
+void Sample::initialize_descriptor_pool(unsigned buffer_count, unsigned sampler_count, unsigned input_attachment_count, unsigned storage_buffer_count, unsigned storage_image_count) {
     // A descriptor is a handle to a resource (such as a buffer or a sampler)
     // Descriptors also hold extra information such as the size of the buffer or the type of sampler
     
     // Descriptors are bound together into descriptor sets (Vulkan does not allow binding individual resources in shaders, this operation must be done in sets)
     // There is a limit to how many descriptor sets different devices support
     
-    VkDescriptorPoolSize pool_sizes[2] { };
-    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // Descriptor sets allocated from this pool are to be used as descriptor sets for uniform buffers
+    VkDescriptorPoolSize pool_sizes[5] { };
+    unsigned pool_size_count = 0u;
+    
+    pool_sizes[pool_size_count].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // Descriptor sets allocated from this pool are to be used as descriptor sets for uniform buffers
     
     // Allocate a descriptor set per frame in flight to prevent writing to uniform buffers of one frame while they are still in use by the rendering operations of the previous frame
-    pool_sizes[0].descriptorCount = buffer_count;
+    pool_sizes[pool_size_count++].descriptorCount = buffer_count;
+    
+    // Pool sizes must have a descriptor count greater than 0, so only descriptor types the sample uses are reserved
+    if (sampler_count > 0u) {
+        pool_sizes[pool_size_count].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; // TODO: should this be image samplers and storage samplers? no errors yet....?
+        pool_sizes[pool_size_count++].descriptorCount = sampler_count;
+    }
+    
+    // Input attachments (subpassInput) for reading attachments written by a previous subpass
+    if (input_attachment_count > 0u) {
+        pool_sizes[pool_size_count].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        pool_sizes[pool_size_count++].descriptorCount = input_attachment_count;
+    }
     
-    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; // TODO: should this be image samplers and storage samplers? no errors yet....?
-    pool_sizes[1].descriptorCount = sampler_count;
+    if (storage_buffer_count > 0u) {
+        pool_sizes[pool_size_count].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pool_sizes[pool_size_count++].descriptorCount = storage_buffer_count;
+    }
+    
+    // Storage images (image2D) for images written by compute shaders
+    if (storage_image_count > 0u) {
+        pool_sizes[pool_size_count].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        pool_sizes[pool_size_count++].descriptorCount = storage_image_count;
+    }
     
     VkDescriptorPoolCreateInfo descriptor_pool_create_info { };
     descriptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptor_pool_create_info.poolSizeCount = 1;
+    descriptor_pool_create_info.poolSizeCount = pool_size_count;
     descriptor_pool_create_info.pPoolSizes = pool_sizes;
-    descriptor_pool_create_info.maxSets = buffer_count + sampler_count; // TODO: not sure this is right
+    descriptor_pool_create_info.maxSets = buffer_count + sampler_count + input_attachment_count + storage_buffer_count + storage_image_count; // TODO: not sure this is right
     descriptor_pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT; // Allow for freeing descriptor sets up at runtime
     
     if (vkCreateDescriptorPool(device, &descriptor_pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
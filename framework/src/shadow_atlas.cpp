@@ -0,0 +1,167 @@
+
+#include "shadow_atlas.hpp"
+#include <algorithm> // std::min, std::max, std::stable_sort
+#include <numeric> // std::iota
+#include <cstdint> // std::uint64_t
+
+namespace {
+    unsigned round_down_to_power_of_two(unsigned value) {
+        unsigned result = 1u;
+        while (result <= value / 2u) {
+            result *= 2u;
+        }
+        return result;
+    }
+}
+
+ShadowAtlas::ShadowAtlas(unsigned size, unsigned min_slot_size) : size(size),
+                                                                  min_slot_size(std::min(min_slot_size, size)) {
+    clear();
+}
+
+ShadowAtlas::~ShadowAtlas() {
+}
+
+bool ShadowAtlas::allocate(unsigned requested, Slot& slot) {
+    unsigned slot_size = get_slot_size(requested);
+    if (slot_size == 0u) {
+        slot = { 0u, 0u, 0u };
+        return false;
+    }
+
+    if (!allocate(0u, slot_size, slot)) {
+        slot = { 0u, 0u, 0u };
+        return false;
+    }
+
+    return true;
+}
+
+bool ShadowAtlas::allocate(unsigned node, unsigned slot_size, Slot& slot) {
+    if (nodes[node].occupied || nodes[node].free_area < slot_size * slot_size) {
+        return false;
+    }
+
+    if (nodes[node].size == slot_size) {
+        // Nodes of the requested size are only free if nothing was allocated in their subtree
+        if (nodes[node].children != 0u) {
+            return false;
+        }
+
+        nodes[node].occupied = true;
+        nodes[node].free_area = 0u;
+        slot = { nodes[node].x, nodes[node].y, slot_size };
+        return true;
+    }
+
+    if (nodes[node].children == 0u) {
+        // Split the node into quadrants (nodes may be reallocated, so the parent is accessed by index)
+        unsigned half = nodes[node].size / 2u;
+        unsigned children = (unsigned) nodes.size();
+
+        for (unsigned i = 0u; i < 4u; ++i) {
+            Node child { };
+            child.x = nodes[node].x + (i & 1u) * half;
+            child.y = nodes[node].y + (i >> 1u) * half;
+            child.size = half;
+            child.children = 0u;
+            child.occupied = false;
+            child.free_area = half * half;
+            nodes.emplace_back(child);
+        }
+
+        nodes[node].children = children;
+    }
+
+    for (unsigned i = 0u; i < 4u; ++i) {
+        if (allocate(nodes[node].children + i, slot_size, slot)) {
+            nodes[node].free_area -= slot_size * slot_size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ShadowAtlas::clear() {
+    nodes.clear();
+
+    Node root { };
+    root.x = 0u;
+    root.y = 0u;
+    root.size = size;
+    root.children = 0u;
+    root.occupied = false;
+    root.free_area = size * size;
+    nodes.emplace_back(root);
+}
+
+std::vector<ShadowAtlas::Slot> ShadowAtlas::pack(const std::vector<unsigned>& sizes) {
+    std::size_t count = sizes.size();
+
+    std::vector<unsigned> slot_sizes(count);
+    std::uint64_t total_area = 0u;
+    for (std::size_t i = 0u; i < count; ++i) {
+        slot_sizes[i] = get_slot_size(sizes[i]);
+        total_area += (std::uint64_t) slot_sizes[i] * slot_sizes[i];
+    }
+
+    // Shrink the largest requests first until all requests fit (earlier requests have priority over later requests of the same size)
+    std::uint64_t capacity = (std::uint64_t) size * size;
+    while (total_area > capacity) {
+        std::size_t largest = 0u;
+        for (std::size_t i = 1u; i < count; ++i) {
+            if (slot_sizes[i] >= slot_sizes[largest]) {
+                largest = i;
+            }
+        }
+
+        if (slot_sizes[largest] > min_slot_size) {
+            total_area -= (std::uint64_t) slot_sizes[largest] * slot_sizes[largest] * 3u / 4u;
+            slot_sizes[largest] /= 2u;
+        }
+        else {
+            // All requests are at the minimum size, drop the last one
+            std::size_t last = count;
+            while (slot_sizes[--last] == 0u) {
+            }
+
+            total_area -= (std::uint64_t) slot_sizes[last] * slot_sizes[last];
+            slot_sizes[last] = 0u;
+        }
+    }
+
+    // Power of two slots allocated in order of decreasing size always fit if their total area does not exceed the area of the atlas
+    std::vector<unsigned> order(count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&slot_sizes](unsigned a, unsigned b) {
+        return slot_sizes[a] > slot_sizes[b];
+    });
+
+    clear();
+
+    std::vector<Slot> slots(count, Slot { 0u, 0u, 0u });
+    for (unsigned i : order) {
+        if (slot_sizes[i] > 0u) {
+            allocate(slot_sizes[i], slots[i]);
+        }
+    }
+
+    return slots;
+}
+
+unsigned ShadowAtlas::get_size() const {
+    return size;
+}
+
+unsigned ShadowAtlas::get_min_slot_size() const {
+    return min_slot_size;
+}
+
+unsigned ShadowAtlas::get_slot_size(unsigned requested) const {
+    if (requested == 0u) {
+        return 0u;
+    }
+
+    return round_down_to_power_of_two(std::max(std::min(requested, size), min_slot_size));
+}
@@ -0,0 +1,198 @@
+
+#include "shadow_cache.hpp"
+#include "helpers.hpp"
+#include <algorithm> // std::binary_search, std::find
+
+ShadowCache::ShadowCache() : invalidated(true) {
+}
+
+ShadowCache::~ShadowCache() {
+}
+
+void ShadowCache::initialize(std::size_t object_count, std::size_t layer_count) {
+    dynamic_objects.assign(object_count, false);
+    static_casters.assign(layer_count, { });
+    dynamic_casters.assign(layer_count, { });
+    cache_dirty.assign(layer_count, true);
+    dirty.assign(layer_count, true);
+    skipped.assign(layer_count, false);
+    cache_draws.clear();
+    draws.clear();
+    invalidated = true;
+}
+
+void ShadowCache::invalidate() {
+    invalidated = true;
+}
+
+void ShadowCache::begin_update(const std::vector<unsigned>& moved) {
+    moved_objects = moved;
+
+    // Objects that move for the first time are removed from the shadow cache of every layer that could see them
+    new_dynamic_objects.clear();
+    for (unsigned i : moved_objects) {
+        if (!dynamic_objects[i]) {
+            dynamic_objects[i] = true;
+            new_dynamic_objects.emplace_back(i);
+        }
+    }
+}
+
+void ShadowCache::update_layer(unsigned layer, const std::vector<unsigned>& casters, bool layer_moved) {
+    std::vector<unsigned> layer_static_casters;
+    std::vector<unsigned> layer_dynamic_casters;
+    for (unsigned i : casters) {
+        if (dynamic_objects[i]) {
+            layer_dynamic_casters.emplace_back(i);
+        }
+        else {
+            layer_static_casters.emplace_back(i);
+        }
+    }
+
+    bool layer_cache_dirty = invalidated || layer_moved || skipped[layer];
+    for (std::size_t i = 0u; !layer_cache_dirty && i < new_dynamic_objects.size(); ++i) {
+        layer_cache_dirty = std::binary_search(static_casters[layer].begin(), static_casters[layer].end(), new_dynamic_objects[i]);
+    }
+
+    // Objects that moved out of the light frustum leave behind a stale shadow, so casters from the previous update are checked as well
+    bool layer_dirty = layer_cache_dirty;
+    for (std::size_t i = 0u; !layer_dirty && i < moved_objects.size(); ++i) {
+        layer_dirty = std::binary_search(layer_dynamic_casters.begin(), layer_dynamic_casters.end(), moved_objects[i]) || std::binary_search(dynamic_casters[layer].begin(), dynamic_casters[layer].end(), moved_objects[i]);
+    }
+
+    static_casters[layer].swap(layer_static_casters);
+    dynamic_casters[layer].swap(layer_dynamic_casters);
+    cache_dirty[layer] = layer_cache_dirty;
+    dirty[layer] = layer_dirty;
+    skipped[layer] = false;
+}
+
+void ShadowCache::skip_layer(unsigned layer) {
+    static_casters[layer].clear();
+    dynamic_casters[layer].clear();
+    cache_dirty[layer] = false;
+    dirty[layer] = false;
+    skipped[layer] = true;
+}
+
+void ShadowCache::end_update(unsigned* instances, unsigned first_instance) {
+    invalidated = false;
+
+    std::size_t capacity = dynamic_objects.size() * cache_dirty.size();
+    build_draws(cache_dirty, static_casters, instances, first_instance, cache_draws);
+    build_draws(dirty, dynamic_casters, instances + capacity, first_instance + (unsigned) capacity, draws);
+}
+
+void ShadowCache::build_draws(const std::vector<bool>& layers, const std::vector<std::vector<unsigned>>& casters, unsigned* instances, unsigned first_instance, std::vector<Draw>& output) const {
+    unsigned instance_count = 0u;
+
+    output.clear();
+    for (std::size_t i = 0u; i < dynamic_objects.size(); ++i) {
+        Draw draw { };
+        draw.object = (unsigned) i;
+        draw.first_instance = first_instance + instance_count;
+        draw.instance_count = 0u;
+
+        for (std::size_t l = 0u; l < layers.size(); ++l) {
+            if (layers[l] && std::binary_search(casters[l].begin(), casters[l].end(), (unsigned) i)) {
+                instances[instance_count++] = (unsigned) l;
+                ++draw.instance_count;
+            }
+        }
+
+        if (draw.instance_count > 0u) {
+            output.emplace_back(draw);
+        }
+    }
+}
+
+void ShadowCache::record(VkCommandBuffer command_buffer, const Pass& pass, const std::function<VkClearRect(unsigned)>& get_region, const std::function<void(VkCommandBuffer, const std::vector<Draw>&)>& record_draws) const {
+    if (std::find(dirty.begin(), dirty.end(), true) == dirty.end()) {
+        // Shadow map is reused from previous frames
+        return;
+    }
+
+    VkImageSubresourceRange subresource_range { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, pass.layer_count };
+
+    VkRenderPassBeginInfo render_pass_info { };
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = pass.render_pass;
+    render_pass_info.renderArea = pass.render_area;
+
+    // The render pass loads its attachment, layers of the shadow cache are cleared explicitly (below), layers of the shadow map are overwritten by the copy
+    render_pass_info.clearValueCount = 0;
+    render_pass_info.pClearValues = nullptr;
+
+    if (std::find(cache_dirty.begin(), cache_dirty.end(), true) != cache_dirty.end()) {
+        // Re-render static casters into the layers of the shadow cache that were invalidated
+        render_pass_info.framebuffer = pass.cache_framebuffer;
+
+        vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline_layout, 0, 1, &pass.descriptor_set, 0, nullptr);
+
+            VkClearAttachment clear_attachment { };
+            clear_attachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            clear_attachment.clearValue.depthStencil = { 1.0f, 0 };
+
+            std::vector<VkClearRect> clear_rects;
+            for (std::size_t l = 0u; l < cache_dirty.size(); ++l) {
+                if (cache_dirty[l]) {
+                    clear_rects.emplace_back(get_region((unsigned) l));
+                }
+            }
+            vkCmdClearAttachments(command_buffer, 1, &clear_attachment, (unsigned) clear_rects.size(), clear_rects.data());
+
+            record_draws(command_buffer, cache_draws);
+        vkCmdEndRenderPass(command_buffer);
+    }
+
+    // Copying is cheaper than depth-compositing the cache with a full screen pass, and also takes care of clearing the layers of the shadow map
+    transition_image(command_buffer, pass.cache_image, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // Shadow map reads from the previous frame need to complete before it is overwritten
+    transition_image(command_buffer, pass.image, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range,
+                     0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // Only the layers that are re-composited this frame are copied
+    std::vector<VkImageCopy> copy_regions;
+    for (std::size_t l = 0u; l < dirty.size(); ++l) {
+        if (dirty[l]) {
+            VkClearRect region = get_region((unsigned) l);
+
+            VkImageCopy& copy_region = copy_regions.emplace_back();
+            copy_region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, region.baseArrayLayer, region.layerCount };
+            copy_region.dstSubresource = copy_region.srcSubresource;
+            copy_region.srcOffset = { region.rect.offset.x, region.rect.offset.y, 0 };
+            copy_region.dstOffset = copy_region.srcOffset;
+            copy_region.extent = { region.rect.extent.width, region.rect.extent.height, 1 };
+        }
+    }
+    vkCmdCopyImage(command_buffer, pass.cache_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pass.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (unsigned) copy_regions.size(), copy_regions.data());
+
+    transition_image(command_buffer, pass.cache_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, subresource_range,
+                     0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+    transition_image(command_buffer, pass.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, subresource_range,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+
+    // Render dynamic casters on top of the static shadows
+    if (!draws.empty()) {
+        render_pass_info.framebuffer = pass.framebuffer;
+
+        vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline_layout, 0, 1, &pass.descriptor_set, 0, nullptr);
+            record_draws(command_buffer, draws);
+        vkCmdEndRenderPass(command_buffer);
+    }
+}
+
+bool ShadowCache::is_cache_dirty(unsigned layer) const {
+    return cache_dirty[layer];
+}
+
+bool ShadowCache::is_dirty(unsigned layer) const {
+    return dirty[layer];
+}
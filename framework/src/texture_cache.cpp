@@ -0,0 +1,175 @@
+
+#include "texture_cache.hpp"
+#include <fstream> // std::ifstream, std::ofstream
+#include <algorithm> // std::max, std::equal, std::copy
+#include <system_error> // std::error_code
+#include <stdexcept> // std::runtime_error
+#include <string> // std::string
+
+namespace {
+    // Incremented whenever the layout of the container changes
+    const std::uint32_t CONTAINER_VERSION = 1u;
+    const char MAGIC[4] = { 'T', 'E', 'X', 'C' };
+
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t format;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t layers;
+        std::uint32_t levels;
+        std::uint32_t texel_size;
+        std::uint64_t size; // Size of the texel data that follows the header, in bytes
+    };
+
+    const std::uint64_t FNV_PRIME = 1099511628211ull;
+}
+
+unsigned CachedTexture::get_level_width(unsigned level) const {
+    return std::max(1u, width >> level);
+}
+
+unsigned CachedTexture::get_level_height(unsigned level) const {
+    return std::max(1u, height >> level);
+}
+
+std::size_t CachedTexture::get_level_offset(unsigned level) const {
+    std::size_t offset = 0u;
+    for (unsigned i = 0u; i < level; ++i) {
+        offset += get_level_size(i);
+    }
+    return offset;
+}
+
+std::size_t CachedTexture::get_level_size(unsigned level) const {
+    return (std::size_t) get_level_width(level) * get_level_height(level) * layers * texel_size;
+}
+
+std::size_t CachedTexture::get_size() const {
+    return get_level_offset(levels);
+}
+
+TextureCache::TextureCache(const std::filesystem::path& directory) : directory(directory) {
+}
+
+TextureCache::~TextureCache() {
+}
+
+std::uint64_t TextureCache::hash(const void* data, std::size_t size, std::uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    std::uint64_t result = seed;
+    for (std::size_t i = 0u; i < size; ++i) {
+        result ^= bytes[i];
+        result *= FNV_PRIME;
+    }
+    return result;
+}
+
+std::uint64_t TextureCache::hash_file(const std::filesystem::path& filepath, std::uint64_t seed) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open '" + filepath.u8string() + "' for hashing!");
+    }
+
+    // Hash in chunks to avoid reading large source files (such as HDR environment maps) into memory at once
+    std::vector<char> buffer(1u << 20u);
+    std::uint64_t result = seed;
+    while (file) {
+        file.read(buffer.data(), (std::streamsize) buffer.size());
+        result = hash(buffer.data(), (std::size_t) file.gcount(), result);
+    }
+    return result;
+}
+
+bool TextureCache::load(const char* name, std::uint64_t key, CachedTexture& texture) const {
+    std::ifstream file(get_filepath(name), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    Header header { };
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(Header))) {
+        return false;
+    }
+
+    if (!std::equal(std::begin(MAGIC), std::end(MAGIC), header.magic) || header.version != CONTAINER_VERSION || header.key != key) {
+        return false;
+    }
+
+    texture.format = header.format;
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.layers = header.layers;
+    texture.levels = header.levels;
+    texture.texel_size = header.texel_size;
+
+    // Description and data must agree, otherwise the entry is corrupt
+    if (header.size != texture.get_size()) {
+        return false;
+    }
+
+    texture.data.resize(header.size);
+    if (!file.read(reinterpret_cast<char*>(texture.data.data()), (std::streamsize) header.size)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool TextureCache::save(const char* name, std::uint64_t key, const CachedTexture& texture) const {
+    if (texture.data.size() != texture.get_size()) {
+        throw std::runtime_error("cached texture data does not match its description!");
+    }
+
+    std::error_code error { };
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return false;
+    }
+
+    Header header { };
+    std::copy(std::begin(MAGIC), std::end(MAGIC), header.magic);
+    header.version = CONTAINER_VERSION;
+    header.key = key;
+    header.format = texture.format;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.layers = texture.layers;
+    header.levels = texture.levels;
+    header.texel_size = texture.texel_size;
+    header.size = texture.data.size();
+
+    std::filesystem::path filepath = get_filepath(name);
+    std::filesystem::path temporary = filepath;
+    temporary += ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(reinterpret_cast<const char*>(texture.data.data()), (std::streamsize) texture.data.size());
+        if (!file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, filepath, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
+
+std::filesystem::path TextureCache::get_filepath(const char* name) const {
+    return directory / (std::string(name) + ".bin");
+}
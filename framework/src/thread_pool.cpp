@@ -0,0 +1,95 @@
+
+#include "thread_pool.hpp"
+#include <algorithm> // std::max
+
+ThreadPool::ThreadPool(unsigned thread_count) : threads(),
+                                                task(nullptr),
+                                                task_count(0u),
+                                                next_task(0u),
+                                                active_workers(0u),
+                                                generation(0u),
+                                                running(true) {
+    if (thread_count == 0u) {
+        // hardware_concurrency() may return 0 if the value is not computable
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    threads.reserve(thread_count);
+    for (unsigned i = 0u; i < thread_count; ++i) {
+        threads.emplace_back(&ThreadPool::worker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    work_available.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+unsigned ThreadPool::size() const {
+    return (unsigned) threads.size();
+}
+
+void ThreadPool::dispatch(std::size_t count, const std::function<void(unsigned, std::size_t)>& fn) {
+    if (count == 0u) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &fn;
+    task_count = count;
+    next_task.store(0u);
+    active_workers = (unsigned) threads.size();
+    ++generation;
+
+    work_available.notify_all();
+
+    // Block until every worker has finished with this dispatch (workers that find no remaining tasks finish immediately)
+    work_complete.wait(lock, [this]() {
+        return active_workers == 0u;
+    });
+
+    task = nullptr;
+}
+
+void ThreadPool::worker(unsigned thread_index) {
+    std::size_t last_generation = 0u;
+
+    while (true) {
+        const std::function<void(unsigned, std::size_t)>* fn;
+        std::size_t count;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this, last_generation]() {
+                return !running || generation != last_generation;
+            });
+
+            if (!running) {
+                return;
+            }
+
+            last_generation = generation;
+            fn = task;
+            count = task_count;
+        }
+
+        // Claim tasks until there are none left
+        for (std::size_t i = next_task.fetch_add(1u); i < count; i = next_task.fetch_add(1u)) {
+            (*fn)(thread_index, i);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active_workers == 0u) {
+                work_complete.notify_one();
+            }
+        }
+    }
+}
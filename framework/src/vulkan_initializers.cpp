@@ -4,6 +4,47 @@
 #include <shaderc/shaderc.hpp>
 #include <filesystem> // std::filesystem
 #include <fstream> // std::ifstream
+#include <iterator> // std::istreambuf_iterator
+#include <memory> // std::make_unique
+
+// Resolves #include "..." directives relative to the directory of the file that contains the directive
+// Shaders shared between samples are copied into shaders/common (see scripts/add_project.cmake)
+class ShaderIncluder final : public shaderc::CompileOptions::IncluderInterface {
+    public:
+        shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type, const char* requesting_source, std::size_t include_depth) override {
+            std::filesystem::path path = std::filesystem::path(requesting_source).parent_path() / requested_source;
+            
+            Include* include = new Include();
+            
+            std::ifstream file(path, std::ios::binary);
+            if (file.is_open()) {
+                include->name = path.u8string();
+                include->content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+            else {
+                // An empty source name signals a failed include, the content is reported as the error message
+                include->content = "failed to open include: " + path.u8string();
+            }
+            
+            include->result.source_name = include->name.c_str();
+            include->result.source_name_length = include->name.size();
+            include->result.content = include->content.c_str();
+            include->result.content_length = include->content.size();
+            include->result.user_data = include;
+            return &include->result;
+        }
+        
+        void ReleaseInclude(shaderc_include_result* data) override {
+            delete static_cast<Include*>(data->user_data);
+        }
+        
+    private:
+        struct Include {
+            std::string name;
+            std::string content;
+            shaderc_include_result result;
+        };
+};
 
 VkShaderModule create_shader_module(VkDevice device, const char* filepath, std::initializer_list<std::pair<std::string, std::string>> preprocessor_definitions) {
     // Read shader into memory
@@ -25,6 +66,7 @@ VkShaderModule create_shader_module(VkDevice device, const char* filepath, std::
     for (const auto&[directive, value] : preprocessor_definitions) {
         options.AddMacroDefinition(directive, value);
     }
+    options.SetIncluder(std::make_unique<ShaderIncluder>());
     
     // TODO: support multiple shader languages
     shaderc_shader_kind type;
@@ -47,10 +89,10 @@ VkShaderModule create_shader_module(VkDevice device, const char* filepath, std::
     }
     
     shaderc::Compiler compiler { };
-    std::string filename = path.stem().u8string(); // Convert from wchar_t
+    std::string filename = path.u8string(); // Convert from wchar_t (full path, as includes are resolved relative to it)
     
     // Function assumes entry point is 'main'
-    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, type, filename.c_str());
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, type, filename.c_str(), options);
     
     if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
         throw std::runtime_error("failed to compile " + std::string(filepath) + ": " + result.GetErrorMessage());
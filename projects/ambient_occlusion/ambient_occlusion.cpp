@@ -2,23 +2,40 @@
 #include "sample.hpp"
 #include "helpers.hpp"
 #include "vulkan_initializers.hpp"
+#include "frustum_culling.hpp"
+#include "render_graph.hpp"
+#include "geometry_buffer.hpp"
 #include "loaders/obj.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/constants.hpp> // glm::two_pi
+#include <cmath> // std::fmod
 #include <random>
+#include <memory> // std::unique_ptr
+#include <string> // std::to_string
 
-// Ambient occlusion consists of doing 4 passes:
+// Ambient occlusion consists of doing 6 passes:
 // 1. Geometry buffer pass
-// 2. Generate ambient occlusion texture
-// 3. Blur ambient occlusion texture
-// 4. Composite ambient occlusion and geometry buffer attachments
+// 2. Downsample depth and normals to the resolution ambient occlusion is computed at (compute)
+// 3. Generate ambient occlusion texture from a fraction of the kernel, rotated every frame (compute)
+// 4. Accumulate ambient occlusion with the reprojected result of previous frames (compute)
+// 5. Blur ambient occlusion texture (compute, separable depth-aware blur from shared memory)
+// 6. Composite ambient occlusion (depth-aware upsample) and geometry buffer attachments
+// Passes are declared in a render graph, which creates the attachments, render passes, framebuffers, and barriers between them
+// Compute passes are submitted to an async compute queue if the device exposes a second queue in the graphics queue family
 
 class AmbientOcclusion final : public Sample {
     public:
         AmbientOcclusion() : Sample("Ambient Occlusion"),
-                             ambient_occlusion_noise({}) {
-            enabled_queue_types = VK_QUEUE_TRANSFER_BIT;
+                             ambient_occlusion_noise({}),
+                             ambient_occlusion_history_images({}),
+                             history_index(0u),
+                             history_valid(false),
+                             ambient_occlusion_frame(0u) {
+            // Compute passes fall back to the graphics queue when no async compute queue is available
+            enabled_queue_types = VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT;
+            async_compute_requested = true;
             debug_view = AO;
             
             camera.set_position(glm::vec3(0, 0.5f, 6));
@@ -50,6 +67,12 @@ class AmbientOcclusion final : public Sample {
 
             std::vector<Object> objects;
         } scene;
+
+        // Model-space bounds of each model, used to (re)compute the world-space bounding volumes of the objects that reference it
+        std::vector<std::pair<glm::vec3, glm::vec3>> model_bounds;
+        
+        FrustumCuller culler;
+        std::vector<unsigned> visible_objects; // Indices into scene.objects that intersect the camera frustum this frame
         
         int OUTPUT = -1;
         int AO = 0;
@@ -61,9 +84,18 @@ class AmbientOcclusion final : public Sample {
         VkBuffer index_buffer;
         VkDeviceMemory index_buffer_memory;
         
-        constexpr static const int KERNEL_SIZE = 36;
+        constexpr static const int KERNEL_SIZE = 32;
         constexpr static const float SAMPLE_RADIUS = 0.5f;
         
+        // Only a fraction of the kernel is evaluated every frame, the temporal pass accumulates the results of KERNEL_SIZE / SAMPLES_PER_FRAME frames to cover the full kernel
+        constexpr static const int SAMPLES_PER_FRAME = 8;
+        
+        // Ambient occlusion is computed at a fraction of the resolution of the geometry buffer in each dimension (2 - half resolution, 4 - quarter resolution)
+        constexpr static const unsigned DOWNSAMPLE_FACTOR = 2u;
+        
+        // Workgroup size (in both dimensions) of the ambient occlusion compute shaders
+        constexpr static const unsigned WORKGROUP_SIZE = 8u;
+        
         glm::vec4 samples[KERNEL_SIZE];
         
         struct Texture {
@@ -72,15 +104,16 @@ class AmbientOcclusion final : public Sample {
             VkImageView image_view { };
         };
         
-        // Geometry buffer
-        // Position, normal, ambient, diffuse, specular, depth
-        std::array<Texture, 6> geometry_framebuffer_attachments;
+        std::unique_ptr<RenderGraph> render_graph;
+        RenderGraph::Resource swapchain_image;
         
-        VkFramebuffer geometry_framebuffer;
-        VkPipelineLayout geometry_pipeline_layout;
+        // Geometry buffer (see geometry_buffer.hpp)
+        // Normal, material, depth (positions are reconstructed from depth)
+        std::array<RenderGraph::Resource, 3> geometry_buffer;
+        RenderGraph::Pass geometry_pass;
         
+        VkPipelineLayout geometry_pipeline_layout;
         VkPipeline geometry_pipeline;
-        VkRenderPass geometry_render_pass;
         
         VkDescriptorSetLayout geometry_global_descriptor_set_layout;
         VkDescriptorSet geometry_global_descriptor_set;
@@ -97,35 +130,67 @@ class AmbientOcclusion final : public Sample {
             glm::mat4 normal;
         };
         struct GeometryObjectFragmentStageUniforms {
-            glm::vec4 ambient; // Padded vec3
-            glm::vec4 diffuse; // Padded vec3
-            glm::vec3 specular; // Padded vec3
-            float exponent;
+            glm::vec3 diffuse;
+            unsigned material; // Index into the material table (ambient, specular)
             int flat_shaded;
         };
         
         // Ambient occlusion
-        // Ambient occlusion, ambient occlusion blurred
-        Texture ambient_occlusion_attachment;
-        VkFramebuffer ambient_occlusion_framebuffer;
+        // Downsampled depth (view space) and normals (view space), ambient occlusion, ambient occlusion blurred (all at reduced resolution)
+        VkExtent2D ambient_occlusion_extent;
+        RenderGraph::Resource ambient_occlusion_depth;
+        RenderGraph::Resource ambient_occlusion_normals;
+        RenderGraph::Pass ambient_occlusion_downsample_pass;
+        
+        RenderGraph::Resource ambient_occlusion_output;
+        RenderGraph::Pass ambient_occlusion_pass;
+        
+        // Accumulated ambient occlusion is stored in two history images owned by the sample that swap roles every frame (history of the previous frame is read, history of this frame is written)
+        // Both are imported into the render graph, as their contents must persist across frames
+        RenderGraph::Resource ambient_occlusion_history;
+        RenderGraph::Resource ambient_occlusion_accumulated;
+        RenderGraph::Resource ambient_occlusion_temporal_output;
+        RenderGraph::Pass ambient_occlusion_temporal_pass;
+        
+        RenderGraph::Resource ambient_occlusion_blur_output;
+        RenderGraph::Pass ambient_occlusion_blur_pass;
         
-        Texture ambient_occlusion_blur_attachment;
-        VkFramebuffer ambient_occlusion_blur_framebuffer;
+        VkPipelineLayout ambient_occlusion_downsample_pipeline_layout;
+        VkPipeline ambient_occlusion_downsample_pipeline;
+        
+        VkDescriptorSetLayout ambient_occlusion_downsample_descriptor_set_layout;
+        VkDescriptorSet ambient_occlusion_downsample_descriptor_set;
         
         VkPipelineLayout ambient_occlusion_pipeline_layout;
         VkPipeline ambient_occlusion_pipeline;
-        VkRenderPass ambient_occlusion_render_pass;
         
         VkDescriptorSetLayout ambient_occlusion_descriptor_set_layout;
         VkDescriptorSet ambient_occlusion_descriptor_set;
         struct AmbientOcclusionUniforms {
             glm::mat4 projection;
+            glm::mat4 inverse_projection;
+            glm::mat4 reprojection; // View space of this frame to view space of the previous frame
+            glm::mat4 previous_projection;
+            unsigned kernel_offset;
+            float kernel_rotation;
+            int history_valid;
+            float padding; // Kernel is aligned to 16 bytes (std140)
             glm::vec4 samples[KERNEL_SIZE];
         };
         
+        VkPipelineLayout ambient_occlusion_temporal_pipeline_layout;
+        VkPipeline ambient_occlusion_temporal_pipeline;
+        
+        VkDescriptorSetLayout ambient_occlusion_temporal_descriptor_set_layout;
+        std::array<VkDescriptorSet, 2> ambient_occlusion_temporal_descriptor_sets; // Indexed by the history image written this frame
+        
+        std::array<Texture, 2> ambient_occlusion_history_images;
+        unsigned history_index; // History image written this frame
+        bool history_valid; // History is invalid until the first frame has been rendered
+        unsigned ambient_occlusion_frame;
+        
         VkPipelineLayout ambient_occlusion_blur_pipeline_layout;
         VkPipeline ambient_occlusion_blur_pipeline;
-        VkRenderPass ambient_occlusion_blur_render_pass;
         
         VkDescriptorSetLayout ambient_occlusion_blur_descriptor_set_layout;
         VkDescriptorSet ambient_occlusion_blur_descriptor_set;
@@ -133,7 +198,7 @@ class AmbientOcclusion final : public Sample {
         Texture ambient_occlusion_noise;
         
         // Composition
-        VkRenderPass composition_render_pass;
+        RenderGraph::Pass composition_pass;
         
         VkPipelineLayout composition_pipeline_layout;
         VkPipeline composition_pipeline;
@@ -142,6 +207,7 @@ class AmbientOcclusion final : public Sample {
         VkDescriptorSet composition_descriptor_set;
         struct CompositionUniforms {
             glm::mat4 view;
+            glm::mat4 inverse_projection;
             glm::vec3 camera_position;
             int debug_view;
         };
@@ -153,21 +219,24 @@ class AmbientOcclusion final : public Sample {
         
         VkSampler sampler; // Shared color sampler
         
+        // With async compute, each frame is split into three submissions: geometry (graphics queue), ambient occlusion (compute queue), and composition (graphics queue)
+        // Only used if the compute queue is from the graphics queue family, so that render graph resources do not need queue family ownership transfers
+        bool async_compute;
+        std::vector<VkCommandBuffer> composition_command_buffers; // Geometry pass is recorded into 'command_buffers', one per frame in flight
+        std::vector<VkSemaphore> is_geometry_complete;
+        std::vector<VkSemaphore> is_ambient_occlusion_complete;
+        
         void initialize_resources() override {
             initialize_samplers();
             initialize_ambient_occlusion_resources();
+            initialize_async_compute_resources();
 
-            initialize_geometry_render_pass();
-            initialize_ambient_occlusion_render_pass();
-            initialize_ambient_occlusion_blur_render_pass();
-            initialize_composition_render_pass();
+            // Attachments must exist before the descriptor sets that sample them are written, and render passes before the pipelines that use them are created
+            initialize_render_graph();
+            render_graph->print_memory();
+            initialize_ambient_occlusion_history_resources();
 
-            initialize_geometry_framebuffer();
-            initialize_ambient_occlusion_framebuffer();
-            initialize_ambient_occlusion_blur_framebuffer();
-            initialize_composition_framebuffers();
-
-            initialize_descriptor_pool(1 + 2 * scene.objects.size() + 1 + 1, 12);
+            initialize_descriptor_pool(1 + 2 * scene.objects.size() + 2 + 2 + 2, 18, 0, 0, 10);
 
             initialize_buffers();
 
@@ -176,12 +245,16 @@ class AmbientOcclusion final : public Sample {
             // Initialize descriptor sets
             initialize_geometry_global_descriptor_set();
             initialize_geometry_per_object_descriptor_sets();
+            initialize_ambient_occlusion_downsample_descriptor_set();
             initialize_ambient_occlusion_descriptor_set();
+            initialize_ambient_occlusion_temporal_descriptor_sets();
             initialize_ambient_occlusion_blur_descriptor_set();
             initialize_composition_descriptor_set();
 
             initialize_geometry_pipeline();
+            initialize_ambient_occlusion_downsample_pipeline();
             initialize_ambient_occlusion_pipeline();
+            initialize_ambient_occlusion_temporal_pipeline();
             initialize_ambient_occlusion_blur_pipeline();
             initialize_composition_pipeline();
         }
@@ -191,8 +264,9 @@ class AmbientOcclusion final : public Sample {
             destroy_descriptor_set_layouts();
             destroy_uniform_buffer();
             destroy_buffers();
-            destroy_framebuffers();
-            destroy_render_passes();
+            destroy_ambient_occlusion_history_resources();
+            destroy_render_graph();
+            destroy_async_compute_resources();
             destroy_ambient_occlusion_resources();
             destroy_samplers();
         }
@@ -201,6 +275,10 @@ class AmbientOcclusion final : public Sample {
             Scene::Object& object = scene.objects.back();
             Transform& transform = object.transform;
             transform.set_rotation(transform.get_rotation() + (float)dt * glm::vec3(0.0f, -10.0f, 0.0f));
+            
+            culler.update_objects(scene.objects, model_bounds);
+            culler.cull(camera.get_projection_matrix() * camera.get_view_matrix(), visible_objects);
+            
             update_uniform_buffers();
         }
         
@@ -212,6 +290,60 @@ class AmbientOcclusion final : public Sample {
 
             // Record command buffer for this frame
             record_command_buffers(image_index);
+            
+            if (async_compute) {
+                // Geometry pass
+                VkSubmitInfo geometry_submit_info { };
+                geometry_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                geometry_submit_info.commandBufferCount = 1;
+                geometry_submit_info.pCommandBuffers = &command_buffers[frame_index];
+                geometry_submit_info.signalSemaphoreCount = 1;
+                geometry_submit_info.pSignalSemaphores = &is_geometry_complete[frame_index];
+                
+                if (vkQueueSubmit(queue, 1, &geometry_submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit command buffer!");
+                }
+                
+                // Ambient occlusion passes
+                // The compute command buffer starts with the barriers that transition the geometry buffer attachments for reading, so all stages must wait on the geometry pass
+                VkPipelineStageFlags compute_wait_stage_flags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                
+                VkSubmitInfo compute_submit_info { };
+                compute_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                compute_submit_info.waitSemaphoreCount = 1;
+                compute_submit_info.pWaitSemaphores = &is_geometry_complete[frame_index];
+                compute_submit_info.pWaitDstStageMask = &compute_wait_stage_flags;
+                compute_submit_info.commandBufferCount = 1;
+                compute_submit_info.pCommandBuffers = &compute_command_buffers[frame_index];
+                compute_submit_info.signalSemaphoreCount = 1;
+                compute_submit_info.pSignalSemaphores = &is_ambient_occlusion_complete[frame_index];
+                
+                if (vkQueueSubmit(compute_queue, 1, &compute_submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit compute command buffer!");
+                }
+                
+                // Composition pass
+                // Same as above, the composition command buffer starts with barriers for the ambient occlusion output written by the compute queue
+                VkSemaphore wait_semaphores[] = { is_ambient_occlusion_complete[frame_index], is_image_available };
+                VkPipelineStageFlags wait_stage_flags[] = { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+                
+                VkSubmitInfo composition_submit_info { };
+                composition_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                composition_submit_info.waitSemaphoreCount = 2;
+                composition_submit_info.pWaitSemaphores = wait_semaphores;
+                composition_submit_info.pWaitDstStageMask = wait_stage_flags;
+                composition_submit_info.commandBufferCount = 1;
+                composition_submit_info.pCommandBuffers = &composition_command_buffers[frame_index];
+                composition_submit_info.signalSemaphoreCount = 1;
+                composition_submit_info.pSignalSemaphores = &is_rendering_complete[frame_index];
+                
+                if (vkQueueSubmit(queue, 1, &composition_submit_info, is_frame_in_flight[frame_index]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to submit command buffer!");
+                }
+                
+                advance_history();
+                return;
+            }
 
             VkSubmitInfo submit_info { };
             submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -234,10 +366,39 @@ class AmbientOcclusion final : public Sample {
             if (vkQueueSubmit(queue, 1, &submit_info, is_frame_in_flight[frame_index]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to submit command buffer!");
             }
+            
+            advance_history();
+        }
+        
+        void advance_history() {
+            // History written this frame is read next frame
+            history_index = 1u - history_index;
+            history_valid = true;
+            ++ambient_occlusion_frame;
         }
         
         void record_command_buffers(unsigned image_index) override {
-            VkCommandBuffer command_buffer = command_buffers[frame_index];
+            // Composition pass renders directly into the swapchain image acquired for this frame
+            render_graph->set_imported_image(swapchain_image, swapchain_images[image_index], swapchain_image_views[image_index]);
+            
+            // History written in the previous frame is read in this frame
+            const Texture& history = ambient_occlusion_history_images[1u - history_index];
+            const Texture& accumulated = ambient_occlusion_history_images[history_index];
+            render_graph->set_imported_image(ambient_occlusion_history, history.image, history.image_view);
+            render_graph->set_imported_image(ambient_occlusion_accumulated, accumulated.image, accumulated.image_view);
+            
+            if (async_compute) {
+                // Passes must be recorded in order, as barriers between passes are recorded with the later pass
+                record_render_graph(command_buffers[frame_index], geometry_pass, geometry_pass);
+                record_render_graph(compute_command_buffers[frame_index], ambient_occlusion_downsample_pass, ambient_occlusion_blur_pass);
+                record_render_graph(composition_command_buffers[frame_index], composition_pass, composition_pass);
+            }
+            else {
+                record_render_graph(command_buffers[frame_index], geometry_pass, composition_pass);
+            }
+        }
+        
+        void record_render_graph(VkCommandBuffer command_buffer, RenderGraph::Pass first, RenderGraph::Pass last) {
             vkResetCommandBuffer(command_buffer, 0);
             
             VkCommandBufferBeginInfo command_buffer_begin_info { };
@@ -246,129 +407,58 @@ class AmbientOcclusion final : public Sample {
             if (vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info) != VK_SUCCESS) {
                 throw std::runtime_error("failed to begin command buffer recording!");
             }
+            
+            render_graph->execute(command_buffer, first, last);
+            
+            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record command buffer!");
+            }
+        }
         
-            // Generate geometry buffer
-            {
-                VkRenderPassBeginInfo render_pass_info { };
-                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                render_pass_info.renderPass = geometry_render_pass;
-                render_pass_info.framebuffer = geometry_framebuffer;
-                render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-                
-                VkClearValue clear_values[6] { };
-                clear_values[0].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Position
-                clear_values[1].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Normal
-                clear_values[2].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Ambient
-                clear_values[3].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Diffuse
-                clear_values[4].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Specular
-                clear_values[5].depthStencil = { 1.0f, 0 }; // Depth
-                render_pass_info.clearValueCount = sizeof(clear_values) / sizeof(clear_values[0]);
-                render_pass_info.pClearValues = clear_values;
-                
-                vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                    // Bind graphics pipeline
-                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline);
-    
-                    // Bind global descriptor set
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline_layout, 0, 1, &geometry_global_descriptor_set, 0, nullptr);
-    
-                    for (std::size_t i = 0u; i < scene.objects.size(); ++i) {
-                        const Scene::Object& object = scene.objects[i];
-                        const Model& model = models[object.model];
-    
-                        // Bind vertex + index buffers buffer
-                        VkDeviceSize offsets[] = { object.vertex_offset  };
-                        vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
-                        vkCmdBindIndexBuffer(command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
-    
-                        // Bind per-object descriptor set
-                        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline_layout, 1, 1, &geometry_object_descriptor_sets[i], 0, nullptr);
-    
-                        vkCmdDrawIndexed(command_buffer, (unsigned) model.indices.size(), 1, 0, 0, 0);
-                    }
-                vkCmdEndRenderPass(command_buffer);
+        void initialize_async_compute_resources() {
+            // Resources written by the compute passes are shared with the graphics passes without ownership transfers, which requires both queues to be from the same queue family
+            async_compute = compute_queue != VK_NULL_HANDLE && compute_queue_family_index == queue_family_index;
+            if (!async_compute) {
+                return;
             }
             
-            // Ambient occlusion pass
-            {
-                VkRenderPassBeginInfo render_pass_info { };
-                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                render_pass_info.renderPass = ambient_occlusion_render_pass;
-                render_pass_info.framebuffer = ambient_occlusion_framebuffer;
-                render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-                
-                // Ambient occlusion pass writes to one color attachment, no depth
-                VkClearValue clear_value { };
-                clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-                render_pass_info.clearValueCount = 1;
-                render_pass_info.pClearValues = &clear_value;
-                
-                vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                    // Bind graphics pipeline
-                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ambient_occlusion_pipeline);
-    
-                    // Bind global descriptor set
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ambient_occlusion_pipeline_layout, 0, 1, &ambient_occlusion_descriptor_set, 0, nullptr);
-                    
-                    // Draw FSQ
-                    vkCmdDraw(command_buffer, 3, 1, 0, 0);
-                vkCmdEndRenderPass(command_buffer);
-            }
+            composition_command_buffers.resize(NUM_FRAMES_IN_FLIGHT);
             
-            // Ambient occlusion blur pass
-            {
-                VkRenderPassBeginInfo render_pass_info { };
-                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                render_pass_info.renderPass = ambient_occlusion_blur_render_pass;
-                render_pass_info.framebuffer = ambient_occlusion_blur_framebuffer;
-                render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-
-                // Ambient occlusion blur pass writes to one color attachment, no depth
-                VkClearValue clear_value { };
-                clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-                render_pass_info.clearValueCount = 1;
-                render_pass_info.pClearValues = &clear_value;
-
-                vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                    // Bind graphics pipeline
-                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ambient_occlusion_blur_pipeline);
-
-                    // Bind global descriptor set
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ambient_occlusion_blur_pipeline_layout, 0, 1, &ambient_occlusion_blur_descriptor_set, 0, nullptr);
-
-                    // Draw FSQ
-                    vkCmdDraw(command_buffer, 3, 1, 0, 0);
-                vkCmdEndRenderPass(command_buffer);
+            VkCommandBufferAllocateInfo command_buffer_ai { };
+            command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            command_buffer_ai.commandPool = command_pool;
+            command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            command_buffer_ai.commandBufferCount = NUM_FRAMES_IN_FLIGHT;
+            
+            if (vkAllocateCommandBuffers(device, &command_buffer_ai, composition_command_buffers.data()) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
             }
             
-            // Composition pass
-            {
-                VkRenderPassBeginInfo render_pass_info { };
-                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                render_pass_info.renderPass = composition_render_pass;
-                render_pass_info.framebuffer = present_framebuffers[image_index];
-                render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-                
-                // Composition pipeline writes to one color attachment, no depth
-                VkClearValue clear_value { };
-                clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-                render_pass_info.clearValueCount = 1;
-                render_pass_info.pClearValues = &clear_value;
+            is_geometry_complete.resize(NUM_FRAMES_IN_FLIGHT);
+            is_ambient_occlusion_complete.resize(NUM_FRAMES_IN_FLIGHT);
+            
+            VkSemaphoreCreateInfo semaphore_create_info { };
+            semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            
+            for (int i = 0; i < NUM_FRAMES_IN_FLIGHT; ++i) {
+                if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &is_geometry_complete[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create semaphore (is_geometry_complete)");
+                }
                 
-                vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                    // Bind graphics pipeline
-                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline);
-    
-                    // Bind global descriptor set
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline_layout, 0, 1, &composition_descriptor_set, 0, nullptr);
-                    
-                    // Draw FSQ
-                    vkCmdDraw(command_buffer, 3, 1, 0, 0);
-                vkCmdEndRenderPass(command_buffer);
+                if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &is_ambient_occlusion_complete[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create semaphore (is_ambient_occlusion_complete)");
+                }
+            }
+        }
+        
+        void destroy_async_compute_resources() {
+            // Command buffers are freed with the command pool they were allocated from
+            for (VkSemaphore semaphore : is_geometry_complete) {
+                vkDestroySemaphore(device, semaphore, nullptr);
             }
             
-            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer!");
+            for (VkSemaphore semaphore : is_ambient_occlusion_complete) {
+                vkDestroySemaphore(device, semaphore, nullptr);
             }
         }
         
@@ -442,11 +532,8 @@ class AmbientOcclusion final : public Sample {
             
             // Needs one color blend attachment per color attachment, otherwise colorMask will be set to 0 and the attachment will not receive any color output
             VkPipelineColorBlendAttachmentState color_blend_attachment_states[] {
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Position
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Normal
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Ambient
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Diffuse
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Specular
+                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT, false), // Normal (octahedral)
+                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Material
             };
         
             VkPipelineColorBlendStateCreateInfo color_blend_create_info { };
@@ -493,8 +580,8 @@ class AmbientOcclusion final : public Sample {
             pipeline_create_info.pColorBlendState = &color_blend_create_info;
             pipeline_create_info.pDynamicState = nullptr;
             pipeline_create_info.layout = geometry_pipeline_layout;
-            pipeline_create_info.renderPass = geometry_render_pass;
-            pipeline_create_info.subpass = 0;
+            pipeline_create_info.renderPass = render_graph->get_render_pass(geometry_pass);
+            pipeline_create_info.subpass = render_graph->get_subpass(geometry_pass);
         
             // TODO: Allows for recreating a pipeline from an existing pipeline
             pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
@@ -510,74 +597,33 @@ class AmbientOcclusion final : public Sample {
             }
         }
         
-        void initialize_ambient_occlusion_pipeline() {
-            // Vertex data is generated directly in the vertex shader, no vertex input state to specify
-            VkPipelineVertexInputStateCreateInfo vertex_input_create_info { };
-            vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-            
-            // Input assembly describes the topology of the geometry being rendered
-            VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = create_input_assembly_state(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-        
-            // The viewport describes the region of the framebuffer that the output will be rendered to
-            VkViewport viewport = create_viewport(0.0f, 0.0f, (float) swapchain_extent.width, (float) swapchain_extent.height, 0.0f, 1.0f);
-        
-            // The scissor region defines the portion of the viewport that will be drawn to the screen
-            VkRect2D scissor = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-            
-            VkPipelineViewportStateCreateInfo viewport_create_info { };
-            viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-            viewport_create_info.viewportCount = 1;
-            viewport_create_info.pViewports = &viewport;
-            viewport_create_info.scissorCount = 1;
-            viewport_create_info.pScissors = &scissor;
-            
-            // Rasterization properties
-            VkPipelineRasterizationStateCreateInfo rasterizer_create_info { };
-            rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-            rasterizer_create_info.depthClampEnable = VK_FALSE; // Fragments beyond the near/far depth planes are clamped instead of discarded
-            rasterizer_create_info.rasterizerDiscardEnable = VK_FALSE; // Discards any / all output fragments to the framebuffer
-        
-            rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
+        void initialize_ambient_occlusion_downsample_pipeline() {
+            VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
+            pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_create_info.setLayoutCount = 1;
+            pipeline_layout_create_info.pSetLayouts = &ambient_occlusion_downsample_descriptor_set_layout;
+            if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &ambient_occlusion_downsample_pipeline_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline layout!");
+            }
             
-            rasterizer_create_info.lineWidth = 1.0f;
-            rasterizer_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
-            rasterizer_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-            rasterizer_create_info.depthBiasEnable = VK_FALSE;
-            rasterizer_create_info.depthBiasConstantFactor = 0.0f;
-            rasterizer_create_info.depthBiasClamp = 0.0f;
-            rasterizer_create_info.depthBiasSlopeFactor = 0.0f;
-        
-            // Multisampling is disabled for this sample
-            VkPipelineMultisampleStateCreateInfo multisampling_create_info { };
-            multisampling_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-            multisampling_create_info.sampleShadingEnable = VK_FALSE;
-            multisampling_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-            multisampling_create_info.minSampleShading = 1.0f;
-            multisampling_create_info.pSampleMask = nullptr;
-            multisampling_create_info.alphaToCoverageEnable = VK_FALSE;
-            multisampling_create_info.alphaToOneEnable = VK_FALSE;
-        
-            // Depth/stencil buffers
-            VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info { };
-            depth_stencil_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-            depth_stencil_create_info.depthTestEnable = VK_FALSE;
-            depth_stencil_create_info.depthWriteEnable = VK_FALSE;
-            depth_stencil_create_info.depthCompareOp = VK_COMPARE_OP_LESS; // Fragments that are closer have a lower depth value and should be kept (fragments further away are discarded)
+            // Downsample factor is compiled into the shader
+            VkShaderModule shader_module = create_shader_module(device, "shaders/downsample.comp", {
+                { "DOWNSAMPLE_FACTOR", std::to_string(DOWNSAMPLE_FACTOR) },
+                { "WORKGROUP_SIZE", std::to_string(WORKGROUP_SIZE) }
+            });
+            
+            VkComputePipelineCreateInfo pipeline_create_info { };
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipeline_create_info.layout = ambient_occlusion_downsample_pipeline_layout;
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &ambient_occlusion_downsample_pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
             
-            // Needs one color blend attachment, otherwise colorMask will be set to 0 and the attachment will not receive any color output
-            VkPipelineColorBlendAttachmentState color_blend_attachment_state = create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false);
+            vkDestroyShaderModule(device, shader_module, nullptr);
+        }
         
-            VkPipelineColorBlendStateCreateInfo color_blend_create_info { };
-            color_blend_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-            color_blend_create_info.logicOpEnable = VK_FALSE; // Use a bitwise operation to combine the old and new color values (setting this to true disables color mixing (specified above) for all framebuffers)
-            color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
-            color_blend_create_info.attachmentCount = 1;
-            color_blend_create_info.pAttachments = &color_blend_attachment_state;
-            color_blend_create_info.blendConstants[0] = 0.0f;
-            color_blend_create_info.blendConstants[1] = 0.0f;
-            color_blend_create_info.blendConstants[2] = 0.0f;
-            color_blend_create_info.blendConstants[3] = 0.0f;
-            
+        void initialize_ambient_occlusion_pipeline() {
             VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
             pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
             pipeline_layout_create_info.setLayoutCount = 1;
@@ -589,8 +635,8 @@ class AmbientOcclusion final : public Sample {
                 throw std::runtime_error("failed to create pipeline layout!");
             }
             
-            // Fragment shader constants
-            VkSpecializationMapEntry specializations[2] { };
+            // Compute shader constants
+            VkSpecializationMapEntry specializations[3] { };
             
             // layout (constant_id = 0) int KERNEL_SIZE;
             specializations[0].constantID = 0;
@@ -602,124 +648,67 @@ class AmbientOcclusion final : public Sample {
             specializations[1].size = sizeof(float);
             specializations[1].offset = sizeof(int);
             
+            // layout (constant_id = 2) int SAMPLES_PER_FRAME;
+            specializations[2].constantID = 2;
+            specializations[2].size = sizeof(int);
+            specializations[2].offset = sizeof(int) + sizeof(float);
+            
             struct SpecializationData {
                 int kernel_size;
                 float sample_radius;
+                int samples_per_frame;
             };
             SpecializationData data { };
             data.kernel_size = KERNEL_SIZE;
             data.sample_radius = SAMPLE_RADIUS;
+            data.samples_per_frame = SAMPLES_PER_FRAME;
             
             VkSpecializationInfo specialization_info { };
-            specialization_info.mapEntryCount = 2;
+            specialization_info.mapEntryCount = 3;
             specialization_info.pMapEntries = specializations;
             specialization_info.dataSize = sizeof(SpecializationData);
             specialization_info.pData = &data;
             
-            // Bundle shader stages to assign to pipeline
-            VkPipelineShaderStageCreateInfo shader_stages[] = {
-                create_shader_stage(create_shader_module(device, "shaders/fullscreen.vert"), VK_SHADER_STAGE_VERTEX_BIT),
-                create_shader_stage(create_shader_module(device, "shaders/ambient_occlusion.frag"), VK_SHADER_STAGE_FRAGMENT_BIT, &specialization_info),
-            };
+            // Workgroup size determines the size of the depth tile cached in shared memory, so it is compiled into the shader
+            VkShaderModule shader_module = create_shader_module(device, "shaders/ambient_occlusion.comp", { { "WORKGROUP_SIZE", std::to_string(WORKGROUP_SIZE) } });
             
-            VkGraphicsPipelineCreateInfo pipeline_create_info { };
-            pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-            pipeline_create_info.stageCount = sizeof(shader_stages) / sizeof(shader_stages[0]);
-            pipeline_create_info.pStages = shader_stages;
-            pipeline_create_info.pVertexInputState = &vertex_input_create_info;
-            pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
-            pipeline_create_info.pViewportState = &viewport_create_info;
-            pipeline_create_info.pRasterizationState = &rasterizer_create_info;
-            pipeline_create_info.pMultisampleState = &multisampling_create_info;
-            pipeline_create_info.pDepthStencilState = &depth_stencil_create_info;
-            pipeline_create_info.pColorBlendState = &color_blend_create_info;
-            pipeline_create_info.pDynamicState = nullptr;
+            VkComputePipelineCreateInfo pipeline_create_info { };
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
             pipeline_create_info.layout = ambient_occlusion_pipeline_layout;
-            pipeline_create_info.renderPass = ambient_occlusion_render_pass;
-            pipeline_create_info.subpass = 0;
-        
-            // TODO: Allows for recreating a pipeline from an existing pipeline
-            pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
-            pipeline_create_info.basePipelineIndex = -1;
-        
-            // TODO: pipeline caching.
-            if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &ambient_occlusion_pipeline) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create pipeline!");
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT, &specialization_info);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &ambient_occlusion_pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
             }
-
-            for (const VkPipelineShaderStageCreateInfo& stage : shader_stages) {
-                vkDestroyShaderModule(device, stage.module, nullptr);
-            }
-        }
-        
-        void initialize_ambient_occlusion_blur_pipeline() {
-            // Vertex data is generated directly in the vertex shader, no vertex input state to specify
-            VkPipelineVertexInputStateCreateInfo vertex_input_create_info { };
-            vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
             
-            // Input assembly describes the topology of the geometry being rendered
-            VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = create_input_assembly_state(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+            vkDestroyShaderModule(device, shader_module, nullptr);
+        }
         
-            // The viewport describes the region of the framebuffer that the output will be rendered to
-            VkViewport viewport = create_viewport(0.0f, 0.0f, (float) swapchain_extent.width, (float) swapchain_extent.height, 0.0f, 1.0f);
+        void initialize_ambient_occlusion_temporal_pipeline() {
+            VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
+            pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_create_info.setLayoutCount = 1;
+            pipeline_layout_create_info.pSetLayouts = &ambient_occlusion_temporal_descriptor_set_layout;
+            pipeline_layout_create_info.pushConstantRangeCount = 0;
+            pipeline_layout_create_info.pPushConstantRanges = nullptr;
         
-            // The scissor region defines the portion of the viewport that will be drawn to the screen
-            VkRect2D scissor = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
+            if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &ambient_occlusion_temporal_pipeline_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline layout!");
+            }
             
-            VkPipelineViewportStateCreateInfo viewport_create_info { };
-            viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-            viewport_create_info.viewportCount = 1;
-            viewport_create_info.pViewports = &viewport;
-            viewport_create_info.scissorCount = 1;
-            viewport_create_info.pScissors = &scissor;
+            VkShaderModule shader_module = create_shader_module(device, "shaders/temporal.comp", { { "WORKGROUP_SIZE", std::to_string(WORKGROUP_SIZE) } });
             
-            // Rasterization properties
-            VkPipelineRasterizationStateCreateInfo rasterizer_create_info { };
-            rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-            rasterizer_create_info.depthClampEnable = VK_FALSE; // Fragments beyond the near/far depth planes are clamped instead of discarded
-            rasterizer_create_info.rasterizerDiscardEnable = VK_FALSE; // Discards any / all output fragments to the framebuffer
-        
-            rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
-            
-            rasterizer_create_info.lineWidth = 1.0f;
-            rasterizer_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
-            rasterizer_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-            rasterizer_create_info.depthBiasEnable = VK_FALSE;
-            rasterizer_create_info.depthBiasConstantFactor = 0.0f;
-            rasterizer_create_info.depthBiasClamp = 0.0f;
-            rasterizer_create_info.depthBiasSlopeFactor = 0.0f;
-        
-            // Multisampling is disabled for this sample
-            VkPipelineMultisampleStateCreateInfo multisampling_create_info { };
-            multisampling_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-            multisampling_create_info.sampleShadingEnable = VK_FALSE;
-            multisampling_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-            multisampling_create_info.minSampleShading = 1.0f;
-            multisampling_create_info.pSampleMask = nullptr;
-            multisampling_create_info.alphaToCoverageEnable = VK_FALSE;
-            multisampling_create_info.alphaToOneEnable = VK_FALSE;
-        
-            // Depth/stencil buffers
-            VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info { };
-            depth_stencil_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-            depth_stencil_create_info.depthTestEnable = VK_FALSE;
-            depth_stencil_create_info.depthWriteEnable = VK_FALSE;
-            depth_stencil_create_info.depthCompareOp = VK_COMPARE_OP_LESS; // Fragments that are closer have a lower depth value and should be kept (fragments further away are discarded)
+            VkComputePipelineCreateInfo pipeline_create_info { };
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipeline_create_info.layout = ambient_occlusion_temporal_pipeline_layout;
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &ambient_occlusion_temporal_pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
             
-            // Needs one color blend attachment, otherwise colorMask will be set to 0 and the attachment will not receive any color output
-            VkPipelineColorBlendAttachmentState color_blend_attachment_state = create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false);
+            vkDestroyShaderModule(device, shader_module, nullptr);
+        }
         
-            VkPipelineColorBlendStateCreateInfo color_blend_create_info { };
-            color_blend_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-            color_blend_create_info.logicOpEnable = VK_FALSE; // Use a bitwise operation to combine the old and new color values (setting this to true disables color mixing (specified above) for all framebuffers)
-            color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
-            color_blend_create_info.attachmentCount = 1;
-            color_blend_create_info.pAttachments = &color_blend_attachment_state;
-            color_blend_create_info.blendConstants[0] = 0.0f;
-            color_blend_create_info.blendConstants[1] = 0.0f;
-            color_blend_create_info.blendConstants[2] = 0.0f;
-            color_blend_create_info.blendConstants[3] = 0.0f;
-            
+        void initialize_ambient_occlusion_blur_pipeline() {
             VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
             pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
             pipeline_layout_create_info.setLayoutCount = 1;
@@ -731,40 +720,17 @@ class AmbientOcclusion final : public Sample {
                 throw std::runtime_error("failed to create pipeline layout!");
             }
             
-            // Bundle shader stages to assign to pipeline
-            VkPipelineShaderStageCreateInfo shader_stages[] = {
-                create_shader_stage(create_shader_module(device, "shaders/fullscreen.vert"), VK_SHADER_STAGE_VERTEX_BIT),
-                create_shader_stage(create_shader_module(device, "shaders/blur.frag"), VK_SHADER_STAGE_FRAGMENT_BIT),
-            };
+            VkShaderModule shader_module = create_shader_module(device, "shaders/blur.comp", { { "WORKGROUP_SIZE", std::to_string(WORKGROUP_SIZE) } });
             
-            VkGraphicsPipelineCreateInfo pipeline_create_info { };
-            pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-            pipeline_create_info.stageCount = sizeof(shader_stages) / sizeof(shader_stages[0]);
-            pipeline_create_info.pStages = shader_stages;
-            pipeline_create_info.pVertexInputState = &vertex_input_create_info;
-            pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
-            pipeline_create_info.pViewportState = &viewport_create_info;
-            pipeline_create_info.pRasterizationState = &rasterizer_create_info;
-            pipeline_create_info.pMultisampleState = &multisampling_create_info;
-            pipeline_create_info.pDepthStencilState = &depth_stencil_create_info;
-            pipeline_create_info.pColorBlendState = &color_blend_create_info;
-            pipeline_create_info.pDynamicState = nullptr;
+            VkComputePipelineCreateInfo pipeline_create_info { };
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
             pipeline_create_info.layout = ambient_occlusion_blur_pipeline_layout;
-            pipeline_create_info.renderPass = ambient_occlusion_blur_render_pass;
-            pipeline_create_info.subpass = 0;
-        
-            // TODO: Allows for recreating a pipeline from an existing pipeline
-            pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
-            pipeline_create_info.basePipelineIndex = -1;
-        
-            // TODO: pipeline caching.
-            if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &ambient_occlusion_blur_pipeline) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create pipeline!");
-            }
-
-            for (const VkPipelineShaderStageCreateInfo& stage : shader_stages) {
-                vkDestroyShaderModule(device, stage.module, nullptr);
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &ambient_occlusion_blur_pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
             }
+            
+            vkDestroyShaderModule(device, shader_module, nullptr);
         }
         
         void initialize_composition_pipeline() {
@@ -775,7 +741,7 @@ class AmbientOcclusion final : public Sample {
             // Bundle shader stages to assign to pipeline
             VkPipelineShaderStageCreateInfo shader_stages[] = {
                 create_shader_stage(create_shader_module(device, "shaders/composition.vert"), VK_SHADER_STAGE_VERTEX_BIT),
-                create_shader_stage(create_shader_module(device, "shaders/composition.frag"), VK_SHADER_STAGE_FRAGMENT_BIT),
+                create_shader_stage(create_shader_module(device, "shaders/composition.frag", { { "MATERIAL_COUNT", std::to_string(scene.objects.size()) } }), VK_SHADER_STAGE_FRAGMENT_BIT), // One material per object
             };
             
             // Input assembly describes the topology of the geometry being rendered
@@ -874,8 +840,8 @@ class AmbientOcclusion final : public Sample {
             pipeline_create_info.pColorBlendState = &color_blend_create_info;
             pipeline_create_info.pDynamicState = nullptr;
             pipeline_create_info.layout = composition_pipeline_layout;
-            pipeline_create_info.renderPass = composition_render_pass;
-            pipeline_create_info.subpass = 0;
+            pipeline_create_info.renderPass = render_graph->get_render_pass(composition_pass);
+            pipeline_create_info.subpass = render_graph->get_subpass(composition_pass);
         
             // TODO: Allows for recreating a pipeline from an existing pipeline
             pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
@@ -900,316 +866,161 @@ class AmbientOcclusion final : public Sample {
             vkDestroyPipelineLayout(device, ambient_occlusion_blur_pipeline_layout, nullptr);
             vkDestroyPipeline(device, ambient_occlusion_blur_pipeline, nullptr);
             
+            // Ambient occlusion temporal accumulation pipeline
+            vkDestroyPipelineLayout(device, ambient_occlusion_temporal_pipeline_layout, nullptr);
+            vkDestroyPipeline(device, ambient_occlusion_temporal_pipeline, nullptr);
+            
             // Ambient occlusion pipeline
             vkDestroyPipelineLayout(device, ambient_occlusion_pipeline_layout, nullptr);
             vkDestroyPipeline(device, ambient_occlusion_pipeline, nullptr);
             
-            // Geometry pipeline
-            vkDestroyPipelineLayout(device, geometry_pipeline_layout, nullptr);
-            vkDestroyPipeline(device, geometry_pipeline, nullptr);
-        }
-        
-        void initialize_geometry_render_pass() {
-            VkAttachmentDescription attachment_descriptions[] {
-                // Vertex positions
-                create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Vertex normals
-                create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Ambient
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Diffuse
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Specular
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Depth
-                create_attachment_description(depth_buffer_format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL),
-            };
-            
-            VkAttachmentReference color_attachment_references[] {
-                create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), // Position
-                create_attachment_reference(1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), // Normals
-                create_attachment_reference(2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), // Ambient
-                create_attachment_reference(3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), // Diffuse
-                create_attachment_reference(4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), // Specular
-            };
-            VkAttachmentReference depth_stencil_attachment_reference = create_attachment_reference(5, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL); // Depth
-            
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = sizeof(color_attachment_references) / sizeof(color_attachment_references[0]);
-            subpass_description.pColorAttachments = color_attachment_references;
-            subpass_description.pDepthStencilAttachment = &depth_stencil_attachment_reference;
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Ensure that color attachment read operations during the composition stage of the previous frame complete before resetting them for the new render pass
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-                                          
-                // Write operations to fill color attachments should complete before the ambient occlusion stage reads from them
-                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT),
-            };
-            
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = sizeof(attachment_descriptions) / sizeof(attachment_descriptions[0]);
-            render_pass_create_info.pAttachments = attachment_descriptions;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &geometry_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create render pass!");
-            }
-        }
-        
-        void initialize_ambient_occlusion_render_pass() {
-            // Ambient occlusion output attachment only has one channel to store the occlusion factor [0.0, 1.0]
-            VkAttachmentDescription attachment_description = create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-            VkAttachmentReference color_attachment_reference = create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-            
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = 1;
-            subpass_description.pColorAttachments = &color_attachment_reference;
-            subpass_description.pDepthStencilAttachment = nullptr; // Not used for this pass
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Ensure that the previous subpass (geometry) finishes entirely before beginning to write the ambient occlusion render pass
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-                                          
-                // Write operations to fill the color attachment should complete before the ambient occlusion blur render pass reads from it
-                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT),
-            };
-            
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = 1;
-            render_pass_create_info.pAttachments = &attachment_description;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &ambient_occlusion_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create render pass!");
-            }
-        }
-        
-        void initialize_ambient_occlusion_blur_render_pass() {
-            // Ambient occlusion blur output attachment only has one channel to store the occlusion factor [0.0, 1.0]
-            VkAttachmentDescription attachment_description = create_attachment_description(VK_FORMAT_R8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-            VkAttachmentReference color_attachment_reference = create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-            
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = 1;
-            subpass_description.pColorAttachments = &color_attachment_reference;
-            subpass_description.pDepthStencilAttachment = nullptr; // Not used for this pass
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Ensure that the previous subpass (ambient occlusion) finishes entirely
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-                                          
-                // Write operations to fill the color attachment should complete before the composition render pass reads from it
-                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT),
-            };
-            
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = 1;
-            render_pass_create_info.pAttachments = &attachment_description;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &ambient_occlusion_blur_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create render pass!");
-            }
-        }
-        
-        void initialize_composition_render_pass() {
-            VkAttachmentDescription attachment_description = create_attachment_description(surface_format.format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-            VkAttachmentReference color_attachment_reference = create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-            
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = 1;
-            subpass_description.pColorAttachments = &color_attachment_reference;
-            subpass_description.pDepthStencilAttachment = nullptr; // Depth information is not used for rendering a FSQ
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Dependency for ensuring that the color attachment (retrieved from the swapchain) is not transitioned to the VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL layout before it is available
-                // Color attachments are guaranteed to be available at the VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT pipeline stage, as that is where the color attachment LOAD operation happens
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-            };
+            // Ambient occlusion downsample pipeline
+            vkDestroyPipelineLayout(device, ambient_occlusion_downsample_pipeline_layout, nullptr);
+            vkDestroyPipeline(device, ambient_occlusion_downsample_pipeline, nullptr);
             
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = 1;
-            render_pass_create_info.pAttachments = &attachment_description;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &composition_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create render pass!");
-            }
-        }
-        
-        void destroy_render_passes() {
-            vkDestroyRenderPass(device, composition_render_pass, nullptr);
-            vkDestroyRenderPass(device, ambient_occlusion_blur_render_pass, nullptr);
-            vkDestroyRenderPass(device, ambient_occlusion_render_pass, nullptr);
-            vkDestroyRenderPass(device, geometry_render_pass, nullptr);
+            // Geometry pipeline
+            vkDestroyPipelineLayout(device, geometry_pipeline_layout, nullptr);
+            vkDestroyPipeline(device, geometry_pipeline, nullptr);
         }
         
-        void initialize_geometry_framebuffer() {
-            // Color attachments
-            for (std::size_t i = 0; i < 5; ++i) {
-                VkFormat format;
-                if (i == 0 || i == 1) {
-                    format = VK_FORMAT_R16G16B16A16_SFLOAT; // 64-bit floating point image format (for higher precision) for position + normal textures
+        void initialize_render_graph() {
+            render_graph = std::make_unique<RenderGraph>(physical_device, device, swapchain_extent);
+            
+            // Swapchain images are acquired every frame, the image backing this resource is set when recording the command buffer
+            swapchain_image = render_graph->import_image("swapchain", VK_NULL_HANDLE, VK_NULL_HANDLE, surface_format.format, swapchain_extent, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            
+            // Compact geometry buffer (12 bytes per pixel), positions are reconstructed from depth
+            geometry_buffer[0] = render_graph->create_image("normal", { GEOMETRY_BUFFER_NORMAL_FORMAT });
+            geometry_buffer[1] = render_graph->create_image("material", { GEOMETRY_BUFFER_MATERIAL_FORMAT });
+            geometry_buffer[2] = render_graph->create_image("depth", { depth_buffer_format });
+            
+            // Ambient occlusion is computed at a reduced resolution
+            ambient_occlusion_extent.width = (swapchain_extent.width + DOWNSAMPLE_FACTOR - 1u) / DOWNSAMPLE_FACTOR;
+            ambient_occlusion_extent.height = (swapchain_extent.height + DOWNSAMPLE_FACTOR - 1u) / DOWNSAMPLE_FACTOR;
+            
+            unsigned width = ambient_occlusion_extent.width;
+            unsigned height = ambient_occlusion_extent.height;
+            
+            // Images written by compute shaders use formats that are guaranteed to support storage image usage (R8 / RG16 formats require the shaderStorageImageExtendedFormats feature)
+            ambient_occlusion_depth = render_graph->create_image("ambient occlusion depth", { VK_FORMAT_R32_SFLOAT, width, height }); // Linear (view space) depth
+            ambient_occlusion_normals = render_graph->create_image("ambient occlusion normals", { VK_FORMAT_R8G8B8A8_SNORM, width, height });
+            
+            // Ambient occlusion outputs only use one channel to store the occlusion factor [0.0, 1.0]
+            // Compute passes write every texel of these images (VK_ATTACHMENT_LOAD_OP_DONT_CARE), so images with non-overlapping lifetimes share memory (the blurred output reuses the memory of the downsampled normals)
+            ambient_occlusion_output = render_graph->create_image("ambient occlusion", { VK_FORMAT_R32_SFLOAT, width, height });
+            ambient_occlusion_temporal_output = render_graph->create_image("ambient occlusion (accumulated)", { VK_FORMAT_R32_SFLOAT, width, height });
+            ambient_occlusion_blur_output = render_graph->create_image("ambient occlusion (blurred)", { VK_FORMAT_R32_SFLOAT, width, height });
+            
+            // History images are only accessed as storage images, so they remain in VK_IMAGE_LAYOUT_GENERAL between frames
+            // The images backing these resources are swapped every frame when recording the command buffer
+            ambient_occlusion_history = render_graph->import_image("ambient occlusion history", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_FORMAT_R32G32B32A32_SFLOAT, ambient_occlusion_extent, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            ambient_occlusion_accumulated = render_graph->import_image("ambient occlusion history (accumulated)", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_FORMAT_R32G32B32A32_SFLOAT, ambient_occlusion_extent, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            
+            // Generate geometry buffer
+            geometry_pass = render_graph->add_graphics_pass("geometry", [this](RenderGraph::PassBuilder& builder) {
+                builder.write_color(geometry_buffer[0]);
+                builder.write_color(geometry_buffer[1]);
+                builder.write_depth(geometry_buffer[2]);
+            }, [this](VkCommandBuffer command_buffer) {
+                // Bind graphics pipeline
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline);
+                
+                // Bind global descriptor set
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline_layout, 0, 1, &geometry_global_descriptor_set, 0, nullptr);
+                
+                // Only objects that passed frustum culling in update() are drawn
+                for (unsigned i : visible_objects) {
+                    const Scene::Object& object = scene.objects[i];
+                    const Model& model = models[object.model];
+                    
+                    // Bind vertex + index buffers buffer
+                    VkDeviceSize offsets[] = { object.vertex_offset  };
+                    vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
+                    vkCmdBindIndexBuffer(command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
+                    
+                    // Bind per-object descriptor set
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline_layout, 1, 1, &geometry_object_descriptor_sets[i], 0, nullptr);
+                    
+                    vkCmdDrawIndexed(command_buffer, (unsigned) model.indices.size(), 1, 0, 0, 0);
                 }
-                else {
-                    // Color cannot be negative, so use an 32-bit unsigned image format for the rest
-                    format = VK_FORMAT_R8G8B8A8_UNORM;
+            });
+            
+            // Downsample the geometry buffer to the resolution ambient occlusion is computed at
+            ambient_occlusion_downsample_pass = render_graph->add_compute_pass("ambient occlusion downsample", [this](RenderGraph::PassBuilder& builder) {
+                builder.read_texture(geometry_buffer[0], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT); // Normal
+                builder.read_texture(geometry_buffer[2], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT); // Depth
+                builder.write_storage_image(ambient_occlusion_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+                builder.write_storage_image(ambient_occlusion_normals, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            }, [this](VkCommandBuffer command_buffer) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_downsample_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_downsample_pipeline_layout, 0, 1, &ambient_occlusion_downsample_descriptor_set, 0, nullptr);
+                dispatch_ambient_occlusion(command_buffer);
+            });
+            
+            ambient_occlusion_pass = render_graph->add_compute_pass("ambient occlusion", [this](RenderGraph::PassBuilder& builder) {
+                builder.read_texture(ambient_occlusion_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.read_texture(ambient_occlusion_normals, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.write_storage_image(ambient_occlusion_output, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            }, [this](VkCommandBuffer command_buffer) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_pipeline_layout, 0, 1, &ambient_occlusion_descriptor_set, 0, nullptr);
+                dispatch_ambient_occlusion(command_buffer);
+            });
+            
+            ambient_occlusion_temporal_pass = render_graph->add_compute_pass("ambient occlusion temporal accumulation", [this](RenderGraph::PassBuilder& builder) {
+                builder.read_texture(ambient_occlusion_output, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.read_texture(ambient_occlusion_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.read_texture(ambient_occlusion_normals, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.read_storage_image(ambient_occlusion_history);
+                builder.write_storage_image(ambient_occlusion_accumulated);
+                builder.write_storage_image(ambient_occlusion_temporal_output, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            }, [this](VkCommandBuffer command_buffer) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_temporal_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_temporal_pipeline_layout, 0, 1, &ambient_occlusion_temporal_descriptor_sets[history_index], 0, nullptr);
+                dispatch_ambient_occlusion(command_buffer);
+            });
+            
+            // Horizontal and vertical blur passes run in the same dispatch, one tile per workgroup
+            ambient_occlusion_blur_pass = render_graph->add_compute_pass("ambient occlusion blur", [this](RenderGraph::PassBuilder& builder) {
+                builder.read_texture(ambient_occlusion_temporal_output, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.read_texture(ambient_occlusion_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                builder.write_storage_image(ambient_occlusion_blur_output, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            }, [this](VkCommandBuffer command_buffer) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_blur_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, ambient_occlusion_blur_pipeline_layout, 0, 1, &ambient_occlusion_blur_descriptor_set, 0, nullptr);
+                dispatch_ambient_occlusion(command_buffer);
+            });
+            
+            // Composition pipeline writes to one color attachment, no depth
+            composition_pass = render_graph->add_graphics_pass("composition", [this](RenderGraph::PassBuilder& builder) {
+                for (std::size_t i = 0u; i < 3u; ++i) {
+                    builder.read_texture(geometry_buffer[i]);
                 }
+                builder.read_texture(ambient_occlusion_blur_output);
+                builder.read_texture(ambient_occlusion_depth); // Depth-aware upsampling
+                builder.write_color(swapchain_image);
+            }, [this](VkCommandBuffer command_buffer) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline_layout, 0, 1, &composition_descriptor_set, 0, nullptr);
                 
-                create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geometry_framebuffer_attachments[i].image, geometry_framebuffer_attachments[i].memory);
-                create_image_view(device, geometry_framebuffer_attachments[i].image, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, geometry_framebuffer_attachments[i].image_view);
-            }
+                // Draw FSQ
+                vkCmdDraw(command_buffer, 3, 1, 0, 0);
+            });
             
-            // Depth attachment
-            create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, depth_buffer_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geometry_framebuffer_attachments[5].image, geometry_framebuffer_attachments[5].memory);
-            create_image_view(device, geometry_framebuffer_attachments[5].image, VK_IMAGE_VIEW_TYPE_2D, depth_buffer_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 1, geometry_framebuffer_attachments[5].image_view);
-            
-            VkImageView attachments[] {
-                geometry_framebuffer_attachments[0].image_view, // Positions
-                geometry_framebuffer_attachments[1].image_view, // Normals
-                geometry_framebuffer_attachments[2].image_view, // Ambient
-                geometry_framebuffer_attachments[3].image_view, // Diffuse
-                geometry_framebuffer_attachments[4].image_view, // Specular
-                geometry_framebuffer_attachments[5].image_view // Depth
-            };
+            render_graph->compile();
             
-            VkFramebufferCreateInfo framebuffer_create_info { };
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_create_info.renderPass = geometry_render_pass;
-            framebuffer_create_info.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-            framebuffer_create_info.pAttachments = attachments;
-            framebuffer_create_info.width = swapchain_extent.width;
-            framebuffer_create_info.height = swapchain_extent.height;
-            framebuffer_create_info.layers = 1; // Number of layers in the swapchain images
-            
-            if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &geometry_framebuffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
-            }
-        }
-        
-        void initialize_ambient_occlusion_framebuffer() {
-            // Color attachments
-            create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ambient_occlusion_attachment.image, ambient_occlusion_attachment.memory);
-            create_image_view(device, ambient_occlusion_attachment.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, ambient_occlusion_attachment.image_view);
-            
-            VkFramebufferCreateInfo framebuffer_create_info { };
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_create_info.renderPass = ambient_occlusion_render_pass;
-            framebuffer_create_info.attachmentCount = 1;
-            framebuffer_create_info.pAttachments = &ambient_occlusion_attachment.image_view;
-            framebuffer_create_info.width = swapchain_extent.width;
-            framebuffer_create_info.height = swapchain_extent.height;
-            framebuffer_create_info.layers = 1; // Number of layers in the swapchain images
-            
-            if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &ambient_occlusion_framebuffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
-            }
-        }
-        
-        void initialize_ambient_occlusion_blur_framebuffer() {
-            // Color attachment
-            create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ambient_occlusion_blur_attachment.image, ambient_occlusion_blur_attachment.memory);
-            create_image_view(device, ambient_occlusion_blur_attachment.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, ambient_occlusion_blur_attachment.image_view);
-            
-            VkFramebufferCreateInfo framebuffer_create_info { };
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_create_info.renderPass = ambient_occlusion_blur_render_pass;
-            framebuffer_create_info.attachmentCount = 1;
-            framebuffer_create_info.pAttachments = &ambient_occlusion_blur_attachment.image_view;
-            framebuffer_create_info.width = swapchain_extent.width;
-            framebuffer_create_info.height = swapchain_extent.height;
-            framebuffer_create_info.layers = 1; // Number of layers in the swapchain images
-            
-            if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &ambient_occlusion_blur_framebuffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
-            }
+            // Framebuffers are owned by the render graph (Sample::destroy_framebuffers() still expects one entry per frame in flight)
+            present_framebuffers.assign(NUM_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
         }
         
-        void initialize_composition_framebuffers() {
-            present_framebuffers.resize(NUM_FRAMES_IN_FLIGHT);
-            for (std::size_t i = 0u; i < NUM_FRAMES_IN_FLIGHT; ++i) {
-                VkFramebufferCreateInfo framebuffer_create_info { };
-                framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-                framebuffer_create_info.renderPass = composition_render_pass;
-                framebuffer_create_info.attachmentCount = 1;
-                framebuffer_create_info.pAttachments = &swapchain_image_views[i];
-                framebuffer_create_info.width = swapchain_extent.width;
-                framebuffer_create_info.height = swapchain_extent.height;
-                framebuffer_create_info.layers = 1;
-                
-                if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &present_framebuffers[i]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to create framebuffer!");
-                }
-            }
+        void dispatch_ambient_occlusion(VkCommandBuffer command_buffer) {
+            // One invocation per pixel of the reduced resolution images
+            vkCmdDispatch(command_buffer, (ambient_occlusion_extent.width + WORKGROUP_SIZE - 1u) / WORKGROUP_SIZE, (ambient_occlusion_extent.height + WORKGROUP_SIZE - 1u) / WORKGROUP_SIZE, 1);
         }
         
-        void destroy_framebuffers() {
-            // Ambient occlusion blur
-            vkDestroyImage(device, ambient_occlusion_blur_attachment.image, nullptr);
-            vkDestroyImageView(device, ambient_occlusion_blur_attachment.image_view, nullptr);
-            vkFreeMemory(device, ambient_occlusion_blur_attachment.memory, nullptr);
-            
-            vkDestroyFramebuffer(device, ambient_occlusion_blur_framebuffer, nullptr);
-            
-            // Ambient occlusion
-            vkDestroyImage(device, ambient_occlusion_attachment.image, nullptr);
-            vkDestroyImageView(device, ambient_occlusion_attachment.image_view, nullptr);
-            vkFreeMemory(device, ambient_occlusion_attachment.memory, nullptr);
-            
-            vkDestroyFramebuffer(device, ambient_occlusion_framebuffer, nullptr);
-            
-            // Geometry buffer
-            for (std::size_t i = 0u; i < geometry_framebuffer_attachments.size(); ++i) {
-                vkDestroyImage(device, geometry_framebuffer_attachments[i].image, nullptr);
-                vkDestroyImageView(device, geometry_framebuffer_attachments[i].image_view, nullptr);
-                vkFreeMemory(device, geometry_framebuffer_attachments[i].memory, nullptr);
-            }
-            vkDestroyFramebuffer(device, geometry_framebuffer, nullptr);
+        void destroy_render_graph() {
+            // Destroys all attachments, render passes, and framebuffers created by the graph
+            render_graph.reset();
         }
         
         void initialize_geometry_global_descriptor_set() {
@@ -1272,10 +1083,9 @@ class AmbientOcclusion final : public Sample {
             //   - mat4 (normal matrix)
             
             // Fragment uniform buffer (binding point 1):
-            //   - vec3 (ambient color)
             //   - vec3 (diffuse color)
-            //   - vec3 (specular color)
-            //   - float (specular exponent)
+            //   - uint (material index)
+            //   - int (flat shaded)
             
             // There needs to be a descriptor set allocated per object in the scene that points into the uniform buffer at the correct offset
 
@@ -1353,26 +1163,24 @@ class AmbientOcclusion final : public Sample {
             }
         }
         
-        void initialize_ambient_occlusion_descriptor_set() {
-            // Initialize the global descriptor set used in the fragment shader for ambient occlusion calculations
-            // This descriptor set is mapped to set 0 and contains a uniform buffer at binding 0 with the following members:
-            //   - mat4 (camera projection)
-            //   - array of vec4s (ambient occlusion kernel)
+        void initialize_ambient_occlusion_downsample_descriptor_set() {
+            // Initialize the descriptor set used in the compute shader for downsampling the geometry buffer
+            // This descriptor set is mapped to set 0 and contains a uniform buffer at binding 2 (shared with the ambient occlusion pass, only the inverse camera projection is used)
             
             // Initialize set layout
             VkDescriptorSetLayoutBinding bindings[] {
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // Positions
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // Normals
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // Depth
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), // Noise
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // Normals
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // Depth
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3), // Downsampled depth
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4), // Downsampled normals
             };
             
             VkDescriptorSetLayoutCreateInfo layout_create_info { };
             layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
             layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
             layout_create_info.pBindings = bindings;
-            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &ambient_occlusion_descriptor_set_layout) != VK_SUCCESS) {
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &ambient_occlusion_downsample_descriptor_set_layout) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create descriptor set layout!");
             }
             
@@ -1381,104 +1189,231 @@ class AmbientOcclusion final : public Sample {
             set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
             set_create_info.descriptorPool = descriptor_pool;
             set_create_info.descriptorSetCount = 1;
-            set_create_info.pSetLayouts = &ambient_occlusion_descriptor_set_layout;
-            if (vkAllocateDescriptorSets(device, &set_create_info, &ambient_occlusion_descriptor_set) != VK_SUCCESS) {
+            set_create_info.pSetLayouts = &ambient_occlusion_downsample_descriptor_set_layout;
+            if (vkAllocateDescriptorSets(device, &set_create_info, &ambient_occlusion_downsample_descriptor_set) != VK_SUCCESS) {
                 throw std::runtime_error("failed to allocate descriptor set!");
             }
             
-            VkWriteDescriptorSet descriptor_writes[5] { };
             VkDescriptorImageInfo image_infos[4] { };
             
-            unsigned binding_point = 0;
+            image_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[0].imageView = render_graph->get_image_view(geometry_buffer[0]); // Normals
+            image_infos[0].sampler = sampler;
             
-            image_infos[binding_point].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_infos[binding_point].imageView = geometry_framebuffer_attachments[0].image_view; // Positions
-            image_infos[binding_point].sampler = sampler;
+            image_infos[1].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            image_infos[1].imageView = render_graph->get_image_view(geometry_buffer[2]); // Depth
+            image_infos[1].sampler = sampler;
             
-            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[binding_point].dstSet = ambient_occlusion_descriptor_set;
-            descriptor_writes[binding_point].dstBinding = binding_point;
-            descriptor_writes[binding_point].dstArrayElement = 0;
-            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_writes[binding_point].descriptorCount = 1;
-            descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point];
+            // Storage images are accessed in the general layout
+            image_infos[2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            image_infos[2].imageView = render_graph->get_image_view(ambient_occlusion_depth);
             
-            ++binding_point;
+            image_infos[3].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            image_infos[3].imageView = render_graph->get_image_view(ambient_occlusion_normals);
             
-            image_infos[binding_point].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_infos[binding_point].imageView = geometry_framebuffer_attachments[1].image_view; // Normals
-            image_infos[binding_point].sampler = sampler;
+            VkDescriptorBufferInfo buffer_info { };
+            buffer_info.buffer = uniform_buffer;
+            buffer_info.offset = get_ambient_occlusion_uniform_buffer_offset();
+            buffer_info.range = sizeof(AmbientOcclusionUniforms);
             
-            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[binding_point].dstSet = ambient_occlusion_descriptor_set;
-            descriptor_writes[binding_point].dstBinding = binding_point;
-            descriptor_writes[binding_point].dstArrayElement = 0;
-            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_writes[binding_point].descriptorCount = 1;
-            descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point];
+            VkWriteDescriptorSet descriptor_writes[5] { };
+            for (unsigned binding_point = 0u; binding_point < 5u; ++binding_point) {
+                descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_writes[binding_point].dstSet = ambient_occlusion_downsample_descriptor_set;
+                descriptor_writes[binding_point].dstBinding = binding_point;
+                descriptor_writes[binding_point].dstArrayElement = 0;
+                descriptor_writes[binding_point].descriptorCount = 1;
+                
+                if (binding_point == 2u) {
+                    descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptor_writes[binding_point].pBufferInfo = &buffer_info;
+                }
+                else {
+                    descriptor_writes[binding_point].descriptorType = binding_point < 2u ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point < 2u ? binding_point : binding_point - 1u];
+                }
+            }
             
-            ++binding_point;
+            vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+        }
+        
+        void initialize_ambient_occlusion_descriptor_set() {
+            // Initialize the global descriptor set used in the compute shader for ambient occlusion calculations
+            // This descriptor set is mapped to set 0 and contains a uniform buffer at binding 3 with the following members:
+            //   - mat4 (camera projection)
+            //   - mat4 (inverse camera projection, for reconstructing positions from depth)
+            //   - array of vec4s (ambient occlusion kernel)
             
-            image_infos[binding_point].imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL;
-            image_infos[binding_point].imageView = geometry_framebuffer_attachments[5].image_view; // Depth
-            image_infos[binding_point].sampler = sampler;
+            // Initialize set layout
+            VkDescriptorSetLayoutBinding bindings[] {
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // Depth (downsampled)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // Normals (downsampled)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // Noise
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4), // Ambient occlusion
+            };
             
-            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[binding_point].dstSet = ambient_occlusion_descriptor_set;
-            descriptor_writes[binding_point].dstBinding = binding_point;
-            descriptor_writes[binding_point].dstArrayElement = 0;
-            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_writes[binding_point].descriptorCount = 1;
-            descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point];
+            VkDescriptorSetLayoutCreateInfo layout_create_info { };
+            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+            layout_create_info.pBindings = bindings;
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &ambient_occlusion_descriptor_set_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create descriptor set layout!");
+            }
             
-            ++binding_point;
+            // Initialize set
+            VkDescriptorSetAllocateInfo set_create_info { };
+            set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            set_create_info.descriptorPool = descriptor_pool;
+            set_create_info.descriptorSetCount = 1;
+            set_create_info.pSetLayouts = &ambient_occlusion_descriptor_set_layout;
+            if (vkAllocateDescriptorSets(device, &set_create_info, &ambient_occlusion_descriptor_set) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate descriptor set!");
+            }
             
-            image_infos[binding_point].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_infos[binding_point].imageView = ambient_occlusion_noise.image_view; // Random noise
-            image_infos[binding_point].sampler = sampler;
+            VkDescriptorImageInfo image_infos[4] { };
             
-            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[binding_point].dstSet = ambient_occlusion_descriptor_set;
-            descriptor_writes[binding_point].dstBinding = binding_point;
-            descriptor_writes[binding_point].dstArrayElement = 0;
-            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_writes[binding_point].descriptorCount = 1;
-            descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point];
+            image_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[0].imageView = render_graph->get_image_view(ambient_occlusion_depth);
+            image_infos[0].sampler = sampler;
             
-            ++binding_point;
+            image_infos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[1].imageView = render_graph->get_image_view(ambient_occlusion_normals);
+            image_infos[1].sampler = sampler;
             
-            // Configure the offsets at which the data for the global uniforms for the geometry pass is located
+            image_infos[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[2].imageView = ambient_occlusion_noise.image_view; // Random noise
+            image_infos[2].sampler = sampler;
             
-            // This descriptor set is located after the per-model descriptor sets for the geometry pass
-            std::size_t globals_uniform_block_size = align_to_device_boundary(physical_device, sizeof(GeometryGlobalUniforms));
-            std::size_t object_uniform_block_size = align_to_device_boundary(physical_device, sizeof(GeometryObjectVertexStageUniforms)) + align_to_device_boundary(physical_device, sizeof(GeometryObjectFragmentStageUniforms));
+            image_infos[3].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            image_infos[3].imageView = render_graph->get_image_view(ambient_occlusion_output);
             
             VkDescriptorBufferInfo buffer_info { };
             buffer_info.buffer = uniform_buffer;
-            buffer_info.offset = globals_uniform_block_size + object_uniform_block_size * scene.objects.size();
+            buffer_info.offset = get_ambient_occlusion_uniform_buffer_offset();
             buffer_info.range = sizeof(AmbientOcclusionUniforms);
             
-            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[binding_point].dstSet = ambient_occlusion_descriptor_set;
-            descriptor_writes[binding_point].dstBinding = binding_point;
-            descriptor_writes[binding_point].dstArrayElement = 0;
-            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptor_writes[binding_point].descriptorCount = 1;
-            descriptor_writes[binding_point].pBufferInfo = &buffer_info;
+            VkWriteDescriptorSet descriptor_writes[5] { };
+            for (unsigned binding_point = 0u; binding_point < 5u; ++binding_point) {
+                descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_writes[binding_point].dstSet = ambient_occlusion_descriptor_set;
+                descriptor_writes[binding_point].dstBinding = binding_point;
+                descriptor_writes[binding_point].dstArrayElement = 0;
+                descriptor_writes[binding_point].descriptorCount = 1;
+                
+                if (binding_point == 3u) {
+                    descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptor_writes[binding_point].pBufferInfo = &buffer_info;
+                }
+                else {
+                    descriptor_writes[binding_point].descriptorType = binding_point < 3u ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point < 3u ? binding_point : binding_point - 1u];
+                }
+            }
             
             vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
         }
         
+        void initialize_ambient_occlusion_temporal_descriptor_sets() {
+            // Initialize the descriptor sets used in the compute shader for accumulating ambient occlusion across frames
+            // The history images swap roles every frame, so there is one descriptor set for each history image written
+            // Uniform buffer at binding 4 is shared with the ambient occlusion pass (reprojection matrices)
+            
+            // Initialize set layout
+            VkDescriptorSetLayoutBinding bindings[] {
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // Ambient occlusion
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // Depth (downsampled)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // Normals (downsampled)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3), // History (previous frame)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 5), // History (this frame)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 6), // Ambient occlusion (accumulated)
+            };
+            
+            VkDescriptorSetLayoutCreateInfo layout_create_info { };
+            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+            layout_create_info.pBindings = bindings;
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &ambient_occlusion_temporal_descriptor_set_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create descriptor set layout!");
+            }
+            
+            VkDescriptorBufferInfo buffer_info { };
+            buffer_info.buffer = uniform_buffer;
+            buffer_info.offset = get_ambient_occlusion_uniform_buffer_offset();
+            buffer_info.range = sizeof(AmbientOcclusionUniforms);
+            
+            for (unsigned i = 0u; i < 2u; ++i) {
+                // Initialize set
+                VkDescriptorSetAllocateInfo set_create_info { };
+                set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                set_create_info.descriptorPool = descriptor_pool;
+                set_create_info.descriptorSetCount = 1;
+                set_create_info.pSetLayouts = &ambient_occlusion_temporal_descriptor_set_layout;
+                if (vkAllocateDescriptorSets(device, &set_create_info, &ambient_occlusion_temporal_descriptor_sets[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate descriptor set!");
+                }
+                
+                VkDescriptorImageInfo image_infos[6] { };
+                
+                image_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                image_infos[0].imageView = render_graph->get_image_view(ambient_occlusion_output);
+                image_infos[0].sampler = sampler;
+                
+                image_infos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                image_infos[1].imageView = render_graph->get_image_view(ambient_occlusion_depth);
+                image_infos[1].sampler = sampler;
+                
+                image_infos[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                image_infos[2].imageView = render_graph->get_image_view(ambient_occlusion_normals);
+                image_infos[2].sampler = sampler;
+                
+                // History images are always in the general layout
+                image_infos[3].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                image_infos[3].imageView = ambient_occlusion_history_images[1u - i].image_view;
+                
+                image_infos[4].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                image_infos[4].imageView = ambient_occlusion_history_images[i].image_view;
+                
+                image_infos[5].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                image_infos[5].imageView = render_graph->get_image_view(ambient_occlusion_temporal_output);
+                
+                VkWriteDescriptorSet descriptor_writes[7] { };
+                for (unsigned binding_point = 0u; binding_point < 7u; ++binding_point) {
+                    descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptor_writes[binding_point].dstSet = ambient_occlusion_temporal_descriptor_sets[i];
+                    descriptor_writes[binding_point].dstBinding = binding_point;
+                    descriptor_writes[binding_point].dstArrayElement = 0;
+                    descriptor_writes[binding_point].descriptorCount = 1;
+                    
+                    if (binding_point == 4u) {
+                        descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                        descriptor_writes[binding_point].pBufferInfo = &buffer_info;
+                    }
+                    else {
+                        descriptor_writes[binding_point].descriptorType = binding_point < 3u ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                        descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point < 4u ? binding_point : binding_point - 1u];
+                    }
+                }
+                
+                vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+            }
+        }
+        
         void initialize_ambient_occlusion_blur_descriptor_set() {
-            // Initialize the global descriptor set used in the fragment shader for blurring
+            // Initialize the global descriptor set used in the compute shader for blurring
             
             // Initialize set layout
-            VkDescriptorSetLayoutBinding binding = create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+            VkDescriptorSetLayoutBinding bindings[] {
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // Ambient occlusion
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // Depth (downsampled)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2), // Ambient occlusion (blurred)
+            };
             
             VkDescriptorSetLayoutCreateInfo layout_create_info { };
             layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            layout_create_info.bindingCount = 1;
-            layout_create_info.pBindings = &binding;
+            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+            layout_create_info.pBindings = bindings;
             if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &ambient_occlusion_blur_descriptor_set_layout) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create descriptor set layout!");
             }
@@ -1493,22 +1428,38 @@ class AmbientOcclusion final : public Sample {
                 throw std::runtime_error("failed to allocate descriptor set!");
             }
             
-            VkWriteDescriptorSet descriptor_write { };
-            VkDescriptorImageInfo image_info { };
+            VkDescriptorImageInfo image_infos[3] { };
             
-            image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_info.imageView = ambient_occlusion_attachment.image_view;
-            image_info.sampler = sampler;
+            image_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[0].imageView = render_graph->get_image_view(ambient_occlusion_temporal_output);
+            image_infos[0].sampler = sampler;
             
-            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_write.dstSet = ambient_occlusion_blur_descriptor_set;
-            descriptor_write.dstBinding = 0;
-            descriptor_write.dstArrayElement = 0;
-            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_write.descriptorCount = 1;
-            descriptor_write.pImageInfo = &image_info;
+            image_infos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[1].imageView = render_graph->get_image_view(ambient_occlusion_depth);
+            image_infos[1].sampler = sampler;
             
-            vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+            image_infos[2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            image_infos[2].imageView = render_graph->get_image_view(ambient_occlusion_blur_output);
+            
+            VkWriteDescriptorSet descriptor_writes[3] { };
+            for (unsigned binding_point = 0u; binding_point < 3u; ++binding_point) {
+                descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_writes[binding_point].dstSet = ambient_occlusion_blur_descriptor_set;
+                descriptor_writes[binding_point].dstBinding = binding_point;
+                descriptor_writes[binding_point].dstArrayElement = 0;
+                descriptor_writes[binding_point].descriptorType = binding_point < 2u ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                descriptor_writes[binding_point].descriptorCount = 1;
+                descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point];
+            }
+            
+            vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+        }
+        
+        std::size_t get_ambient_occlusion_uniform_buffer_offset() const {
+            // Ambient occlusion uniforms are located after the per-model descriptor sets for the geometry pass
+            std::size_t globals_uniform_block_size = align_to_device_boundary(physical_device, sizeof(GeometryGlobalUniforms));
+            std::size_t object_uniform_block_size = align_to_device_boundary(physical_device, sizeof(GeometryObjectVertexStageUniforms)) + align_to_device_boundary(physical_device, sizeof(GeometryObjectFragmentStageUniforms));
+            return globals_uniform_block_size + object_uniform_block_size * scene.objects.size();
         }
         
         void initialize_composition_descriptor_set() {
@@ -1516,13 +1467,13 @@ class AmbientOcclusion final : public Sample {
             
             // Initialize set layout
             VkDescriptorSetLayoutBinding bindings[] {
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // Position
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // Normals
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // Ambient
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), // Diffuse
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), // Specular
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), // Ambient occlusion
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // Normals
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // Material
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // Depth
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), // Ambient occlusion
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), // Materials
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6) // Ambient occlusion depth (for upsampling)
             };
             
             VkDescriptorSetLayoutCreateInfo layout_create_info { };
@@ -1543,14 +1494,14 @@ class AmbientOcclusion final : public Sample {
             }
             
             VkWriteDescriptorSet descriptor_writes[7] { };
-            VkDescriptorImageInfo image_infos[6] { };
+            VkDescriptorImageInfo image_infos[5] { };
             
             unsigned binding_point;
             
-            // Descriptors 0 - 4 come from the geometry framebuffer (position, normal, ambient, diffuse, specular)
-            for (binding_point = 0; binding_point < 5; ++binding_point) {
-                image_infos[binding_point].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                image_infos[binding_point].imageView = geometry_framebuffer_attachments[binding_point].image_view;
+            // Descriptors 0 - 2 come from the geometry framebuffer (normal, material, depth)
+            for (binding_point = 0; binding_point < 3; ++binding_point) {
+                image_infos[binding_point].imageLayout = binding_point == 2 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                image_infos[binding_point].imageView = render_graph->get_image_view(geometry_buffer[binding_point]);
                 image_infos[binding_point].sampler = sampler;
                 
                 descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1562,9 +1513,9 @@ class AmbientOcclusion final : public Sample {
                 descriptor_writes[binding_point].pImageInfo = &image_infos[binding_point];
             }
             
-            // Descriptor 5 comes from the ambient occlusion framebuffer
+            // Descriptor 3 comes from the ambient occlusion framebuffer
             image_infos[binding_point].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_infos[binding_point].imageView = ambient_occlusion_blur_attachment.image_view;
+            image_infos[binding_point].imageView = render_graph->get_image_view(ambient_occlusion_blur_output);
             image_infos[binding_point].sampler = sampler;
             
             descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1581,12 +1532,12 @@ class AmbientOcclusion final : public Sample {
             std::size_t object_uniform_block_size = align_to_device_boundary(physical_device, sizeof(GeometryObjectVertexStageUniforms)) + align_to_device_boundary(physical_device, sizeof(GeometryObjectFragmentStageUniforms));
             std::size_t ambient_occlusion_uniform_block_size = align_to_device_boundary(physical_device, sizeof(AmbientOcclusionUniforms));
             
-            VkDescriptorBufferInfo buffer_info { };
-            buffer_info.buffer = uniform_buffer;
-            buffer_info.offset = globals_uniform_block_size + object_uniform_block_size * scene.objects.size() + ambient_occlusion_uniform_block_size;
-            buffer_info.range = sizeof(CompositionUniforms);
+            VkDescriptorBufferInfo buffer_infos[2] { };
+            buffer_infos[0].buffer = uniform_buffer;
+            buffer_infos[0].offset = globals_uniform_block_size + object_uniform_block_size * scene.objects.size() + ambient_occlusion_uniform_block_size;
+            buffer_infos[0].range = sizeof(CompositionUniforms);
             
-            ++binding_point; // 6
+            ++binding_point; // 4
             
             descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptor_writes[binding_point].dstSet = composition_descriptor_set;
@@ -1594,7 +1545,37 @@ class AmbientOcclusion final : public Sample {
             descriptor_writes[binding_point].dstArrayElement = 0;
             descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
             descriptor_writes[binding_point].descriptorCount = 1;
-            descriptor_writes[binding_point].pBufferInfo = &buffer_info;
+            descriptor_writes[binding_point].pBufferInfo = &buffer_infos[0];
+            
+            // Material table is located directly after the composition uniforms
+            buffer_infos[1].buffer = uniform_buffer;
+            buffer_infos[1].offset = buffer_infos[0].offset + align_to_device_boundary(physical_device, sizeof(CompositionUniforms));
+            buffer_infos[1].range = sizeof(GeometryBufferMaterial) * scene.objects.size();
+            
+            ++binding_point; // 5
+            
+            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[binding_point].dstSet = composition_descriptor_set;
+            descriptor_writes[binding_point].dstBinding = binding_point;
+            descriptor_writes[binding_point].dstArrayElement = 0;
+            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptor_writes[binding_point].descriptorCount = 1;
+            descriptor_writes[binding_point].pBufferInfo = &buffer_infos[1];
+            
+            // Descriptor 6 is the reduced resolution depth ambient occlusion was computed from
+            image_infos[4].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            image_infos[4].imageView = render_graph->get_image_view(ambient_occlusion_depth);
+            image_infos[4].sampler = sampler;
+            
+            ++binding_point; // 6
+            
+            descriptor_writes[binding_point].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[binding_point].dstSet = composition_descriptor_set;
+            descriptor_writes[binding_point].dstBinding = binding_point;
+            descriptor_writes[binding_point].dstArrayElement = 0;
+            descriptor_writes[binding_point].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptor_writes[binding_point].descriptorCount = 1;
+            descriptor_writes[binding_point].pImageInfo = &image_infos[4];
             
             // Specify the buffer and region within it that contains the data for the allocated descriptors
             vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
@@ -1603,7 +1584,9 @@ class AmbientOcclusion final : public Sample {
         void destroy_descriptor_set_layouts() {
             vkDestroyDescriptorSetLayout(device, composition_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, ambient_occlusion_blur_descriptor_set_layout, nullptr);
+            vkDestroyDescriptorSetLayout(device, ambient_occlusion_temporal_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, ambient_occlusion_descriptor_set_layout, nullptr);
+            vkDestroyDescriptorSetLayout(device, ambient_occlusion_downsample_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, geometry_object_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, geometry_global_descriptor_set_layout, nullptr);
         }
@@ -1671,6 +1654,12 @@ class AmbientOcclusion final : public Sample {
             knight.transform = Transform(glm::vec3(0, 0.5f, 0), glm::vec3(1.5f), glm::vec3(0.0f, -55.0f, 0.0f));
             knight.flat_shaded = true;
             
+            // Compute model-space bounds for frustum culling
+            for (const Model& model : models) {
+                model_bounds.emplace_back(compute_model_bounds(model));
+            }
+            culler.add_objects(scene.objects, model_bounds);
+            
             // This sample only uses vertex position and normal
             unsigned vertex_buffer_size = 0u;
             unsigned index_buffer_size = 0u;
@@ -1839,7 +1828,13 @@ class AmbientOcclusion final : public Sample {
             std::size_t ambient_occlusion_uniform_block_size = align_to_device_boundary(physical_device, sizeof(AmbientOcclusionUniforms));
             std::size_t composition_uniform_block_size = align_to_device_boundary(physical_device, sizeof(CompositionUniforms));
             
-            std::size_t uniform_buffer_size = geometry_global_uniform_block_size + geometry_object_uniform_block_size * scene.objects.size() + ambient_occlusion_uniform_block_size + composition_uniform_block_size;
+            // Material table (one material per object), indexed by the material index stored in the geometry buffer
+            if (scene.objects.size() > MAX_GEOMETRY_BUFFER_MATERIALS) {
+                throw std::runtime_error("scene contains more materials than can be indexed by the geometry buffer!");
+            }
+            std::size_t material_uniform_block_size = align_to_device_boundary(physical_device, sizeof(GeometryBufferMaterial) * scene.objects.size());
+            
+            std::size_t uniform_buffer_size = geometry_global_uniform_block_size + geometry_object_uniform_block_size * scene.objects.size() + ambient_occlusion_uniform_block_size + composition_uniform_block_size + material_uniform_block_size;
 
             create_buffer(physical_device, device, uniform_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniform_buffer, uniform_buffer_memory);
             vkMapMemory(device, uniform_buffer_memory, 0, uniform_buffer_size, 0, &uniform_buffer_mapped);
@@ -1861,7 +1856,8 @@ class AmbientOcclusion final : public Sample {
             }
             
             // Geometry pass per-object uniforms
-            for (Scene::Object& object : scene.objects) {
+            for (std::size_t i = 0u; i < scene.objects.size(); ++i) {
+                Scene::Object& object = scene.objects[i];
                 Transform& transform = object.transform;
                 
                 // Vertex
@@ -1874,10 +1870,8 @@ class AmbientOcclusion final : public Sample {
                 
                 // Fragment
                 GeometryObjectFragmentStageUniforms fragment { };
-                fragment.ambient = glm::vec4(object.ambient, 1.0f);
-                fragment.diffuse = glm::vec4(object.diffuse, 1.0f);
-                fragment.specular = glm::vec4(object.specular, 1.0f);
-                fragment.exponent = object.specular_exponent;
+                fragment.diffuse = object.diffuse;
+                fragment.material = (unsigned) i;
                 fragment.flat_shaded = (int) object.flat_shaded;
                 
                 memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &fragment, sizeof(GeometryObjectFragmentStageUniforms));
@@ -1888,6 +1882,17 @@ class AmbientOcclusion final : public Sample {
             {
                 AmbientOcclusionUniforms uniforms { };
                 uniforms.projection = camera.get_projection_matrix();
+                uniforms.inverse_projection = glm::inverse(uniforms.projection);
+                
+                // Camera still holds the matrices of the previous frame (see Camera::end_frame())
+                uniforms.reprojection = camera.get_previous_view_matrix() * glm::inverse(camera.get_view_matrix());
+                uniforms.previous_projection = camera.get_previous_projection_matrix();
+                
+                // Cycle through interleaved subsets of the kernel, and rotate the kernel by the golden angle every frame so that consecutive frames sample different directions
+                uniforms.kernel_offset = ambient_occlusion_frame % (KERNEL_SIZE / SAMPLES_PER_FRAME);
+                uniforms.kernel_rotation = (float) std::fmod((double) ambient_occlusion_frame * 2.399963229728653, glm::two_pi<double>());
+                uniforms.history_valid = (int) history_valid;
+                
                 memcpy(&uniforms.samples, &samples, KERNEL_SIZE * sizeof(glm::vec4));
                 
                 memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &uniforms, sizeof(AmbientOcclusionUniforms));
@@ -1898,12 +1903,23 @@ class AmbientOcclusion final : public Sample {
             {
                 CompositionUniforms uniforms { };
                 uniforms.view = camera.get_view_matrix();
+                uniforms.inverse_projection = glm::inverse(camera.get_projection_matrix());
                 uniforms.camera_position = camera.get_position();
                 uniforms.debug_view = debug_view;
                 
                 memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &uniforms, sizeof(CompositionUniforms));
                 offset += align_to_device_boundary(physical_device, sizeof(CompositionUniforms));
             }
+            
+            // Material table
+            for (const Scene::Object& object : scene.objects) {
+                GeometryBufferMaterial material { };
+                material.ambient = glm::vec4(object.ambient, 1.0f);
+                material.specular = glm::vec4(object.specular, object.specular_exponent);
+                
+                memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &material, sizeof(GeometryBufferMaterial));
+                offset += sizeof(GeometryBufferMaterial);
+            }
         }
         
         void destroy_uniform_buffer() {
@@ -1941,8 +1957,8 @@ class AmbientOcclusion final : public Sample {
             // A better approach would be to tile a smaller subset of of randomized rotation vectors across the image
             
             std::vector<glm::vec4> noise_values;
-            unsigned dimension = 6;
-            noise_values.resize(dimension * dimension); // 64 random rotation vectors
+            unsigned dimension = 4;
+            noise_values.resize(dimension * dimension); // 16 random rotation vectors (per-frame rotation of the kernel provides additional variation over time)
             
             for (std::size_t i = 0u; i < dimension * dimension; ++i) {
                 // Rotation kernel (initialized above) is oriented along the z axis, so keep the z component of the random offset 0 to rotate around this axis
@@ -2008,7 +2024,7 @@ class AmbientOcclusion final : public Sample {
                                  // Wait until the image is fully written to
                                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
                                  // Ensure any reads from the image are done after transitioning the image layout
-                                 VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                                 VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
             submit_transient_command_buffer(command_buffer);
             
             create_image_view(device, ambient_occlusion_noise.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, ambient_occlusion_noise.image_view);
@@ -2018,6 +2034,43 @@ class AmbientOcclusion final : public Sample {
             vkDestroyBuffer(device, staging_buffer, nullptr);
         }
         
+        void initialize_ambient_occlusion_history_resources() {
+            // History images are written by the temporal pass as storage images and read back in the next frame
+            VkImageSubresourceRange subresource_range { };
+            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresource_range.baseMipLevel = 0;
+            subresource_range.levelCount = 1;
+            subresource_range.layerCount = 1;
+            subresource_range.baseArrayLayer = 0;
+            
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+            
+            for (Texture& texture : ambient_occlusion_history_images) {
+                create_image(physical_device, device, ambient_occlusion_extent.width, ambient_occlusion_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+                create_image_view(device, texture.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, texture.image_view);
+                
+                // The render graph expects history images to be in VK_IMAGE_LAYOUT_GENERAL at the start of every frame
+                // Contents are not read until the history has been written once (see 'history_valid')
+                transition_image(command_buffer, texture.image,
+                                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range,
+                                 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            }
+            
+            submit_transient_command_buffer(command_buffer);
+            
+            history_index = 0u;
+            history_valid = false;
+        }
+        
+        void destroy_ambient_occlusion_history_resources() {
+            for (Texture& texture : ambient_occlusion_history_images) {
+                vkDestroyImageView(device, texture.image_view, nullptr);
+                vkDestroyImage(device, texture.image, nullptr);
+                vkFreeMemory(device, texture.memory, nullptr);
+            }
+        }
+        
         void destroy_ambient_occlusion_resources() {
             vkFreeMemory(device, ambient_occlusion_noise.memory, nullptr);
             vkDestroyImageView(device, ambient_occlusion_noise.image_view, nullptr);
@@ -0,0 +1,24 @@
+// Shared between the ambient occlusion compute shaders and the composition pass
+// Ambient occlusion is computed from a reduced resolution copy of the geometry buffer that stores linear (view space) depth and view space normals
+
+#ifndef AMBIENT_OCCLUSION_GLSL
+#define AMBIENT_OCCLUSION_GLSL
+
+// Relative depth difference at which reduced resolution samples stop contributing to a pixel when filtering / upsampling
+const float DEPTH_TOLERANCE = 0.05f;
+
+// Reconstructs the view space position of a point at view space depth 'z' (negative, the camera looks down -z) that projects to 'uv'
+// Only valid for perspective projections
+vec3 reconstruct_view_position(vec2 uv, float z, mat4 projection) {
+    vec2 ndc = uv * 2.0f - 1.0f;
+    return vec3((ndc * -z - vec2(projection[2][0], projection[2][1]) * z) / vec2(projection[0][0], projection[1][1]), z);
+}
+
+// Weight of a sample at depth 'sample_z' when filtering a pixel at depth 'z', so that occlusion does not bleed across depth discontinuities
+// The depth difference is relative to the depth of the pixel so that the tolerance does not depend on the distance to the camera
+float depth_weight(float z, float sample_z) {
+    float difference = abs(z - sample_z) / max(abs(z), 0.0001f);
+    return max(0.0f, 1.0f - difference / DEPTH_TOLERANCE);
+}
+
+#endif // AMBIENT_OCCLUSION_GLSL
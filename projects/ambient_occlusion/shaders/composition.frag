@@ -1,94 +1,117 @@
-
 #version 450
 
+#include "common/geometry_buffer.glsl"
+#include "ambient_occlusion.glsl"
+
 layout (location = 0) in vec2 vertex_uv;
 
-layout (set = 0, binding = 0) uniform sampler2D positions;
-layout (set = 0, binding = 1) uniform sampler2D normals;
-layout (set = 0, binding = 2) uniform sampler2D ambient;
-layout (set = 0, binding = 3) uniform sampler2D diffuse;
-layout (set = 0, binding = 4) uniform sampler2D specular;
-layout (set = 0, binding = 5) uniform sampler2D ambient_occlusion;
+layout (set = 0, binding = 0) uniform sampler2D normals;
+layout (set = 0, binding = 1) uniform sampler2D materials;
+layout (set = 0, binding = 2) uniform sampler2D depth;
+layout (set = 0, binding = 3) uniform sampler2D ambient_occlusion; // Reduced resolution
 
 struct Light {
     vec3 position;
     float radius;
 };
 
-layout (set = 0, binding = 6) uniform LightingUniforms {
+layout (set = 0, binding = 4) uniform LightingUniforms {
     mat4 view;
+    mat4 inverse_projection; // For reconstructing view space positions from depth
     vec3 camera_position;
     int debug_view; // For debug rendering attachments
     // TODO: lights array
 } lighting;
 
+// MATERIAL_COUNT is provided when the shader is compiled
+layout (set = 0, binding = 5) uniform MaterialUniforms {
+    Material materials[MATERIAL_COUNT];
+} material_table;
+
+layout (set = 0, binding = 6) uniform sampler2D ambient_occlusion_depth; // View space depth ambient occlusion was computed from
+
 layout (location = 0) out vec4 out_color;
 
-void main() {
-    if (lighting.debug_view == 0) {
-        vec3 color = vec3(0.0f);
+// Depth-aware (bilateral) upsampling of the reduced resolution ambient occlusion
+// Bilinear weights of the four nearest reduced resolution texels are scaled by how closely their depth matches the depth of this pixel
+float upsample_ambient_occlusion(vec2 uv, float z) {
+    ivec2 size = textureSize(ambient_occlusion_depth, 0);
+    vec2 texel = uv * vec2(size) - 0.5f;
+    ivec2 base = ivec2(floor(texel));
+    vec2 f = fract(texel);
 
-        vec4 view_position = texture(positions, vertex_uv);
-        vec4 N = texture(normals, vertex_uv);
-        vec4 V = normalize((lighting.view * vec4(lighting.camera_position, 1.0f)) - view_position);
+    float result = 0.0f;
+    float total_weight = 0.0f;
 
-        // Hardcode one light for the time being
-        vec4 light_position = vec4(0.0f, 3.f, 1.0f, 1.0f);
-        vec3 light_color = vec3(1.0f, 1.0f, 1.0f);
+    float nearest = 1.0f;
+    float nearest_difference = 1e30f;
 
-        vec4 L = normalize((lighting.view * light_position) - view_position);
+    for (int i = 0; i < 4; ++i) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 coordinate = clamp(base + offset, ivec2(0), size - 1);
 
-        // Ambient + ambient occlusion component
-        color += (texture(ambient, vertex_uv).xyz * texture(ambient_occlusion, vertex_uv).r);
+        float sample_z = texelFetch(ambient_occlusion_depth, coordinate, 0).r;
+        float occlusion = texelFetch(ambient_occlusion, coordinate, 0).r;
 
-        // Diffuse
-        float lambert = max(dot(N, L), 0.0f);
-        color += light_color * texture(diffuse, vertex_uv).rgb * lambert;
+        vec2 bilinear = mix(1.0f - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y * depth_weight(z, sample_z);
 
-        // Specular
-        if (lambert > 0.0f) {
-            vec4 specular = texture(specular, vertex_uv);
+        result += occlusion * weight;
+        total_weight += weight;
 
-            // Specular highlights only happen with visible faces
-            vec4 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
-            if (max(dot(R, V), 0.0f) > 0.0f) {
-                color += specular.rgb * pow(max(dot(R, V), 0.0f), specular.a);
-            }
+        if (abs(z - sample_z) < nearest_difference) {
+            nearest_difference = abs(z - sample_z);
+            nearest = occlusion;
         }
+    }
+
+    // None of the reduced resolution texels are on the same surface as this pixel (thin features), fall back to the texel closest in depth
+    return total_weight > 0.0001f ? result / total_weight : nearest;
+}
 
-        out_color = vec4(color, 1.0f);
+void main() {
+    float d = texture(depth, vertex_uv).r;
+    if (d == 1.0f) {
+        // Background
+        out_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
     }
-    else {
-        vec3 color = vec3(0.0f);
 
-        vec4 view_position = texture(positions, vertex_uv);
-        vec4 N = texture(normals, vertex_uv);
-        vec4 V = normalize((lighting.view * vec4(lighting.camera_position, 1.0f)) - view_position);
+    vec4 material = texture(materials, vertex_uv);
+    Material m = material_table.materials[min(decode_material_index(material), uint(MATERIAL_COUNT - 1))];
 
-        // Hardcode one light for the time being
-        vec4 light_position = vec4(0.0f, 3.f, 1.0f, 1.0f);
-        vec3 light_color = vec3(1.0f, 1.0f, 1.0f);
+    vec3 color = vec3(0.0f);
 
-        vec4 L = normalize((lighting.view * light_position) - view_position);
+    vec4 view_position = vec4(reconstruct_position(vertex_uv, d, lighting.inverse_projection), 1.0f);
+    vec4 N = vec4(decode_normal(texture(normals, vertex_uv).xy), 0.0f);
+    vec4 V = normalize((lighting.view * vec4(lighting.camera_position, 1.0f)) - view_position);
 
-        // Ambient
-        color += texture(ambient, vertex_uv).xyz;
+    // Hardcode one light for the time being
+    vec4 light_position = vec4(0.0f, 3.f, 1.0f, 1.0f);
+    vec3 light_color = vec3(1.0f, 1.0f, 1.0f);
 
-        // Diffuse
-        float lambert = max(dot(N, L), 0.0f);
-        color += light_color * texture(diffuse, vertex_uv).rgb * lambert;
+    vec4 L = normalize((lighting.view * light_position) - view_position);
 
-        // Specular
-        if (lambert > 0.0f) {
-            vec4 specular = texture(specular, vertex_uv);
+    // Ambient (+ ambient occlusion component)
+    if (lighting.debug_view == 0) {
+        color += m.ambient.rgb * upsample_ambient_occlusion(vertex_uv, view_position.z);
+    }
+    else {
+        color += m.ambient.rgb;
+    }
 
-            // Specular highlights only happen with visible faces
-            vec4 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
-            if (max(dot(R, V), 0.0f) > 0.0f) {
-                color += specular.rgb * pow(max(dot(R, V), 0.0f), specular.a);
-            }
-        }
+    // Diffuse
+    float lambert = max(dot(N, L), 0.0f);
+    color += light_color * material.rgb * lambert;
 
-        out_color = vec4(color, 1.0f);
+    // Specular
+    if (lambert > 0.0f) {
+        // Specular highlights only happen with visible faces
+        vec4 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
+        if (max(dot(R, V), 0.0f) > 0.0f) {
+            color += m.specular.rgb * pow(max(dot(R, V), 0.0f), m.specular.a);
+        }
     }
+
+    out_color = vec4(color, 1.0f);
 }
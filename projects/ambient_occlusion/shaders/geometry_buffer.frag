@@ -1,8 +1,9 @@
-
 #version 450 core
 
-layout (location = 0) in vec3 world_position;
-layout (location = 1) in vec3 world_normal;
+#include "common/geometry_buffer.glsl"
+
+layout (location = 0) in vec3 view_position;
+layout (location = 1) in vec3 view_normal;
 
 layout (set = 0, binding = 0) uniform GlobalUniforms {
     mat4 view;
@@ -11,18 +12,14 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
 } globals;
 
 layout (set = 1, binding = 1) uniform PhongUniforms {
-    vec3 ambient;
     vec3 diffuse;
-    vec3 specular;
-    float specular_exponent;
+    uint material; // Index into the material table (ambient, specular)
     int flat_shaded;
 } shading;
 
-layout (location = 0) out vec3 out_position;
-layout (location = 1) out vec3 out_normal;
-layout (location = 2) out vec3 out_ambient;
-layout (location = 3) out vec3 out_diffuse;
-layout (location = 4) out vec4 out_specular; // (r, g, b, exponent)
+// Positions are reconstructed from depth
+layout (location = 0) out vec2 out_normal;
+layout (location = 1) out vec4 out_material;
 
 vec3 calculate_face_normal(vec3 position) {
     vec3 dx = dFdx(position);
@@ -31,15 +28,14 @@ vec3 calculate_face_normal(vec3 position) {
 }
 
 void main() {
-    out_position = world_position;
-
+    vec3 normal;
     if (shading.flat_shaded == 1) {
-        out_normal = calculate_face_normal(world_position);
+        normal = calculate_face_normal(view_position);
     }
     else {
-        out_normal = normalize(world_normal);
+        normal = normalize(view_normal);
     }
-    out_ambient = shading.ambient;
-    out_diffuse = shading.diffuse;
-    out_specular = vec4(shading.specular, shading.specular_exponent);
+
+    out_normal = encode_normal(normal);
+    out_material = encode_material(shading.diffuse, shading.material);
 }
@@ -4,9 +4,18 @@
 #include "helpers.hpp"
 #include "vulkan_initializers.hpp"
 #include "loaders/obj.hpp"
+#include "texture_cache.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
+#include <iostream> // std::cout, std::endl
+#include <iomanip> // std::setw, std::setprecision
+#include <algorithm> // std::fill, std::min, std::max
+#include <cmath> // std::ceil, std::floor
+#include <limits> // std::numeric_limits
+#include <chrono> // std::chrono::high_resolution_clock
+#include <filesystem> // std::filesystem::path
+#include <string> // std::string
 
 class DeferredRendering final : public Sample {
     public:
@@ -16,23 +25,66 @@ class DeferredRendering final : public Sample {
             
             dimension = 100;
             size = 7.0f;
+            
+            model_index = 0u;
+            
+            solver = Springs;
+            timestep = SOLVER_TIMESTEPS[solver];
+            maximum_substeps = 16u;
+            accumulated_time = 0.0;
+            simulation_step = 0u;
+            render_step = 0u;
+            
+            benchmark.running = false;
+            
             enabled_queue_types = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+            
+            // The cloth simulation runs on a separate compute queue, paced against rendering with timeline semaphores
+            // Timeline semaphores are required (Vulkan 1.2), device creation fails if they are not supported
+            async_compute_requested = true;
+            enabled_vulkan_12_features.timelineSemaphore = VK_TRUE;
         }
         
         ~DeferredRendering() override {
         }
         
-        // SSBO data
-        struct Particle {
-            alignas(16) glm::vec3 position;
-            alignas(16) glm::vec3 velocity;
-            glm::vec2 uv;
-            alignas(16) glm::vec3 normal;
+    private:
+        // Particle state is stored in a ring of buffers, decoupled from the frames in flight
+        // Simulation step 's' reads the state written by step 's - 1' and writes buffer 's % SIMULATION_BUFFER_COUNT'
+        // The simulation runs one step ahead of rendering (step 's + 1' is computed while the frame that draws step 's' is rasterized), so a third buffer is required for the step being computed to not overwrite the state that is being drawn
+        static constexpr unsigned SIMULATION_BUFFER_COUNT = 3u;
+        
+        // Each simulation step runs a variable number of fixed-size substeps, intermediate substeps ping-pong between the output buffer of the step and a scratch buffer that is never drawn
+        static constexpr unsigned SCRATCH_BUFFER = SIMULATION_BUFFER_COUNT;
+        static constexpr unsigned PARTICLE_BUFFER_COUNT = SIMULATION_BUFFER_COUNT + 1u;
+        
+        // The spring solver integrates Hooke's law explicitly and requires a small timestep to remain stable at high spring stiffness
+        // The XPBD solver (toggled with 'X') projects distance and bending constraints on the positions of the particles directly, and remains stable at larger timesteps
+        enum Solver {
+            Springs,
+            XPBD
         };
         
-        std::vector<Particle> cloth_vertices;
+        static constexpr float SOLVER_TIMESTEPS[] = { 0.005f, 1.0f / 120.0f };
+        
+        // XPBD substeps run a prediction pass, one pass per color of each constraint type, and a final pass (shaders/xpbd.comp)
+        static constexpr int XPBD_CONSTRAINT_TYPES = 6; // Structural (horizontal, vertical), shear (both diagonals), and bending (horizontal, vertical)
+        static constexpr int XPBD_CONSTRAINT_COLORS = 2;
+        static constexpr unsigned XPBD_PIPELINE_COUNT = XPBD_CONSTRAINT_TYPES * XPBD_CONSTRAINT_COLORS + 2u;
+        
+        // Cloth dimensions measured by the benchmark
+        static constexpr int CLOTH_DIMENSIONS[] = { 64, 128, 256, 512, 1024 };
+        
+        // Models the cloth collides with (switched with 'M')
+        static constexpr const char* MODELS[] = { "assets/models/sphere.obj", "assets/models/bunny_medium_poly.obj", "assets/models/dragon_low_poly.obj" };
+        
+        // Models are voxelized into a signed distance field (SDF) when they are loaded, collision queries of the cloth kernels sample the SDF in constant time (shaders/collision.glsl)
+        static constexpr unsigned SDF_RESOLUTION = 64u; // Voxels along each side, must be a multiple of SDF_SLICES_PER_DISPATCH
+        static constexpr float SDF_PADDING = 0.1f; // The SDF extends past the bounds of the model by this fraction of its size on every side
+        
+        // Voxelization tests every voxel against every triangle, so the SDF is voxelized in slabs (one submission each) to keep submissions for models with many triangles short
+        static constexpr unsigned SDF_SLICES_PER_DISPATCH = 8u; // Must be a multiple of 4 (invocation group size)
         
-    private:
         struct Buffer {
             VkBuffer buffer;
             VkDeviceMemory memory;
@@ -49,18 +101,49 @@ class DeferredRendering final : public Sample {
             bool flat_shaded;
         } model;
         
+        unsigned model_index; // Index into MODELS
+        
+        struct Texture {
+            VkImage image;
+            VkDeviceMemory memory;
+            VkImageView view;
+        };
+        
+        // Distances are stored in the object space of the model, which allows the transform of the model to change without voxelizing it again
+        Texture sdf;
+        glm::vec3 sdf_origin; // Object-space position of the minimum corner of the (cubic) volume covered by the SDF
+        float sdf_size; // Object-space length of one side of the volume
+        VkSampler sdf_sampler;
+        
+        // Voxelizing a model is expensive, so SDFs are cached on disk (depth slices of the SDF are stored as layers of the cached texture)
+        TextureCache sdf_cache { "cache/compute_cloth" };
+        
         Buffer model_vertex_buffer; // Holds vertex data for the main model
-        Buffer index_buffer; // Holds indices for the main model and the cloth
-
-
-        std::vector<unsigned> cloth_indices;
+        Buffer index_buffer; // Holds indices for the main model
+        
+        Buffer cloth_index_buffer;
+        unsigned cloth_index_count;
         
         int dimension; // Number of particles one one side of the cloth
         float size; // World-space size of the cloth
         
+        Solver solver;
+        
+        // The simulation advances in fixed timesteps (in seconds), independent of the frame rate
+        // Each simulation step runs as many substeps as fit into the real time accumulated since the previous step
+        float timestep;
+        unsigned maximum_substeps; // Time past this limit is dropped, so that a long frame does not cause an even longer frame
+        double accumulated_time;
+        
         // Updated by the compute pipeline, displayed by the graphics pipeline
-        // Holds vertex data for the cloth
-        Buffer ssbo;
+        // Particle data is split into tightly packed buffers per attribute (structure of arrays), which are also bound as separate vertex buffers for rendering the cloth
+        // Positions and velocities hold PARTICLE_BUFFER_COUNT consecutive copies, normals are only computed for the final state of a simulation step and hold SIMULATION_BUFFER_COUNT copies
+        // Positions, velocities, and normals are stored as glm::vec4 (arrays of vec3 have a stride of 16 bytes in std430)
+        Buffer positions;
+        Buffer velocities;
+        Buffer normals;
+        Buffer uvs; // Never changes
+        std::size_t particle_buffer_stride; // Size of one copy, aligned so that every copy can be bound as a storage buffer
 
         // Uniforms
         struct SimulationUniforms {
@@ -70,10 +153,13 @@ class DeferredRendering final : public Sample {
             float spring_length_diagonal;
             glm::vec3 gravity;
             float spring_stiffness;
-            glm::vec3 sphere_position;
-            float sphere_radius;
+            glm::mat4 world_to_sdf;
+            float sdf_scale;
+            float sdf_voxel_size;
             float dampening;
             int dimension;
+            float compliance;
+            float bending_compliance;
         };
         
         struct CameraUniforms {
@@ -115,9 +201,18 @@ class DeferredRendering final : public Sample {
         VkPipeline compute_pipeline;
         VkPipelineLayout compute_pipeline_layout;
         
+        VkPipeline normal_pipeline;
+        VkPipelineLayout normal_pipeline_layout;
+        
+        // XPBD passes share the layout (and descriptor sets) of the spring solver
+        std::array<VkPipeline, XPBD_PIPELINE_COUNT> xpbd_pipelines; // In dispatch order
+        
         // Descriptor sets
         VkDescriptorSetLayout compute_descriptor_set_layout;
-        std::array<VkDescriptorSet, 2> compute_descriptor_sets;
+        std::array<std::array<VkDescriptorSet, PARTICLE_BUFFER_COUNT>, PARTICLE_BUFFER_COUNT> compute_descriptor_sets; // Indexed by the buffer that is read, then the buffer that is written
+        
+        VkDescriptorSetLayout normal_descriptor_set_layout;
+        std::array<VkDescriptorSet, SIMULATION_BUFFER_COUNT> normal_descriptor_sets; // Indexed by the buffer that is written
         
         VkDescriptorSetLayout global_descriptor_set_layout;
         VkDescriptorSet global_descriptor_set;
@@ -126,27 +221,62 @@ class DeferredRendering final : public Sample {
         std::array<VkDescriptorSet, 2> object_descriptor_sets;
         
         // Synchronization
-        VkSemaphore is_compute_finished;
-        VkFence is_compute_in_flight;
-        
-        VkCommandBuffer compute_command_buffer;
+        // Both timeline semaphores count simulation steps: 'simulation_timeline' reaches 's' once step 's' has been written, and 'render_timeline' reaches 's' once the frame that draws step 's' has finished
+        VkSemaphore simulation_timeline;
+        VkSemaphore render_timeline;
+        std::uint64_t simulation_step; // Last simulation step submitted
+        std::uint64_t render_step; // Simulation step drawn by the current frame
+        
+        // The simulation is submitted to the async compute queue if it is from the graphics queue family (the SSBO is shared without queue family ownership transfers), otherwise to 'queue'
+        VkQueue simulation_queue;
+        std::vector<VkCommandBuffer> simulation_command_buffers; // One per frame in flight, indexed by simulation step
+        
+        // GPU time of each simulation step is measured with timestamp queries, 2 per simulation command buffer
+        bool timestamps_supported;
+        VkQueryPool query_pool;
+        std::vector<unsigned> simulation_substeps; // Per simulation command buffer, timestamps are only read back for command buffers that ran at least one substep
+        
+        // Benchmark mode (started with 'B') runs the simulation at every dimension in CLOTH_DIMENSIONS and reports the throughput of the simulation (particles updated per millisecond)
+        static constexpr unsigned BENCHMARK_WARMUP_STEPS = 16u;
+        static constexpr unsigned BENCHMARK_MEASURED_STEPS = 128u;
+        
+        struct Benchmark {
+            bool running;
+            unsigned step; // Index into CLOTH_DIMENSIONS
+            unsigned frame; // Simulation steps read back at the current dimension
+            
+            // Accumulated over the measured simulation steps
+            double time; // Milliseconds
+            unsigned substeps;
+            
+            // Restored once the benchmark completes
+            int dimension;
+        } benchmark;
         
         VkSampler sampler;
         
         void initialize_resources() override {
             initialize_geometry_buffers();
+            initialize_cloth_buffers();
             initialize_uniform_buffer();
             
             initialize_samplers();
             
             initialize_synchronization();
-            initialize_compute_command_buffer();
+            initialize_simulation_command_buffers();
+            initialize_query_pool();
             
             initialize_model_render_pass();
             initialize_cloth_render_pass();
             initialize_framebuffers();
             
-            initialize_descriptor_pool(5, 0);
+            // Global and per-object descriptor sets reference 6 uniform buffers
+            // One compute descriptor set for each pair of distinct particle buffers (4 storage buffers and the SDF each), and one normal descriptor set per simulation buffer (2 storage buffers each)
+            // The descriptor set used for voxelizing the model (2 storage buffers, 1 storage image) is only allocated while the SDF is baked
+            unsigned compute_descriptor_set_count = PARTICLE_BUFFER_COUNT * (PARTICLE_BUFFER_COUNT - 1u);
+            initialize_descriptor_pool(6 + compute_descriptor_set_count + SIMULATION_BUFFER_COUNT, compute_descriptor_set_count, 0, 4 * compute_descriptor_set_count + 2 * SIMULATION_BUFFER_COUNT + 2, 1);
+            
+            initialize_sdf();
             
             initialize_global_descriptor_set();
             initialize_compute_descriptor_sets();
@@ -161,47 +291,68 @@ class DeferredRendering final : public Sample {
             destroy_pipelines();
             destroy_descriptor_sets();
             destroy_uniform_buffer();
+            destroy_cloth_buffers();
             destroy_buffers();
+            destroy_sdf();
             destroy_framebuffers();
             destroy_render_passes();
+            destroy_query_pool();
             destroy_synchronization();
             destroy_samplers();
         }
         
         void update() override {
+            if (benchmark.running && benchmark.frame >= BENCHMARK_WARMUP_STEPS + BENCHMARK_MEASURED_STEPS) {
+                update_benchmark();
+            }
+            
+            accumulated_time += dt;
             update_uniform_buffers();
         }
         
         void initialize_synchronization() {
+            VkSemaphoreTypeCreateInfo semaphore_type_create_info { };
+            semaphore_type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            semaphore_type_create_info.initialValue = 0u; // Step 0 is the initial state of the cloth, uploaded during initialization
+            
             VkSemaphoreCreateInfo semaphore_create_info { };
             semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-            if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &is_compute_finished) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create semaphore (is_compute_finished)!");
+            semaphore_create_info.pNext = &semaphore_type_create_info;
+            
+            if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &simulation_timeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create semaphore (simulation_timeline)!");
             }
             
-            VkFenceCreateInfo fence_create_info { };
-            fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-            fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Create the fence in the signaled state so that waiting on the fence during the first frame returns immediately
-    
-            if (vkCreateFence(device, &fence_create_info, nullptr, &is_compute_in_flight) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create fence!");
+            if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &render_timeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create semaphore (render_timeline)!");
             }
         }
         
         void destroy_synchronization() {
-            vkDestroySemaphore(device, is_compute_finished, nullptr);
-            vkDestroyFence(device, is_compute_in_flight, nullptr);
+            vkDestroySemaphore(device, simulation_timeline, nullptr);
+            vkDestroySemaphore(device, render_timeline, nullptr);
         }
         
-        void initialize_compute_command_buffer() {
+        void initialize_simulation_command_buffers() {
+            if (compute_queue && compute_queue_family_index == queue_family_index) {
+                simulation_queue = compute_queue;
+                simulation_command_buffers = compute_command_buffers;
+                return;
+            }
+            
+            // Simulation steps are submitted to the graphics queue, in order with rendering
+            simulation_queue = queue;
+            simulation_command_buffers.resize(NUM_FRAMES_IN_FLIGHT);
+            
             VkCommandBufferAllocateInfo command_buffer_allocate_info { };
             command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
             command_buffer_allocate_info.commandPool = command_pool;
             command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            command_buffer_allocate_info.commandBufferCount = 1;
+            command_buffer_allocate_info.commandBufferCount = NUM_FRAMES_IN_FLIGHT;
             
-            if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &compute_command_buffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate compute command buffer!");
+            if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, simulation_command_buffers.data()) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate compute command buffers!");
             }
         }
         
@@ -266,14 +417,16 @@ class DeferredRendering final : public Sample {
                     vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cloth_pipeline_layout, 0, 1, &global_descriptor_set, 0, nullptr);
 
                     // Bind vertex + index buffers
-                    VkDeviceSize offset = { ((frame_index + 1) % 2) * (sizeof(Particle) * cloth_vertices.size()) };
-                    vkCmdBindVertexBuffers(command_buffer, 0, 1, &ssbo.buffer, &offset);
-                    vkCmdBindIndexBuffer(command_buffer, index_buffer.buffer, model.model.indices.size() * sizeof(unsigned), VK_INDEX_TYPE_UINT32); // Cloth indices come after model indices
+                    // Positions and normals of the simulation step drawn by this frame
+                    VkBuffer vertex_buffers[] = { positions.buffer, normals.buffer, uvs.buffer };
+                    VkDeviceSize offsets[] = { (render_step % SIMULATION_BUFFER_COUNT) * particle_buffer_stride, (render_step % SIMULATION_BUFFER_COUNT) * particle_buffer_stride, 0u };
+                    vkCmdBindVertexBuffers(command_buffer, 0, 3, vertex_buffers, offsets);
+                    vkCmdBindIndexBuffer(command_buffer, cloth_index_buffer.buffer, 0u, VK_INDEX_TYPE_UINT32);
 
                     // Bind per-object descriptor set (set 1)
                     vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cloth_pipeline_layout, 1, 1, &object_descriptor_sets[1], 0, nullptr);
 
-                    vkCmdDrawIndexed(command_buffer, cloth_indices.size(), 1, 0, 0, 0);
+                    vkCmdDrawIndexed(command_buffer, cloth_index_count, 1, 0, 0, 0);
                 vkCmdEndRenderPass(command_buffer);
             }
     
@@ -282,8 +435,7 @@ class DeferredRendering final : public Sample {
             }
         }
         
-        void record_compute_command_buffer() {
-            VkCommandBuffer command_buffer = compute_command_buffer;
+        void record_compute_command_buffer(VkCommandBuffer command_buffer, std::uint64_t step, unsigned substeps) {
             vkResetCommandBuffer(command_buffer, 0);
             
             VkCommandBufferBeginInfo command_buffer_begin_info { };
@@ -293,42 +445,149 @@ class DeferredRendering final : public Sample {
                 throw std::runtime_error("failed to begin compute command buffer recording!");
             }
             
-            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
+            unsigned query = (unsigned) (step % NUM_FRAMES_IN_FLIGHT) * 2u;
+            if (timestamps_supported) {
+                vkCmdResetQueryPool(command_buffer, query_pool, query, 2u);
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, query);
+            }
             
-            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1, &compute_descriptor_sets[frame_index % 2], 0, nullptr);
+            unsigned input = (unsigned) ((step + SIMULATION_BUFFER_COUNT - 1u) % SIMULATION_BUFFER_COUNT);
+            unsigned output = (unsigned) (step % SIMULATION_BUFFER_COUNT);
             
-            // Specify compute workgroups
             // Each invocation group runs 10x10
-            vkCmdDispatch(command_buffer, std::ceil((float) dimension / 10.0f), std::ceil((float) dimension / 10.0f), 1);
+            unsigned workgroup_count = (unsigned) std::ceil((float) dimension / 10.0f);
+            
+            if (substeps == 0u) {
+                // Not enough time has passed for a substep, the state of the previous step is carried over
+                std::size_t particle_buffer_size = (std::size_t) dimension * dimension * sizeof(glm::vec4);
+                copy_buffer(command_buffer, positions.buffer, input * particle_buffer_stride, positions.buffer, output * particle_buffer_stride, particle_buffer_size);
+                copy_buffer(command_buffer, velocities.buffer, input * particle_buffer_stride, velocities.buffer, output * particle_buffer_stride, particle_buffer_size);
+            }
+            else {
+                if (solver == Springs) {
+                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
+                }
+                
+                for (unsigned substep = 0u; substep < substeps; ++substep) {
+                    // Alternate between the scratch buffer and the output buffer so that the last substep writes the output buffer
+                    unsigned destination = (substeps - 1u - substep) % 2u == 0u ? output : SCRATCH_BUFFER;
+                    
+                    if (substep > 0u) {
+                        // Substep reads the particles written by the previous substep, and overwrites the buffer read by the previous substep
+                        record_compute_barrier(command_buffer);
+                    }
+                    
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1, &compute_descriptor_sets[input][destination], 0, nullptr);
+                    
+                    if (solver == Springs) {
+                        vkCmdDispatch(command_buffer, workgroup_count, workgroup_count, 1);
+                    }
+                    else {
+                        // Every pass reads the positions written by the previous pass
+                        // Constraints within a color batch do not share particles, so no synchronization is required within a pass
+                        for (unsigned pass = 0u; pass < XPBD_PIPELINE_COUNT; ++pass) {
+                            if (pass > 0u) {
+                                record_compute_barrier(command_buffer);
+                            }
+                            
+                            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, xpbd_pipelines[pass]);
+                            vkCmdDispatch(command_buffer, workgroup_count, workgroup_count, 1);
+                        }
+                    }
+                    
+                    input = destination;
+                }
+            }
+            
+            // Normals are computed once, from the final positions of this step
+            VkMemoryBarrier barrier { };
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, normal_pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, normal_pipeline_layout, 0, 1, &normal_descriptor_sets[output], 0, nullptr);
+            vkCmdDispatch(command_buffer, workgroup_count, workgroup_count, 1);
+            
+            if (timestamps_supported) {
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, query + 1u);
+            }
             
             if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
                 throw std::runtime_error("failed to record compute command buffer!");
             }
         }
         
-        void render() override {
-            std::size_t timeout = std::numeric_limits<std::size_t>::max();
+        void record_compute_barrier(VkCommandBuffer command_buffer) {
+            VkMemoryBarrier barrier { };
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        
+        void submit_simulation_step() {
+            std::uint64_t step = ++simulation_step;
             
-            // Compute submission
-            {
-                // Wait for compute work from the previous frame to complete before kicking off a new set of workgroups
-                vkWaitForFences(device, 1, &is_compute_in_flight, VK_TRUE, timeout);
-                vkResetFences(device, 1, &is_compute_in_flight); // Fences must be manually reset for the next frame
+            // Command buffers are reused every NUM_FRAMES_IN_FLIGHT steps, the step that last used this command buffer has almost always finished by now
+            if (step > NUM_FRAMES_IN_FLIGHT) {
+                std::uint64_t value = step - NUM_FRAMES_IN_FLIGHT;
                 
-                record_compute_command_buffer();
+                VkSemaphoreWaitInfo wait_info { };
+                wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+                wait_info.semaphoreCount = 1;
+                wait_info.pSemaphores = &simulation_timeline;
+                wait_info.pValues = &value;
+                vkWaitSemaphores(device, &wait_info, std::numeric_limits<std::uint64_t>::max());
                 
-                VkSubmitInfo submit_info { };
-                submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-                submit_info.commandBufferCount = 1;
-                submit_info.pCommandBuffers = &compute_command_buffer;
-                submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &is_compute_finished;
-                
-                // Compute command buffer signals the is_compute_in_flight fence to indicate that the compute portion of this frame is complete
-                // This allows for the next frame to begin recording data
-                if (vkQueueSubmit(queue, 1, &submit_info, is_compute_in_flight) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to submit compute command buffer!");
-                }
+                update_timings(step % NUM_FRAMES_IN_FLIGHT);
+            }
+            
+            // Consume the accumulated time in fixed substeps, the remainder carries over to the next step
+            unsigned substeps = (unsigned) std::min(std::floor(accumulated_time / timestep), (double) maximum_substeps);
+            accumulated_time = std::min(accumulated_time - substeps * (double) timestep, (double) timestep);
+            
+            VkCommandBuffer command_buffer = simulation_command_buffers[step % NUM_FRAMES_IN_FLIGHT];
+            record_compute_command_buffer(command_buffer, step, substeps);
+            simulation_substeps[step % NUM_FRAMES_IN_FLIGHT] = substeps;
+            
+            // Step 's' reads the state written by step 's - 1', and overwrites the state of step 's - SIMULATION_BUFFER_COUNT' (which must no longer be in use by the frame that draws it)
+            // Waiting on a value of 0 returns immediately, as both timelines start at 0
+            VkSemaphore wait_semaphores[] = { simulation_timeline, render_timeline };
+            std::uint64_t wait_values[] = { step - 1u, step > SIMULATION_BUFFER_COUNT ? step - SIMULATION_BUFFER_COUNT : 0u };
+            // Steps without substeps copy the previous state instead
+            VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT };
+            
+            VkTimelineSemaphoreSubmitInfo timeline_submit_info { };
+            timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_submit_info.waitSemaphoreValueCount = 2;
+            timeline_submit_info.pWaitSemaphoreValues = wait_values;
+            timeline_submit_info.signalSemaphoreValueCount = 1;
+            timeline_submit_info.pSignalSemaphoreValues = &step;
+            
+            VkSubmitInfo submit_info { };
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = &timeline_submit_info;
+            submit_info.waitSemaphoreCount = 2;
+            submit_info.pWaitSemaphores = wait_semaphores;
+            submit_info.pWaitDstStageMask = wait_stages;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &command_buffer;
+            submit_info.signalSemaphoreCount = 1;
+            submit_info.pSignalSemaphores = &simulation_timeline;
+            
+            if (vkQueueSubmit(simulation_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit compute command buffer!");
+            }
+        }
+        
+        void render() override {
+            // This frame draws the next simulation step
+            // The simulation is kept one step ahead, so that the step after it is computed on the compute queue while this frame is rasterized
+            ++render_step;
+            while (simulation_step < render_step + 1u) {
+                submit_simulation_step();
             }
             
             unsigned image_index;
@@ -337,23 +596,35 @@ class DeferredRendering final : public Sample {
             
             // Graphics submission
             {
-                // Wait for graphics work from the previous frame to complete before kicking off a new set of rendering operations
                 record_command_buffers(image_index);
                 
-                VkSemaphore wait_semaphores[] = { is_compute_finished, is_presentation_complete[frame_index] };
+                VkSemaphore wait_semaphores[] = { simulation_timeline, is_presentation_complete[frame_index] };
+                std::uint64_t wait_values[] = { render_step, 0u }; // Values for binary semaphores are ignored
                 
                 // Wait on the VK_PIPELINE_STAGE_VERTEX_INPUT_BIT pipeline stage to ensure that the graphics pipeline does not read vertex data from the cloth SSBO before the compute shader has finished writing to it
                 VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
                 
+                // Signaling the render timeline releases the buffer this frame reads to the simulation step that overwrites it
+                VkSemaphore signal_semaphores[] = { is_rendering_complete[frame_index], render_timeline };
+                std::uint64_t signal_values[] = { 0u, render_step };
+                
+                VkTimelineSemaphoreSubmitInfo timeline_submit_info { };
+                timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+                timeline_submit_info.waitSemaphoreValueCount = 2;
+                timeline_submit_info.pWaitSemaphoreValues = wait_values;
+                timeline_submit_info.signalSemaphoreValueCount = 2;
+                timeline_submit_info.pSignalSemaphoreValues = signal_values;
+                
                 VkSubmitInfo submit_info { };
                 submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submit_info.pNext = &timeline_submit_info;
                 submit_info.waitSemaphoreCount = 2;
                 submit_info.pWaitSemaphores = wait_semaphores;
                 submit_info.pWaitDstStageMask = wait_stages;
                 submit_info.commandBufferCount = 1;
                 submit_info.pCommandBuffers = &command_buffers[frame_index];
-                submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &is_rendering_complete[frame_index];
+                submit_info.signalSemaphoreCount = 2;
+                submit_info.pSignalSemaphores = signal_semaphores;
                 
                 if (vkQueueSubmit(queue, 1, &submit_info, is_frame_in_flight[frame_index]) != VK_SUCCESS) {
                     throw std::runtime_error("failed to submit graphics command buffer!");
@@ -582,21 +853,25 @@ class DeferredRendering final : public Sample {
         }
         
         void initialize_cloth_pipeline() {
-            // One vertex for the cloth contains position, velocity, uv, and normal
-            VkVertexInputBindingDescription vertex_binding_description = create_vertex_binding_description(0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX);
-
+            // Cloth positions, normals, and uvs are stored in separate buffers, one vertex binding each
             // Velocity is only used for the computation stage of the sample, not the rendering
+            VkVertexInputBindingDescription vertex_binding_descriptions[] {
+                create_vertex_binding_description(0, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
+                create_vertex_binding_description(1, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
+                create_vertex_binding_description(2, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX)
+            };
+
             VkVertexInputAttributeDescription vertex_attribute_descriptions[] {
-                create_vertex_attribute_description(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Particle, position)),
-                create_vertex_attribute_description(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Particle, normal)),
-                create_vertex_attribute_description(0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(Particle, uv))
+                create_vertex_attribute_description(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+                create_vertex_attribute_description(1, 1, VK_FORMAT_R32G32B32_SFLOAT, 0),
+                create_vertex_attribute_description(2, 2, VK_FORMAT_R32G32_SFLOAT, 0)
             };
             
             // Describe the format of the vertex data passed to the vertex shader
             VkPipelineVertexInputStateCreateInfo vertex_input_create_info { };
             vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-            vertex_input_create_info.vertexBindingDescriptionCount = 1;
-            vertex_input_create_info.pVertexBindingDescriptions = &vertex_binding_description;
+            vertex_input_create_info.vertexBindingDescriptionCount = sizeof(vertex_binding_descriptions) / sizeof(vertex_binding_descriptions[0]);
+            vertex_input_create_info.pVertexBindingDescriptions = vertex_binding_descriptions;
             vertex_input_create_info.vertexAttributeDescriptionCount = sizeof(vertex_attribute_descriptions) / sizeof(vertex_attribute_descriptions[0]);
             vertex_input_create_info.pVertexAttributeDescriptions = vertex_attribute_descriptions;
             
@@ -741,9 +1016,74 @@ class DeferredRendering final : public Sample {
             }
             
             vkDestroyShaderModule(device, shader_module, nullptr);
+            
+            // Normal pipeline
+            pipeline_layout_create_info.pSetLayouts = { &normal_descriptor_set_layout };
+            if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &normal_pipeline_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create normal pipeline layout!");
+            }
+            
+            pipeline_create_info.layout = normal_pipeline_layout;
+            
+            shader_module = create_shader_module(device, "shaders/cloth_normals.comp");
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &normal_pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create normal pipeline!");
+            }
+            
+            vkDestroyShaderModule(device, shader_module, nullptr);
+            
+            // XPBD pipelines
+            // layout (constant_id = 0) const int PASS;
+            // layout (constant_id = 1) const int CONSTRAINT;
+            // layout (constant_id = 2) const int COLOR;
+            VkSpecializationMapEntry specializations[3] { };
+            for (unsigned i = 0u; i < 3u; ++i) {
+                specializations[i].constantID = i;
+                specializations[i].size = sizeof(int);
+                specializations[i].offset = i * sizeof(int);
+            }
+            
+            pipeline_create_info.layout = compute_pipeline_layout;
+            shader_module = create_shader_module(device, "shaders/xpbd.comp");
+            
+            for (unsigned pass = 0u; pass < XPBD_PIPELINE_COUNT; ++pass) {
+                int constants[3] { };
+                if (pass == 0u) {
+                    constants[0] = 0; // PREDICT
+                }
+                else if (pass == XPBD_PIPELINE_COUNT - 1u) {
+                    constants[0] = 2; // FINALIZE
+                }
+                else {
+                    constants[0] = 1; // CONSTRAINTS
+                    constants[1] = (int) (pass - 1u) / XPBD_CONSTRAINT_COLORS;
+                    constants[2] = (int) (pass - 1u) % XPBD_CONSTRAINT_COLORS;
+                }
+                
+                VkSpecializationInfo specialization_info { };
+                specialization_info.mapEntryCount = 3;
+                specialization_info.pMapEntries = specializations;
+                specialization_info.dataSize = sizeof(constants);
+                specialization_info.pData = constants;
+                
+                pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT, &specialization_info);
+                if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &xpbd_pipelines[pass]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create XPBD pipeline!");
+                }
+            }
+            
+            vkDestroyShaderModule(device, shader_module, nullptr);
         }
         
         void destroy_pipelines() {
+            for (VkPipeline pipeline : xpbd_pipelines) {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            }
+            
+            vkDestroyPipelineLayout(device, normal_pipeline_layout, nullptr);
+            vkDestroyPipeline(device, normal_pipeline, nullptr);
+            
             vkDestroyPipelineLayout(device, compute_pipeline_layout, nullptr);
             vkDestroyPipeline(device, compute_pipeline, nullptr);
             
@@ -993,12 +1333,16 @@ class DeferredRendering final : public Sample {
         void initialize_compute_descriptor_sets() {
             // Descriptor set 0 is used for the compute pipeline
             VkDescriptorSetLayoutBinding bindings[] = {
-                // Binding 0 contains the input SSBO (particle data from the previous frame)
+                // Bindings 0 and 1 contain the input positions and velocities (particle data from the previous substep)
                 create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
-                // Binding 1 contains the output SSBO for the current frame
                 create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
-                // Binding 2 contains cloth simulation uniforms
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+                // Bindings 2 and 3 contain the output positions and velocities for the current substep
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+                // Binding 4 contains cloth simulation uniforms
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+                // Binding 5 contains the SDF of the model
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
             };
             
             VkDescriptorSetLayoutCreateInfo layout_create_info { };
@@ -1009,125 +1353,131 @@ class DeferredRendering final : public Sample {
                 throw std::runtime_error("failed to allocate compute descriptor set layout!");
             }
             
-            // Input and output SSBOs switch between frames
-            // This is primarily done to reduce the number of individual buffers required to support a dual-SSBO setup such as this one (both logical buffers are contained within the same SSBO object)
-            // One frame uses the first SSBO as readonly and second SSBO as the output, and the next frame uses the second SSBO as input and the first SSBO as output
-            // The correct descriptor set is bound at compute at render time
+            // Descriptor set 0 of the normal pipeline
+            VkDescriptorSetLayoutBinding normal_bindings[] = {
+                // Binding 0 contains the final positions of a simulation step
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+                // Binding 1 contains the output normals
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+                // Binding 2 contains cloth simulation uniforms
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+            };
             
-            VkWriteDescriptorSet descriptor_writes[3] { };
-            VkDescriptorBufferInfo buffer_infos[3] { };
+            layout_create_info.bindingCount = sizeof(normal_bindings) / sizeof(normal_bindings[0]);
+            layout_create_info.pBindings = normal_bindings;
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &normal_descriptor_set_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate normal descriptor set layout!");
+            }
             
-            std::size_t shader_storage_buffer_size = sizeof(Particle) * dimension * dimension;
+            // Substeps read from one buffer and write to another, the correct descriptor set for each substep is bound at record time
+            for (unsigned input = 0u; input < PARTICLE_BUFFER_COUNT; ++input) {
+                for (unsigned output = 0u; output < PARTICLE_BUFFER_COUNT; ++output) {
+                    if (input == output) {
+                        compute_descriptor_sets[input][output] = VK_NULL_HANDLE;
+                        continue;
+                    }
+                    
+                    VkDescriptorSetAllocateInfo set_allocate_info { };
+                    set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    set_allocate_info.descriptorPool = descriptor_pool;
+                    set_allocate_info.descriptorSetCount = 1;
+                    set_allocate_info.pSetLayouts = &compute_descriptor_set_layout;
+                    if (vkAllocateDescriptorSets(device, &set_allocate_info, &compute_descriptor_sets[input][output]) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to allocate compute descriptor set!");
+                    }
+                }
+            }
             
-            {
+            for (unsigned i = 0u; i < SIMULATION_BUFFER_COUNT; ++i) {
                 VkDescriptorSetAllocateInfo set_allocate_info { };
                 set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
                 set_allocate_info.descriptorPool = descriptor_pool;
                 set_allocate_info.descriptorSetCount = 1;
-                set_allocate_info.pSetLayouts = &compute_descriptor_set_layout;
-                if (vkAllocateDescriptorSets(device, &set_allocate_info, &compute_descriptor_sets[0]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to allocate compute descriptor set!");
+                set_allocate_info.pSetLayouts = &normal_descriptor_set_layout;
+                if (vkAllocateDescriptorSets(device, &set_allocate_info, &normal_descriptor_sets[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate normal descriptor set!");
                 }
-                
-                // First SSBO as input and second SSBO as output
-                buffer_infos[0].buffer = ssbo.buffer;
-                buffer_infos[0].offset = 0u;
-                buffer_infos[0].range = shader_storage_buffer_size;
-                
-                descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_writes[0].dstSet = compute_descriptor_sets[0];
-                descriptor_writes[0].dstBinding = 0;
-                descriptor_writes[0].dstArrayElement = 0;
-                descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                descriptor_writes[0].descriptorCount = 1;
-                descriptor_writes[0].pBufferInfo = &buffer_infos[0];
-                
-                buffer_infos[1].buffer = ssbo.buffer;
-                buffer_infos[1].offset = shader_storage_buffer_size;
-                buffer_infos[1].range = shader_storage_buffer_size;
-                
-                descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_writes[1].dstSet = compute_descriptor_sets[0];
-                descriptor_writes[1].dstBinding = 1;
-                descriptor_writes[1].dstArrayElement = 0;
-                descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                descriptor_writes[1].descriptorCount = 1;
-                descriptor_writes[1].pBufferInfo = &buffer_infos[1];
-                
-                buffer_infos[2].buffer = uniform_buffer.buffer;
-                buffer_infos[2].offset = 0u;
-                buffer_infos[2].range = sizeof(SimulationUniforms);
-                
-                descriptor_writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_writes[2].dstSet = compute_descriptor_sets[0];
-                descriptor_writes[2].dstBinding = 2;
-                descriptor_writes[2].dstArrayElement = 0;
-                descriptor_writes[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptor_writes[2].descriptorCount = 1;
-                descriptor_writes[2].pBufferInfo = &buffer_infos[2];
-                
-                vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
             }
             
-            // Second SSBO as input and first SSBO as output
-            {
-                VkDescriptorSetAllocateInfo set_allocate_info { };
-                set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                set_allocate_info.descriptorPool = descriptor_pool;
-                set_allocate_info.descriptorSetCount = 1;
-                set_allocate_info.pSetLayouts = &compute_descriptor_set_layout;
-                if (vkAllocateDescriptorSets(device, &set_allocate_info, &compute_descriptor_sets[1]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to allocate compute descriptor set!");
+            write_compute_descriptor_sets();
+        }
+        
+        void write_compute_descriptor_sets() {
+            // Called again whenever the cloth buffers or the SDF are recreated
+            std::size_t shader_storage_buffer_size = (std::size_t) dimension * dimension * sizeof(glm::vec4);
+            
+            VkDescriptorImageInfo image_info { };
+            image_info.sampler = sdf_sampler;
+            image_info.imageView = sdf.view;
+            image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            
+            for (unsigned input = 0u; input < PARTICLE_BUFFER_COUNT; ++input) {
+                for (unsigned output = 0u; output < PARTICLE_BUFFER_COUNT; ++output) {
+                    if (input == output) {
+                        continue;
+                    }
+                    
+                    VkDescriptorBufferInfo buffer_infos[5] { };
+                    buffer_infos[0] = { positions.buffer, input * particle_buffer_stride, shader_storage_buffer_size };
+                    buffer_infos[1] = { velocities.buffer, input * particle_buffer_stride, shader_storage_buffer_size };
+                    buffer_infos[2] = { positions.buffer, output * particle_buffer_stride, shader_storage_buffer_size };
+                    buffer_infos[3] = { velocities.buffer, output * particle_buffer_stride, shader_storage_buffer_size };
+                    buffer_infos[4] = { uniform_buffer.buffer, 0u, sizeof(SimulationUniforms) };
+                    
+                    VkWriteDescriptorSet descriptor_writes[6] { };
+                    for (unsigned binding = 0u; binding < 5u; ++binding) {
+                        descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                        descriptor_writes[binding].dstSet = compute_descriptor_sets[input][output];
+                        descriptor_writes[binding].dstBinding = binding;
+                        descriptor_writes[binding].dstArrayElement = 0;
+                        descriptor_writes[binding].descriptorType = binding < 4u ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                        descriptor_writes[binding].descriptorCount = 1;
+                        descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+                    }
+                    
+                    descriptor_writes[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptor_writes[5].dstSet = compute_descriptor_sets[input][output];
+                    descriptor_writes[5].dstBinding = 5;
+                    descriptor_writes[5].dstArrayElement = 0;
+                    descriptor_writes[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    descriptor_writes[5].descriptorCount = 1;
+                    descriptor_writes[5].pImageInfo = &image_info;
+                    
+                    vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
                 }
+            }
+            
+            for (unsigned i = 0u; i < SIMULATION_BUFFER_COUNT; ++i) {
+                VkDescriptorBufferInfo buffer_infos[3] { };
+                buffer_infos[0] = { positions.buffer, i * particle_buffer_stride, shader_storage_buffer_size };
+                buffer_infos[1] = { normals.buffer, i * particle_buffer_stride, shader_storage_buffer_size };
+                buffer_infos[2] = { uniform_buffer.buffer, 0u, sizeof(SimulationUniforms) };
                 
-                buffer_infos[0].buffer = ssbo.buffer;
-                buffer_infos[0].offset = shader_storage_buffer_size;
-                buffer_infos[0].range = shader_storage_buffer_size;
-                
-                descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_writes[0].dstSet = compute_descriptor_sets[1];
-                descriptor_writes[0].dstBinding = 0;
-                descriptor_writes[0].dstArrayElement = 0;
-                descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                descriptor_writes[0].descriptorCount = 1;
-                descriptor_writes[0].pBufferInfo = &buffer_infos[0];
-                
-                buffer_infos[1].buffer = ssbo.buffer;
-                buffer_infos[1].offset = 0u;
-                buffer_infos[1].range = shader_storage_buffer_size;
-                
-                descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_writes[1].dstSet = compute_descriptor_sets[1];
-                descriptor_writes[1].dstBinding = 1;
-                descriptor_writes[1].dstArrayElement = 0;
-                descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                descriptor_writes[1].descriptorCount = 1;
-                descriptor_writes[1].pBufferInfo = &buffer_infos[1];
-                
-                buffer_infos[2].buffer = uniform_buffer.buffer;
-                buffer_infos[2].offset = 0u;
-                buffer_infos[2].range = sizeof(SimulationUniforms);
-                
-                descriptor_writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_writes[2].dstSet = compute_descriptor_sets[1];
-                descriptor_writes[2].dstBinding = 2;
-                descriptor_writes[2].dstArrayElement = 0;
-                descriptor_writes[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptor_writes[2].descriptorCount = 1;
-                descriptor_writes[2].pBufferInfo = &buffer_infos[2];
+                VkWriteDescriptorSet descriptor_writes[3] { };
+                for (unsigned binding = 0u; binding < 3u; ++binding) {
+                    descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptor_writes[binding].dstSet = normal_descriptor_sets[i];
+                    descriptor_writes[binding].dstBinding = binding;
+                    descriptor_writes[binding].dstArrayElement = 0;
+                    descriptor_writes[binding].descriptorType = binding < 2u ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptor_writes[binding].descriptorCount = 1;
+                    descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+                }
                 
                 vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
             }
         }
 
         void destroy_descriptor_sets() {
+            vkDestroyDescriptorSetLayout(device, normal_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, compute_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, global_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, object_descriptor_set_layout, nullptr);
         }
         
         void initialize_geometry_buffers() {
-            model.model = load_obj("assets/models/sphere.obj");
+            // The loader centers models at the origin and scales them to fit in [-1, 1]
+            model.model = load_obj(MODELS[model_index]);
             model.diffuse = glm::vec3(0.8f);
             model.specular = glm::vec3(0.0f);
             model.specular_exponent = 0.0f;
@@ -1137,22 +1487,82 @@ class DeferredRendering final : public Sample {
             std::size_t model_vertex_buffer_size = model.model.vertices.size() * sizeof(Model::Vertex);
             std::size_t model_index_buffer_size = model.model.indices.size() * sizeof(unsigned);
             
-            cloth_vertices.resize(dimension * dimension);
+            Buffer staging_buffer { };
+            VkBufferUsageFlags staging_buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            VkMemoryPropertyFlags staging_buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            
+            // Use one staging buffer to transfer all data from subranges
+            std::size_t staging_buffer_size = model_vertex_buffer_size + model_index_buffer_size;
+            create_buffer(physical_device, device, staging_buffer_size, staging_buffer_usage, staging_buffer_memory_properties, staging_buffer.buffer, staging_buffer.memory);
+            
+            void* data = nullptr;
+            std::size_t offset = 0u;
+            vkMapMemory(device, staging_buffer.memory, 0, staging_buffer_size, 0, &data);
+                // Copy model vertex data
+                memcpy((void*)(((const char*) data) + offset), model.model.vertices.data(), model_vertex_buffer_size);
+                offset += model_vertex_buffer_size;
+                
+                // Copy model index data
+                memcpy((void*)(((const char*) data) + offset), model.model.indices.data(), model_index_buffer_size);
+                offset += model_index_buffer_size;
+            vkUnmapMemory(device, staging_buffer.memory);
+            
+            // Model vertex buffer
+            VkBufferUsageFlags model_vertex_buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+            VkMemoryPropertyFlags model_vertex_buffer_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            create_buffer(physical_device, device, model_vertex_buffer_size, model_vertex_buffer_usage, model_vertex_buffer_memory_properties, model_vertex_buffer.buffer, model_vertex_buffer.memory);
+            
+            // Index buffer
+            VkBufferUsageFlags index_buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT; // This buffer is the destination buffer in a memory transfer operation (and also the index buffer).
+            VkMemoryPropertyFlags index_buffer_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            create_buffer(physical_device, device, model_index_buffer_size, index_buffer_usage, index_buffer_memory_properties, index_buffer.buffer, index_buffer.memory);
+            
+            // Copy from staging buffer into device-local memory
+            offset = 0u;
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                // Copy model vertex data
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, model_vertex_buffer.buffer, 0, model_vertex_buffer_size);
+                offset += model_vertex_buffer_size;
+                
+                // Copy model index data
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, index_buffer.buffer, 0, model_index_buffer_size);
+                offset += model_index_buffer_size;
+            submit_transient_command_buffer(command_buffer);
+            
+            // Staging buffer resources are no longer necessary
+            vkFreeMemory(device, staging_buffer.memory, nullptr);
+            vkDestroyBuffer(device, staging_buffer.buffer, nullptr);
+        }
+        
+        void destroy_buffers() {
+            // Destroy geometry buffers
+            vkFreeMemory(device, index_buffer.memory, nullptr);
+            vkDestroyBuffer(device, index_buffer.buffer, nullptr);
+
+            vkFreeMemory(device, model_vertex_buffer.memory, nullptr);
+            vkDestroyBuffer(device, model_vertex_buffer.buffer, nullptr);
+        }
+        
+        void initialize_cloth_buffers() {
+            std::size_t particle_count = (std::size_t) dimension * dimension;
+            
+            std::vector<glm::vec4> cloth_positions(particle_count);
+            std::vector<glm::vec4> cloth_velocities(particle_count, glm::vec4(0.0f));
+            std::vector<glm::vec4> cloth_normals(particle_count, glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+            std::vector<glm::vec2> cloth_uvs(particle_count, glm::vec2(0.0f));
+            
             float dp = (float) size / (float) (dimension - 1);
             
             // Initialize cloth particles
             for (int z = 0; z < dimension; ++z) {
                 for (int x = 0; x < dimension; ++x) {
                     // Center cloth at (0, 0)
-                    cloth_vertices[x + z * dimension].position = glm::vec3(-size / 2.0f + dp * (float) x, 5.0f, (float) -size / 2.0f + dp * (float) z);
-                    cloth_vertices[x + z * dimension].velocity = glm::vec3(0.0f);
-                    cloth_vertices[x + z * dimension].uv = glm::vec2(0.0f);
-                    cloth_vertices[x + z * dimension].normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                    cloth_positions[x + z * dimension] = glm::vec4(-size / 2.0f + dp * (float) x, 5.0f, (float) -size / 2.0f + dp * (float) z, 0.0f);
                 }
             }
             
-            std::size_t cloth_vertex_buffer_size = cloth_vertices.size() * sizeof(Particle);
             unsigned primitive_restart_index = -1;
+            std::vector<unsigned> cloth_indices;
             
             // Order cloth vertex indices in a triangle strip pattern:
             //  1     3     5     7     9     11    13
@@ -1170,69 +1580,72 @@ class DeferredRendering final : public Sample {
                 cloth_indices.emplace_back(primitive_restart_index);
             }
             
+            cloth_index_count = (unsigned) cloth_indices.size();
+            
+            std::size_t particle_buffer_size = particle_count * sizeof(glm::vec4);
+            std::size_t uv_buffer_size = particle_count * sizeof(glm::vec2);
             std::size_t cloth_index_buffer_size = cloth_indices.size() * sizeof(unsigned);
             
+            // Copies of the particle state are bound as storage buffers at offsets that are multiples of the stride
+            std::size_t alignment = physical_device_properties.limits.minStorageBufferOffsetAlignment;
+            particle_buffer_stride = (particle_buffer_size + alignment - 1u) / alignment * alignment;
+            
             Buffer staging_buffer { };
             VkBufferUsageFlags staging_buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
             VkMemoryPropertyFlags staging_buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
             
-            // Use one staging buffer to transfer all data from subranges
-            std::size_t storage_buffer_size = model_vertex_buffer_size + cloth_vertex_buffer_size + model_index_buffer_size + cloth_index_buffer_size;
-            create_buffer(physical_device, device, storage_buffer_size, staging_buffer_usage, staging_buffer_memory_properties, staging_buffer.buffer, staging_buffer.memory);
+            std::size_t staging_buffer_size = 3u * particle_buffer_size + uv_buffer_size + cloth_index_buffer_size;
+            create_buffer(physical_device, device, staging_buffer_size, staging_buffer_usage, staging_buffer_memory_properties, staging_buffer.buffer, staging_buffer.memory);
             
             void* data = nullptr;
             std::size_t offset = 0u;
-            vkMapMemory(device, staging_buffer.memory, 0, storage_buffer_size, 0, &data);
-                // Copy model vertex data
-                memcpy((void*)(((const char*) data) + offset), model.model.vertices.data(), model_vertex_buffer_size);
-                offset += model_vertex_buffer_size;
+            vkMapMemory(device, staging_buffer.memory, 0, staging_buffer_size, 0, &data);
+                memcpy((void*)(((const char*) data) + offset), cloth_positions.data(), particle_buffer_size);
+                offset += particle_buffer_size;
                 
-                // Copy cloth vertex data
-                memcpy((void*)(((const char*) data) + offset), cloth_vertices.data(), cloth_vertex_buffer_size);
-                offset += cloth_vertex_buffer_size;
+                memcpy((void*)(((const char*) data) + offset), cloth_velocities.data(), particle_buffer_size);
+                offset += particle_buffer_size;
                 
-                // Copy model index data
-                memcpy((void*)(((const char*) data) + offset), model.model.indices.data(), model_index_buffer_size);
-                offset += model_index_buffer_size;
+                memcpy((void*)(((const char*) data) + offset), cloth_normals.data(), particle_buffer_size);
+                offset += particle_buffer_size;
+                
+                memcpy((void*)(((const char*) data) + offset), cloth_uvs.data(), uv_buffer_size);
+                offset += uv_buffer_size;
                 
-                // Copy cloth index data
                 memcpy((void*)(((const char*) data) + offset), cloth_indices.data(), cloth_index_buffer_size);
                 offset += cloth_index_buffer_size;
             vkUnmapMemory(device, staging_buffer.memory);
             
-            // Model vertex buffer
-            VkBufferUsageFlags model_vertex_buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-            VkMemoryPropertyFlags model_vertex_buffer_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-            create_buffer(physical_device, device, model_vertex_buffer_size, model_vertex_buffer_usage, model_vertex_buffer_memory_properties, model_vertex_buffer.buffer, model_vertex_buffer.memory);
+            // Storage buffers (positions and normals are also used as vertex buffers for rendering the cloth)
+            // Simulation steps that run no substeps copy between buffers (VK_BUFFER_USAGE_TRANSFER_SRC_BIT), and the initial state is transferred from the staging buffer (VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+            VkBufferUsageFlags storage_buffer_usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            VkMemoryPropertyFlags storage_buffer_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            create_buffer(physical_device, device, particle_buffer_stride * PARTICLE_BUFFER_COUNT, storage_buffer_usage, storage_buffer_memory_properties, positions.buffer, positions.memory);
+            create_buffer(physical_device, device, particle_buffer_stride * PARTICLE_BUFFER_COUNT, storage_buffer_usage, storage_buffer_memory_properties, velocities.buffer, velocities.memory);
+            create_buffer(physical_device, device, particle_buffer_stride * SIMULATION_BUFFER_COUNT, storage_buffer_usage, storage_buffer_memory_properties, normals.buffer, normals.memory);
             
-            // Index buffer (for both the main model and cloth)
-            VkBufferUsageFlags index_buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT; // This buffer is the destination buffer in a memory transfer operation (and also the index buffer).
-            VkMemoryPropertyFlags index_buffer_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-            create_buffer(physical_device, device, model_index_buffer_size + cloth_index_buffer_size, index_buffer_usage, index_buffer_memory_properties, index_buffer.buffer, index_buffer.memory);
+            create_buffer(physical_device, device, uv_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, uvs.buffer, uvs.memory);
+            create_buffer(physical_device, device, cloth_index_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cloth_index_buffer.buffer, cloth_index_buffer.memory);
             
-            // Storage buffer (also used as vertex buffer for rendering the cloth)
-            // Buffers are used as storage buffers (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT), inputs to the vertex shader (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT), and a destination for transfer operations (VK_BUFFER_USAGE_TRANSFER_DST_BIT) for transferring cloth particle data from the staging buffer
-            VkBufferUsageFlags storage_buffer_usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-            VkMemoryPropertyFlags storage_buffer_memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-            create_buffer(physical_device, device, cloth_vertex_buffer_size * 2, storage_buffer_usage, storage_buffer_memory_properties, ssbo.buffer, ssbo.memory);
+            // The initial state is written to the buffer of the most recent simulation step, which is read by the next one
+            std::size_t state_offset = (simulation_step % SIMULATION_BUFFER_COUNT) * particle_buffer_stride;
             
             // Copy from staging buffer into device-local memory
             offset = 0u;
             VkCommandBuffer command_buffer = begin_transient_command_buffer();
-                // Copy model vertex data
-                copy_buffer(command_buffer, staging_buffer.buffer, offset, model_vertex_buffer.buffer, 0, model_vertex_buffer_size);
-                offset += model_vertex_buffer_size;
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, positions.buffer, state_offset, particle_buffer_size);
+                offset += particle_buffer_size;
                 
-                // Copy cloth vertex data
-                copy_buffer(command_buffer, staging_buffer.buffer, offset, ssbo.buffer, 0, cloth_vertex_buffer_size);
-                offset += cloth_vertex_buffer_size;
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, velocities.buffer, state_offset, particle_buffer_size);
+                offset += particle_buffer_size;
                 
-                // Copy model index data
-                copy_buffer(command_buffer, staging_buffer.buffer, offset, index_buffer.buffer, 0, model_index_buffer_size);
-                offset += model_index_buffer_size;
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, normals.buffer, state_offset, particle_buffer_size);
+                offset += particle_buffer_size;
                 
-                // Copy cloth index data
-                copy_buffer(command_buffer, staging_buffer.buffer, offset, index_buffer.buffer, model_index_buffer_size, cloth_index_buffer_size);
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, uvs.buffer, 0, uv_buffer_size);
+                offset += uv_buffer_size;
+                
+                copy_buffer(command_buffer, staging_buffer.buffer, offset, cloth_index_buffer.buffer, 0, cloth_index_buffer_size);
                 offset += cloth_index_buffer_size;
             submit_transient_command_buffer(command_buffer);
             
@@ -1241,17 +1654,464 @@ class DeferredRendering final : public Sample {
             vkDestroyBuffer(device, staging_buffer.buffer, nullptr);
         }
         
-        void destroy_buffers() {
-            // Destroy geometry buffers
-            vkFreeMemory(device, index_buffer.memory, nullptr);
-            vkDestroyBuffer(device, index_buffer.buffer, nullptr);
-
-            vkFreeMemory(device, model_vertex_buffer.memory, nullptr);
-            vkDestroyBuffer(device, model_vertex_buffer.buffer, nullptr);
+        void destroy_cloth_buffers() {
+            Buffer* buffers[] = { &positions, &velocities, &normals, &uvs, &cloth_index_buffer };
+            for (Buffer* buffer : buffers) {
+                vkFreeMemory(device, buffer->memory, nullptr);
+                vkDestroyBuffer(device, buffer->buffer, nullptr);
+            }
+        }
+        
+        void set_dimension(int value) {
+            // Cloth buffers are in use by the simulation steps and frames in flight
+            vkDeviceWaitIdle(device);
             
-            // Destroy shader storage buffer
-            vkFreeMemory(device, ssbo.memory, nullptr);
-            vkDestroyBuffer(device, ssbo.buffer, nullptr);
+            destroy_cloth_buffers();
+            dimension = value;
+            initialize_cloth_buffers();
+            write_compute_descriptor_sets();
+            
+            // Time that passed while the buffers were recreated is not simulated, and timings recorded before the change are discarded
+            accumulated_time = 0.0;
+            std::fill(simulation_substeps.begin(), simulation_substeps.end(), 0u);
+        }
+        
+        void initialize_sdf() {
+            // Object-space bounds of the model
+            glm::vec3 minimum(std::numeric_limits<float>::max());
+            glm::vec3 maximum(std::numeric_limits<float>::lowest());
+            for (const Model::Vertex& vertex : model.model.vertices) {
+                minimum = glm::min(minimum, vertex.position);
+                maximum = glm::max(maximum, vertex.position);
+            }
+            
+            // The volume is a cube so that voxels are cubes, and the gradient of the distance field is computed with the same step along every axis
+            glm::vec3 extents = maximum - minimum;
+            sdf_size = std::max({ extents.x, extents.y, extents.z }) * (1.0f + 2.0f * SDF_PADDING);
+            sdf_origin = (minimum + maximum) / 2.0f - glm::vec3(sdf_size / 2.0f);
+            
+            VkImageCreateInfo image_create_info { };
+            image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_create_info.imageType = VK_IMAGE_TYPE_3D;
+            image_create_info.format = VK_FORMAT_R32_SFLOAT;
+            image_create_info.extent = { SDF_RESOLUTION, SDF_RESOLUTION, SDF_RESOLUTION };
+            image_create_info.mipLevels = 1;
+            image_create_info.arrayLayers = 1;
+            image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            // Written by the voxelization pass or uploaded from the cache, read back when saved to the cache
+            image_create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (vkCreateImage(device, &image_create_info, nullptr, &sdf.image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create SDF image!");
+            }
+            
+            VkMemoryRequirements memory_requirements { };
+            vkGetImageMemoryRequirements(device, sdf.image, &memory_requirements);
+            
+            VkMemoryAllocateInfo memory_allocate_info { };
+            memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            memory_allocate_info.allocationSize = memory_requirements.size;
+            memory_allocate_info.memoryTypeIndex = get_memory_type_index(physical_device, memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (vkAllocateMemory(device, &memory_allocate_info, nullptr, &sdf.memory) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate memory for SDF image!");
+            }
+            
+            vkBindImageMemory(device, sdf.image, sdf.memory, 0);
+            create_image_view(device, sdf.image, VK_IMAGE_VIEW_TYPE_3D, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 1, sdf.view);
+            
+            std::uint64_t key = compute_sdf_cache_key();
+            if (!load_sdf(key)) {
+                bake_sdf();
+                save_sdf(key);
+            }
+        }
+        
+        void destroy_sdf() {
+            vkDestroyImageView(device, sdf.view, nullptr);
+            vkDestroyImage(device, sdf.image, nullptr);
+            vkFreeMemory(device, sdf.memory, nullptr);
+        }
+        
+        std::string get_sdf_cache_name() const {
+            // One cache entry per model
+            return "sdf_" + std::filesystem::path(MODELS[model_index]).stem().string();
+        }
+        
+        std::uint64_t compute_sdf_cache_key() {
+            // Incremented whenever the voxelization process changes in a way that is not captured by the parameters or shader below (including how models are loaded)
+            const unsigned SDF_CACHE_VERSION = 1u;
+            
+            std::uint64_t key = TextureCache::hash_file(MODELS[model_index]);
+            
+            unsigned parameters[] = { SDF_CACHE_VERSION, SDF_RESOLUTION, (unsigned) VK_FORMAT_R32_SFLOAT };
+            key = TextureCache::hash(parameters, sizeof(parameters), key);
+            key = TextureCache::hash(&SDF_PADDING, sizeof(SDF_PADDING), key);
+            
+            return TextureCache::hash_file("shaders/sdf.comp", key);
+        }
+        
+        bool load_sdf(std::uint64_t key) {
+            CachedTexture cached { };
+            if (!sdf_cache.load(get_sdf_cache_name().c_str(), key, cached) || cached.format != (unsigned) VK_FORMAT_R32_SFLOAT || cached.width != SDF_RESOLUTION || cached.height != SDF_RESOLUTION || cached.layers != SDF_RESOLUTION || cached.levels != 1u) {
+                std::cout << "SDF cache entry for '" << MODELS[model_index] << "' is missing or out of date" << std::endl;
+                return false;
+            }
+            
+            Buffer staging_buffer { };
+            create_buffer(physical_device, device, cached.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer.buffer, staging_buffer.memory);
+            
+            void* data;
+            vkMapMemory(device, staging_buffer.memory, 0, cached.data.size(), 0, &data);
+                memcpy(data, cached.data.data(), cached.data.size());
+            vkUnmapMemory(device, staging_buffer.memory);
+            
+            // Depth slices are tightly packed, one after another
+            VkBufferImageCopy region { };
+            region.bufferOffset = 0u;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageOffset = { 0, 0, 0 };
+            region.imageExtent = { SDF_RESOLUTION, SDF_RESOLUTION, SDF_RESOLUTION };
+            
+            VkImageSubresourceRange subresource_range { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                transition_image(command_buffer, sdf.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                vkCmdCopyBufferToImage(command_buffer, staging_buffer.buffer, sdf.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+                transition_image(command_buffer, sdf.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            submit_transient_command_buffer(command_buffer);
+            
+            vkFreeMemory(device, staging_buffer.memory, nullptr);
+            vkDestroyBuffer(device, staging_buffer.buffer, nullptr);
+            return true;
+        }
+        
+        void save_sdf(std::uint64_t key) {
+            CachedTexture cached { };
+            cached.format = (unsigned) VK_FORMAT_R32_SFLOAT;
+            cached.width = SDF_RESOLUTION;
+            cached.height = SDF_RESOLUTION;
+            cached.layers = SDF_RESOLUTION;
+            cached.levels = 1u;
+            cached.texel_size = sizeof(float);
+            cached.data.resize(cached.get_size());
+            
+            Buffer staging_buffer { };
+            create_buffer(physical_device, device, cached.data.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer.buffer, staging_buffer.memory);
+            
+            VkBufferImageCopy region { };
+            region.bufferOffset = 0u;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageOffset = { 0, 0, 0 };
+            region.imageExtent = { SDF_RESOLUTION, SDF_RESOLUTION, SDF_RESOLUTION };
+            
+            VkImageSubresourceRange subresource_range { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                transition_image(command_buffer, sdf.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                vkCmdCopyImageToBuffer(command_buffer, sdf.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging_buffer.buffer, 1, &region);
+                transition_image(command_buffer, sdf.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            submit_transient_command_buffer(command_buffer);
+            
+            void* data;
+            vkMapMemory(device, staging_buffer.memory, 0, cached.data.size(), 0, &data);
+                memcpy(cached.data.data(), data, cached.data.size());
+            vkUnmapMemory(device, staging_buffer.memory);
+            
+            vkFreeMemory(device, staging_buffer.memory, nullptr);
+            vkDestroyBuffer(device, staging_buffer.buffer, nullptr);
+            
+            // Failing to write to the cache is not an error, the model is voxelized again during the next run
+            if (!sdf_cache.save(get_sdf_cache_name().c_str(), key, cached)) {
+                std::cout << "failed to write SDF cache entry for '" << MODELS[model_index] << "'" << std::endl;
+            }
+        }
+        
+        void bake_sdf() {
+            std::cout << "voxelizing '" << MODELS[model_index] << "' into a " << SDF_RESOLUTION << "^3 SDF" << std::endl;
+            auto start = std::chrono::high_resolution_clock::now();
+            
+            // Positions are padded to glm::vec4 (arrays of vec3 have a stride of 16 bytes in std430)
+            std::vector<glm::vec4> vertex_positions;
+            vertex_positions.reserve(model.model.vertices.size());
+            for (const Model::Vertex& vertex : model.model.vertices) {
+                vertex_positions.emplace_back(vertex.position, 1.0f);
+            }
+            
+            const std::vector<unsigned>& indices = model.model.indices;
+            std::size_t positions_size = vertex_positions.size() * sizeof(glm::vec4);
+            std::size_t indices_size = indices.size() * sizeof(unsigned);
+            
+            // Mesh data is only read while baking, so it is not copied into device local memory
+            Buffer positions_buffer { };
+            Buffer indices_buffer { };
+            create_buffer(physical_device, device, positions_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, positions_buffer.buffer, positions_buffer.memory);
+            create_buffer(physical_device, device, indices_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indices_buffer.buffer, indices_buffer.memory);
+            
+            void* data;
+            vkMapMemory(device, positions_buffer.memory, 0, positions_size, 0, &data);
+                memcpy(data, vertex_positions.data(), positions_size);
+            vkUnmapMemory(device, positions_buffer.memory);
+            
+            vkMapMemory(device, indices_buffer.memory, 0, indices_size, 0, &data);
+                memcpy(data, indices.data(), indices_size);
+            vkUnmapMemory(device, indices_buffer.memory);
+            
+            // Descriptor set layout, descriptor set, and pipeline are only used while baking
+            VkDescriptorSetLayoutBinding bindings[] = {
+                // Binding 0 contains vertex positions
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+                // Binding 1 contains triangle indices
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+                // Binding 2 contains the output SDF
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+            };
+            
+            VkDescriptorSetLayoutCreateInfo layout_create_info { };
+            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+            layout_create_info.pBindings = bindings;
+            
+            VkDescriptorSetLayout descriptor_set_layout { };
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate SDF descriptor set layout!");
+            }
+            
+            VkDescriptorSetAllocateInfo set_allocate_info { };
+            set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            set_allocate_info.descriptorPool = descriptor_pool;
+            set_allocate_info.descriptorSetCount = 1;
+            set_allocate_info.pSetLayouts = &descriptor_set_layout;
+            
+            VkDescriptorSet descriptor_set { };
+            if (vkAllocateDescriptorSets(device, &set_allocate_info, &descriptor_set) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate SDF descriptor set!");
+            }
+            
+            VkDescriptorBufferInfo buffer_infos[2] { };
+            buffer_infos[0] = { positions_buffer.buffer, 0u, positions_size };
+            buffer_infos[1] = { indices_buffer.buffer, 0u, indices_size };
+            
+            VkDescriptorImageInfo image_info { };
+            image_info.imageView = sdf.view;
+            image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            
+            VkWriteDescriptorSet descriptor_writes[3] { };
+            for (unsigned binding = 0u; binding < 3u; ++binding) {
+                descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_writes[binding].dstSet = descriptor_set;
+                descriptor_writes[binding].dstBinding = binding;
+                descriptor_writes[binding].dstArrayElement = 0;
+                descriptor_writes[binding].descriptorCount = 1;
+            }
+            
+            descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptor_writes[0].pBufferInfo = &buffer_infos[0];
+            descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptor_writes[1].pBufferInfo = &buffer_infos[1];
+            descriptor_writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptor_writes[2].pImageInfo = &image_info;
+            
+            vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+            
+            struct PushConstants {
+                glm::vec4 origin;
+                float size;
+                unsigned triangle_count;
+                unsigned slice_offset;
+            };
+            
+            VkPushConstantRange push_constant_range { };
+            push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            push_constant_range.offset = 0u;
+            push_constant_range.size = sizeof(PushConstants);
+            
+            VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
+            pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_create_info.setLayoutCount = 1;
+            pipeline_layout_create_info.pSetLayouts = &descriptor_set_layout;
+            pipeline_layout_create_info.pushConstantRangeCount = 1;
+            pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+            
+            VkPipelineLayout pipeline_layout { };
+            if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create SDF pipeline layout!");
+            }
+            
+            VkComputePipelineCreateInfo pipeline_create_info { };
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipeline_create_info.layout = pipeline_layout;
+            
+            VkShaderModule shader_module = create_shader_module(device, "shaders/sdf.comp");
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
+            
+            VkPipeline pipeline { };
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create SDF pipeline!");
+            }
+            
+            vkDestroyShaderModule(device, shader_module, nullptr);
+            
+            PushConstants push_constants { };
+            push_constants.origin = glm::vec4(sdf_origin, 0.0f);
+            push_constants.size = sdf_size;
+            push_constants.triangle_count = (unsigned) (indices.size() / 3u);
+            
+            VkImageSubresourceRange subresource_range { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            
+            // Each invocation group runs 4x4x4
+            unsigned workgroup_count = SDF_RESOLUTION / 4u;
+            
+            for (unsigned slice = 0u; slice < SDF_RESOLUTION; slice += SDF_SLICES_PER_DISPATCH) {
+                push_constants.slice_offset = slice;
+                
+                // Transient command buffers are waited on after submission, slabs do not need to be synchronized with each other (they write disjoint voxels)
+                VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                    if (slice == 0u) {
+                        transition_image(command_buffer, sdf.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                    }
+                    
+                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+                    vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push_constants);
+                    vkCmdDispatch(command_buffer, workgroup_count, workgroup_count, SDF_SLICES_PER_DISPATCH / 4u);
+                    
+                    if (slice + SDF_SLICES_PER_DISPATCH == SDF_RESOLUTION) {
+                        transition_image(command_buffer, sdf.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                    }
+                submit_transient_command_buffer(command_buffer);
+            }
+            
+            vkDestroyPipeline(device, pipeline, nullptr);
+            vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+            vkFreeDescriptorSets(device, descriptor_pool, 1, &descriptor_set);
+            vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+            
+            vkFreeMemory(device, indices_buffer.memory, nullptr);
+            vkDestroyBuffer(device, indices_buffer.buffer, nullptr);
+            vkFreeMemory(device, positions_buffer.memory, nullptr);
+            vkDestroyBuffer(device, positions_buffer.buffer, nullptr);
+            
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << "done (" << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
+        }
+        
+        void set_model(unsigned index) {
+            // Model buffers and the SDF are in use by the simulation steps and frames in flight
+            vkDeviceWaitIdle(device);
+            
+            destroy_buffers();
+            destroy_sdf();
+            model_index = index;
+            initialize_geometry_buffers();
+            initialize_sdf();
+            
+            // Drop the cloth onto the new model, which also updates the compute descriptor sets that reference the SDF
+            set_dimension(dimension);
+        }
+        
+        void set_solver(Solver value) {
+            solver = value;
+            timestep = SOLVER_TIMESTEPS[solver];
+            
+            // Time accumulated for the previous solver carries over into substeps of the new timestep
+            std::cout << (solver == Springs ? "spring solver" : "XPBD solver") << " (timestep: " << timestep << "s)" << std::endl;
+        }
+        
+        void initialize_query_pool() {
+            simulation_substeps.assign(NUM_FRAMES_IN_FLIGHT, 0u);
+            
+            // Timestamps must be supported on all graphics and compute queues
+            timestamps_supported = physical_device_properties.limits.timestampComputeAndGraphics == VK_TRUE;
+            if (!timestamps_supported) {
+                std::cout << "timestamp queries are not supported, GPU timings are not available" << std::endl;
+                return;
+            }
+            
+            VkQueryPoolCreateInfo query_pool_create_info { };
+            query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_create_info.queryCount = 2u * NUM_FRAMES_IN_FLIGHT;
+            if (vkCreateQueryPool(device, &query_pool_create_info, nullptr, &query_pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create query pool!");
+            }
+        }
+        
+        void destroy_query_pool() {
+            if (timestamps_supported) {
+                vkDestroyQueryPool(device, query_pool, nullptr);
+            }
+        }
+        
+        // Reads back the timestamps of a simulation command buffer that has finished executing
+        void update_timings(unsigned index) {
+            unsigned substeps = simulation_substeps[index];
+            if (!timestamps_supported || substeps == 0u) {
+                return;
+            }
+            
+            std::uint64_t timestamps[2] { };
+            if (vkGetQueryPoolResults(device, query_pool, index * 2u, 2u, sizeof(timestamps), timestamps, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+                return;
+            }
+            
+            // Timestamps are in units of timestampPeriod nanoseconds
+            double period = (double) physical_device_properties.limits.timestampPeriod / 1e6;
+            double time = (double) (timestamps[1] - timestamps[0]) * period;
+            
+            if (benchmark.running && benchmark.frame < BENCHMARK_WARMUP_STEPS + BENCHMARK_MEASURED_STEPS) {
+                if (benchmark.frame++ >= BENCHMARK_WARMUP_STEPS) {
+                    benchmark.time += time;
+                    benchmark.substeps += substeps;
+                }
+            }
+        }
+        
+        void start_benchmark() {
+            if (!timestamps_supported) {
+                std::cout << "benchmark requires timestamp queries" << std::endl;
+                return;
+            }
+            
+            benchmark.running = true;
+            benchmark.step = 0u;
+            benchmark.frame = 0u;
+            benchmark.time = 0.0;
+            benchmark.substeps = 0u;
+            benchmark.dimension = dimension;
+            
+            std::cout << (solver == Springs ? "spring solver" : "XPBD solver") << std::endl;
+            std::cout << std::setw(12) << "dimension" << std::setw(12) << "particles" << std::setw(18) << "substep (ms)" << std::setw(18) << "particles / ms" << std::endl;
+            
+            set_dimension(CLOTH_DIMENSIONS[0]);
+        }
+        
+        // Called once all steps of the current dimension have been measured
+        void update_benchmark() {
+            // Substep times include the normal pass, amortized over the substeps of a simulation step
+            int value = CLOTH_DIMENSIONS[benchmark.step];
+            double particle_count = (double) value * (double) value;
+            double substep_time = benchmark.time / (double) benchmark.substeps;
+            
+            std::cout << std::fixed << std::setprecision(3) << std::setw(12) << value << std::setw(12) << value * value << std::setw(18) << substep_time << std::setw(18) << std::setprecision(0) << particle_count / substep_time << std::endl;
+            
+            benchmark.frame = 0u;
+            benchmark.time = 0.0;
+            benchmark.substeps = 0u;
+            
+            if (++benchmark.step == sizeof(CLOTH_DIMENSIONS) / sizeof(CLOTH_DIMENSIONS[0])) {
+                // Restore the configuration from before the benchmark
+                benchmark.running = false;
+                set_dimension(benchmark.dimension);
+                return;
+            }
+            
+            set_dimension(CLOTH_DIMENSIONS[benchmark.step]);
         }
         
         void initialize_samplers() {
@@ -1327,9 +2187,33 @@ class DeferredRendering final : public Sample {
             if (vkCreateSampler(device, &texture_sampler_create_info, nullptr, &sampler) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create texture sampler!");
             }
+            
+            // Distances are interpolated between voxels, and clamped at the edges of the volume covered by the SDF
+            VkSamplerCreateInfo sdf_sampler_create_info { };
+            sdf_sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            sdf_sampler_create_info.magFilter = VK_FILTER_LINEAR;
+            sdf_sampler_create_info.minFilter = VK_FILTER_LINEAR;
+            sdf_sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            sdf_sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            sdf_sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            sdf_sampler_create_info.anisotropyEnable = VK_FALSE;
+            sdf_sampler_create_info.maxAnisotropy = 1.0f;
+            sdf_sampler_create_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+            sdf_sampler_create_info.unnormalizedCoordinates = VK_FALSE;
+            sdf_sampler_create_info.compareEnable = VK_FALSE;
+            sdf_sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
+            sdf_sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST; // SDF has one mipmap level
+            sdf_sampler_create_info.mipLodBias = 0.0f;
+            sdf_sampler_create_info.minLod = 0.0f;
+            sdf_sampler_create_info.maxLod = 0.0f;
+            
+            if (vkCreateSampler(device, &sdf_sampler_create_info, nullptr, &sdf_sampler) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create SDF sampler!");
+            }
         }
         
         void destroy_samplers() {
+            vkDestroySampler(device, sdf_sampler, nullptr);
             vkDestroySampler(device, sampler, nullptr);
         }
         
@@ -1351,16 +2235,23 @@ class DeferredRendering final : public Sample {
             std::size_t offset = 0u;
             
             SimulationUniforms simulation_uniforms { };
-            simulation_uniforms.dt = 0.01f;
+            simulation_uniforms.dt = timestep;
             simulation_uniforms.particle_mass = 0.6f;
             simulation_uniforms.spring_length = size / (float) (dimension - 1);
             simulation_uniforms.spring_length_diagonal = std::sqrt(simulation_uniforms.spring_length * simulation_uniforms.spring_length + simulation_uniforms.spring_length * simulation_uniforms.spring_length);
             simulation_uniforms.gravity = glm::vec3(0.0f, -0.1f, 0.0f);
             simulation_uniforms.spring_stiffness = 300.0f;
-            simulation_uniforms.sphere_position = model.transform.get_position();
-            simulation_uniforms.sphere_radius = model.transform.get_scale().x; // Assume the same in all 3 directions
+            
+            // World space is transformed into the object space of the model, then into texture coordinates of the SDF
+            glm::mat4 object_to_sdf = glm::scale(glm::vec3(1.0f / sdf_size)) * glm::translate(-sdf_origin);
+            simulation_uniforms.world_to_sdf = object_to_sdf * glm::inverse(model.transform.get_matrix());
+            simulation_uniforms.sdf_scale = model.transform.get_scale().x; // Assume the same in all 3 directions
+            simulation_uniforms.sdf_voxel_size = sdf_size * simulation_uniforms.sdf_scale / (float) SDF_RESOLUTION;
+            
             simulation_uniforms.dampening = 0.1f;
             simulation_uniforms.dimension = dimension;
+            simulation_uniforms.compliance = 1.0e-6f; // Nearly inextensible
+            simulation_uniforms.bending_compliance = 1.0e-3f;
             
             memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &simulation_uniforms, sizeof(SimulationUniforms));
             offset += align_to_device_boundary(physical_device, sizeof(SimulationUniforms));
@@ -1415,6 +2306,21 @@ class DeferredRendering final : public Sample {
             if (key == GLFW_KEY_F) {
                 take_screenshot(swapchain_images[frame_index], surface_format.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, "compute_cloth.ppm"); // Output attachment
             }
+            else if (key == GLFW_KEY_B) {
+                if (!benchmark.running) {
+                    start_benchmark();
+                }
+            }
+            else if (key == GLFW_KEY_M) {
+                if (!benchmark.running) {
+                    set_model((model_index + 1u) % (sizeof(MODELS) / sizeof(MODELS[0])));
+                }
+            }
+            else if (key == GLFW_KEY_X) {
+                if (!benchmark.running) {
+                    set_solver(solver == Springs ? XPBD : Springs);
+                }
+            }
         }
         
 };
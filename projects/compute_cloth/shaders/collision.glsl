@@ -0,0 +1,43 @@
+// Shared between the cloth solvers
+// Collisions are resolved against a signed distance field (SDF) of the model, voxelized once when the model is loaded (shaders/sdf.comp)
+// Every query is a constant number of texture samples, independent of the number of triangles of the model
+
+#ifndef COLLISION_GLSL
+#define COLLISION_GLSL
+
+// Particles are kept slightly offset past the surface of the model to prevent z fighting
+const float COLLISION_OFFSET = 0.01f;
+
+// 'world_to_sdf' transforms world-space positions into texture coordinates of the SDF, 'scale' converts distances stored in the SDF (in object space) to world space
+float sample_sdf(sampler3D distance_field, mat4 world_to_sdf, float scale, vec3 position) {
+    return texture(distance_field, (world_to_sdf * vec4(position, 1.0f)).xyz).r * scale;
+}
+
+// Particles closer to the surface of the model than COLLISION_OFFSET are moved onto the offset surface and stop moving
+// 'voxel_size' is the world-space size of one voxel of the SDF
+void resolve_collision(sampler3D distance_field, mat4 world_to_sdf, float scale, float voxel_size, inout vec3 position, inout vec3 velocity) {
+    vec3 uvw = (world_to_sdf * vec4(position, 1.0f)).xyz;
+    if (any(lessThan(uvw, vec3(0.0f))) || any(greaterThan(uvw, vec3(1.0f)))) {
+        // Particle is outside of the volume covered by the SDF, and therefore far away from the model
+        return;
+    }
+
+    float signed_distance = texture(distance_field, uvw).r * scale;
+    if (signed_distance >= COLLISION_OFFSET) {
+        return;
+    }
+
+    // The direction to the closest point on the surface is the gradient of the distance field (central differences, one voxel apart)
+    vec2 h = vec2(voxel_size, 0.0f);
+    vec3 gradient = vec3(sample_sdf(distance_field, world_to_sdf, scale, position + h.xyy) - sample_sdf(distance_field, world_to_sdf, scale, position - h.xyy),
+                         sample_sdf(distance_field, world_to_sdf, scale, position + h.yxy) - sample_sdf(distance_field, world_to_sdf, scale, position - h.yxy),
+                         sample_sdf(distance_field, world_to_sdf, scale, position + h.yyx) - sample_sdf(distance_field, world_to_sdf, scale, position - h.yyx));
+    if (dot(gradient, gradient) < 1e-12f) {
+        return;
+    }
+
+    position += normalize(gradient) * (COLLISION_OFFSET - signed_distance);
+    velocity = vec3(0.0f);
+}
+
+#endif // COLLISION_GLSL
@@ -2,17 +2,45 @@
 #include "sample.hpp"
 #include "helpers.hpp"
 #include "vulkan_initializers.hpp"
+#include "frustum_culling.hpp"
+#include "render_graph.hpp"
+#include "geometry_buffer.hpp"
 #include "loaders/obj.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
+#include <memory> // std::unique_ptr
+#include <random>
+#include <string> // std::to_string
+#include <iomanip> // std::setw, std::setprecision
+#include <cmath> // std::log, std::cbrt
+#include <algorithm> // std::fill
 
 class DeferredRendering final : public Sample {
     public:
         DeferredRendering() : Sample("Deferred Rendering") {
             debug_view = OUTPUT;
+            
+            // Geometry and lighting passes are merged into one render pass, reading the geometry buffer through input attachments (toggled with 'M')
+            single_pass = true;
+            
             camera.set_position(glm::vec3(0, 2, 6));
             camera.set_look_direction(glm::vec3(0.0f, 0.25f, -1.0f));
+            
+            // Draw calls for the geometry pass are recorded in parallel into secondary command buffers
+            worker_thread_count = 4;
+
+            // The scene only has 6 objects, which the default minimum (32) would record into a single secondary command buffer
+            // Splitting into chunks of 2 spreads recording over 3 worker threads, the cost of executing the extra secondary command buffers is negligible at this scale
+            minimum_secondary_command_buffer_size = 2u;
+
+            // Lights are culled per cluster in a compute pass before shading (toggled with 'C')
+            // Culling is dispatched on the graphics queue, which must therefore also support compute
+            enabled_queue_types |= VK_QUEUE_COMPUTE_BIT;
+            clustered = true;
+            light_count = LIGHT_COUNTS[0];
+            
+            benchmark.running = false;
         }
         
         ~DeferredRendering() override {
@@ -40,6 +68,12 @@ class DeferredRendering final : public Sample {
             std::vector<Object> objects;
         } scene;
         
+        // Model-space bounds of each model, used to (re)compute the world-space bounding volumes of the objects that reference it
+        std::vector<std::pair<glm::vec3, glm::vec3>> model_bounds;
+        
+        FrustumCuller culler;
+        std::vector<unsigned> visible_objects; // Indices into scene.objects that intersect the camera frustum this frame
+        
         int debug_view;
         
         VkBuffer vertex_buffer;
@@ -48,13 +82,7 @@ class DeferredRendering final : public Sample {
         VkBuffer index_buffer;
         VkDeviceMemory index_buffer_memory;
         
-        struct FramebufferAttachment {
-            VkImage image;
-            VkDeviceMemory memory;
-            VkImageView image_view;
-            VkFormat format;
-        };
-        
+        // Debug views (settings.view in shaders/composition.frag)
         int OUTPUT = -1;
         
         int POSITION = 0;
@@ -63,14 +91,28 @@ class DeferredRendering final : public Sample {
         int DIFFUSE = 3;
         int SPECULAR = 4;
         int DEPTH = 5;
-        std::array<FramebufferAttachment, 6> offscreen_framebuffer_attachments;
-        VkFramebuffer offscreen_framebuffer;
+        
+        // Geometry buffer attachments (see geometry_buffer.hpp)
+        // Positions are reconstructed from depth, and ambient / specular terms are looked up from a table of materials
+        int NORMAL_ATTACHMENT = 0;
+        int MATERIAL_ATTACHMENT = 1;
+        int DEPTH_ATTACHMENT = 2;
+        
+        // Deferred shading can be done in two ways:
+        //   - multi pass: the geometry buffer is written to memory in one render pass, and sampled as textures in a second render pass for lighting
+        //   - single pass: geometry and lighting are two subpasses of the same render pass, and lighting reads the geometry buffer through input attachments (subpassInput) at the same pixel
+        //     Geometry buffer attachments are never stored (transient), so on tile-based GPUs they remain in tile memory and never consume memory bandwidth
+        bool single_pass;
+        
+        std::unique_ptr<RenderGraph> render_graph;
+        RenderGraph::Resource swapchain_image;
+        
+        std::array<RenderGraph::Resource, 3> geometry_buffer;
+        RenderGraph::Pass offscreen_pass;
         
         VkPipeline offscreen_pipeline;
         VkPipelineLayout offscreen_pipeline_layout;
         
-        VkRenderPass offscreen_render_pass;
-        
         // Descriptor sets
         VkDescriptorSetLayout offscreen_global_layout;
         VkDescriptorSet offscreen_global;
@@ -78,13 +120,8 @@ class DeferredRendering final : public Sample {
         VkDescriptorSetLayout offscreen_object_layout;
         std::vector<VkDescriptorSet> offscreen_objects;
         
-        // Used to synchronize between rendering the geometry buffer and rendering the final scene
-        VkSemaphore is_offscreen_rendering_complete;
-        
-        std::vector<VkCommandBuffer> offscreen_command_buffers;
-        
         // Composition
-        VkRenderPass composition_render_pass;
+        RenderGraph::Pass composition_pass;
         
         VkPipeline composition_pipeline;
         VkPipelineLayout composition_pipeline_layout;
@@ -99,30 +136,116 @@ class DeferredRendering final : public Sample {
         
         VkSampler sampler;
         
-        void initialize_resources() override {
-            VkSemaphoreCreateInfo semaphore_create_info { };
-            semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-            if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &is_offscreen_rendering_complete) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create semaphore (offscreen)");
-            }
+        // Clustered lighting
+        // The view frustum is subdivided into a grid of clusters (froxels): screen space tiles, split into slices that are exponentially distributed along the view axis
+        // A compute pass bins every light into the clusters its volume intersects, and the composition pass only shades the lights of the cluster a pixel falls into
+        // This makes the cost of shading a pixel proportional to the number of lights that can actually affect it, rather than the total number of lights in the scene
+        static constexpr unsigned CLUSTER_COUNT_X = 16u;
+        static constexpr unsigned CLUSTER_COUNT_Y = 9u;
+        static constexpr unsigned CLUSTER_COUNT_Z = 24u;
+        static constexpr unsigned CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+        
+        // Every cluster has a fixed number of slots for light indices, lights past this limit are dropped
+        static constexpr unsigned MAX_LIGHTS_PER_CLUSTER = 128u;
+        
+        // Light counts the sample can be switched between with 'L' (also the light counts measured by the benchmark)
+        static constexpr unsigned LIGHT_COUNTS[] = { 32u, 64u, 128u, 256u, 512u, 1024u, 2048u, 4096u, 8192u, 10000u };
+        static constexpr unsigned MAX_LIGHTS = 10000u;
+        
+        // Matches the layout of Light in shaders/light_culling.comp and shaders/composition.frag (std430)
+        struct Light {
+            glm::vec3 position; // World space
+            float radius;
+            glm::vec3 color;
+            int type; // 0 - point, 1 - spot
+            glm::vec3 direction; // World space
+            float outer; // Cosine of the outer cone angle
+            float inner; // Cosine of the inner cone angle
+            float padding[3];
+        };
+        
+        // Matches ClusterUniforms in shaders/light_culling.comp and shaders/composition.frag (std140)
+        struct ClusterData {
+            glm::mat4 view;
+            glm::mat4 inverse_projection;
+            glm::vec2 tile_size;
+            float z_scale;
+            float z_bias;
+            float near;
+            float far;
+            unsigned light_count;
+            int clustered;
+        };
+        
+        bool clustered;
+        unsigned light_count;
+        
+        VkBuffer light_buffer; // Host visible, lights are only written when the light count changes
+        VkDeviceMemory light_buffer_memory;
+        void* light_buffer_mapped;
+        
+        VkBuffer cluster_buffer; // Per-cluster light counts, followed by the per-cluster light index lists
+        VkDeviceMemory cluster_buffer_memory;
+        
+        RenderGraph::Pass light_culling_pass;
+        
+        VkPipeline light_culling_pipeline;
+        VkPipelineLayout light_culling_pipeline_layout;
+        
+        VkDescriptorSetLayout light_culling_layout;
+        VkDescriptorSet light_culling_global;
+        
+        // GPU timings (light culling, entire frame) are measured with timestamp queries, 3 per frame in flight
+        bool timestamps_supported;
+        VkQueryPool query_pool;
+        std::vector<bool> timestamps_written; // Per frame in flight, queries are only read back once they have been written
+        
+        // Benchmark mode (started with 'B') scales the light count from 32 to 10k and reports average GPU frame times
+        // Every light count is measured with clustered shading, and then with brute force shading (up to BRUTE_FORCE_LIGHT_LIMIT lights, past which it gets too slow to be useful)
+        static constexpr unsigned BENCHMARK_WARMUP_FRAMES = 16u;
+        static constexpr unsigned BENCHMARK_MEASURED_FRAMES = 64u;
+        static constexpr unsigned BRUTE_FORCE_LIGHT_LIMIT = 2048u;
+        
+        struct Benchmark {
+            bool running;
+            unsigned step; // Index into LIGHT_COUNTS
+            unsigned frame;
             
-            initialize_samplers();
+            // Accumulated over the measured frames (in milliseconds)
+            double culling_time;
+            double frame_time;
+            
+            // Results of the clustered run of the current step
+            double clustered_culling_time;
+            double clustered_frame_time;
             
-            initialize_command_buffer();
+            // Restored once the benchmark completes
+            unsigned light_count;
+            bool clustered;
+        } benchmark;
+        
+        void initialize_resources() override {
+            initialize_samplers();
             
-            initialize_render_passes();
-            initialize_framebuffers();
+            initialize_render_graph();
+            render_graph->print_memory();
             
             // This sample allocates 3 descriptor sets:
             //   1. Global set (0) for the geometry pass
             //   1. 2 per-object sets (1) for the geometry pass, per object
             //   1. Global set (2) for the composition pass
-            initialize_descriptor_pool(1 + 2 * offscreen_objects.size() + 2, 6);
+            //   1. Global set (0) for the light culling pass
+            // The geometry buffer is either sampled or read as input attachments by the composition pass, depending on the mode
+            // Lights and per-cluster light lists are bound as storage buffers to both the light culling and composition passes
+            initialize_descriptor_pool(1 + 2 * offscreen_objects.size() + 3 + 2, 3, 3, 4);
             
             initialize_buffers();
+            initialize_light_buffers();
             
             initialize_uniform_buffer();
             
+            initialize_query_pool();
+            
             initialize_descriptor_set_layouts();
             initialize_descriptor_sets();
             
@@ -135,21 +258,27 @@ class DeferredRendering final : public Sample {
             destroy_descriptor_set_layouts();
             destroy_uniform_buffer();
             
+            destroy_query_pool();
+            
+            destroy_light_buffers();
             destroy_buffers();
             
-            destroy_framebuffers();
-            destroy_render_passes();
+            destroy_render_graph();
             
             destroy_samplers();
-            
-            vkDestroySemaphore(device, is_offscreen_rendering_complete, nullptr);
         }
         
         void update() override {
+            // The fence for this frame in flight has been waited on, so the timings of the last frame recorded for it are available
+            update_timings();
+            
             Scene::Object& object = scene.objects.back();
             Transform& transform = object.transform;
             transform.set_rotation(transform.get_rotation() + (float)dt * glm::vec3(0.0f, -10.0f, 0.0f));
             
+            culler.update_objects(scene.objects, model_bounds);
+            culler.cull(camera.get_projection_matrix() * camera.get_view_matrix(), visible_objects);
+            
             update_uniform_buffers();
             
             for (std::size_t i = 0u; i < scene.objects.size(); ++i)
@@ -174,72 +303,29 @@ class DeferredRendering final : public Sample {
             // Instead, waiting on the pipeline stage where writes are performed to the color attachment allows Vulkan to begin scheduling other work that happens before the VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT stage is reached for execution (such as invoking the vertex shader)
             // This way, the implementation waits only the time that is absolutely necessary for coherent memory operations
             
-            // Presentation -> geometry buffer pass
-            {
-                VkSemaphore wait_semaphores[] = { is_image_available, is_offscreen_rendering_complete }; // Semaphore(s) to wait on before the command buffers can begin execution
-                VkPipelineStageFlags wait_stage_flags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }; // Note: wait_stage_flags and wait_semaphores have a 1:1 correlation, meaning it is possible to wait on and signal different semaphores at different pipeline stages
-                
-                // Waiting on the swapchain image to be ready (if not yet) when the pipeline is ready to perform writes to color attachments
-                submit_info.waitSemaphoreCount = 1;
-                submit_info.pWaitSemaphores = wait_semaphores;
-                submit_info.pWaitDstStageMask = wait_stage_flags;
-                
-                submit_info.commandBufferCount = 1;
-                submit_info.pCommandBuffers = &offscreen_command_buffers[frame_index]; // Command buffer(s) to execute
+            // Both the geometry buffer and composition passes are recorded into the same command buffer (the render graph inserts the necessary barriers between them)
+            VkSemaphore wait_semaphores[] = { is_image_available }; // Semaphore(s) to wait on before the command buffers can begin execution
+            VkPipelineStageFlags wait_stage_flags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }; // Note: wait_stage_flags and wait_semaphores have a 1:1 correlation, meaning it is possible to wait on and signal different semaphores at different pipeline stages
             
-                submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &is_offscreen_rendering_complete; // Signal offscreen semaphore
+            // Waiting on the swapchain image to be ready (if not yet) when the pipeline is ready to perform writes to color attachments
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitSemaphores = wait_semaphores;
+            submit_info.pWaitDstStageMask = wait_stage_flags;
             
-                // Submit
-                if (vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to submit offscreen command buffer!");
-                }
-            }
-
-            // Geometry buffer pass -> presentation
-            {
-                VkSemaphore wait_semaphores[] = { is_offscreen_rendering_complete };
-                VkPipelineStageFlags wait_stage_flags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-                
-                submit_info.waitSemaphoreCount = 1;
-                submit_info.pWaitSemaphores = wait_semaphores;
-                submit_info.pWaitDstStageMask = wait_stage_flags;
-                submit_info.commandBufferCount = 1;
-                submit_info.pCommandBuffers = &command_buffers[frame_index];
-            
-                submit_info.signalSemaphoreCount = 1;
-                submit_info.pSignalSemaphores = &is_rendering_complete[frame_index];
-            
-                // Submit
-                // TODO: fence is not necessary here
-                if (vkQueueSubmit(queue, 1, &submit_info, is_frame_in_flight[frame_index]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to submit presentation command buffer!");
-                }
-            }
-        }
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &command_buffers[frame_index];
+        
+            submit_info.signalSemaphoreCount = 1;
+            submit_info.pSignalSemaphores = &is_rendering_complete[frame_index];
         
-        void initialize_command_buffer() {
-            VkCommandBufferAllocateInfo command_buffer_allocate_info { };
-            command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            command_buffer_allocate_info.commandPool = command_pool;
-            command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            command_buffer_allocate_info.commandBufferCount = NUM_FRAMES_IN_FLIGHT;
-            
-            offscreen_command_buffers.resize(NUM_FRAMES_IN_FLIGHT);
-    
-            // Command buffer will get released with the command pool at the end of the sample
-            if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, offscreen_command_buffers.data()) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate offscreen command buffer!");
+            // Submit
+            if (vkQueueSubmit(queue, 1, &submit_info, is_frame_in_flight[frame_index]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit command buffer!");
             }
         }
         
         void record_command_buffers(unsigned image_index) override {
-            record_offscreen_command_buffer();
-            record_composition_command_buffer(image_index);
-        }
-        
-        void record_offscreen_command_buffer() {
-            VkCommandBuffer command_buffer = offscreen_command_buffers[frame_index];
+            VkCommandBuffer command_buffer = command_buffers[frame_index];
             vkResetCommandBuffer(command_buffer, 0);
             
             VkCommandBufferBeginInfo command_buffer_begin_info { };
@@ -248,115 +334,147 @@ class DeferredRendering final : public Sample {
             if (vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info) != VK_SUCCESS) {
                 throw std::runtime_error("failed to begin command buffer recording!");
             }
+            
+            if (timestamps_supported) {
+                vkCmdResetQueryPool(command_buffer, query_pool, frame_index * 3u, 3u);
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, frame_index * 3u);
+            }
+            
+            // Composition pass renders directly into the swapchain image acquired for this frame
+            render_graph->set_imported_image(swapchain_image, swapchain_images[image_index], swapchain_image_views[image_index]);
+            render_graph->execute(command_buffer);
+            
+            if (timestamps_supported) {
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, frame_index * 3u + 2u);
+                timestamps_written[frame_index] = true;
+            }
+            
+            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record command buffer!");
+            }
+        }
         
-            VkRenderPassBeginInfo render_pass_info { };
-            render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_info.renderPass = offscreen_render_pass;
-            render_pass_info.framebuffer = offscreen_framebuffer; // Only one geometry buffer
-        
-            // Specify render area and offset
-            render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-        
-            VkClearValue clear_values[6] { };
-            clear_values[POSITION].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-            clear_values[NORMAL].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-            clear_values[AMBIENT].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-            clear_values[DIFFUSE].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-            clear_values[SPECULAR].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-            clear_values[DEPTH].depthStencil = { 1.0f, 0 };
-
-            render_pass_info.clearValueCount = sizeof(clear_values) / sizeof(clear_values[0]);
-            render_pass_info.pClearValues = clear_values;
-        
-            unsigned set;
+        void record_light_culling_pass(VkCommandBuffer command_buffer) {
+            if (clustered) {
+                // Light lists of the previous frame may still be read by its composition pass (write-after-read only requires an execution dependency)
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+                
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, light_culling_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, light_culling_pipeline_layout, 0, 1, &light_culling_global, 0, nullptr);
+                
+                // One invocation per cluster, 128 invocations per workgroup
+                vkCmdDispatch(command_buffer, (CLUSTER_COUNT + 127u) / 128u, 1, 1);
+                
+                // Light lists must be written before they are read by the composition pass
+                VkBufferMemoryBarrier buffer_memory_barrier { };
+                buffer_memory_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                buffer_memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                buffer_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                buffer_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                buffer_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                buffer_memory_barrier.buffer = cluster_buffer;
+                buffer_memory_barrier.offset = 0;
+                buffer_memory_barrier.size = VK_WHOLE_SIZE;
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &buffer_memory_barrier, 0, nullptr);
+            }
             
-            // Record command for starting the offscreen render pass
-            vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                // Bind graphics pipeline
-                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, offscreen_pipeline);
+            if (timestamps_supported) {
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, query_pool, frame_index * 3u + 1u);
+            }
+        }
+        
+        void record_offscreen_pass(VkCommandBuffer command_buffer) {
+            // Draw calls are recorded into secondary command buffers on the worker threads, split by ranges of visible objects
+            // The framebuffer is created by the render graph (and may change between frames), so it is left unspecified
+            VkCommandBufferInheritanceInfo inheritance_info { };
+            inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritance_info.renderPass = render_graph->get_render_pass(offscreen_pass);
+            inheritance_info.subpass = render_graph->get_subpass(offscreen_pass);
+            inheritance_info.framebuffer = VK_NULL_HANDLE;
+            
+            std::vector<VkCommandBuffer> secondary_command_buffers = record_secondary_command_buffers(inheritance_info, visible_objects.size(), [this](VkCommandBuffer secondary_command_buffer, std::size_t begin, std::size_t end) {
+                unsigned set;
+                
+                // State is not inherited from the primary command buffer, so every secondary command buffer binds its own pipeline and global descriptor sets
+                vkCmdBindPipeline(secondary_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, offscreen_pipeline);
                 
-                // Bind pipeline-global descriptor sets
                 set = 0;
-                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, offscreen_pipeline_layout, set, 1, &offscreen_global, 0, nullptr);
+                vkCmdBindDescriptorSets(secondary_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, offscreen_pipeline_layout, set, 1, &offscreen_global, 0, nullptr);
                 
-                for (std::size_t i = 0u; i < scene.objects.size(); ++i) {
+                // Only objects that passed frustum culling in update() are drawn
+                for (std::size_t n = begin; n < end; ++n) {
+                    unsigned i = visible_objects[n];
                     const Scene::Object& object = scene.objects[i];
                     const Model& model = models[object.model];
                     
                     // Bind vertex buffer
                     VkDeviceSize offsets[] = { object.vertex_offset  };
-                    vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
+                    vkCmdBindVertexBuffers(secondary_command_buffer, 0, 1, &vertex_buffer, offsets);
                     
                     // Bind index buffer
-                    vkCmdBindIndexBuffer(command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
+                    vkCmdBindIndexBuffer(secondary_command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
                     
                     // Descriptor sets need to be bound per object
                     set = 1;
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, offscreen_pipeline_layout, set, 1, &offscreen_objects[i], 0, nullptr);
+                    vkCmdBindDescriptorSets(secondary_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, offscreen_pipeline_layout, set, 1, &offscreen_objects[i], 0, nullptr);
                     
                     // Draw indices.size() vertices which make up 1 instance starting at vertex index 0 and instance index 0.
-                    vkCmdDrawIndexed(command_buffer, (unsigned) model.indices.size(), 1, 0, 0, 0);
+                    vkCmdDrawIndexed(secondary_command_buffer, (unsigned) model.indices.size(), 1, 0, 0, 0);
                 }
+            });
             
-            vkCmdEndRenderPass(command_buffer);
-            
-            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer!");
+            // Contents of the geometry buffer (sub)pass are provided entirely by secondary command buffers
+            if (!secondary_command_buffers.empty()) {
+                vkCmdExecuteCommands(command_buffer, (unsigned) secondary_command_buffers.size(), secondary_command_buffers.data());
             }
         }
         
-        void record_composition_command_buffer(unsigned image_index) {
-            VkCommandBuffer command_buffer = command_buffers[frame_index];
-            vkResetCommandBuffer(command_buffer, 0);
+        void record_composition_pass(VkCommandBuffer command_buffer) {
+            // Bind graphics pipeline
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline);
             
-            VkCommandBufferBeginInfo command_buffer_begin_info { };
-            command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            command_buffer_begin_info.flags = 0;
-            if (vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info) != VK_SUCCESS) {
-                throw std::runtime_error("failed to begin command buffer recording!");
-            }
-        
-            VkRenderPassBeginInfo render_pass_info { };
-            render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_info.renderPass = composition_render_pass;
-            render_pass_info.framebuffer = present_framebuffers[image_index]; // Bind the framebuffer for the swapchain image being rendered to
-        
-            // Specify render area and offset
-            render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
-        
-            VkClearValue clear_value { };
-
-            // Clear value for color attachment
-            clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
-            render_pass_info.clearValueCount = 1;
+            // Bind pipeline-global descriptor sets
+            unsigned set = 0;
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline_layout, set, 1, &composition_global, 0, nullptr);
             
-            render_pass_info.pClearValues = &clear_value;
-            
-            // Record command for starting the composition render pass
-            vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                // Bind graphics pipeline
-                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline);
-                
-                // Bind pipeline-global descriptor sets
-                unsigned set = 0;
-                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline_layout, set, 1, &composition_global, 0, nullptr);
-                
-                // Draw a full screen triangle
-                vkCmdDraw(command_buffer, 3, 1, 0, 0);
-            
-            // Finish recording the command buffer
-            vkCmdEndRenderPass(command_buffer);
-            
-            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer!");
-            }
+            // Draw a full screen triangle
+            vkCmdDraw(command_buffer, 3, 1, 0, 0);
         }
         
         void initialize_pipelines() {
+            initialize_light_culling_pipeline();
             initialize_offscreen_pipeline();
             initialize_composition_pipeline();
         }
         
+        void initialize_light_culling_pipeline() {
+            VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
+            pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_create_info.setLayoutCount = 1;
+            pipeline_layout_create_info.pSetLayouts = &light_culling_layout;
+            if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &light_culling_pipeline_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create light culling pipeline layout!");
+            }
+            
+            // Cluster grid dimensions are compiled into the shader
+            VkShaderModule shader_module = create_shader_module(device, "shaders/light_culling.comp", {
+                { "CLUSTER_COUNT_X", std::to_string(CLUSTER_COUNT_X) },
+                { "CLUSTER_COUNT_Y", std::to_string(CLUSTER_COUNT_Y) },
+                { "CLUSTER_COUNT_Z", std::to_string(CLUSTER_COUNT_Z) },
+                { "MAX_LIGHTS_PER_CLUSTER", std::to_string(MAX_LIGHTS_PER_CLUSTER) }
+            });
+            
+            VkComputePipelineCreateInfo pipeline_create_info { };
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipeline_create_info.layout = light_culling_pipeline_layout;
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &light_culling_pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create light culling pipeline!");
+            }
+            
+            vkDestroyShaderModule(device, shader_module, nullptr);
+        }
+        
         void initialize_offscreen_pipeline() {
             VkVertexInputBindingDescription vertex_binding_descriptions[] {
                 create_vertex_binding_description(0, sizeof(glm::vec3) * 2, VK_VERTEX_INPUT_RATE_VERTEX) // One element is vertex position (vec3) + normal (vec3)
@@ -433,11 +551,8 @@ class DeferredRendering final : public Sample {
             
             // Needs one color blend attachment per color attachment, otherwise colorMask will be set to 0 and the attachment will not receive any color output
             VkPipelineColorBlendAttachmentState color_blend_attachment_states[] {
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Position
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Normal
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Ambient
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Diffuse
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Specular
+                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT, false), // Normal (octahedral)
+                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Material
             };
         
             VkPipelineColorBlendStateCreateInfo color_blend_create_info { };
@@ -478,8 +593,8 @@ class DeferredRendering final : public Sample {
             pipeline_create_info.pColorBlendState = &color_blend_create_info;
             pipeline_create_info.pDynamicState = nullptr;
             pipeline_create_info.layout = offscreen_pipeline_layout;
-            pipeline_create_info.renderPass = offscreen_render_pass;
-            pipeline_create_info.subpass = 0;
+            pipeline_create_info.renderPass = render_graph->get_render_pass(offscreen_pass);
+            pipeline_create_info.subpass = render_graph->get_subpass(offscreen_pass);
         
             // TODO: Allows for recreating a pipeline from an existing pipeline
             pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
@@ -503,7 +618,7 @@ class DeferredRendering final : public Sample {
             // Bundle shader stages to assign to pipeline
             VkPipelineShaderStageCreateInfo shader_stages[] = {
                 create_shader_stage(create_shader_module(device, "shaders/composition.vert"), VK_SHADER_STAGE_VERTEX_BIT),
-                create_shader_stage(create_shader_module(device, "shaders/composition.frag"), VK_SHADER_STAGE_FRAGMENT_BIT),
+                create_shader_stage(create_composition_shader_module(), VK_SHADER_STAGE_FRAGMENT_BIT),
             };
             
             // Input assembly describes the topology of the geometry being rendered
@@ -603,8 +718,8 @@ class DeferredRendering final : public Sample {
             pipeline_create_info.pColorBlendState = &color_blend_create_info;
             pipeline_create_info.pDynamicState = nullptr;
             pipeline_create_info.layout = composition_pipeline_layout;
-            pipeline_create_info.renderPass = composition_render_pass;
-            pipeline_create_info.subpass = 0;
+            pipeline_create_info.renderPass = render_graph->get_render_pass(composition_pass);
+            pipeline_create_info.subpass = render_graph->get_subpass(composition_pass);
         
             // TODO: Allows for recreating a pipeline from an existing pipeline
             pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
@@ -620,7 +735,25 @@ class DeferredRendering final : public Sample {
             }
         }
         
+        VkShaderModule create_composition_shader_module() {
+            std::string x = std::to_string(CLUSTER_COUNT_X);
+            std::string y = std::to_string(CLUSTER_COUNT_Y);
+            std::string z = std::to_string(CLUSTER_COUNT_Z);
+            std::string max_lights = std::to_string(MAX_LIGHTS_PER_CLUSTER);
+            std::string materials = std::to_string(scene.objects.size()); // One material per object
+            
+            if (single_pass) {
+                return create_shader_module(device, "shaders/composition.frag", { { "INPUT_ATTACHMENTS", "1" }, { "CLUSTER_COUNT_X", x }, { "CLUSTER_COUNT_Y", y }, { "CLUSTER_COUNT_Z", z }, { "MAX_LIGHTS_PER_CLUSTER", max_lights }, { "MATERIAL_COUNT", materials } });
+            }
+            else {
+                return create_shader_module(device, "shaders/composition.frag", { { "CLUSTER_COUNT_X", x }, { "CLUSTER_COUNT_Y", y }, { "CLUSTER_COUNT_Z", z }, { "MAX_LIGHTS_PER_CLUSTER", max_lights }, { "MATERIAL_COUNT", materials } });
+            }
+        }
+        
         void destroy_pipelines() {
+            vkDestroyPipelineLayout(device, light_culling_pipeline_layout, nullptr);
+            vkDestroyPipeline(device, light_culling_pipeline, nullptr);
+            
             vkDestroyPipelineLayout(device, composition_pipeline_layout, nullptr);
             vkDestroyPipeline(device, composition_pipeline, nullptr);
             
@@ -628,203 +761,84 @@ class DeferredRendering final : public Sample {
             vkDestroyPipeline(device, offscreen_pipeline, nullptr);
         }
         
-        void initialize_render_passes() {
-            initialize_offscreen_render_pass();
-            initialize_composition_render_pass();
-        }
-        
-        void initialize_offscreen_render_pass() {
-            // TODO: consolidate specifying attachment format into one place
-            VkAttachmentDescription attachment_descriptions[] {
-                // Color attachments are transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL to be read during the composition pass
-                // Vertex positions (64-bit floating point format)
-                create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Vertex normals
-                create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Ambient
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Diffuse
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Specular
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                
-                // Depth
-                create_attachment_description(depth_buffer_format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL),
-            };
-            
-            VkAttachmentReference color_attachment_references[] {
-                create_attachment_reference(POSITION, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(NORMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(AMBIENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(DIFFUSE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(SPECULAR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-            };
-            VkAttachmentReference depth_stencil_attachment_reference = create_attachment_reference(DEPTH, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-            
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = sizeof(color_attachment_references) / sizeof(color_attachment_references[0]);
-            subpass_description.pColorAttachments = color_attachment_references;
-            subpass_description.pDepthStencilAttachment = &depth_stencil_attachment_reference;
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Ensure that color attachment read operations during the previous frame complete before resetting them for the new render pass
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-                                          
-                // Write operations to fill color attachments should complete before being read from
-                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT),
-            };
-            
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = sizeof(attachment_descriptions) / sizeof(attachment_descriptions[0]);
-            render_pass_create_info.pAttachments = attachment_descriptions;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &offscreen_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create offscreen render pass!");
-            }
-        }
-        
-        void initialize_composition_render_pass() {
-            VkAttachmentDescription attachment_descriptions[] {
-                create_attachment_description(surface_format.format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR),
-            };
-            
-            VkAttachmentReference color_attachment_references[] {
-                create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-            };
+        void initialize_render_graph() {
+            render_graph = std::make_unique<RenderGraph>(physical_device, device, swapchain_extent);
+            
+            // Swapchain images are acquired every frame, the image backing this resource is set when recording the command buffer
+            swapchain_image = render_graph->import_image("swapchain", VK_NULL_HANDLE, VK_NULL_HANDLE, surface_format.format, swapchain_extent, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+            
+            // Geometry buffer attachments are copied from when taking screenshots, which is only possible if their contents are stored (multi pass)
+            // In single pass mode, the graph makes them transient (lazily allocated where supported)
+            VkImageUsageFlags usage = single_pass ? 0 : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            
+            // Compact geometry buffer (12 bytes per pixel), positions are reconstructed from depth in the composition pass
+            geometry_buffer[NORMAL_ATTACHMENT] = render_graph->create_image("normal", { GEOMETRY_BUFFER_NORMAL_FORMAT, 0u, 0u, VK_SAMPLE_COUNT_1_BIT, usage });
+            geometry_buffer[MATERIAL_ATTACHMENT] = render_graph->create_image("material", { GEOMETRY_BUFFER_MATERIAL_FORMAT, 0u, 0u, VK_SAMPLE_COUNT_1_BIT, usage });
+            geometry_buffer[DEPTH_ATTACHMENT] = render_graph->create_image("depth", { depth_buffer_format, 0u, 0u, VK_SAMPLE_COUNT_1_BIT, usage });
+            
+            // Light lists are written to a buffer, which is not tracked by the render graph (barriers are recorded by the pass itself)
+            light_culling_pass = render_graph->add_compute_pass("light culling", [](RenderGraph::PassBuilder& builder) {
+                builder.set_side_effects();
+            }, [this](VkCommandBuffer command_buffer) {
+                record_light_culling_pass(command_buffer);
+            });
+            
+            offscreen_pass = render_graph->add_graphics_pass("geometry", [this](RenderGraph::PassBuilder& builder) {
+                builder.write_color(geometry_buffer[NORMAL_ATTACHMENT]);
+                builder.write_color(geometry_buffer[MATERIAL_ATTACHMENT]);
+                builder.write_depth(geometry_buffer[DEPTH_ATTACHMENT]);
+                builder.set_subpass_contents(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            }, [this](VkCommandBuffer command_buffer) {
+                record_offscreen_pass(command_buffer);
+            });
+            
+            // Reading the geometry buffer through input attachments (only the current pixel is accessed) allows the graph to merge both passes into subpasses of the same render pass
+            // Sampling the geometry buffer as textures requires it to be stored to memory at the end of the geometry pass and results in two render passes
+            composition_pass = render_graph->add_graphics_pass("composition", [this](RenderGraph::PassBuilder& builder) {
+                for (int i = NORMAL_ATTACHMENT; i <= DEPTH_ATTACHMENT; ++i) {
+                    if (single_pass) {
+                        builder.read_input_attachment(geometry_buffer[i]); // input_attachment_index matches the order of the reads
+                    }
+                    else {
+                        builder.read_texture(geometry_buffer[i]);
+                    }
+                }
+                builder.write_color(swapchain_image);
+            }, [this](VkCommandBuffer command_buffer) {
+                record_composition_pass(command_buffer);
+            });
             
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = sizeof(color_attachment_references) / sizeof(color_attachment_references[0]);
-            subpass_description.pColorAttachments = color_attachment_references;
-            subpass_description.pDepthStencilAttachment = nullptr; // Depth information is not used for rendering a FSQ
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Dependency for ensuring that the color attachment (retrieved from the swapchain) is not transitioned to the VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL layout before it is available
-                // Color attachments are guaranteed to be available at the VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT pipeline stage, as that is where the color attachment LOAD operation happens
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-            };
+            render_graph->compile();
             
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = sizeof(attachment_descriptions) / sizeof(attachment_descriptions[0]);
-            render_pass_create_info.pAttachments = attachment_descriptions;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &composition_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create composition render pass!");
-            }
+            // Framebuffers are owned by the render graph (Sample::destroy_framebuffers() still expects one entry per frame in flight)
+            present_framebuffers.assign(NUM_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
         }
         
-        void destroy_render_passes() {
-            vkDestroyRenderPass(device, offscreen_render_pass, nullptr);
-            vkDestroyRenderPass(device, composition_render_pass, nullptr);
+        void destroy_render_graph() {
+            // Destroys all attachments, render passes, and framebuffers created by the graph
+            render_graph.reset();
         }
         
-        void initialize_framebuffers() {
-            initialize_offscreen_framebuffer();
-            initialize_composition_framebuffers();
+        void initialize_descriptor_set_layouts() {
+            initialize_light_culling_descriptor_set_layouts();
+            initialize_offscreen_descriptor_set_layouts();
+            initialize_composition_descriptor_set_layouts();
         }
         
-        void initialize_offscreen_framebuffer() {
-            // Initialize color attachments
-            for (std::size_t i = 0; i < 5; ++i) {
-                VkFormat format;
-                if (i == POSITION || i == NORMAL) {
-                    format = VK_FORMAT_R16G16B16A16_SFLOAT; // 64-bit floating point image format (for higher precision)
-                }
-                else {
-                    // Color cannot be negative, so use an 32-bit unsigned image format
-                    format = VK_FORMAT_R8G8B8A8_UNORM;
-                }
-                
-                create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreen_framebuffer_attachments[i].image, offscreen_framebuffer_attachments[i].memory);
-                create_image_view(device, offscreen_framebuffer_attachments[i].image, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, offscreen_framebuffer_attachments[i].image_view);
-            }
-            
-            // Initialize depth attachment
-            create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, depth_buffer_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreen_framebuffer_attachments[DEPTH].image, offscreen_framebuffer_attachments[DEPTH].memory);
-            create_image_view(device, offscreen_framebuffer_attachments[DEPTH].image, VK_IMAGE_VIEW_TYPE_2D, depth_buffer_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 1, offscreen_framebuffer_attachments[DEPTH].image_view);
-            
-            VkImageView attachments[] {
-                offscreen_framebuffer_attachments[POSITION].image_view,
-                offscreen_framebuffer_attachments[NORMAL].image_view,
-                offscreen_framebuffer_attachments[AMBIENT].image_view,
-                offscreen_framebuffer_attachments[DIFFUSE].image_view,
-                offscreen_framebuffer_attachments[SPECULAR].image_view,
-                offscreen_framebuffer_attachments[DEPTH].image_view
+        void initialize_light_culling_descriptor_set_layouts() {
+            VkDescriptorSetLayoutBinding bindings[] {
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // Uniform buffer for cluster data
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // Lights
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // Per-cluster light lists
             };
             
-            VkFramebufferCreateInfo framebuffer_create_info { };
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_create_info.renderPass = offscreen_render_pass;
-            framebuffer_create_info.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-            framebuffer_create_info.pAttachments = attachments;
-            framebuffer_create_info.width = swapchain_extent.width;
-            framebuffer_create_info.height = swapchain_extent.height;
-            framebuffer_create_info.layers = 1; // Number of layers in the swapchain images
-            
-            if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &offscreen_framebuffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create offscreen framebuffer!");
-            }
-        }
-        
-        void initialize_composition_framebuffers() {
-            present_framebuffers.resize(NUM_FRAMES_IN_FLIGHT);
-            
-            for (std::size_t i = 0u; i < NUM_FRAMES_IN_FLIGHT; ++i) {
-                VkImageView attachments[] = { swapchain_image_views[i] };
-                
-                VkFramebufferCreateInfo framebuffer_create_info { };
-                framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-                framebuffer_create_info.renderPass = composition_render_pass;
-                framebuffer_create_info.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-                framebuffer_create_info.pAttachments = attachments;
-                framebuffer_create_info.width = swapchain_extent.width;
-                framebuffer_create_info.height = swapchain_extent.height;
-                framebuffer_create_info.layers = 1; // Number of layers in the swapchain images
-                
-                if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &present_framebuffers[i]) != VK_SUCCESS) {
-                    throw std::runtime_error("failed to create present framebuffer!");
-                }
-            }
-        }
-        
-        void destroy_framebuffers() {
-            for (std::size_t i = 0u; i < offscreen_framebuffer_attachments.size(); ++i) {
-                vkDestroyImage(device, offscreen_framebuffer_attachments[i].image, nullptr);
-                vkDestroyImageView(device, offscreen_framebuffer_attachments[i].image_view, nullptr);
-                
-                vkFreeMemory(device, offscreen_framebuffer_attachments[i].memory, nullptr);
+            VkDescriptorSetLayoutCreateInfo layout_create_info { };
+            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+            layout_create_info.pBindings = bindings;
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &light_culling_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate light culling descriptor set layout!");
             }
-            
-            vkDestroyFramebuffer(device, offscreen_framebuffer, nullptr);
-        }
-        
-        void initialize_descriptor_set_layouts() {
-            initialize_offscreen_descriptor_set_layouts();
-            initialize_composition_descriptor_set_layouts();
         }
         
         void initialize_offscreen_descriptor_set_layouts() {
@@ -864,15 +878,18 @@ class DeferredRendering final : public Sample {
         }
         
         void initialize_composition_descriptor_set_layouts() {
+            VkDescriptorType geometry_buffer_descriptor_type = single_pass ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            
             VkDescriptorSetLayoutBinding bindings[] {
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // Position sampler
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // Normal sampler
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // Ambient sampler
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), // Diffuse sampler
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), // Specular sampler
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), // Depth sampler
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6), // Uniform buffer for lights
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7), // Uniform buffer for render settings
+                create_descriptor_set_layout_binding(geometry_buffer_descriptor_type, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // Normal
+                create_descriptor_set_layout_binding(geometry_buffer_descriptor_type, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // Material
+                create_descriptor_set_layout_binding(geometry_buffer_descriptor_type, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // Depth
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), // Uniform buffer for lights
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), // Uniform buffer for render settings
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), // Uniform buffer for materials
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6), // Uniform buffer for cluster data
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7), // Lights
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 8), // Per-cluster light lists
             };
             
             // Initialize the descriptor set layout
@@ -886,6 +903,8 @@ class DeferredRendering final : public Sample {
         }
         
         void destroy_descriptor_set_layouts() {
+            vkDestroyDescriptorSetLayout(device, light_culling_layout, nullptr);
+            
             vkDestroyDescriptorSetLayout(device, offscreen_global_layout, nullptr);
             vkDestroyDescriptorSetLayout(device, offscreen_object_layout, nullptr);
             
@@ -893,10 +912,65 @@ class DeferredRendering final : public Sample {
         }
         
         void initialize_descriptor_sets() {
+            initialize_light_culling_descriptor_sets();
             initialize_offscreen_descriptor_sets();
             initialize_composition_descriptor_sets();
         }
         
+        // Offset of the material table in the uniform buffer (located directly after the cluster data)
+        std::size_t get_material_uniform_offset() {
+            return get_cluster_uniform_offset() + align_to_device_boundary(physical_device, sizeof(ClusterData));
+        }
+        
+        // Offset of the cluster data in the uniform buffer (located directly after the composition uniforms)
+        std::size_t get_cluster_uniform_offset() {
+            std::size_t object_uniform_size = align_to_device_boundary(physical_device, (sizeof(glm::mat4) * 2)) + align_to_device_boundary(physical_device, sizeof(glm::vec4));
+            return align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2 + sizeof(glm::vec4)) + scene.objects.size() * object_uniform_size + align_to_device_boundary(physical_device, sizeof(glm::mat4) + sizeof(glm::vec4) * 2) + align_to_device_boundary(physical_device, sizeof(int));
+        }
+        
+        // Writes the cluster data, light, and light list descriptors (bindings 'first_binding' to 'first_binding' + 2) into the given set
+        void write_cluster_descriptors(VkDescriptorSet set, unsigned first_binding) {
+            VkDescriptorBufferInfo buffer_infos[3] { };
+            
+            buffer_infos[0].buffer = uniform_buffer;
+            buffer_infos[0].offset = get_cluster_uniform_offset();
+            buffer_infos[0].range = sizeof(ClusterData);
+            
+            buffer_infos[1].buffer = light_buffer;
+            buffer_infos[1].offset = 0;
+            buffer_infos[1].range = VK_WHOLE_SIZE;
+            
+            buffer_infos[2].buffer = cluster_buffer;
+            buffer_infos[2].offset = 0;
+            buffer_infos[2].range = VK_WHOLE_SIZE;
+            
+            VkWriteDescriptorSet descriptor_writes[3] { };
+            for (unsigned i = 0u; i < 3u; ++i) {
+                descriptor_writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_writes[i].dstSet = set;
+                descriptor_writes[i].dstBinding = first_binding + i;
+                descriptor_writes[i].dstArrayElement = 0;
+                descriptor_writes[i].descriptorType = i == 0u ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptor_writes[i].descriptorCount = 1;
+                descriptor_writes[i].pBufferInfo = &buffer_infos[i];
+            }
+            
+            vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+        }
+        
+        void initialize_light_culling_descriptor_sets() {
+            VkDescriptorSetAllocateInfo light_culling_set_allocate_info { };
+            light_culling_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            light_culling_set_allocate_info.descriptorPool = descriptor_pool;
+            light_culling_set_allocate_info.descriptorSetCount = 1;
+            light_culling_set_allocate_info.pSetLayouts = &light_culling_layout;
+            if (vkAllocateDescriptorSets(device, &light_culling_set_allocate_info, &light_culling_global) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate light culling descriptor set!");
+            }
+            
+            write_cluster_descriptors(light_culling_global, 0);
+        }
+        
         void initialize_offscreen_descriptor_sets() {
             // All descriptor sets are allocated from the same descriptor pool, allocated at the start of the frame
             
@@ -934,7 +1008,7 @@ class DeferredRendering final : public Sample {
 
             
             // Configure per-object uniform ranges
-            std::size_t object_uniform_size = align_to_device_boundary(physical_device, (sizeof(glm::mat4) * 2)) + align_to_device_boundary(physical_device, sizeof(glm::vec4) * 3 + 4);
+            std::size_t object_uniform_size = align_to_device_boundary(physical_device, (sizeof(glm::mat4) * 2)) + align_to_device_boundary(physical_device, sizeof(glm::vec4));
             
             for (std::size_t i = 0u; i < scene.objects.size(); ++i) {
                 VkDescriptorSetAllocateInfo offscreen_object_set_allocate_info { };
@@ -968,7 +1042,7 @@ class DeferredRendering final : public Sample {
                 // Fragment shader
                 buffer_infos[1].buffer = uniform_buffer;
                 buffer_infos[1].offset = starting_offset;
-                buffer_infos[1].range = (sizeof(glm::vec4) * 3) + 4;
+                buffer_infos[1].range = sizeof(glm::vec4);
                 starting_offset += align_to_device_boundary(physical_device, buffer_infos[1].range);
                 
                 descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -994,47 +1068,47 @@ class DeferredRendering final : public Sample {
                 throw std::runtime_error("failed to allocate global composition descriptor set!");
             }
             
-            VkWriteDescriptorSet descriptor_writes[8] { };
-            VkDescriptorImageInfo image_infos[6] { };
+            VkWriteDescriptorSet descriptor_writes[6] { };
+            VkDescriptorImageInfo image_infos[3] { };
             
             unsigned binding;
             
-            // Descriptors 0 - 5 - combined image sampler (position, normal, ambient, diffuse, specular, depth)
-            for (binding = 0; binding < 6; ++binding) {
-                if (binding == DEPTH) {
-                    image_infos[binding].imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL;
+            // Descriptors 0 - 2 - combined image sampler or input attachment (normal, material, depth)
+            for (binding = 0; binding < 3; ++binding) {
+                if (binding == DEPTH_ATTACHMENT) {
+                    image_infos[binding].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
                 }
                 else {
                     image_infos[binding].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                 }
                 
-                image_infos[binding].imageView = offscreen_framebuffer_attachments[binding].image_view;
-                image_infos[binding].sampler = sampler;
+                image_infos[binding].imageView = render_graph->get_image_view(geometry_buffer[binding]);
+                image_infos[binding].sampler = single_pass ? VK_NULL_HANDLE : sampler; // Input attachments are not sampled
                 
                 descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
                 descriptor_writes[binding].dstSet = composition_global;
                 descriptor_writes[binding].dstBinding = binding;
                 descriptor_writes[binding].dstArrayElement = 0;
-                descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptor_writes[binding].descriptorType = single_pass ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
                 descriptor_writes[binding].descriptorCount = 1;
                 descriptor_writes[binding].pImageInfo = &image_infos[binding];
             }
             
-            VkDescriptorBufferInfo buffer_infos[2] { };
+            VkDescriptorBufferInfo buffer_infos[3] { };
             
             // The same uniform buffer is used for both offscreen and composition passes
             // Composition uniforms are located directly after all the offscreen uniforms
             
             // vertex uniforms + fragment uniforms
-            std::size_t object_uniform_size = align_to_device_boundary(physical_device, (sizeof(glm::mat4) * 2)) + align_to_device_boundary(physical_device, sizeof(glm::vec4) * 3 + 4);
+            std::size_t object_uniform_size = align_to_device_boundary(physical_device, (sizeof(glm::mat4) * 2)) + align_to_device_boundary(physical_device, sizeof(glm::vec4));
             std::size_t offset = align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2 + sizeof(glm::vec4)) + scene.objects.size() * object_uniform_size;
             
-            // Descriptor 6 - uniform buffer for lighting data
+            // Descriptor 3 - uniform buffer for lighting data
             buffer_infos[0].buffer = uniform_buffer;
             buffer_infos[0].offset = offset;
             buffer_infos[0].range = sizeof(glm::mat4) + sizeof(glm::vec4);
             
-            offset += align_to_device_boundary(physical_device, buffer_infos[0].range);
+            offset += align_to_device_boundary(physical_device, sizeof(glm::mat4) + sizeof(glm::vec4) * 2);
             
             descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             descriptor_writes[binding].dstSet = composition_global;
@@ -1046,7 +1120,7 @@ class DeferredRendering final : public Sample {
             
             ++binding;
             
-            // Descriptor 7 - uniform buffer for settings
+            // Descriptor 4 - uniform buffer for settings
             buffer_infos[1].buffer = uniform_buffer;
             buffer_infos[1].offset = offset;
             buffer_infos[1].range = sizeof(int);
@@ -1061,8 +1135,26 @@ class DeferredRendering final : public Sample {
             descriptor_writes[binding].descriptorCount = 1;
             descriptor_writes[binding].pBufferInfo = &buffer_infos[1];
             
+            ++binding;
+            
+            // Descriptor 5 - uniform buffer for the material table (located after the cluster data)
+            buffer_infos[2].buffer = uniform_buffer;
+            buffer_infos[2].offset = get_material_uniform_offset();
+            buffer_infos[2].range = sizeof(GeometryBufferMaterial) * scene.objects.size();
+            
+            descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[binding].dstSet = composition_global;
+            descriptor_writes[binding].dstBinding = binding;
+            descriptor_writes[binding].dstArrayElement = 0;
+            descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptor_writes[binding].descriptorCount = 1;
+            descriptor_writes[binding].pBufferInfo = &buffer_infos[2];
+            
             // Specify the buffer and region within it that contains the data for the allocated descriptors
             vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+            
+            // Descriptors 6 - 8 - cluster data, lights, per-cluster light lists
+            write_cluster_descriptors(composition_global, 6);
         }
         
         void destroy_descriptor_sets() {
@@ -1126,6 +1218,12 @@ class DeferredRendering final : public Sample {
             knight.specular_exponent = 0.0f;
             knight.transform = Transform(glm::vec3(0, 0.5f, 0), glm::vec3(1.5f), glm::vec3(0.0f, 50.0f, 0.0f));
             
+            // Compute model-space bounds for frustum culling
+            for (const Model& model : models) {
+                model_bounds.emplace_back(compute_model_bounds(model));
+            }
+            culler.add_objects(scene.objects, model_bounds);
+            
             // This sample only uses vertex position and normal
             std::size_t vertex_buffer_size = 0u;
             std::size_t index_buffer_size = 0u;
@@ -1292,10 +1390,19 @@ class DeferredRendering final : public Sample {
             std::size_t offscreen_buffer_size = align_to_device_boundary(physical_device, (sizeof(glm::mat4) * 2) + sizeof(glm::vec4));
             
             // Per-object uniforms
-            offscreen_buffer_size += (align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2) + align_to_device_boundary(physical_device, sizeof(glm::vec4) * 3 + 4)) * scene.objects.size();
+            offscreen_buffer_size += (align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2) + align_to_device_boundary(physical_device, sizeof(glm::vec4))) * scene.objects.size();
             
             std::size_t composition_buffer_size = align_to_device_boundary(physical_device, sizeof(glm::mat4) + sizeof(glm::vec4) * 2) + align_to_device_boundary(physical_device, sizeof(int));
             
+            // Cluster data (shared between the light culling and composition passes)
+            composition_buffer_size += align_to_device_boundary(physical_device, sizeof(ClusterData));
+            
+            // Material table (one material per object), indexed by the material index stored in the geometry buffer
+            if (scene.objects.size() > MAX_GEOMETRY_BUFFER_MATERIALS) {
+                throw std::runtime_error("scene contains more materials than can be indexed by the geometry buffer!");
+            }
+            composition_buffer_size += align_to_device_boundary(physical_device, sizeof(GeometryBufferMaterial) * scene.objects.size());
+            
             std::size_t uniform_buffer_size = offscreen_buffer_size + composition_buffer_size;
             
             create_buffer(physical_device, device, uniform_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniform_buffer, uniform_buffer_memory);
@@ -1304,7 +1411,7 @@ class DeferredRendering final : public Sample {
         
         void update_object_uniform_buffers(unsigned id) {
             Scene::Object& object = scene.objects[id];
-            std::size_t offset = align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2 + sizeof(glm::vec4)) + (align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2) + align_to_device_boundary(physical_device, sizeof(glm::vec4) * 3 + 4)) * id;
+            std::size_t offset = align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2 + sizeof(glm::vec4)) + (align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2) + align_to_device_boundary(physical_device, sizeof(glm::vec4))) * id;
             
             struct ObjectData {
                 glm::mat4 model;
@@ -1317,21 +1424,22 @@ class DeferredRendering final : public Sample {
             memcpy((void*)((const char*) (uniform_buffer_mapped) + offset), &object_data, sizeof(ObjectData));
             offset += align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2);
             
+            // Only the diffuse color is written to the geometry buffer, along with the index of the material that holds the remaining terms
             struct MaterialData {
-                // Must be aligned to vec4
-                glm::vec4 ambient;
-                glm::vec4 diffuse;
-                glm::vec4 specular;
-                float exponent;
+                glm::vec3 diffuse;
+                unsigned material;
             };
             MaterialData material_data { };
-            material_data.ambient = glm::vec4(object.ambient, 1.0f);
-            material_data.diffuse = glm::vec4(object.diffuse, 1.0f);
-            material_data.specular = glm::vec4(object.specular, 1.0f);
-            material_data.exponent = object.specular_exponent;
+            material_data.diffuse = object.diffuse;
+            material_data.material = id;
             
             memcpy((void*)((const char*) (uniform_buffer_mapped) + offset), &material_data, sizeof(MaterialData));
-            offset += align_to_device_boundary(physical_device, sizeof(glm::vec4) * 3 + 4);
+            offset += align_to_device_boundary(physical_device, sizeof(glm::vec4));
+            
+            GeometryBufferMaterial material { };
+            material.ambient = glm::vec4(object.ambient, 1.0f);
+            material.specular = glm::vec4(object.specular, object.specular_exponent);
+            memcpy((void*)((const char*) (uniform_buffer_mapped) + get_material_uniform_offset() + sizeof(GeometryBufferMaterial) * id), &material, sizeof(GeometryBufferMaterial));
         }
         
         void update_uniform_buffers() {
@@ -1347,7 +1455,7 @@ class DeferredRendering final : public Sample {
             memcpy(uniform_buffer_mapped, &globals, sizeof(CameraData));
             std::size_t offset = align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2 + sizeof(glm::vec4));
             
-            offset += (align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2) + align_to_device_boundary(physical_device, sizeof(glm::vec4) * 3 + 4)) * scene.objects.size();
+            offset += (align_to_device_boundary(physical_device, sizeof(glm::mat4) * 2) + align_to_device_boundary(physical_device, sizeof(glm::vec4))) * scene.objects.size();
             
             struct LightingData {
                 glm::mat4 view;
@@ -1366,6 +1474,204 @@ class DeferredRendering final : public Sample {
             render_settings.view = debug_view;
             memcpy((void*)((const char*) (uniform_buffer_mapped) + offset), &render_settings, sizeof(RenderSettings));
             offset += align_to_device_boundary(physical_device, sizeof(int));
+            
+            float near = camera.get_near_plane_distance();
+            float far = camera.get_far_plane_distance();
+            
+            ClusterData cluster_data { };
+            cluster_data.view = camera.get_view_matrix();
+            cluster_data.inverse_projection = glm::inverse(camera.get_projection_matrix());
+            cluster_data.tile_size = glm::vec2((float) swapchain_extent.width / (float) CLUSTER_COUNT_X, (float) swapchain_extent.height / (float) CLUSTER_COUNT_Y);
+            
+            // Slices are exponentially distributed between the near and far planes: slice(z) = log(z / near) / log(far / near) * CLUSTER_COUNT_Z
+            cluster_data.z_scale = (float) CLUSTER_COUNT_Z / std::log(far / near);
+            cluster_data.z_bias = -(float) CLUSTER_COUNT_Z * std::log(near) / std::log(far / near);
+            cluster_data.near = near;
+            cluster_data.far = far;
+            cluster_data.light_count = light_count;
+            cluster_data.clustered = clustered ? 1 : 0;
+            memcpy((void*)((const char*) (uniform_buffer_mapped) + offset), &cluster_data, sizeof(ClusterData));
+            offset += align_to_device_boundary(physical_device, sizeof(ClusterData));
+        }
+        
+        void initialize_light_buffers() {
+            // Lights are written directly by the CPU (only when the light count changes), so the buffer is kept persistently mapped
+            create_buffer(physical_device, device, sizeof(Light) * MAX_LIGHTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, light_buffer, light_buffer_memory);
+            vkMapMemory(device, light_buffer_memory, 0, sizeof(Light) * MAX_LIGHTS, 0, &light_buffer_mapped);
+            
+            // Light lists are only accessed by the GPU
+            VkDeviceSize cluster_buffer_size = sizeof(unsigned) * CLUSTER_COUNT * (1u + MAX_LIGHTS_PER_CLUSTER);
+            create_buffer(physical_device, device, cluster_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cluster_buffer, cluster_buffer_memory);
+            
+            set_light_count(light_count);
+        }
+        
+        void destroy_light_buffers() {
+            vkDestroyBuffer(device, cluster_buffer, nullptr);
+            vkFreeMemory(device, cluster_buffer_memory, nullptr);
+            
+            vkUnmapMemory(device, light_buffer_memory);
+            vkDestroyBuffer(device, light_buffer, nullptr);
+            vkFreeMemory(device, light_buffer_memory, nullptr);
+        }
+        
+        void set_light_count(unsigned count) {
+            // Lights may still be read by frames in flight
+            vkDeviceWaitIdle(device);
+            
+            light_count = count;
+            
+            // Fixed seed so that every run (and every benchmark) uses the same lights
+            std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+            std::default_random_engine generator(1337u);
+            
+            Light* lights = reinterpret_cast<Light*>(light_buffer_mapped);
+            
+            // First light is a white light above the scene that covers the entire room
+            lights[0] = { };
+            lights[0].position = glm::vec3(0.0f, 3.0f, 1.0f);
+            lights[0].radius = 20.0f;
+            lights[0].color = glm::vec3(1.0f);
+            lights[0].type = 0;
+            
+            // The radius of the remaining lights shrinks as the number of lights grows, keeping the number of lights that overlap at any given point roughly the same
+            float radius = 1.5f * std::cbrt(32.0f / (float) count);
+            
+            for (unsigned i = 1u; i < count; ++i) {
+                Light& light = lights[i];
+                light = { };
+                
+                // Distributed within the room (walls at x = +-3, z = -3, floor at y = -1, ceiling at y = 5)
+                light.position = glm::vec3(distribution(generator) * 6.0f - 3.0f, distribution(generator) * 6.0f - 1.0f, distribution(generator) * 6.0f - 3.0f);
+                light.radius = radius * (0.75f + 0.5f * distribution(generator));
+                light.color = glm::vec3(distribution(generator), distribution(generator), distribution(generator)) * 0.8f + 0.2f;
+                
+                // Every other light is a spot light, pointing (roughly) downwards
+                light.type = (int) (i % 2u);
+                light.direction = glm::normalize(glm::vec3(distribution(generator) - 0.5f, -1.0f, distribution(generator) - 0.5f));
+                light.outer = std::cos(glm::radians(40.0f));
+                light.inner = std::cos(glm::radians(30.0f));
+            }
+            
+            // Timings of frames recorded before the change are discarded
+            std::fill(timestamps_written.begin(), timestamps_written.end(), false);
+        }
+        
+        void initialize_query_pool() {
+            timestamps_written.assign(NUM_FRAMES_IN_FLIGHT, false);
+            
+            // Timestamps must be supported on all graphics and compute queues
+            timestamps_supported = physical_device_properties.limits.timestampComputeAndGraphics == VK_TRUE;
+            if (!timestamps_supported) {
+                std::cout << "timestamp queries are not supported, GPU timings are not available" << std::endl;
+                return;
+            }
+            
+            VkQueryPoolCreateInfo query_pool_create_info { };
+            query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_create_info.queryCount = 3u * NUM_FRAMES_IN_FLIGHT;
+            if (vkCreateQueryPool(device, &query_pool_create_info, nullptr, &query_pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create query pool!");
+            }
+        }
+        
+        void destroy_query_pool() {
+            if (timestamps_supported) {
+                vkDestroyQueryPool(device, query_pool, nullptr);
+            }
+        }
+        
+        void update_timings() {
+            if (!timestamps_supported || !timestamps_written[frame_index]) {
+                return;
+            }
+            
+            std::uint64_t timestamps[3] { };
+            if (vkGetQueryPoolResults(device, query_pool, frame_index * 3u, 3u, sizeof(timestamps), timestamps, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+                return;
+            }
+            
+            // Timestamps are in units of timestampPeriod nanoseconds
+            double period = (double) physical_device_properties.limits.timestampPeriod / 1e6;
+            double culling_time = (double) (timestamps[1] - timestamps[0]) * period;
+            double frame_time = (double) (timestamps[2] - timestamps[0]) * period;
+            
+            if (benchmark.running) {
+                update_benchmark(culling_time, frame_time);
+            }
+        }
+        
+        void start_benchmark() {
+            if (!timestamps_supported) {
+                std::cout << "benchmark requires timestamp queries" << std::endl;
+                return;
+            }
+            
+            benchmark.running = true;
+            benchmark.step = 0u;
+            benchmark.frame = 0u;
+            benchmark.culling_time = 0.0;
+            benchmark.frame_time = 0.0;
+            benchmark.light_count = light_count;
+            benchmark.clustered = clustered;
+            
+            std::cout << std::setw(8) << "lights" << std::setw(16) << "culling (ms)" << std::setw(16) << "clustered (ms)" << std::setw(20) << "brute force (ms)" << std::endl;
+            
+            clustered = true;
+            set_light_count(LIGHT_COUNTS[0]);
+        }
+        
+        void update_benchmark(double culling_time, double frame_time) {
+            if (benchmark.frame++ < BENCHMARK_WARMUP_FRAMES) {
+                return;
+            }
+            
+            benchmark.culling_time += culling_time;
+            benchmark.frame_time += frame_time;
+            
+            if (benchmark.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_MEASURED_FRAMES) {
+                return;
+            }
+            
+            unsigned count = LIGHT_COUNTS[benchmark.step];
+            double average_culling_time = benchmark.culling_time / BENCHMARK_MEASURED_FRAMES;
+            double average_frame_time = benchmark.frame_time / BENCHMARK_MEASURED_FRAMES;
+            
+            benchmark.frame = 0u;
+            benchmark.culling_time = 0.0;
+            benchmark.frame_time = 0.0;
+            
+            if (clustered) {
+                benchmark.clustered_culling_time = average_culling_time;
+                benchmark.clustered_frame_time = average_frame_time;
+                
+                if (count <= BRUTE_FORCE_LIGHT_LIMIT) {
+                    // Measure the same light count with brute force shading
+                    clustered = false;
+                    std::fill(timestamps_written.begin(), timestamps_written.end(), false);
+                    return;
+                }
+            }
+            
+            std::cout << std::fixed << std::setprecision(3) << std::setw(8) << count << std::setw(16) << benchmark.clustered_culling_time << std::setw(16) << benchmark.clustered_frame_time;
+            if (!clustered) {
+                std::cout << std::setw(20) << average_frame_time << std::endl;
+            }
+            else {
+                std::cout << std::setw(20) << "-" << std::endl;
+            }
+            
+            if (++benchmark.step == sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0])) {
+                // Restore the configuration from before the benchmark
+                benchmark.running = false;
+                clustered = benchmark.clustered;
+                set_light_count(benchmark.light_count);
+                return;
+            }
+            
+            clustered = true;
+            set_light_count(LIGHT_COUNTS[benchmark.step]);
         }
         
         void destroy_uniform_buffer() {
@@ -1395,15 +1701,53 @@ class DeferredRendering final : public Sample {
             else if (key == GLFW_KEY_7) {
                 debug_view = DEPTH;
             }
+            else if (key == GLFW_KEY_C) {
+                clustered = !clustered;
+                std::cout << (clustered ? "clustered" : "brute force") << " shading" << std::endl;
+            }
+            else if (key == GLFW_KEY_L) {
+                // Cycle through light counts
+                std::size_t i = 0u;
+                while (LIGHT_COUNTS[i] != light_count) {
+                    ++i;
+                }
+                set_light_count(LIGHT_COUNTS[(i + 1u) % (sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]))]);
+                std::cout << light_count << " lights" << std::endl;
+            }
+            else if (key == GLFW_KEY_B) {
+                if (!benchmark.running) {
+                    start_benchmark();
+                }
+            }
+            else if (key == GLFW_KEY_M) {
+                single_pass = !single_pass;
+                
+                // Switching modes changes the render pass structure (and therefore the pipelines), as well as the type of the composition descriptors
+                vkDeviceWaitIdle(device);
+                
+                destroy_pipelines();
+                
+                vkFreeDescriptorSets(device, descriptor_pool, 1, &composition_global);
+                vkDestroyDescriptorSetLayout(device, composition_global_layout, nullptr);
+                
+                destroy_render_graph();
+                initialize_render_graph();
+                
+                initialize_composition_descriptor_set_layouts();
+                initialize_composition_descriptor_sets();
+                
+                initialize_pipelines();
+            }
             else if (key == GLFW_KEY_F) {
                 // Save screenshot of all attachments
                 take_screenshot(swapchain_images[frame_index], surface_format.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, "deferred_rendering.ppm"); // Output attachment
                 
-                take_screenshot(offscreen_framebuffer_attachments[POSITION].image, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "positions.ppm");
-                take_screenshot(offscreen_framebuffer_attachments[NORMAL].image, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "normals.ppm");
-                take_screenshot(offscreen_framebuffer_attachments[AMBIENT].image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "ambient.ppm");
-                take_screenshot(offscreen_framebuffer_attachments[DIFFUSE].image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "diffuse.ppm");
-                take_screenshot(offscreen_framebuffer_attachments[SPECULAR].image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "specular.ppm");
+                // Geometry buffer attachments are transient in single pass mode (contents are never written to memory)
+                // Attachments are saved in their encoded form (decoded attachments can be viewed with keys 2 - 7)
+                if (!single_pass) {
+                    take_screenshot(render_graph->get_image(geometry_buffer[NORMAL_ATTACHMENT]), GEOMETRY_BUFFER_NORMAL_FORMAT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "normals.ppm");
+                    take_screenshot(render_graph->get_image(geometry_buffer[MATERIAL_ATTACHMENT]), GEOMETRY_BUFFER_MATERIAL_FORMAT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, "material.ppm");
+                }
             }
         }
         
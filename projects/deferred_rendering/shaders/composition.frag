@@ -1,95 +1,184 @@
 
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "common/geometry_buffer.glsl"
 
 layout (location = 0) in vec2 vertex_uv;
 
-layout (binding = 0) uniform sampler2D positions;
-layout (binding = 1) uniform sampler2D normals;
-layout (binding = 2) uniform sampler2D ambient;
-layout (binding = 3) uniform sampler2D diffuse;
-layout (binding = 4) uniform sampler2D specular;
-layout (binding = 5) uniform sampler2D depth;
+#ifdef INPUT_ATTACHMENTS
+// Single pass: geometry buffer attachments are read at the current pixel from the previous subpass
+layout (input_attachment_index = 0, binding = 0) uniform subpassInput normals;
+layout (input_attachment_index = 1, binding = 1) uniform subpassInput materials;
+layout (input_attachment_index = 2, binding = 2) uniform subpassInput depth;
+
+#define READ(attachment) subpassLoad(attachment)
+#else
+layout (binding = 0) uniform sampler2D normals;
+layout (binding = 1) uniform sampler2D materials;
+layout (binding = 2) uniform sampler2D depth;
+
+#define READ(attachment) texture(attachment, vertex_uv)
+#endif
+
+// CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, MAX_LIGHTS_PER_CLUSTER are provided when the shader is compiled
+#define CLUSTER_COUNT (CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z)
 
 struct Light {
-    vec3 position;
+    vec3 position; // World space
     float radius;
+    vec3 color;
+    int type; // 0 - point, 1 - spot
+    vec3 direction; // World space
+    float outer; // Cosine of the outer cone angle
+    float inner; // Cosine of the inner cone angle
 };
 
-layout (set = 0, binding = 6) uniform LightingUniforms {
+layout (set = 0, binding = 3) uniform LightingUniforms {
     mat4 view;
     vec3 camera_position;
-    // TODO: lights array
 } lighting;
 
 // For viewing individual attachments
-layout (set = 0, binding = 7) uniform RenderSettings {
+layout (set = 0, binding = 4) uniform RenderSettings {
     int view;
 } settings;
 
+// MATERIAL_COUNT is provided when the shader is compiled
+layout (set = 0, binding = 5) uniform MaterialUniforms {
+    Material materials[MATERIAL_COUNT];
+} material_table;
+
+layout (set = 0, binding = 6) uniform ClusterUniforms {
+    mat4 view;
+    mat4 inverse_projection;
+    vec2 tile_size; // Size of a cluster in screen space (pixels)
+    float z_scale; // Depth slice of a view space depth z is log(z) * z_scale + z_bias
+    float z_bias;
+    float near;
+    float far;
+    uint light_count;
+    int clustered; // Lights are culled per cluster (otherwise, all lights are evaluated for every pixel)
+} clusters;
+
+layout (set = 0, binding = 7) readonly buffer Lights {
+    Light lights[];
+};
+
+// Written by the light culling compute pass
+layout (set = 0, binding = 8) readonly buffer ClusterLights {
+    uint counts[CLUSTER_COUNT];
+    uint indices[];
+} cluster_lights;
+
 layout (location = 0) out vec4 out_color;
 
+// Returns the diffuse + specular contribution of a light (all vectors in view space)
+vec3 shade(Light light, vec3 position, vec3 N, vec3 V, vec3 diffuse_color, vec4 specular_color) {
+    vec3 L = (lighting.view * vec4(light.position, 1.0f)).xyz - position;
+    float d = length(L);
+    if (d > light.radius) {
+        return vec3(0.0f);
+    }
+    L /= d;
+
+    // Smooth falloff to 0 at the radius of the light
+    float attenuation = clamp(1.0f - (d * d) / (light.radius * light.radius), 0.0f, 1.0f);
+    attenuation *= attenuation;
+
+    if (light.type == 1) {
+        // Spot light
+        vec3 direction = normalize(mat3(lighting.view) * light.direction);
+        attenuation *= smoothstep(light.outer, light.inner, dot(-L, direction));
+    }
+
+    // Diffuse
+    float lambert = max(dot(N, L), 0.0f);
+    vec3 color = diffuse_color * lambert;
+
+    // Specular
+    if (lambert > 0.0f) {
+        // Specular highlights only happen with visible faces
+        vec3 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
+        if (max(dot(R, V), 0.0f) > 0.0f) {
+            color += specular_color.rgb * pow(max(dot(R, V), 0.0f), specular_color.a);
+        }
+    }
+
+    return light.color * color * attenuation;
+}
+
+Material get_material(vec4 material) {
+    // Cleared pixels (no geometry) have an out of range material index
+    return material_table.materials[min(decode_material_index(material), uint(MATERIAL_COUNT - 1))];
+}
+
 void main() {
+    float z = READ(depth).r;
+    vec3 position = reconstruct_position(vertex_uv, z, clusters.inverse_projection); // View space
+    vec3 N = decode_normal(READ(normals).xy);
+
+    vec4 encoded_material = READ(materials);
+    Material material = get_material(encoded_material);
+
     if (settings.view == 0) {
         // Output positions
-        out_color = vec4(texture(positions, vertex_uv).xyz, 1.0f);
+        out_color = vec4(position, 1.0f);
     }
     else if (settings.view == 1) {
         // Output normals
-        out_color = vec4(texture(normals, vertex_uv).xyz, 1.0f);
+        out_color = vec4(N, 1.0f);
     }
     else if (settings.view == 2) {
         // Output ambient
-        out_color = vec4(texture(ambient, vertex_uv).xyz, 1.0f);
+        out_color = vec4(material.ambient.rgb, 1.0f);
     }
     else if (settings.view == 3) {
         // Output diffuse
-        out_color = vec4(texture(diffuse, vertex_uv).xyz, 1.0f);
+        out_color = vec4(encoded_material.rgb, 1.0f);
     }
     else if (settings.view == 4) {
         // Output specular (rgb) + specular exponent (a)
-        out_color = texture(specular, vertex_uv);
+        out_color = material.specular;
     }
     else if (settings.view == 5) {
         // Output depth
-        // Depth information is stored in the r channel (depth buffer is a 1-channel image)
-        float z = texture(depth, vertex_uv).r;
-
         // Linearlize depth
         float camera_near = 0.01f;
         float camera_far = 10.0f;
-        float depth = (2.0 * camera_near) / (camera_far + camera_near - z * (camera_far - camera_near));
+        float linear_depth = (2.0 * camera_near) / (camera_far + camera_near - z * (camera_far - camera_near));
 
-        out_color = vec4(vec3(depth), 1.0f);
+        out_color = vec4(vec3(linear_depth), 1.0f);
+    }
+    else if (z == 1.0f) {
+        // Nothing was rendered to this pixel
+        out_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     }
     else {
         // Output lighting
-        vec3 color = vec3(0.0f);
-
-        vec4 view_position = texture(positions, vertex_uv);
-        vec4 N = texture(normals, vertex_uv);
-        vec4 V = normalize((lighting.view * vec4(lighting.camera_position, 1.0f)) - view_position);
+        vec3 V = normalize(-position); // Camera is at the origin in view space
 
-        // Hardcode one light for the time being
-        vec4 light_position = vec4(0.0f, 3.f, 1.0f, 1.0f);
-        vec3 light_color = vec3(1.0f, 1.0f, 1.0f);
-
-        vec4 L = normalize((lighting.view * light_position) - view_position);
+        vec3 diffuse_color = encoded_material.rgb;
+        vec4 specular_color = material.specular; // specular color.rgb, specular exponent
 
         // Ambient
-        color += texture(ambient, vertex_uv).xyz;
-
-        // Diffuse
-        float lambert = max(dot(N, L), 0.0f);
-        color += light_color * texture(diffuse, vertex_uv).xyz * lambert;
-
-        // Specular
-        if (lambert > 0.0f) {
-            vec4 specular = texture(specular, vertex_uv);
-
-            // Specular highlights only happen with visible faces
-            vec4 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
-            if (max(dot(R, V), 0.0f) > 0.0f) {
-                color += specular.xyz * pow(max(dot(R, V), 0.0f), specular.a);
+        vec3 color = material.ambient.rgb;
+
+        if (clusters.clustered == 1) {
+            // Only lights binned into the cluster containing this pixel contribute
+            uvec3 id;
+            id.xy = min(uvec2(gl_FragCoord.xy / clusters.tile_size), uvec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+            id.z = uint(clamp(log(-position.z) * clusters.z_scale + clusters.z_bias, 0.0f, float(CLUSTER_COUNT_Z - 1)));
+            uint cluster = id.x + id.y * CLUSTER_COUNT_X + id.z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+
+            uint count = cluster_lights.counts[cluster];
+            for (uint i = 0u; i < count; ++i) {
+                color += shade(lights[cluster_lights.indices[cluster * MAX_LIGHTS_PER_CLUSTER + i]], position, N, V, diffuse_color, specular_color);
+            }
+        }
+        else {
+            for (uint i = 0u; i < clusters.light_count; ++i) {
+                color += shade(lights[i], position, N, V, diffuse_color, specular_color);
             }
         }
 
@@ -1,5 +1,8 @@
 
 #version 450 core
+#extension GL_GOOGLE_include_directive : require
+
+#include "common/geometry_buffer.glsl"
 
 layout (location = 0) in vec3 view_position;
 layout (location = 1) in vec3 view_normal;
@@ -10,18 +13,14 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
     vec3 camera_position;
 } globals;
 
+// Ambient and specular terms are stored in the material table, indexed by 'material'
 layout (set = 1, binding = 1) uniform PhongUniforms {
-    vec3 ambient;
     vec3 diffuse;
-    vec3 specular;
-    float specular_exponent;
+    uint material;
 } shading;
 
-layout (location = 0) out vec3 out_position;
-layout (location = 1) out vec3 out_normal;
-layout (location = 2) out vec3 out_ambient;
-layout (location = 3) out vec3 out_diffuse;
-layout (location = 4) out vec4 out_specular; // (r, g, b, exponent)
+layout (location = 0) out vec2 out_normal; // Octahedral encoded (view space)
+layout (location = 1) out vec4 out_material; // (diffuse r, g, b, material index)
 
 float normal_blend = 0.0f;
 vec3 calculate_face_normal(vec3 position) {
@@ -31,9 +30,6 @@ vec3 calculate_face_normal(vec3 position) {
 }
 
 void main() {
-    out_position = view_position.xyz;
-    out_normal = mix(calculate_face_normal(view_position), normalize(view_normal), normal_blend); // Normal color
-    out_ambient = shading.ambient;
-    out_diffuse = shading.diffuse;
-    out_specular = vec4(shading.specular, shading.specular_exponent);
+    out_normal = encode_normal(normalize(mix(calculate_face_normal(view_position), normalize(view_normal), normal_blend)));
+    out_material = encode_material(shading.diffuse, shading.material);
 }
@@ -1,6 +1,8 @@
 
 #version 450
 
+#include "common/geometry_buffer.glsl"
+
 layout (location = 0) in vec2 vertex_uv;
 
 layout (set = 0, binding = 0) uniform GlobalUniforms {
@@ -9,10 +11,12 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
     vec3 camera_position; // Unused
     int debug_view;
     float camera_far_plane;
+    mat4 inverse_view_projection; // For reconstructing world space positions from depth
 } global;
 
 layout (set = 0, binding = 1) uniform LightUniforms {
     mat4 transform[6];
+    vec4 slots[6]; // Slot of each cube face in the shadow atlas, in texture coordinates (x, y: origin, z: size)
     vec3 position;
     float outer;
     vec3 direction;
@@ -20,12 +24,16 @@ layout (set = 0, binding = 1) uniform LightUniforms {
     vec3 color;
 } light;
 
-layout (set = 0, binding = 2) uniform sampler2D positions; // world space
-layout (set = 0, binding = 3) uniform sampler2D normals; // world space
-layout (set = 0, binding = 4) uniform sampler2D ambient;
-layout (set = 0, binding = 5) uniform sampler2D diffuse;
-layout (set = 0, binding = 6) uniform sampler2D specular;
-layout (set = 0, binding = 7) uniform samplerCube shadow;
+// Geometry buffer attachments are read at the current pixel from the previous subpass
+layout (input_attachment_index = 0, set = 0, binding = 2) uniform subpassInput normals; // world space, octahedral encoded
+layout (input_attachment_index = 1, set = 0, binding = 3) uniform subpassInput materials;
+layout (set = 0, binding = 4) uniform sampler2D depth;
+layout (set = 0, binding = 5) uniform sampler2D shadow; // Shadow atlas, one slot per cube face
+
+// MATERIAL_COUNT is provided when the shader is compiled
+layout (set = 0, binding = 6) uniform MaterialUniforms {
+    Material materials[MATERIAL_COUNT];
+} material_table;
 
 layout (location = 0) out vec4 out_color;
 
@@ -35,10 +43,36 @@ float linearize(float d) {
     return (2.0 * camera_near) / (camera_far + camera_near - d * (camera_far - camera_near));
 }
 
+// Returns the cube face whose frustum contains the direction (needs to match the order of the light transforms: +x, -x, +y, -y, +z, -z)
+int get_cube_face(vec3 direction) {
+    vec3 a = abs(direction);
+    if (a.x >= a.y && a.x >= a.z) {
+        return direction.x > 0.0f ? 0 : 1;
+    }
+    else if (a.y >= a.z) {
+        return direction.y > 0.0f ? 2 : 3;
+    }
+    return direction.z > 0.0f ? 4 : 5;
+}
+
 float shadowing(vec3 position) {
     vec3 fragment_to_light = position - light.position;
 
-    float closest = texture(shadow, fragment_to_light).r * global.camera_far_plane;
+    int face = get_cube_face(fragment_to_light);
+    vec4 slot = light.slots[face];
+    if (slot.z == 0.0f) {
+        // Face did not receive a slot in the atlas (it does not cover any visible geometry)
+        return 0.0f;
+    }
+
+    vec4 shadow_position = light.transform[face] * vec4(position, 1.0f);
+    vec2 face_uv = (shadow_position.xy / shadow_position.w) * 0.5f + 0.5f; // [0.0, 1.0]
+
+    // Keep filtering from reading texels of neighboring slots
+    vec2 half_texel = 0.5f / vec2(textureSize(shadow, 0));
+    vec2 uv = slot.xy + clamp(face_uv * slot.z, half_texel, slot.z - half_texel);
+
+    float closest = texture(shadow, uv).r * global.camera_far_plane;
     float current = length(fragment_to_light);
 
     // Shadowing is determined by comparing the distance from the light to the point to the (linearized) depth at the point when rendered from the lights POV
@@ -48,23 +82,33 @@ float shadowing(vec3 position) {
 }
 
 void main() {
-    vec3 position = texture(positions, vertex_uv).xyz;
-    vec3 N = texture(normals, vertex_uv).xyz;
+    float d = texture(depth, vertex_uv).r;
+    if (d == 1.0f) {
+        // Background
+        out_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+
+    vec4 material = subpassLoad(materials);
+    Material m = material_table.materials[min(decode_material_index(material), uint(MATERIAL_COUNT - 1))];
+
+    vec3 position = reconstruct_position(vertex_uv, d, global.inverse_view_projection);
+    vec3 N = decode_normal(subpassLoad(normals).xy);
     vec3 V = normalize(global.camera_position - position);
 
     vec3 L = normalize(light.position - position);
 
     // Ambient
-    vec3 ambient_component = texture(ambient, vertex_uv).xyz;
+    vec3 ambient_component = m.ambient.rgb;
 
     // Diffuse
     float lambert = max(dot(N, L), 0.0f);
-    vec3 diffuse_component = light.color * texture(diffuse, vertex_uv).rgb * lambert;
+    vec3 diffuse_component = light.color * material.rgb * lambert;
 
     // Specular
     vec3 specular_component = vec3(0.0f);
     if (lambert > 0.0f) {
-        vec4 s = texture(specular, vertex_uv); // specular color.rgb, specular exponent
+        vec4 s = m.specular; // specular color.rgb, specular exponent
 
         // Specular highlights only happen with visible faces
         vec3 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
@@ -11,6 +11,7 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
 
 layout (set = 0, binding = 1) uniform LightUniforms {
     mat4 transform[6];
+    vec4 slots[6]; // Slot of each cube face in the shadow atlas, in texture coordinates (x, y: origin, z: size)
     vec3 position;
     float outer;
     vec3 direction;
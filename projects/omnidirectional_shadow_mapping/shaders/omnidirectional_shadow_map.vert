@@ -1,14 +1,43 @@
-
 #version 450
 
 layout (location = 0) in vec3 vertex_position;
+layout (location = 1) in uint face; // Per instance, one instance per cube face that can see the object
+
+layout (location = 0) out vec3 world_position;
+
+layout (set = 0, binding = 1) uniform LightUniforms {
+    mat4 transform[6];
+    vec4 slots[6]; // Slot of each cube face in the shadow atlas, in texture coordinates (x, y: origin, z: size)
+    vec3 position;
+    float outer;
+    vec3 direction;
+    float inner;
+    vec3 color;
+} light;
 
 layout (set = 1, binding = 0) uniform ObjectTransforms {
     mat4 model;
     mat4 normal;
 } object;
 
+out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_ClipDistance[4];
+};
+
 void main() {
-    // Output vertices in world space
-    gl_Position = object.model * vec4(vertex_position, 1.0f);
+    world_position = (object.model * vec4(vertex_position, 1.0f)).xyz;
+    vec4 position = light.transform[face] * vec4(world_position, 1.0f);
+
+    // Geometry outside of the frustum of the face is clipped against the edges of the frustum (instead of the viewport, which covers the entire atlas) so that it does not bleed into neighboring slots
+    gl_ClipDistance[0] = position.w + position.x;
+    gl_ClipDistance[1] = position.w - position.x;
+    gl_ClipDistance[2] = position.w + position.y;
+    gl_ClipDistance[3] = position.w - position.y;
+
+    // The shadow framebuffer has one depth attachment (the atlas), scale and offset the frustum of the face into its slot
+    // [-1, 1] maps to [origin, origin + size] in texture coordinates, which is [2 * origin - 1, 2 * (origin + size) - 1] in normalized device coordinates
+    vec2 origin = light.slots[face].xy;
+    float size = light.slots[face].z;
+    gl_Position = vec4(position.xy * size + position.w * (2.0f * origin + size - 1.0f), position.zw);
 }
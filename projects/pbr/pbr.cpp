@@ -3,12 +3,22 @@
 #include "helpers.hpp"
 #include "vulkan_initializers.hpp"
 #include "loaders/obj.hpp"
+#include "texture_cache.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan requires depth values to range [0.0, 1.0], not the default [-1.0, 1.0] that OpenGL uses
 #include <glm/gtx/transform.hpp>
 #include <string> // std::string, std::to_string
 #include <chrono> // std::chrono::high_resolution_clock
+#include <array> // std::array
+#include <initializer_list> // std::initializer_list
+#include <cstdint> // std::uint64_t
+#include <cmath> // std::sqrt, std::abs, std::floor, std::log2
+#include <algorithm> // std::max, std::sort, std::find
+#include <future> // std::future, std::async
+#include <filesystem> // std::filesystem::directory_iterator
+#include <utility> // std::swap
+#include <limits> // std::numeric_limits
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -19,6 +29,16 @@ class PBR final : public Sample {
     public:
         PBR() : Sample("Physically-Based Rendering") {
             enabled_physical_device_features.geometryShader = (VkBool32) true;
+            
+            // Compute shaders write to storage images without a format qualifier, so that the formats of the precomputed textures can be selected at runtime
+            enabled_physical_device_features.shaderStorageImageWriteWithoutFormat = (VkBool32) true;
+            
+            // Prefiltering indexes into an array of storage images (one per mipmap level)
+            enabled_physical_device_features.shaderStorageImageArrayDynamicIndexing = (VkBool32) true;
+            
+            // Environments loaded at runtime are baked in the background (see load_environment)
+            async_compute_requested = true;
+            
             width = 2560;
             height = 1440;
         }
@@ -51,14 +71,93 @@ class PBR final : public Sample {
         Texture roughness;
         Texture normals;
         
-        unsigned environment_map_size = 1024u;
-        unsigned brdf_lut_size = 512u;
+        // Resolution of the precomputed image-based lighting textures (per cubemap face)
+        // The environment map is only an input to the bakes, the base level of the prefiltered environment map is copied from the environment map mipmap level of the same size
+        unsigned environment_map_size = 512u;
+        unsigned prefiltered_environment_map_size = 256u;
+        unsigned brdf_lut_size = 128u; // The BRDF LUT is a smooth function of (NdotV, roughness)
+        
+        // Formats of the precomputed image-based lighting textures, selected from the formats supported by the device (see select_ibl_formats)
+        VkFormat hdr_format; // Environment / prefiltered environment map
+        VkFormat brdf_lut_format;
+        
+        // Image-based lighting textures that depend on the environment, along with the descriptor sets that reference them
+        struct EnvironmentLighting {
+            Texture irradiance_sh; // Spherical harmonics coefficients of the irradiance (9 x 1)
+            Texture prefiltered_environment_map;
+            
+            VkDescriptorSet global_descriptor_set;
+            VkDescriptorSet skybox_descriptor_set;
+        };
+        
+        // Lighting of the environment that is currently being rendered, and a second set of textures that new environments are baked into in the background
+        // The two are swapped once a bake completes (see update_environment)
+        EnvironmentLighting lighting;
+        EnvironmentLighting baked_lighting;
+        unsigned baked_lighting_frames = 0u; // Number of frames until 'baked_lighting' is no longer referenced by frames in flight
+        
+        Texture brdf_lut; // Does not depend on the environment
+        
+        // HDR environment maps in assets/textures, cycled through at runtime
+        std::vector<std::string> environments;
+        unsigned environment_index = 0u;
+        std::string requested_environment; // Environment to bake next (see load_environment)
+        
+        struct ComputePipeline {
+            VkDescriptorSetLayout descriptor_set_layout;
+            VkPipelineLayout layout;
+            VkPipeline pipeline;
+        };
+        
+        // Pipelines for baking environment-dependent textures are kept alive for the lifetime of the sample, as creating pipelines at runtime causes frame hitches
+        ComputePipeline equirectangular_to_cubemap_pipeline;
+        ComputePipeline irradiance_sh_pipeline;
+        ComputePipeline prefilter_pipeline;
+        
+        // Environment map decoded (and written into a staging buffer) on a worker thread
+        struct DecodedEnvironment {
+            VkBuffer staging_buffer;
+            VkDeviceMemory staging_buffer_memory;
+            unsigned width;
+            unsigned height;
+        };
+        
+        // The bake of the environment-dependent textures is split into steps that can be recorded into separate command buffers, to spread the work of a bake at runtime across multiple frames
+        // Step 0 converts the equirectangular environment map into a cubemap and generates its mipmaps, step 1 projects the irradiance and copies the base level of the prefiltered environment map, and each of the remaining steps prefilters one face of one mipmap level
+        struct EnvironmentBake {
+            bool active;
+            std::string filepath;
+            EnvironmentLighting* target;
+            
+            std::future<DecodedEnvironment> decoded; // Only valid while the environment map is being decoded
+            DecodedEnvironment source;
+            
+            // Only valid while baking
+            Texture equirectangular;
+            Texture environment_map;
+            std::vector<VkImageView> prefiltered_views; // Storage image views of the mipmap tail of the prefiltered environment map
+            
+            VkDescriptorSet equirectangular_descriptor_set;
+            VkDescriptorSet irradiance_descriptor_set;
+            VkDescriptorSet prefilter_descriptor_set;
+            
+            unsigned step; // Next step to record
+            unsigned frames; // Number of frames the bake has been running for
+            std::chrono::high_resolution_clock::time_point start;
+        };
+        EnvironmentBake bake { };
+        
+        // Steps of runtime bakes are submitted to the async compute queue (if available), so that they can overlap with rendering
+        // Generating mipmaps requires a queue with graphics support, so only a second queue from the graphics queue family is used
+        VkQueue bake_queue;
+        VkCommandBuffer bake_command_buffer;
+        VkFence bake_fence; // Signaled when the last submitted step has completed
         
-        Texture environment_map;
-        Texture irradiance_map;
+        // Precomputed textures from previous runs (relative to the working directory)
+        TextureCache ibl_cache { "cache/pbr" };
         
-        Texture prefiltered_environment_map;
-        Texture brdf_lut;
+        // Additionally bakes the irradiance cubemap and prints a comparison against the spherical harmonics irradiance (bypasses the cache)
+        bool compare_irradiance = false;
         
         VkSampler color_sampler;
         VkSampler environment_map_sampler;
@@ -70,10 +169,7 @@ class PBR final : public Sample {
         VkDeviceMemory index_buffer_memory;
         
         VkDescriptorSetLayout global_descriptor_set_layout;
-        VkDescriptorSet global_descriptor_set;
-        
         VkDescriptorSetLayout skybox_descriptor_set_layout;
-        VkDescriptorSet skybox_descriptor_set;
         
         VkDescriptorSetLayout bloom_descriptor_set_layout;
         VkDescriptorSet bloom_descriptor_set;
@@ -131,7 +227,9 @@ class PBR final : public Sample {
         void initialize_resources() override {
             initialize_scene();
             
-            initialize_descriptor_pool(1 + transforms.size() + 2, 5);
+            // Global and skybox descriptor sets are allocated for both sets of environment lighting textures
+            // Descriptor sets for baking the environment are allocated for the duration of a bake
+            initialize_descriptor_pool(transforms.size() + 4, 2 * 9 + 4, 0, 0, 6);
             
             initialize_samplers();
             initialize_textures();
@@ -156,6 +254,9 @@ class PBR final : public Sample {
         }
         
         void destroy_resources() override {
+            cancel_environment_bake();
+            destroy_environment_bake_resources();
+            
             destroy_pipelines();
             destroy_descriptor_sets();
             destroy_uniform_buffer();
@@ -172,6 +273,7 @@ class PBR final : public Sample {
                 transform.set_rotation(transform.get_rotation() + (float) dt * glm::vec3(0.0f, 0.0f, 15.0f));
             }
             
+            update_environment();
             update_uniform_buffers();
         }
         
@@ -203,7 +305,7 @@ class PBR final : public Sample {
                 // Skybox render pass
                 vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
                     vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skybox_pipeline);
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skybox_pipeline_layout, 0, 1, &skybox_descriptor_set, 0, nullptr);
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skybox_pipeline_layout, 0, 1, &lighting.skybox_descriptor_set, 0, nullptr);
 
                     // Update push constants
                     vkCmdPushConstants(command_buffer, skybox_pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(unsigned), &mipmap_level);
@@ -236,7 +338,7 @@ class PBR final : public Sample {
                     vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
                     // Bind global descriptor set
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &global_descriptor_set, 0, nullptr);
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &lighting.global_descriptor_set, 0, nullptr);
 
                     // TODO: convert to instanced rendering
                     for (std::size_t i = 0u; i < transforms.size(); ++i) {
@@ -834,51 +936,54 @@ class PBR final : public Sample {
             }
             
             // Initialize descriptor sets
-            VkDescriptorSetAllocateInfo set_create_info { };
-            set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            set_create_info.descriptorPool = descriptor_pool;
-            set_create_info.descriptorSetCount = 1;
-            set_create_info.pSetLayouts = &global_descriptor_set_layout;
-            if (vkAllocateDescriptorSets(device, &set_create_info, &global_descriptor_set) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate descriptor set!");
-            }
-            
-            VkWriteDescriptorSet descriptor_write { };
-            VkDescriptorBufferInfo buffer_info { };
-            
-            // Binding 0
-            buffer_info.buffer = uniform_buffer;
-            buffer_info.offset = 0u;
-            buffer_info.range = sizeof(GlobalUniforms);
-            
-            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_write.dstSet = global_descriptor_set;
-            descriptor_write.dstBinding = 0;
-            descriptor_write.dstArrayElement = 0;
-            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptor_write.descriptorCount = 1;
-            descriptor_write.pBufferInfo = &buffer_info;
-            
-            vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
-            
-            // Bindings 1 - 8
-            VkImageView textures[8] = { albedo.view, ao.view, emissive.view, roughness.view, normals.view, irradiance_map.view, prefiltered_environment_map.view, brdf_lut.view };
-            VkSampler samplers[8] = { color_sampler, color_sampler, color_sampler, environment_map_sampler, environment_map_sampler, environment_map_sampler, environment_map_sampler, environment_map_sampler };
-            for (int i = 0; i < sizeof(textures) / sizeof(textures[0]); ++i) {
-                VkDescriptorImageInfo image_info { };
-                image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                image_info.imageView = textures[i];
-                image_info.sampler = samplers[i];
+            // Both sets of environment lighting textures get their own descriptor set, so that swapping environments only requires binding a different descriptor set
+            for (EnvironmentLighting* target : { &lighting, &baked_lighting }) {
+                VkDescriptorSetAllocateInfo set_create_info { };
+                set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                set_create_info.descriptorPool = descriptor_pool;
+                set_create_info.descriptorSetCount = 1;
+                set_create_info.pSetLayouts = &global_descriptor_set_layout;
+                if (vkAllocateDescriptorSets(device, &set_create_info, &target->global_descriptor_set) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate descriptor set!");
+                }
+                
+                VkWriteDescriptorSet descriptor_write { };
+                VkDescriptorBufferInfo buffer_info { };
+                
+                // Binding 0
+                buffer_info.buffer = uniform_buffer;
+                buffer_info.offset = 0u;
+                buffer_info.range = sizeof(GlobalUniforms);
                 
                 descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptor_write.dstSet = global_descriptor_set;
-                descriptor_write.dstBinding = 1 + i;
+                descriptor_write.dstSet = target->global_descriptor_set;
+                descriptor_write.dstBinding = 0;
                 descriptor_write.dstArrayElement = 0;
-                descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
                 descriptor_write.descriptorCount = 1;
-                descriptor_write.pImageInfo = &image_info;
+                descriptor_write.pBufferInfo = &buffer_info;
                 
                 vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+                
+                // Bindings 1 - 8
+                VkImageView textures[8] = { albedo.view, ao.view, emissive.view, roughness.view, normals.view, target->irradiance_sh.view, target->prefiltered_environment_map.view, brdf_lut.view };
+                VkSampler samplers[8] = { color_sampler, color_sampler, color_sampler, environment_map_sampler, environment_map_sampler, environment_map_sampler, environment_map_sampler, environment_map_sampler };
+                for (int i = 0; i < sizeof(textures) / sizeof(textures[0]); ++i) {
+                    VkDescriptorImageInfo image_info { };
+                    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    image_info.imageView = textures[i];
+                    image_info.sampler = samplers[i];
+                    
+                    descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptor_write.dstSet = target->global_descriptor_set;
+                    descriptor_write.dstBinding = 1 + i;
+                    descriptor_write.dstArrayElement = 0;
+                    descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    descriptor_write.descriptorCount = 1;
+                    descriptor_write.pImageInfo = &image_info;
+                    
+                    vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+                }
             }
         }
         
@@ -900,46 +1005,48 @@ class PBR final : public Sample {
             }
             
             // Initialize descriptor sets
-            VkDescriptorSetAllocateInfo set_create_info { };
-            set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            set_create_info.descriptorPool = descriptor_pool;
-            set_create_info.descriptorSetCount = 1;
-            set_create_info.pSetLayouts = &skybox_descriptor_set_layout;
-            if (vkAllocateDescriptorSets(device, &set_create_info, &skybox_descriptor_set) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate skybox descriptor set!");
+            for (EnvironmentLighting* target : { &lighting, &baked_lighting }) {
+                VkDescriptorSetAllocateInfo set_create_info { };
+                set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                set_create_info.descriptorPool = descriptor_pool;
+                set_create_info.descriptorSetCount = 1;
+                set_create_info.pSetLayouts = &skybox_descriptor_set_layout;
+                if (vkAllocateDescriptorSets(device, &set_create_info, &target->skybox_descriptor_set) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate skybox descriptor set!");
+                }
+                
+                VkWriteDescriptorSet descriptor_write { };
+                VkDescriptorBufferInfo buffer_info { };
+                
+                // Binding 0
+                buffer_info.buffer = uniform_buffer;
+                buffer_info.offset = 0u;
+                buffer_info.range = sizeof(GlobalUniforms);
+                
+                descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_write.dstSet = target->skybox_descriptor_set;
+                descriptor_write.dstBinding = 0;
+                descriptor_write.dstArrayElement = 0;
+                descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                descriptor_write.descriptorCount = 1;
+                descriptor_write.pBufferInfo = &buffer_info;
+                
+                vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+                VkDescriptorImageInfo image_info { };
+                image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                image_info.imageView = target->prefiltered_environment_map.view;
+                image_info.sampler = environment_map_sampler;
+                
+                descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_write.dstSet = target->skybox_descriptor_set;
+                descriptor_write.dstBinding = 1;
+                descriptor_write.dstArrayElement = 0;
+                descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptor_write.descriptorCount = 1;
+                descriptor_write.pImageInfo = &image_info;
+                
+                vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
             }
-            
-            VkWriteDescriptorSet descriptor_write { };
-            VkDescriptorBufferInfo buffer_info { };
-            
-            // Binding 0
-            buffer_info.buffer = uniform_buffer;
-            buffer_info.offset = 0u;
-            buffer_info.range = sizeof(GlobalUniforms);
-            
-            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_write.dstSet = skybox_descriptor_set;
-            descriptor_write.dstBinding = 0;
-            descriptor_write.dstArrayElement = 0;
-            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptor_write.descriptorCount = 1;
-            descriptor_write.pBufferInfo = &buffer_info;
-            
-            vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
-            VkDescriptorImageInfo image_info { };
-            image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_info.imageView = prefiltered_environment_map.view;
-            image_info.sampler = environment_map_sampler;
-            
-            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_write.dstSet = skybox_descriptor_set;
-            descriptor_write.dstBinding = 1;
-            descriptor_write.dstArrayElement = 0;
-            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_write.descriptorCount = 1;
-            descriptor_write.pImageInfo = &image_info;
-            
-            vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
         }
         
         void initialize_object_descriptor_sets() {
@@ -1244,57 +1351,6 @@ class PBR final : public Sample {
             vkDestroyBuffer(device, staging_buffer, nullptr);
         }
         
-        void load_hdr_texture(const char* filepath, Texture& texture) {
-            int width;
-            int height;
-            int channels;
-//            stbi_set_flip_vertically_on_load(true);
-            float* image_data = stbi_loadf(filepath, &width, &height, &channels, STBI_rgb_alpha);
-            if (!image_data) {
-                throw std::runtime_error("failed to load HDR texture!");
-            }
-            
-            texture.width = width;
-            texture.height = height;
-            
-            create_image(physical_device, device, width, height, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
-            create_image_view(device, texture.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 1, texture.view);
-            
-            VkBuffer staging_buffer { };
-            VkDeviceMemory staging_buffer_memory { };
-            VkBufferUsageFlags staging_buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            VkMemoryPropertyFlags staging_buffer_memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            
-            std::size_t staging_buffer_size = width * height * 4 * sizeof(float);
-            create_buffer(physical_device, device, staging_buffer_size, staging_buffer_usage, staging_buffer_memory_properties, staging_buffer, staging_buffer_memory);
-            
-            // Upload image pixel data into staging buffer
-            void* data;
-            vkMapMemory(device, staging_buffer_memory, 0, staging_buffer_size, 0, &data);
-                memcpy(data, image_data, staging_buffer_size);
-            vkUnmapMemory(device, staging_buffer_memory);
-            
-            stbi_image_free(image_data); // No longer necessary
-            
-            VkImageSubresourceRange subresource_range { };
-            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            subresource_range.baseMipLevel = 0;
-            subresource_range.levelCount = 1;
-            subresource_range.baseArrayLayer = 0;
-            subresource_range.layerCount = 1;
-            
-            VkCommandBuffer command_buffer = begin_transient_command_buffer();
-                transition_image(command_buffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-                copy_buffer_to_image(command_buffer, staging_buffer, 0, texture.image, 0, width, height);
-                // All shader read operations must wait until the transfer stage is completed
-                transition_image(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-            submit_transient_command_buffer(command_buffer);
-            
-            // Staging buffer resources are no longer necessary
-            vkFreeMemory(device, staging_buffer_memory, nullptr);
-            vkDestroyBuffer(device, staging_buffer, nullptr);
-        }
-        
         void initialize_textures() {
             // SRGB
             load_rgba_texture("assets/models/damaged_helmet/Default_albedo.jpg", albedo, VK_FORMAT_R8G8B8A8_SRGB);
@@ -1303,96 +1359,32 @@ class PBR final : public Sample {
             load_rgba_texture("assets/models/damaged_helmet/Default_metalRoughness.jpg", roughness, VK_FORMAT_R8G8B8A8_SRGB);
             load_rgba_texture("assets/models/damaged_helmet/Default_normal.jpg", normals, VK_FORMAT_R8G8B8A8_UNORM);
             
-            // Load (equirectangular) environment map
-            Texture environment { };
-            load_hdr_texture("assets/textures/loft.hdr", environment);
             mipmap_level = 1u; // Render slightly blurred
             
-            unsigned layers = 6u;
-            unsigned mipmap_levels = compute_num_mipmap_levels(environment_map_size, environment_map_size);
+            initialize_environments();
             
-            // Image needs to be created with the VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT flags enabled
-            create_image(physical_device, device,
-                         environment_map_size, environment_map_size, mipmap_levels, layers,
-                         VK_SAMPLE_COUNT_1_BIT,
-                         VK_FORMAT_R32G32B32A32_SFLOAT,
-                         VK_IMAGE_TILING_OPTIMAL,
-                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-                         VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
-                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                         environment_map.image, environment_map.memory);
+            // Precomputed image-based lighting textures are created up front so that they can either be baked or uploaded from the on-disk cache
+            select_ibl_formats();
+            create_ibl_textures();
             
-            // Image view needs to be created with VK_IMAGE_VIEW_TYPE_CUBE to support cube maps
-            // The environment map is created with mipmaps for prefiltering during specular PBR
-            create_image_view(device, environment_map.image, VK_IMAGE_VIEW_TYPE_CUBE, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, mipmap_levels, layers, environment_map.view);
+            initialize_environment_bake_resources();
             
-            {
-                std::cout << "converting equirectangular environment map to cubemap" << std::endl;
-                auto start = std::chrono::high_resolution_clock::now();
-                    convert_equirectangular_to_cubemap(environment, environment_map);
-                auto end = std::chrono::high_resolution_clock::now();
-                std::cout << "done (" << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
+            // Baking only depends on the environment map, the bake parameters, and the bake shaders, so the result of a previous run can be reused if none of these changed
+            std::uint64_t key = compute_ibl_cache_key();
+            if (!compare_irradiance && load_ibl_textures(key)) {
+                return;
             }
             
-            // Generate environment map mipmaps
-            VkCommandBuffer command_buffer = begin_transient_command_buffer();
-                VkImageSubresourceRange subresource_range = { };
-                subresource_range.baseMipLevel = 0;
-                subresource_range.levelCount = 1;
-                subresource_range.baseArrayLayer = 0;
-                subresource_range.layerCount = 6;
-                subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            
-                for (unsigned level = 1u, size = environment_map_size / 2; level < mipmap_levels; ++level, size /= 2) {
-                    // Transition source mipmap level to VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-                    subresource_range.baseMipLevel = level - 1;
-                    transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-                    
-                    // Transition destination mipmap level to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-                    subresource_range.baseMipLevel = level;
-                    transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-                    
-                    VkImageBlit blit_region = { };
-                    blit_region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 6 };
-                    blit_region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 6 };
-                    blit_region.srcOffsets[1] = { (int) (size * 2), (int) (size * 2), 1 };
-                    blit_region.dstOffsets[1] = { (int) size, (int) size, 1 };
-                    vkCmdBlitImage(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit_region, VK_FILTER_LINEAR);
-                }
-                
-                // Transition entire image to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                subresource_range.baseMipLevel = 0;
-                subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
-                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-
-            submit_transient_command_buffer(command_buffer);
-
-            // Irradiance map is also a cube map
-            create_image(physical_device, device,
-                         environment_map_size, environment_map_size, 1, layers,
-                         VK_SAMPLE_COUNT_1_BIT,
-                         VK_FORMAT_R32G32B32A32_SFLOAT,
-                         VK_IMAGE_TILING_OPTIMAL,
-                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                         VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
-                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                         irradiance_map.image, irradiance_map.memory);
-            create_image_view(device, irradiance_map.image, VK_IMAGE_VIEW_TYPE_CUBE, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, layers, irradiance_map.view);
-
             {
-                std::cout << "computing convoluted irradiance map" << std::endl;
+                std::cout << "baking environment '" << environments[environment_index] << "'" << std::endl;
                 auto start = std::chrono::high_resolution_clock::now();
-                    precompute_irradiance_map(environment_map, irradiance_map);
+                    bake_environment(environments[environment_index], lighting);
                 auto end = std::chrono::high_resolution_clock::now();
                 std::cout << "done (" << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
             }
-
-            {
-                std::cout << "computing prefiltered environment map" << std::endl;
-                auto start = std::chrono::high_resolution_clock::now();
-                    compute_prefiltered_environment_map();
-                auto end = std::chrono::high_resolution_clock::now();
-                std::cout << "done (" << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
+            
+            if (compare_irradiance) {
+                report_irradiance_comparison();
             }
             
             {
@@ -1403,129 +1395,843 @@ class PBR final : public Sample {
                 std::cout << "done (" << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
             }
             
-            // Delete equirectangular texture once no longer needed
-            vkDestroyImageView(device, environment.view, nullptr);
-            vkDestroyImage(device, environment.image, nullptr);
-            vkFreeMemory(device, environment.memory, nullptr);
-        }
-
-        void convert_equirectangular_to_cubemap(const Texture& equirectangular, Texture& cubemap) {
-            // HDR maps are typically stored as equirectangular images, which are generated by projecting an environment to a sphere and 'unrolling' the image into a plane
-            // While possible to use the equirectangular map directly as a skybox and for environment lookups, it is more performant to sample from if it is first converted to a cubemap
-            // This is done by projecting the sphere onto a unit cube
+            // Equirectangular texture and environment map are no longer needed
+            finish_environment_bake();
             
-            VkDescriptorSetLayout compute_descriptor_set_layout { };
-            VkDescriptorSet compute_descriptor_set { };
+            save_ibl_textures(key);
+        }
+        
+        void initialize_environments() {
+            // Any HDR image in assets/textures can be used as an environment, the sample starts with the loft
+            for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("assets/textures")) {
+                if (entry.is_regular_file() && entry.path().extension() == ".hdr") {
+                    environments.emplace_back(entry.path().generic_string());
+                }
+            }
+            std::sort(environments.begin(), environments.end());
             
-            VkDescriptorSetLayoutBinding bindings[] {
-                // Equirectangular environment map (input texture)
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
-                // Cubemap (output texture)
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+            std::vector<std::string>::iterator loft = std::find(environments.begin(), environments.end(), "assets/textures/loft.hdr");
+            if (loft == environments.end()) {
+                throw std::runtime_error("failed to find 'assets/textures/loft.hdr' environment map!");
+            }
+            environment_index = (unsigned) (loft - environments.begin());
+        }
+        
+        // Precomputed image-based lighting textures, in the order they are baked
+        struct PrecomputedTexture {
+            const char* name; // Name of the cache entry
+            Texture* texture;
+            unsigned width;
+            unsigned height;
+            unsigned levels;
+            unsigned layers;
+            VkFormat format;
+        };
+        
+        std::array<PrecomputedTexture, 3> get_precomputed_textures() {
+            unsigned mipmap_levels = compute_num_prefiltered_mipmap_levels();
+            return {
+                PrecomputedTexture { "irradiance_sh", &lighting.irradiance_sh, 9u, 1u, 1u, 1u, VK_FORMAT_R32G32B32A32_SFLOAT },
+                PrecomputedTexture { "prefiltered_environment_map", &lighting.prefiltered_environment_map, prefiltered_environment_map_size, prefiltered_environment_map_size, mipmap_levels, 6u, hdr_format },
+                PrecomputedTexture { "brdf_lut", &brdf_lut, brdf_lut_size, brdf_lut_size, 1u, 1u, brdf_lut_format }
             };
-            
-            VkDescriptorSetLayoutCreateInfo layout_create_info { };
-            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
-            layout_create_info.pBindings = bindings;
-            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &compute_descriptor_set_layout) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create compute descriptor set layout!");
+        }
+        
+        VkFormat select_format(std::initializer_list<VkFormat> candidates, VkFormatFeatureFlags features) {
+            // Candidates are in order of preference
+            for (VkFormat format : candidates) {
+                VkFormatProperties properties { };
+                vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+                if ((properties.optimalTilingFeatures & features) == features) {
+                    return format;
+                }
             }
             
-            VkDescriptorSetAllocateInfo set_create_info { };
-            set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            set_create_info.descriptorPool = descriptor_pool;
-            set_create_info.descriptorSetCount = 1;
-            set_create_info.pSetLayouts = &compute_descriptor_set_layout;
-            if (vkAllocateDescriptorSets(device, &set_create_info, &compute_descriptor_set) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate compute descriptor set!");
-            }
+            throw std::runtime_error("failed to find supported image format!");
+        }
+        
+        void select_ibl_formats() {
+            // Precomputed textures are written by compute shaders and sampled with linear filtering
+            VkFormatFeatureFlags features = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
             
-            VkWriteDescriptorSet descriptor_writes[2] { };
-            VkDescriptorImageInfo image_infos[2] { };
+            // Prefer a packed (unsigned) HDR format, radiance is never negative and the alpha channel is unused
+            // Mipmaps of the environment map are generated with vkCmdBlitImage
+            // VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 would be more precise, but is not supported as a storage image
+            hdr_format = select_format({ VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT }, features | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT);
             
-            // Binding 0
-            image_infos[0].imageView = equirectangular.view;
-            image_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            image_infos[0].sampler = color_sampler;
+            // The BRDF LUT only stores a scale and a bias (in [0.0, 1.0])
+            brdf_lut_format = select_format({ VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT }, features);
+        }
+        
+        unsigned get_texel_size(VkFormat format) {
+            switch (format) {
+                case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+                case VK_FORMAT_R16G16_SFLOAT:
+                    return 4u;
+                case VK_FORMAT_R16G16B16A16_SFLOAT:
+                    return 8u;
+                case VK_FORMAT_R32G32B32A32_SFLOAT:
+                    return 16u;
+                default:
+                    throw std::runtime_error("unsupported image format!");
+            }
+        }
+        
+        void create_ibl_texture(Texture& texture, unsigned width, unsigned height, unsigned levels, unsigned layers, VkFormat format) {
+            texture.format = format;
+            texture.width = width;
+            texture.height = height;
             
-            descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[0].dstSet = compute_descriptor_set;
-            descriptor_writes[0].dstBinding = 0;
-            descriptor_writes[0].dstArrayElement = 0;
-            descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_writes[0].descriptorCount = 1;
-            descriptor_writes[0].pImageInfo = &image_infos[0];
+            // All precomputed textures are also transfer sources / destinations for downloading them into / uploading them from the cache (and for generating mipmaps)
+            VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
             
-            // Binding 1
-            image_infos[1].imageView = cubemap.view;
-            image_infos[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-            image_infos[1].sampler = color_sampler;
+            // Cube maps need to be created with the VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT flag enabled and viewed with VK_IMAGE_VIEW_TYPE_CUBE
+            // Views cover all mipmap levels, to be able to sample at different LODs (for example, in the specular portion of the PBR shader)
+            bool cubemap = layers == 6u;
+            create_image(physical_device, device,
+                         width, height, levels, layers,
+                         VK_SAMPLE_COUNT_1_BIT,
+                         format,
+                         VK_IMAGE_TILING_OPTIMAL,
+                         usage,
+                         cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                         texture.image, texture.memory);
+            create_image_view(device, texture.image, cubemap ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, layers, texture.view);
+        }
+        
+        void create_ibl_textures() {
+            for (const PrecomputedTexture& precomputed : get_precomputed_textures()) {
+                create_ibl_texture(*precomputed.texture, precomputed.width, precomputed.height, precomputed.levels, precomputed.layers, precomputed.format);
+            }
             
-            descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[1].dstSet = compute_descriptor_set;
-            descriptor_writes[1].dstBinding = 1;
-            descriptor_writes[1].dstArrayElement = 0;
-            descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-            descriptor_writes[1].descriptorCount = 1;
-            descriptor_writes[1].pImageInfo = &image_infos[1];
+            // Environments loaded at runtime are always baked (never cached)
+            unsigned mipmap_levels = compute_num_prefiltered_mipmap_levels();
+            create_ibl_texture(baked_lighting.irradiance_sh, 9u, 1u, 1u, 1u, VK_FORMAT_R32G32B32A32_SFLOAT);
+            create_ibl_texture(baked_lighting.prefiltered_environment_map, prefiltered_environment_map_size, prefiltered_environment_map_size, mipmap_levels, 6u, hdr_format);
+        }
+        
+        std::uint64_t compute_ibl_cache_key() {
+            // Incremented whenever the baking process changes in a way that is not captured by the parameters or shaders below
+            const unsigned IBL_CACHE_VERSION = 3u;
             
-            vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
+            std::uint64_t key = TextureCache::hash_file(environments[environment_index]);
             
-            // Create pipeline
-            VkPipelineLayout compute_pipeline_layout { };
-            VkPipeline compute_pipeline { };
+            unsigned parameters[] = { IBL_CACHE_VERSION, environment_map_size, prefiltered_environment_map_size, brdf_lut_size, compute_num_mipmap_levels(environment_map_size, environment_map_size), compute_num_prefiltered_mipmap_levels(), (unsigned) hdr_format, (unsigned) brdf_lut_format };
+            key = TextureCache::hash(parameters, sizeof(parameters), key);
             
-            // Pipeline layout
-            VkPipelineLayoutCreateInfo compute_pipeline_layout_create_info { };
-            compute_pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            compute_pipeline_layout_create_info.setLayoutCount = 1;
-            compute_pipeline_layout_create_info.pSetLayouts = { &compute_descriptor_set_layout };
-            if (vkCreatePipelineLayout(device, &compute_pipeline_layout_create_info, nullptr, &compute_pipeline_layout) != VK_SUCCESS) {
+            const char* shaders[] = { "shaders/equirectangular_to_cubemap.comp", "shaders/irradiance_sh.comp", "shaders/prefilter_environment_map.comp", "shaders/compute_brdf_lut.comp" };
+            for (const char* shader : shaders) {
+                key = TextureCache::hash_file(shader, key);
+            }
+            
+            return key;
+        }
+        
+        bool load_ibl_textures(std::uint64_t key) {
+            std::cout << "loading precomputed IBL textures from cache" << std::endl;
+            auto start = std::chrono::high_resolution_clock::now();
+            
+            // All textures must be present (and up to date) in the cache, otherwise everything is baked again
+            std::array<PrecomputedTexture, 3> textures = get_precomputed_textures();
+            std::array<CachedTexture, 3> cached { };
+            
+            for (std::size_t i = 0u; i < textures.size(); ++i) {
+                const PrecomputedTexture& precomputed = textures[i];
+                const Texture& texture = *precomputed.texture;
+                
+                if (!ibl_cache.load(precomputed.name, key, cached[i]) || cached[i].format != (unsigned) texture.format || cached[i].width != texture.width || cached[i].height != texture.height || cached[i].levels != precomputed.levels || cached[i].layers != precomputed.layers) {
+                    std::cout << "cache entry '" << precomputed.name << "' is missing or out of date" << std::endl;
+                    return false;
+                }
+            }
+            
+            for (std::size_t i = 0u; i < textures.size(); ++i) {
+                upload_cached_texture(cached[i], *textures[i].texture);
+            }
+            
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << "done (" << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
+            return true;
+        }
+        
+        void save_ibl_textures(std::uint64_t key) {
+            for (const PrecomputedTexture& precomputed : get_precomputed_textures()) {
+                CachedTexture cached { };
+                download_cached_texture(*precomputed.texture, precomputed.levels, precomputed.layers, cached);
+                
+                // Failing to write to the cache is not an error, textures are baked again during the next run
+                if (!ibl_cache.save(precomputed.name, key, cached)) {
+                    std::cout << "failed to write cache entry '" << precomputed.name << "'" << std::endl;
+                }
+            }
+        }
+        
+        void upload_cached_texture(const CachedTexture& cached, Texture& texture) {
+            VkBuffer staging_buffer { };
+            VkDeviceMemory staging_buffer_memory { };
+            create_buffer(physical_device, device, cached.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+            
+            void* data;
+            vkMapMemory(device, staging_buffer_memory, 0, cached.data.size(), 0, &data);
+                memcpy(data, cached.data.data(), cached.data.size());
+            vkUnmapMemory(device, staging_buffer_memory);
+            
+            // One region per mipmap level, covering all layers
+            std::vector<VkBufferImageCopy> regions(cached.levels);
+            for (unsigned level = 0u; level < cached.levels; ++level) {
+                VkBufferImageCopy& region = regions[level];
+                region.bufferOffset = cached.get_level_offset(level);
+                region.bufferRowLength = 0; // Tightly packed
+                region.bufferImageHeight = 0;
+                region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, cached.layers };
+                region.imageOffset = { 0, 0, 0 };
+                region.imageExtent = { cached.get_level_width(level), cached.get_level_height(level), 1 };
+            }
+            
+            VkImageSubresourceRange subresource_range { };
+            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresource_range.baseMipLevel = 0;
+            subresource_range.levelCount = cached.levels;
+            subresource_range.baseArrayLayer = 0;
+            subresource_range.layerCount = cached.layers;
+            
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                transition_image(command_buffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                vkCmdCopyBufferToImage(command_buffer, staging_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (unsigned) regions.size(), regions.data());
+                // Baked textures are left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                transition_image(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            submit_transient_command_buffer(command_buffer);
+            
+            vkFreeMemory(device, staging_buffer_memory, nullptr);
+            vkDestroyBuffer(device, staging_buffer, nullptr);
+        }
+        
+        void download_cached_texture(const Texture& texture, unsigned levels, unsigned layers, CachedTexture& cached) {
+            cached.format = (unsigned) texture.format;
+            cached.width = texture.width;
+            cached.height = texture.height;
+            cached.layers = layers;
+            cached.levels = levels;
+            cached.texel_size = get_texel_size(texture.format);
+            cached.data.resize(cached.get_size());
+            
+            VkBuffer staging_buffer { };
+            VkDeviceMemory staging_buffer_memory { };
+            create_buffer(physical_device, device, cached.data.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+            
+            std::vector<VkBufferImageCopy> regions(levels);
+            for (unsigned level = 0u; level < levels; ++level) {
+                VkBufferImageCopy& region = regions[level];
+                region.bufferOffset = cached.get_level_offset(level);
+                region.bufferRowLength = 0;
+                region.bufferImageHeight = 0;
+                region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layers };
+                region.imageOffset = { 0, 0, 0 };
+                region.imageExtent = { cached.get_level_width(level), cached.get_level_height(level), 1 };
+            }
+            
+            VkImageSubresourceRange subresource_range { };
+            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresource_range.baseMipLevel = 0;
+            subresource_range.levelCount = levels;
+            subresource_range.baseArrayLayer = 0;
+            subresource_range.layerCount = layers;
+            
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                transition_image(command_buffer, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                vkCmdCopyImageToBuffer(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging_buffer, (unsigned) regions.size(), regions.data());
+                transition_image(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                
+                // Make transfer writes visible to the host
+                VkMemoryBarrier barrier { };
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            submit_transient_command_buffer(command_buffer);
+            
+            void* data;
+            vkMapMemory(device, staging_buffer_memory, 0, cached.data.size(), 0, &data);
+                memcpy(cached.data.data(), data, cached.data.size());
+            vkUnmapMemory(device, staging_buffer_memory);
+            
+            vkFreeMemory(device, staging_buffer_memory, nullptr);
+            vkDestroyBuffer(device, staging_buffer, nullptr);
+        }
+
+        void create_compute_pipeline(const VkDescriptorSetLayoutBinding* bindings, unsigned binding_count, const char* filepath, VkSpecializationInfo* specialization_info, VkPipelineCreateFlags flags, ComputePipeline& compute_pipeline) {
+            VkDescriptorSetLayoutCreateInfo layout_create_info { };
+            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_create_info.bindingCount = binding_count;
+            layout_create_info.pBindings = bindings;
+            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &compute_pipeline.descriptor_set_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute descriptor set layout!");
+            }
+            
+            VkPipelineLayoutCreateInfo pipeline_layout_create_info { };
+            pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_create_info.setLayoutCount = 1;
+            pipeline_layout_create_info.pSetLayouts = &compute_pipeline.descriptor_set_layout;
+            if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &compute_pipeline.layout) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create compute pipeline layout!");
             }
             
             VkComputePipelineCreateInfo pipeline_create_info { };
             pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-            pipeline_create_info.layout = compute_pipeline_layout;
+            pipeline_create_info.flags = flags;
+            pipeline_create_info.layout = compute_pipeline.layout;
             
-            VkShaderModule shader_module = create_shader_module(device, "shaders/equirectangular_to_cubemap.comp");
-            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT);
-            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &compute_pipeline) != VK_SUCCESS) {
+            VkShaderModule shader_module = create_shader_module(device, filepath);
+            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT, specialization_info);
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &compute_pipeline.pipeline) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create compute pipeline!");
             }
             
             vkDestroyShaderModule(device, shader_module, nullptr);
+        }
+        
+        void destroy_compute_pipeline(ComputePipeline& compute_pipeline) {
+            vkDestroyPipeline(device, compute_pipeline.pipeline, nullptr);
+            vkDestroyPipelineLayout(device, compute_pipeline.layout, nullptr);
+            vkDestroyDescriptorSetLayout(device, compute_pipeline.descriptor_set_layout, nullptr);
+        }
+        
+        void allocate_compute_descriptor_set(const ComputePipeline& compute_pipeline, VkDescriptorSet& descriptor_set) {
+            VkDescriptorSetAllocateInfo set_create_info { };
+            set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            set_create_info.descriptorPool = descriptor_pool;
+            set_create_info.descriptorSetCount = 1;
+            set_create_info.pSetLayouts = &compute_pipeline.descriptor_set_layout;
+            if (vkAllocateDescriptorSets(device, &set_create_info, &descriptor_set) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate compute descriptor set!");
+            }
+        }
+        
+        void write_image_descriptors(VkDescriptorSet descriptor_set, unsigned binding, VkDescriptorType type, const VkImageView* views, unsigned count, VkSampler sampler) {
+            // Sampled images are read in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, storage images are written in VK_IMAGE_LAYOUT_GENERAL
+            std::vector<VkDescriptorImageInfo> image_infos(count);
+            for (unsigned i = 0u; i < count; ++i) {
+                image_infos[i].imageView = views[i];
+                image_infos[i].imageLayout = type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                image_infos[i].sampler = sampler;
+            }
             
-            VkCommandBuffer command_buffer = begin_transient_command_buffer();
-                VkImageSubresourceRange subresource_range { };
-                subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                subresource_range.baseMipLevel = 0;
-                subresource_range.levelCount = 1;
-                subresource_range.baseArrayLayer = 0;
-                subresource_range.layerCount = 1;
+            VkWriteDescriptorSet descriptor_write { };
+            descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_write.dstSet = descriptor_set;
+            descriptor_write.dstBinding = binding;
+            descriptor_write.dstArrayElement = 0;
+            descriptor_write.descriptorType = type;
+            descriptor_write.descriptorCount = count;
+            descriptor_write.pImageInfo = image_infos.data();
+            
+            vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+        }
+        
+        void initialize_environment_bake_resources() {
+            unsigned num_mipmap_tail_levels = compute_num_prefiltered_mipmap_levels() - 1u; // Subtract one for level 0, which is copied from the environment map
+            
+            {
+                VkDescriptorSetLayoutBinding bindings[] {
+                    // Equirectangular environment map (input texture)
+                    create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+                    // Cubemap (output texture)
+                    create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+                };
+                create_compute_pipeline(bindings, sizeof(bindings) / sizeof(bindings[0]), "shaders/equirectangular_to_cubemap.comp", nullptr, 0, equirectangular_to_cubemap_pipeline);
+            }
             
-                // Equirectangular texture is already in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, for optimal shader reads
-                transition_image(command_buffer, equirectangular.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            {
+                VkDescriptorSetLayoutBinding bindings[] {
+                    // Environment map (input texture)
+                    create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+                    // Spherical harmonics coefficients (output texture)
+                    create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+                };
                 
-                // Convert cubemap to VK_IMAGE_LAYOUT_GENERAL for storage image writes
-                // Cubemap texture is only being written to (VK_ACCESS_SHADER_WRITE_BIT access)
-                subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
-                subresource_range.layerCount = VK_REMAINING_ARRAY_LAYERS;
-                transition_image(command_buffer, cubemap.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                // layout (constant_id = 0) const int MIP_LEVEL;
+                // Project the 64x64 mipmap level of the environment map (the smallest levels of the full mipmap chain are too coarse to resolve the second band)
+                VkSpecializationMapEntry specialization { };
+                specialization.constantID = 0;
+                specialization.size = sizeof(int);
+                specialization.offset = 0;
                 
-                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
-				vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1, &compute_descriptor_set, 0, nullptr);
-				vkCmdDispatch(command_buffer, environment_map_size / 32, environment_map_size / 32, 6);
+                int mip_level = (int) compute_num_mipmap_levels(environment_map_size, environment_map_size) - (int) compute_num_mipmap_levels(64u, 64u);
+                
+                VkSpecializationInfo specialization_info { };
+                specialization_info.mapEntryCount = 1;
+                specialization_info.pMapEntries = &specialization;
+                specialization_info.dataSize = sizeof(int);
+                specialization_info.pData = &mip_level;
+                
+                create_compute_pipeline(bindings, sizeof(bindings) / sizeof(bindings[0]), "shaders/irradiance_sh.comp", &specialization_info, 0, irradiance_sh_pipeline);
+            }
+            
+            {
+                VkDescriptorSetLayoutBinding bindings[] {
+                    // Environment map (input texture)
+                    create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+                    // Prefiltered environment map (output texture, one storage image per mipmap level)
+                    create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, num_mipmap_tail_levels),
+                };
+                
+                // layout (constant_id = 0) const uint NUM_MIP_LEVELS;
+                // Size of the storage image array, which does not include the base level
+                VkSpecializationMapEntry specialization { };
+                specialization.constantID = 0;
+                specialization.size = sizeof(unsigned);
+                specialization.offset = 0;
+                
+                VkSpecializationInfo specialization_info { };
+                specialization_info.mapEntryCount = 1;
+                specialization_info.pMapEntries = &specialization;
+                specialization_info.dataSize = sizeof(unsigned);
+                specialization_info.pData = &num_mipmap_tail_levels;
+                
+                // Runtime bakes prefilter one face of one mipmap level per step, which requires dispatching with a non-zero base workgroup (vkCmdDispatchBase)
+                create_compute_pipeline(bindings, sizeof(bindings) / sizeof(bindings[0]), "shaders/prefilter_environment_map.comp", &specialization_info, VK_PIPELINE_CREATE_DISPATCH_BASE_BIT, prefilter_pipeline);
+            }
+            
+            VkCommandPool bake_command_pool = command_pool;
+            bake_queue = queue;
+            if (compute_queue && compute_queue_family_index == queue_family_index) {
+                bake_command_pool = compute_command_pool;
+                bake_queue = compute_queue;
+            }
+            
+            VkCommandBufferAllocateInfo command_buffer_ai { };
+            command_buffer_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            command_buffer_ai.commandPool = bake_command_pool;
+            command_buffer_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            command_buffer_ai.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &command_buffer_ai, &bake_command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate environment bake command buffer!");
+            }
+            
+            // Created in the signaled state, as no step has been submitted yet
+            VkFenceCreateInfo fence_create_info { };
+            fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            if (vkCreateFence(device, &fence_create_info, nullptr, &bake_fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create environment bake fence!");
+            }
+        }
+        
+        void destroy_environment_bake_resources() {
+            destroy_compute_pipeline(equirectangular_to_cubemap_pipeline);
+            destroy_compute_pipeline(irradiance_sh_pipeline);
+            destroy_compute_pipeline(prefilter_pipeline);
+            
+            vkDestroyFence(device, bake_fence, nullptr);
+            
+            // Command buffer is released alongside its command pool
+        }
+        
+        void load_environment(const std::string& filepath) {
+            // The environment is baked in the background and swapped in once the bake completes (see update_environment)
+            // Requests made while a bake is in progress are deferred until it completes, only the most recent request is kept
+            requested_environment = filepath;
+        }
+        
+        void update_environment() {
+            if (baked_lighting_frames > 0u) {
+                --baked_lighting_frames;
+            }
+            
+            if (!bake.active) {
+                // The previous environment cannot be baked into until all frames that sample from it have completed
+                if (!requested_environment.empty() && baked_lighting_frames == 0u) {
+                    std::cout << "baking environment '" << requested_environment << "'" << std::endl;
+                    begin_environment_bake(requested_environment, baked_lighting);
+                    requested_environment.clear();
+                }
+                return;
+            }
+            
+            if (!update_environment_bake()) {
+                return;
+            }
+            
+            std::cout << "done (" << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bake.start).count() << " ms, " << bake.frames << " frames)" << std::endl;
+            finish_environment_bake();
+            
+            // Frames recorded from this point on render with the new environment, frames in flight still sample from the previous one
+            std::swap(lighting, baked_lighting);
+            baked_lighting_frames = NUM_FRAMES_IN_FLIGHT;
+        }
+        
+        void begin_environment_bake(const std::string& filepath, EnvironmentLighting& target) {
+            bake.active = true;
+            bake.filepath = filepath;
+            bake.target = &target;
+            bake.step = 0u;
+            bake.frames = 0u;
+            bake.start = std::chrono::high_resolution_clock::now();
+            
+            // Decoding a large HDR image (and writing it into a staging buffer) takes long enough to cause a frame hitch, so it is done on a worker thread
+            // Creating buffers and mapping memory do not require external synchronization
+            bake.decoded = std::async(std::launch::async, [this, filepath]() {
+                int width;
+                int height;
+                int channels;
+                float* image_data = stbi_loadf(filepath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+                if (!image_data) {
+                    throw std::runtime_error("failed to load HDR texture '" + filepath + "'!");
+                }
+                
+                DecodedEnvironment decoded { };
+                decoded.width = width;
+                decoded.height = height;
                 
-                transition_image(command_buffer, cubemap.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                std::size_t staging_buffer_size = (std::size_t) width * height * 4 * sizeof(float);
+                create_buffer(physical_device, device, staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, decoded.staging_buffer, decoded.staging_buffer_memory);
+                
+                void* data;
+                vkMapMemory(device, decoded.staging_buffer_memory, 0, staging_buffer_size, 0, &data);
+                    memcpy(data, image_data, staging_buffer_size);
+                vkUnmapMemory(device, decoded.staging_buffer_memory);
+                
+                stbi_image_free(image_data); // No longer necessary
+                return decoded;
+            });
+        }
+        
+        void prepare_environment_bake() {
+            // Creates the transient resources of the bake, once the environment map has been decoded
+            Texture& equirectangular = bake.equirectangular;
+            equirectangular.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            equirectangular.width = bake.source.width;
+            equirectangular.height = bake.source.height;
+            create_image(physical_device, device, equirectangular.width, equirectangular.height, 1, 1, VK_SAMPLE_COUNT_1_BIT, equirectangular.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, equirectangular.image, equirectangular.memory);
+            create_image_view(device, equirectangular.image, VK_IMAGE_VIEW_TYPE_2D, equirectangular.format, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 1, equirectangular.view);
+            
+            // The environment map is created with a full mipmap chain, prefiltering samples from the level that matches the solid angle of each sample (filtered importance sampling)
+            create_ibl_texture(bake.environment_map, environment_map_size, environment_map_size, compute_num_mipmap_levels(environment_map_size, environment_map_size), 6u, hdr_format);
+            
+            // Starting at 1 (0 is copied from the environment map and is handled separately)
+            const Texture& prefiltered = bake.target->prefiltered_environment_map;
+            unsigned num_mipmap_levels = compute_num_prefiltered_mipmap_levels();
+            bake.prefiltered_views.resize(num_mipmap_levels - 1u);
+            for (unsigned level = 1u; level < num_mipmap_levels; ++level) {
+                create_image_view(device, prefiltered.image, VK_IMAGE_VIEW_TYPE_CUBE, prefiltered.format, VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 6, bake.prefiltered_views[level - 1u]);
+            }
+            
+            allocate_compute_descriptor_set(equirectangular_to_cubemap_pipeline, bake.equirectangular_descriptor_set);
+            write_image_descriptors(bake.equirectangular_descriptor_set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &equirectangular.view, 1, color_sampler);
+            write_image_descriptors(bake.equirectangular_descriptor_set, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &bake.environment_map.view, 1, VK_NULL_HANDLE);
+            
+            // The irradiance projection and prefiltering sample from explicit mipmap levels of the environment map
+            allocate_compute_descriptor_set(irradiance_sh_pipeline, bake.irradiance_descriptor_set);
+            write_image_descriptors(bake.irradiance_descriptor_set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &bake.environment_map.view, 1, environment_map_sampler);
+            write_image_descriptors(bake.irradiance_descriptor_set, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &bake.target->irradiance_sh.view, 1, VK_NULL_HANDLE);
+            
+            allocate_compute_descriptor_set(prefilter_pipeline, bake.prefilter_descriptor_set);
+            write_image_descriptors(bake.prefilter_descriptor_set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &bake.environment_map.view, 1, environment_map_sampler);
+            write_image_descriptors(bake.prefilter_descriptor_set, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, bake.prefiltered_views.data(), (unsigned) bake.prefiltered_views.size(), VK_NULL_HANDLE);
+        }
+        
+        void bake_environment(const std::string& filepath, EnvironmentLighting& target) {
+            // Bakes all steps at once, blocking until the bake completes
+            // Transient resources of the bake are kept until finish_environment_bake, so that the environment map can be used for other bakes
+            begin_environment_bake(filepath, target);
+            bake.source = bake.decoded.get();
+            prepare_environment_bake();
+            
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                for (unsigned step = 0u; step < get_environment_bake_step_count(); ++step) {
+                    record_environment_bake_step(command_buffer, step);
+                }
             submit_transient_command_buffer(command_buffer);
+        }
+        
+        bool update_environment_bake() {
+            // Returns true once all steps of the bake have completed
+            // Never blocks, at most one step is in flight at a time (and at most one step is submitted per frame)
+            ++bake.frames;
             
-            // Cleanup resources
-            vkDestroyPipelineLayout(device, compute_pipeline_layout, nullptr);
-            vkDestroyPipeline(device, compute_pipeline, nullptr);
-            vkDestroyDescriptorSetLayout(device, compute_descriptor_set_layout, nullptr);
-            vkFreeDescriptorSets(device, descriptor_pool, 1, &compute_descriptor_set);
+            if (bake.decoded.valid()) {
+                if (bake.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    return false;
+                }
+                
+                try {
+                    bake.source = bake.decoded.get();
+                }
+                catch (const std::runtime_error& error) {
+                    // Failing to load an environment at runtime keeps the current environment
+                    std::cout << error.what() << std::endl;
+                    bake.active = false;
+                    return false;
+                }
+                
+                prepare_environment_bake();
+            }
+            
+            if (vkGetFenceStatus(device, bake_fence) != VK_SUCCESS) {
+                // Previous step has not completed yet
+                return false;
+            }
+            
+            if (bake.step == get_environment_bake_step_count()) {
+                return true;
+            }
+            
+            vkResetFences(device, 1, &bake_fence);
+            vkResetCommandBuffer(bake_command_buffer, 0);
+            
+            VkCommandBufferBeginInfo command_buffer_begin_info { };
+            command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (vkBeginCommandBuffer(bake_command_buffer, &command_buffer_begin_info) != VK_SUCCESS) {
+                throw std::runtime_error("failed to begin command buffer recording!");
+            }
+            
+            record_environment_bake_step(bake_command_buffer, bake.step++);
+            
+            if (vkEndCommandBuffer(bake_command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record command buffer!");
+            }
+            
+            // The textures being baked into are not used for rendering until the bake completes (as observed through the fence), so the step does not need to synchronize with rendering
+            VkSubmitInfo submit_info { };
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &bake_command_buffer;
+            if (vkQueueSubmit(bake_queue, 1, &submit_info, bake_fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit environment bake command buffer!");
+            }
+            
+            return false;
+        }
+        
+        void finish_environment_bake() {
+            // Releases the transient resources of the bake
+            vkFreeMemory(device, bake.source.staging_buffer_memory, nullptr);
+            vkDestroyBuffer(device, bake.source.staging_buffer, nullptr);
+            
+            vkDestroyImageView(device, bake.equirectangular.view, nullptr);
+            vkDestroyImage(device, bake.equirectangular.image, nullptr);
+            vkFreeMemory(device, bake.equirectangular.memory, nullptr);
+            
+            vkDestroyImageView(device, bake.environment_map.view, nullptr);
+            vkDestroyImage(device, bake.environment_map.image, nullptr);
+            vkFreeMemory(device, bake.environment_map.memory, nullptr);
+            
+            for (VkImageView view : bake.prefiltered_views) {
+                vkDestroyImageView(device, view, nullptr);
+            }
+            bake.prefiltered_views.clear();
+            
+            VkDescriptorSet descriptor_sets[] = { bake.equirectangular_descriptor_set, bake.irradiance_descriptor_set, bake.prefilter_descriptor_set };
+            vkFreeDescriptorSets(device, descriptor_pool, sizeof(descriptor_sets) / sizeof(descriptor_sets[0]), descriptor_sets);
+            
+            bake.active = false;
+        }
+        
+        void cancel_environment_bake() {
+            // Waits for a bake that is still in progress when the sample is closed
+            if (!bake.active) {
+                return;
+            }
+            
+            if (bake.decoded.valid()) {
+                // Only the staging buffer has been created
+                try {
+                    DecodedEnvironment decoded = bake.decoded.get();
+                    vkFreeMemory(device, decoded.staging_buffer_memory, nullptr);
+                    vkDestroyBuffer(device, decoded.staging_buffer, nullptr);
+                }
+                catch (const std::runtime_error&) {
+                }
+                
+                bake.active = false;
+                return;
+            }
+            
+            vkWaitForFences(device, 1, &bake_fence, VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+            finish_environment_bake();
+        }
+        
+        unsigned get_environment_bake_step_count() {
+            // Conversion and irradiance projection, followed by one step per face of each mipmap level of the prefiltered environment map (not including the base level)
+            return 2u + 6u * (compute_num_prefiltered_mipmap_levels() - 1u);
+        }
+        
+        void record_environment_bake_step(VkCommandBuffer command_buffer, unsigned step) {
+            // Each step synchronizes with the commands of the previous step, so steps can either be submitted separately or recorded into the same command buffer
+            if (step == 0u) {
+                record_environment_map_conversion(command_buffer);
+            }
+            else if (step == 1u) {
+                record_irradiance_projection(command_buffer);
+                record_prefiltered_base_level(command_buffer);
+            }
+            else {
+                record_prefiltered_face(command_buffer, step - 2u);
+            }
+        }
+        
+        void record_environment_map_conversion(VkCommandBuffer command_buffer) {
+            // HDR maps are typically stored as equirectangular images, which are generated by projecting an environment to a sphere and 'unrolling' the image into a plane
+            // While possible to use the equirectangular map directly as a skybox and for environment lookups, it is more performant to sample from if it is first converted to a cubemap
+            // This is done by projecting the sphere onto a unit cube
+            const Texture& equirectangular = bake.equirectangular;
+            const Texture& environment_map = bake.environment_map;
+            unsigned mipmap_levels = compute_num_mipmap_levels(environment_map_size, environment_map_size);
+            
+            VkImageSubresourceRange subresource_range { };
+            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresource_range.baseMipLevel = 0;
+            subresource_range.levelCount = 1;
+            subresource_range.baseArrayLayer = 0;
+            subresource_range.layerCount = 1;
+            
+            // Upload the equirectangular texture
+            transition_image(command_buffer, equirectangular.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            copy_buffer_to_image(command_buffer, bake.source.staging_buffer, 0, equirectangular.image, 0, equirectangular.width, equirectangular.height);
+            transition_image(command_buffer, equirectangular.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            
+            // Convert environment map to VK_IMAGE_LAYOUT_GENERAL for storage image writes
+            subresource_range.levelCount = mipmap_levels;
+            subresource_range.layerCount = 6;
+            transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, equirectangular_to_cubemap_pipeline.pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, equirectangular_to_cubemap_pipeline.layout, 0, 1, &bake.equirectangular_descriptor_set, 0, nullptr);
+            vkCmdDispatch(command_buffer, environment_map_size / 32, environment_map_size / 32, 6);
+            
+            // Generate environment map mipmaps, each level is blitted from the previous level
+            subresource_range.levelCount = 1;
+            for (unsigned level = 1u, size = environment_map_size / 2; level < mipmap_levels; ++level, size /= 2) {
+                // Transition source mipmap level to VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL (written by the conversion, or by the previous blit)
+                subresource_range.baseMipLevel = level - 1;
+                if (level == 1u) {
+                    transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                }
+                else {
+                    transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                }
+                
+                // Transition destination mipmap level to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                subresource_range.baseMipLevel = level;
+                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                
+                VkImageBlit blit_region = { };
+                blit_region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 6 };
+                blit_region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 6 };
+                blit_region.srcOffsets[1] = { (int) (size * 2), (int) (size * 2), 1 };
+                blit_region.dstOffsets[1] = { (int) size, (int) size, 1 };
+                vkCmdBlitImage(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit_region, VK_FILTER_LINEAR);
+            }
+            
+            // Transition entire image to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, for the irradiance projection / prefiltering and the copy into the base level of the prefiltered environment map
+            VkAccessFlags dst_access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+            VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+            if (mipmap_levels > 1u) {
+                subresource_range.baseMipLevel = 0;
+                subresource_range.levelCount = mipmap_levels - 1;
+                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_access, dst_stage);
+                
+                subresource_range.baseMipLevel = mipmap_levels - 1;
+                subresource_range.levelCount = 1;
+                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_access, dst_stage);
+            }
+            else {
+                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_access, dst_stage);
+            }
+        }
+        
+        void record_irradiance_projection(VkCommandBuffer command_buffer) {
+            // Irradiance is represented by 9 spherical harmonics coefficients (per color channel) instead of a cubemap, which the PBR shader evaluates analytically for the surface normal
+            // Projecting the environment map is a single reduction over a low resolution mipmap level, and the coefficients take up 144 bytes (instead of a 6 layer cubemap at the resolution of the environment map)
+            const Texture& irradiance = bake.target->irradiance_sh;
+            
+            VkImageSubresourceRange subresource_range { };
+            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresource_range.baseMipLevel = 0;
+            subresource_range.levelCount = 1;
+            subresource_range.baseArrayLayer = 0;
+            subresource_range.layerCount = 1;
+            transition_image(command_buffer, irradiance.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            
+            // The entire reduction is performed by a single workgroup
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, irradiance_sh_pipeline.pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, irradiance_sh_pipeline.layout, 0, 1, &bake.irradiance_descriptor_set, 0, nullptr);
+            vkCmdDispatch(command_buffer, 1, 1, 1);
+            
+            transition_image(command_buffer, irradiance.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+        
+        void record_prefiltered_base_level(VkCommandBuffer command_buffer) {
+            // The base level of the prefiltered environment map (roughness 0) is copied from the environment map mipmap level of the same size
+            // Both textures use the same format
+            const Texture& environment_map = bake.environment_map;
+            const Texture& prefiltered = bake.target->prefiltered_environment_map;
+            
+            unsigned source_level = 0u;
+            while ((environment_map_size >> source_level) > prefiltered_environment_map_size) {
+                ++source_level;
+            }
+            
+            if ((environment_map_size >> source_level) != prefiltered_environment_map_size || source_level >= compute_num_mipmap_levels(environment_map_size, environment_map_size)) {
+                throw std::runtime_error("prefiltered environment map size must match a mipmap level of the environment map!");
+            }
+            
+            VkImageSubresourceRange subresource_range { };
+            subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresource_range.baseMipLevel = source_level;
+            subresource_range.levelCount = 1;
+            subresource_range.baseArrayLayer = 0;
+            subresource_range.layerCount = 6; // Cubemap layers
+            
+            // The environment map level may still be read by the irradiance projection
+            transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            
+            subresource_range.baseMipLevel = 0;
+            transition_image(command_buffer, prefiltered.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            
+            VkImageCopy copy_region { };
+            copy_region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, source_level, 0, 6 };
+            copy_region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 6 };
+            copy_region.extent = { prefiltered_environment_map_size, prefiltered_environment_map_size, 1 };
+            vkCmdCopyImage(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, prefiltered.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+            
+            // Transition the environment map level back to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for prefiltering
+            subresource_range.baseMipLevel = source_level;
+            transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            
+            // The base level is complete
+            subresource_range.baseMipLevel = 0;
+            transition_image(command_buffer, prefiltered.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            
+            // Transition the remaining mipmap levels to VK_IMAGE_LAYOUT_GENERAL for storage image writes
+            subresource_range.baseMipLevel = 1;
+            subresource_range.levelCount = (unsigned) bake.prefiltered_views.size();
+            transition_image(command_buffer, prefiltered.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        
+        void record_prefiltered_face(VkCommandBuffer command_buffer, unsigned index) {
+            // Prefilters one face of one mipmap level of the prefiltered environment map, the shader determines the mipmap level and face from gl_GlobalInvocationID.z = level * 6 + face
+            // Faces write to disjoint regions of the image, so no synchronization is necessary between them
+            unsigned num_faces = 6u * (unsigned) bake.prefiltered_views.size();
+            unsigned size = prefiltered_environment_map_size >> (index / 6u + 1u); // Index 0 is mipmap level 1
+            unsigned num_work_groups = (size + 7) / 8; // 8x8 workgroups
+            
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilter_pipeline.pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilter_pipeline.layout, 0, 1, &bake.prefilter_descriptor_set, 0, nullptr);
+            vkCmdDispatchBase(command_buffer, 0, 0, index, num_work_groups, num_work_groups, 1);
+            
+            if (index == num_faces - 1u) {
+                // Transition all prefiltered mipmap levels to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                VkImageSubresourceRange subresource_range { };
+                subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                subresource_range.baseMipLevel = 1;
+                subresource_range.levelCount = (unsigned) bake.prefiltered_views.size();
+                subresource_range.baseArrayLayer = 0;
+                subresource_range.layerCount = 6;
+                transition_image(command_buffer, bake.target->prefiltered_environment_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            }
         }
         
         void precompute_irradiance_map(const Texture& environment, Texture& irradiance) {
@@ -1533,6 +2239,7 @@ class PBR final : public Sample {
             // It represents the total incoming light integrated over the hemisphere for each point, and aims to account for the contributions of the incoming light from all texels in the environment map (if each texel was its own light source)
             // The irradiance map is precomputed once for all possible incoming directions and stored in a cubemap (similar to the environment map), as this computation is too expensive to perform real time
             // Determining the amount of diffuse lighting on the surface of a fragment requires sampling the irradiance map for the hemisphere of the surface normal
+            // Irradiance is now represented with spherical harmonics (see compute_irradiance_sh), the cubemap is only computed as a reference for comparison
             
             VkDescriptorSetLayout compute_descriptor_set_layout { };
             VkDescriptorSet compute_descriptor_set { };
@@ -1644,238 +2351,116 @@ class PBR final : public Sample {
             vkFreeDescriptorSets(device, descriptor_pool, 1, &compute_descriptor_set);
         }
         
-        unsigned compute_num_mipmap_levels(unsigned w, unsigned h) {
-            // Reducing the number to prevent artifacts at high roughness levels
-            // TODO: investigate why this is happening
-            return 4; // (unsigned)(std::floor(std::log2(std::max(w, h)))) + 1;
-        }
-        
-        void compute_prefiltered_environment_map() {
-            unsigned num_mipmap_levels = compute_num_mipmap_levels(environment_map_size, environment_map_size);
-            unsigned num_mipmap_tail_levels = num_mipmap_levels - 1; // Subtract one for level 0, which is the original texture
-
-            // The prefiltered environment map is an array of cubemaps for varying roughness levels
+        void report_irradiance_comparison() {
+            // Projection is timed separately from the rest of the bake (projects the environment map of the bake into the same texture again)
+            std::cout << "computing spherical harmonics irradiance" << std::endl;
+            auto sh_start = std::chrono::high_resolution_clock::now();
+                VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                    record_irradiance_projection(command_buffer);
+                submit_transient_command_buffer(command_buffer);
+            auto sh_end = std::chrono::high_resolution_clock::now();
+            double sh_time = std::chrono::duration<double, std::milli>(sh_end - sh_start).count();
+            
+            // Bake the irradiance cubemap as a reference
+            Texture reference { };
+            reference.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            reference.width = environment_map_size;
+            reference.height = environment_map_size;
+            
             create_image(physical_device, device,
-                         environment_map_size, environment_map_size, num_mipmap_levels, 6,
+                         reference.width, reference.height, 1, 6,
                          VK_SAMPLE_COUNT_1_BIT,
-                         VK_FORMAT_R32G32B32A32_SFLOAT,
+                         reference.format,
                          VK_IMAGE_TILING_OPTIMAL,
-                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
                          VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                         prefiltered_environment_map.image, prefiltered_environment_map.memory);
-
-            // Image view covers all mipmap levels
-            // This is to be able to sample at different LODs in the specular portion of the PBR shader
-            // Can also use VK_REMAINING_MIP_LEVELS instead of hardcoding the number of mipmap levels
-            create_image_view(device, prefiltered_environment_map.image, VK_IMAGE_VIEW_TYPE_CUBE, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, num_mipmap_levels, 6, prefiltered_environment_map.view);
-            
-            unsigned layers = 6u;
-            
-            VkDescriptorSetLayout compute_descriptor_set_layout { };
-            VkDescriptorSet compute_descriptor_set { };
-            
-            VkDescriptorSetLayoutBinding bindings[] {
-                // Environment map (input texture)
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
-                // Prefiltered environment map (output texture)
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, num_mipmap_tail_levels),
-            };
-            
-            VkDescriptorSetLayoutCreateInfo layout_create_info { };
-            layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            layout_create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
-            layout_create_info.pBindings = bindings;
-            if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &compute_descriptor_set_layout) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create compute descriptor set layout!");
-            }
-            
-            VkDescriptorSetAllocateInfo set_create_info { };
-            set_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            set_create_info.descriptorPool = descriptor_pool;
-            set_create_info.descriptorSetCount = 1;
-            set_create_info.pSetLayouts = &compute_descriptor_set_layout;
-            if (vkAllocateDescriptorSets(device, &set_create_info, &compute_descriptor_set) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate compute descriptor set!");
-            }
-            
-            VkWriteDescriptorSet descriptor_writes[2] { };
-            
-            // Binding 0 (contains an image view to the source environment map)
-            VkDescriptorImageInfo environment_map_image_info { };
-            environment_map_image_info.imageView = environment_map.view;
-            environment_map_image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            environment_map_image_info.sampler = environment_map_sampler;
-            
-            descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[0].dstSet = compute_descriptor_set;
-            descriptor_writes[0].dstBinding = 0;
-            descriptor_writes[0].dstArrayElement = 0;
-            descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptor_writes[0].descriptorCount = 1;
-            descriptor_writes[0].pImageInfo = &environment_map_image_info;
-            
-            // Binding 1 (contains an array of image views to each mipmap level of the prefiltered environment map)
-            std::vector<VkImageView> image_views(num_mipmap_tail_levels);
-            std::vector<VkDescriptorImageInfo> image_infos(num_mipmap_tail_levels);
-            
-            // Starting at 1 (0 is the original image and is handled separately)
-            for (unsigned level = 1u; level < num_mipmap_levels; ++level) {
-                // Create an image view for this level
-                create_image_view(device, prefiltered_environment_map.image, VK_IMAGE_VIEW_TYPE_CUBE, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1, layers, image_views[level - 1u]);
-            
-                image_infos[level - 1].imageView = image_views[level - 1];
-                image_infos[level - 1].imageLayout = VK_IMAGE_LAYOUT_GENERAL; // For storage image reads
-                image_infos[level - 1].sampler = environment_map_sampler;
-            }
-            
-            descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptor_writes[1].dstSet = compute_descriptor_set;
-            descriptor_writes[1].dstBinding = 1;
-            descriptor_writes[1].dstArrayElement = 0;
-            descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-            descriptor_writes[1].descriptorCount = image_infos.size();
-            descriptor_writes[1].pImageInfo = image_infos.data();
-            
-            vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
-            
-            // Create pipeline
-            VkPipelineLayout compute_pipeline_layout { };
-            VkPipeline compute_pipeline { };
-            
-            // Pipeline layout
-            VkPipelineLayoutCreateInfo compute_pipeline_layout_create_info { };
-            compute_pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            compute_pipeline_layout_create_info.setLayoutCount = 1;
-            compute_pipeline_layout_create_info.pSetLayouts = { &compute_descriptor_set_layout };
-            
-            // Push constant ranges
-            struct PushConstants {
-                unsigned mip_level;
-                float roughness;
-            };
-            VkPushConstantRange push_constant_range { };
-            push_constant_range.size = sizeof(PushConstants);
-            push_constant_range.offset = 0u;
-            push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-            compute_pipeline_layout_create_info.pushConstantRangeCount = 1;
-            compute_pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
-            
-            if (vkCreatePipelineLayout(device, &compute_pipeline_layout_create_info, nullptr, &compute_pipeline_layout) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create compute pipeline layout!");
-            }
-            
-            VkComputePipelineCreateInfo pipeline_create_info { };
-            pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-            pipeline_create_info.layout = compute_pipeline_layout;
-            
-            // Compute shader constants
-            VkSpecializationMapEntry specialization { };
-            
-            // layout (constant_id = 0) const int NUM_MIP_LEVELS;
-            specialization.constantID = 0;
-            specialization.size = sizeof(unsigned);
-            specialization.offset = 0;
-            
-            struct SpecializationData {
-                unsigned num_mipmap_levels;
-            };
-            SpecializationData data { };
-            data.num_mipmap_levels = num_mipmap_levels;
-            
-            VkSpecializationInfo specialization_info { };
-            specialization_info.mapEntryCount = 1;
-            specialization_info.pMapEntries = &specialization;
-            specialization_info.dataSize = sizeof(SpecializationData);
-            specialization_info.pData = &data;
-            
-            VkShaderModule shader_module = create_shader_module(device, "shaders/prefilter_environment_map.comp");
-            pipeline_create_info.stage = create_shader_stage(shader_module, VK_SHADER_STAGE_COMPUTE_BIT, &specialization_info);
-            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &compute_pipeline) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create compute pipeline!");
-            }
-            
-            vkDestroyShaderModule(device, shader_module, nullptr);
-            
-            VkCommandBuffer command_buffer = begin_transient_command_buffer();
-                // Transfer images to expected formats
-                VkImageSubresourceRange subresource_range { };
-                subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                subresource_range.baseMipLevel = 0;
-                subresource_range.levelCount = 1;
-                subresource_range.baseArrayLayer = 0;
-                subresource_range.layerCount = 6; // Cubemap layers
-                
-                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-                transition_image(command_buffer, prefiltered_environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresource_range, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-                // Copy mipmap level 0 (original texture) into destination environment map
-                copy_image_to_image(command_buffer, environment_map.image, prefiltered_environment_map.image, 0, 0, layers, environment_map_size, environment_map_size, 1);
-            
-                // Environment map is no longer needed, transition to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL (use VK_IMAGE_LAYOUT_UNDEFINED because only the first layer was transitioned to VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) for use in the COMPUTE stage (for prefiltering individual mipmap levels)
-                subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
-                transition_image(command_buffer, environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-                
-                // Transition ALL MIPMAP LEVELS of the prefiltered environment map to VK_IMAGE_LAYOUT_GENERAL for storage image writes
-                subresource_range.baseMipLevel = 0;
-                subresource_range.levelCount = num_mipmap_levels;
-                transition_image(command_buffer, prefiltered_environment_map.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresource_range, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-                
-                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
-                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1, &compute_descriptor_set, 0, nullptr);
-                
-                // Each mipmap level is half the size of the previous level
-                for (unsigned level = 1u, size = environment_map_size / 2; level < num_mipmap_levels; ++level, size /= 2) {
-                    std::size_t num_work_groups = std::max(1u, size / 32);
-                    
-                    PushConstants push_constants { };
-                    push_constants.mip_level = level - 1;
-                    push_constants.roughness =  (float) level / (float) num_mipmap_levels;
-                    
-					vkCmdPushConstants(command_buffer, compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push_constants);
-                    vkCmdDispatch(command_buffer, num_work_groups, num_work_groups, 6);
+                         reference.image, reference.memory);
+            create_image_view(device, reference.image, VK_IMAGE_VIEW_TYPE_CUBE, reference.format, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 6, reference.view);
+            
+            std::cout << "computing convoluted irradiance map (reference)" << std::endl;
+            auto start = std::chrono::high_resolution_clock::now();
+                precompute_irradiance_map(bake.environment_map, reference);
+            auto end = std::chrono::high_resolution_clock::now();
+            double cubemap_time = std::chrono::duration<double, std::milli>(end - start).count();
+            
+            CachedTexture reference_texels { };
+            download_cached_texture(reference, 1u, 6u, reference_texels);
+            
+            CachedTexture coefficient_texels { };
+            download_cached_texture(bake.target->irradiance_sh, 1u, 1u, coefficient_texels);
+            
+            vkDestroyImageView(device, reference.view, nullptr);
+            vkDestroyImage(device, reference.image, nullptr);
+            vkFreeMemory(device, reference.memory, nullptr);
+            
+            const glm::vec4* coefficients = reinterpret_cast<const glm::vec4*>(coefficient_texels.data.data());
+            const glm::vec4* texels = reinterpret_cast<const glm::vec4*>(reference_texels.data.data());
+            
+            // Compare luminance at every texel of the reference, using the same sample directions as shaders/irradiance_map.comp
+            glm::vec3 luminance_weights = glm::vec3(0.2126f, 0.7152f, 0.0722f);
+            double squared_error = 0.0;
+            double squared_reference = 0.0;
+            double max_relative_error = 0.0;
+            
+            unsigned size = reference.width;
+            for (unsigned face = 0u; face < 6u; ++face) {
+                for (unsigned y = 0u; y < size; ++y) {
+                    for (unsigned x = 0u; x < size; ++x) {
+                        glm::vec2 uv = glm::vec2((float) x / (float) size, 1.0f - (float) y / (float) size) * 2.0f - 1.0f;
+                        glm::vec3 directions[6] = {
+                            glm::vec3(1.0f, uv.y, -uv.x),
+                            glm::vec3(-1.0f, uv.y, uv.x),
+                            glm::vec3(uv.x, 1.0f, -uv.y),
+                            glm::vec3(uv.x, -1.0f, uv.y),
+                            glm::vec3(uv.x, uv.y, 1.0f),
+                            glm::vec3(-uv.x, uv.y, -1.0f)
+                        };
+                        glm::vec3 n = glm::normalize(directions[face]);
+                        
+                        // Must match evaluate_irradiance in shaders/brdf.frag
+                        glm::vec3 irradiance = glm::vec3(coefficients[0]) * 0.282095f +
+                                               glm::vec3(coefficients[1]) * 0.488603f * n.y +
+                                               glm::vec3(coefficients[2]) * 0.488603f * n.z +
+                                               glm::vec3(coefficients[3]) * 0.488603f * n.x +
+                                               glm::vec3(coefficients[4]) * 1.092548f * n.x * n.y +
+                                               glm::vec3(coefficients[5]) * 1.092548f * n.y * n.z +
+                                               glm::vec3(coefficients[6]) * 0.315392f * (3.0f * n.z * n.z - 1.0f) +
+                                               glm::vec3(coefficients[7]) * 1.092548f * n.x * n.z +
+                                               glm::vec3(coefficients[8]) * 0.546274f * (n.x * n.x - n.y * n.y);
+                        irradiance = glm::max(irradiance, glm::vec3(0.0f));
+                        
+                        double expected = glm::dot(glm::vec3(texels[(face * size + y) * size + x]), luminance_weights);
+                        double error = glm::dot(irradiance, luminance_weights) - expected;
+                        
+                        squared_error += error * error;
+                        squared_reference += expected * expected;
+                        if (expected > 1e-4) {
+                            max_relative_error = std::max(max_relative_error, std::abs(error) / expected);
+                        }
+                    }
                 }
-                
-                // Transition image + all mipmap levels to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                subresource_range.baseMipLevel = 0;
-                subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
-                transition_image(command_buffer, prefiltered_environment_map.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-            
-            submit_transient_command_buffer(command_buffer);
-            
-            // Destroy resources
-            // Image views for mip chain
-            for (VkImageView view : image_views) {
-                vkDestroyImageView(device, view, nullptr);
             }
             
-            // Pipeline layout
-            vkDestroyPipelineLayout(device, compute_pipeline_layout, nullptr);
-            
-            // Pipeline
-            vkDestroyPipeline(device, compute_pipeline, nullptr);
-            
-            // Descriptor set layout
-            vkDestroyDescriptorSetLayout(device, compute_descriptor_set_layout, nullptr);
-            
-            // Descriptor sets
-            vkFreeDescriptorSets(device, descriptor_pool, 1, &compute_descriptor_set);
+            std::cout << "irradiance comparison (spherical harmonics / " << size << "x" << size << " cubemap)" << std::endl;
+            std::cout << "  bake time: " << sh_time << " ms / " << cubemap_time << " ms" << std::endl;
+            std::cout << "  memory: " << coefficient_texels.data.size() << " bytes / " << reference_texels.data.size() / (1024.0 * 1024.0) << " MB" << std::endl;
+            std::cout << "  relative RMS luminance error: " << std::sqrt(squared_error / squared_reference) * 100.0 << "%" << std::endl;
+            std::cout << "  maximum relative luminance error: " << max_relative_error * 100.0 << "%" << std::endl;
+        }
+        
+        unsigned compute_num_mipmap_levels(unsigned w, unsigned h) {
+            return (unsigned) (std::floor(std::log2(std::max(w, h)))) + 1u;
+        }
+        
+        unsigned compute_num_prefiltered_mipmap_levels() {
+            // Each mipmap level of the prefiltered environment map stores one roughness level
+            // Roughness is spread over a reduced number of levels to prevent artifacts at high roughness levels (the smallest levels of a full mipmap chain are too coarse to represent wide lobes)
+            return 4u;
         }
         
         void compute_brdf_lut() {
-            // The BRDF LUT is a 2D texture that represents how the BRDF of the object responds
-            create_image(physical_device, device,
-                         brdf_lut_size, brdf_lut_size, 1, 1,
-                         VK_SAMPLE_COUNT_1_BIT,
-                         VK_FORMAT_R32G32B32A32_SFLOAT,
-                         VK_IMAGE_TILING_OPTIMAL,
-                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-                         0,
-                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                         brdf_lut.image, brdf_lut.memory);
-            create_image_view(device, brdf_lut.image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 1, brdf_lut.view);
-            
+            // The BRDF LUT is a 2D texture that represents how the BRDF of the object responds (created in create_ibl_textures)
             VkDescriptorSetLayout compute_descriptor_set_layout { };
             VkDescriptorSet compute_descriptor_set { };
             
@@ -1958,7 +2543,7 @@ class PBR final : public Sample {
                 
                 vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline);
                 vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout, 0, 1, &compute_descriptor_set, 0, nullptr);
-                vkCmdDispatch(command_buffer, 32, 32, 1);
+                vkCmdDispatch(command_buffer, std::max(1u, brdf_lut_size / 32), std::max(1u, brdf_lut_size / 32), 1);
                 
                 transition_image(command_buffer, brdf_lut.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
             submit_transient_command_buffer(command_buffer);
@@ -1997,17 +2582,15 @@ class PBR final : public Sample {
             vkFreeMemory(device, normals.memory, nullptr);
             vkDestroyImageView(device, normals.view, nullptr);
             
-            vkDestroyImage(device, environment_map.image, nullptr);
-            vkFreeMemory(device, environment_map.memory, nullptr);
-            vkDestroyImageView(device, environment_map.view, nullptr);
-            
-            vkDestroyImage(device, irradiance_map.image, nullptr);
-            vkFreeMemory(device, irradiance_map.memory, nullptr);
-            vkDestroyImageView(device, irradiance_map.view, nullptr);
-            
-            vkDestroyImage(device, prefiltered_environment_map.image, nullptr);
-            vkFreeMemory(device, prefiltered_environment_map.memory, nullptr);
-            vkDestroyImageView(device, prefiltered_environment_map.view, nullptr);
+            for (EnvironmentLighting* target : { &lighting, &baked_lighting }) {
+                vkDestroyImage(device, target->irradiance_sh.image, nullptr);
+                vkFreeMemory(device, target->irradiance_sh.memory, nullptr);
+                vkDestroyImageView(device, target->irradiance_sh.view, nullptr);
+                
+                vkDestroyImage(device, target->prefiltered_environment_map.image, nullptr);
+                vkFreeMemory(device, target->prefiltered_environment_map.memory, nullptr);
+                vkDestroyImageView(device, target->prefiltered_environment_map.view, nullptr);
+            }
             
             vkDestroyImage(device, brdf_lut.image, nullptr);
             vkFreeMemory(device, brdf_lut.memory, nullptr);
@@ -2043,7 +2626,7 @@ class PBR final : public Sample {
                 debug_view = NORMAL;
             }
             else if (key == GLFW_KEY_P) {
-                mipmap_level = glm::clamp(++mipmap_level, 0u, compute_num_mipmap_levels(environment_map_size, environment_map_size));
+                mipmap_level = glm::clamp(++mipmap_level, 0u, compute_num_prefiltered_mipmap_levels() - 1u);
             }
             else if (key == GLFW_KEY_O) {
                 if (mipmap_level > 0) {
@@ -2055,6 +2638,11 @@ class PBR final : public Sample {
             else if (key == GLFW_KEY_SPACE) {
                 paused = !paused;
             }
+            else if (key == GLFW_KEY_N) {
+                // Cycle through environments
+                environment_index = (environment_index + 1u) % (unsigned) environments.size();
+                load_environment(environments[environment_index]);
+            }
             
             // Orbit camera movement
             else if (key == GLFW_KEY_A) {
@@ -20,7 +20,7 @@ layout (set = 0, binding = 2) uniform sampler2D ao_map;
 layout (set = 0, binding = 3) uniform sampler2D emissive_map;
 layout (set = 0, binding = 4) uniform sampler2D metallic_roughness_map;
 layout (set = 0, binding = 5) uniform sampler2D normal_map;
-layout (set = 0, binding = 6) uniform samplerCube irradiance_map;
+layout (set = 0, binding = 6) uniform sampler2D irradiance_sh; // 9 spherical harmonics coefficients (RGB)
 layout (set = 0, binding = 7) uniform samplerCube prefiltered_environment_map;
 layout (set = 0, binding = 8) uniform sampler2D brdf_lut;
 
@@ -64,6 +64,25 @@ float D(vec3 N, vec3 H, float roughness) {
     return alpha2 / (pi * denominator * denominator);
 }
 
+// Irradiance (divided by π) for a surface with normal N, evaluated from the spherical harmonics representation of the environment
+// Coefficients are already convolved with the clamped cosine lobe
+vec3 evaluate_irradiance(vec3 N) {
+    vec3 sh[9];
+    for (int i = 0; i < 9; ++i) {
+        sh[i] = texelFetch(irradiance_sh, ivec2(i, 0), 0).rgb;
+    }
+
+    return max(sh[0] * 0.282095 +
+               sh[1] * 0.488603 * N.y +
+               sh[2] * 0.488603 * N.z +
+               sh[3] * 0.488603 * N.x +
+               sh[4] * 1.092548 * N.x * N.y +
+               sh[5] * 1.092548 * N.y * N.z +
+               sh[6] * 0.315392 * (3.0 * N.z * N.z - 1.0) +
+               sh[7] * 1.092548 * N.x * N.z +
+               sh[8] * 0.546274 * (N.x * N.x - N.y * N.y), vec3(0.0));
+}
+
 vec3 calculate_normal() {
     // This calculation follows the calculation of vertex tangents, except using derivatives of the interpolated world position / texture coordinates
     // Derivation: https://web.archive.org/web/20110708081637/http://www.terathon.com/code/tangent.html
@@ -118,7 +137,7 @@ void main() {
         vec3 kD = 1.0 - kS;
         kD *= 1.0 - metallic;
 
-        vec3 irradiance = texture(irradiance_map, N).rgb;
+        vec3 irradiance = evaluate_irradiance(N);
         vec3 diffuse = irradiance * albedo;
 
         int mipmap_levels = textureQueryLevels(prefiltered_environment_map);
@@ -156,7 +175,7 @@ void main() {
         vec3 ks = F(N, V, F0, roughness);
         vec3 kd = 1.0 - ks;
 
-        vec3 irradiance = texture(irradiance_map, N).rgb;
+        vec3 irradiance = evaluate_irradiance(N);
         vec3 diffuse = irradiance; // * albedo;
 
         vec3 color = diffuse; // (kd * diffuse) * ao;
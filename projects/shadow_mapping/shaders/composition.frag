@@ -1,12 +1,13 @@
 
 #version 450
 
+#include "common/geometry_buffer.glsl"
+
 layout (constant_id = 0) const int LIGHT_COUNT = 32;
 
 layout (location = 0) in vec2 vertex_uv;
 
 struct Light {
-    mat4 transform; // Stores projection * view
     vec3 position;
 
     float outer;
@@ -21,18 +22,30 @@ layout (set = 0, binding = 0) uniform GlobalUniforms {
     mat4 projection;
     vec3 camera_position;
     int debug_view;
+    mat4 inverse_view_projection; // For reconstructing world space positions from depth
 } global;
 
 layout (set = 0, binding = 1) uniform LightingUniforms {
     Light lights[LIGHT_COUNT];
 } lighting;
 
-layout (set = 0, binding = 2) uniform sampler2D positions; // world space
-layout (set = 0, binding = 3) uniform sampler2D normals; // world space
-layout (set = 0, binding = 4) uniform sampler2D ambient;
-layout (set = 0, binding = 5) uniform sampler2D diffuse;
-layout (set = 0, binding = 6) uniform sampler2D specular;
-layout (set = 0, binding = 7) uniform sampler2DArray shadow;
+// Geometry buffer attachments are read at the current pixel from the previous subpass
+layout (input_attachment_index = 0, set = 0, binding = 2) uniform subpassInput normals; // world space, octahedral encoded
+layout (input_attachment_index = 1, set = 0, binding = 3) uniform subpassInput materials;
+layout (set = 0, binding = 4) uniform sampler2D depth;
+layout (set = 0, binding = 5) uniform sampler2D shadow; // Shadow atlas, one slot per cascade of each light
+
+// MATERIAL_COUNT, CASCADE_COUNT, SHADOW_LAYER_COUNT are provided when the shader is compiled
+
+layout (set = 0, binding = 6) uniform MaterialUniforms {
+    Material materials[MATERIAL_COUNT];
+} material_table;
+
+layout (set = 0, binding = 7) uniform ShadowUniforms {
+    mat4 transforms[SHADOW_LAYER_COUNT]; // Light projection * view of each cascade, indexed by light * CASCADE_COUNT + cascade
+    vec4 slots[SHADOW_LAYER_COUNT]; // Slot of each cascade in the shadow atlas, in texture coordinates (x, y: origin, z: size)
+    vec4 splits; // View space far distance of each cascade
+} shadows;
 
 layout (location = 0) out vec4 out_color;
 
@@ -43,20 +56,38 @@ float linearize(float d) {
 }
 
 float shadowing(vec3 position, vec3 normal, int i) {
-    Light light = lighting.lights[i];
+    // Select the first cascade that contains the point
+    float view_depth = -(global.view * vec4(position, 1.0f)).z;
+    int cascade = CASCADE_COUNT - 1;
+    for (int c = 0; c < CASCADE_COUNT - 1; ++c) {
+        if (view_depth < shadows.splits[c]) {
+            cascade = c;
+            break;
+        }
+    }
+    int layer = i * CASCADE_COUNT + cascade;
+    vec4 slot = shadows.slots[layer];
+    if (slot.z == 0.0f) {
+        // Cascade did not receive a slot in the atlas (it does not cover any visible geometry)
+        return 0.0f;
+    }
 
-    vec4 shadow_position = light.transform * vec4(position, 1.0f);
+    vec4 shadow_position = shadows.transforms[layer] * vec4(position, 1.0f);
     shadow_position /= shadow_position.w; // Perspective divide
     shadow_position.xy = shadow_position.xy * 0.5f + 0.5f; // [0.0, 1.0]
 
-    if (shadow_position.z < 0.0f || shadow_position.z > 1.0f) {
-        // Point is behind the light view frustum
+    if (shadow_position.z < 0.0f || shadow_position.z > 1.0f || any(lessThan(shadow_position.xy, vec2(0.0f))) || any(greaterThan(shadow_position.xy, vec2(1.0f)))) {
+        // Point is outside of the light view frustum
         // Return this point as fully illuminated
         return 0.0f;
     }
 
+    // Keep filtering from reading texels of neighboring slots
+    vec2 half_texel = 0.5f / vec2(textureSize(shadow, 0));
+    vec2 uv = slot.xy + clamp(shadow_position.xy * slot.z, half_texel, slot.z - half_texel);
+
     // Depth value from the perspective of the light
-    float shadow_map_depth = texture(shadow, vec3(shadow_position.xy, i)).r;
+    float shadow_map_depth = texture(shadow, uv).r;
 
     // When transformed, the fragment has a greater depth than when rendered from the light, meaning it is obstructed and cannot be seen by the light
     // It is in shadow
@@ -65,10 +96,20 @@ float shadowing(vec3 position, vec3 normal, int i) {
 }
 
 void main() {
+    float d = texture(depth, vertex_uv).r;
+    if (d == 1.0f) {
+        // Background
+        out_color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+
+    vec4 material = subpassLoad(materials);
+    Material m = material_table.materials[min(decode_material_index(material), uint(MATERIAL_COUNT - 1))];
+
     vec3 color = vec3(0.0f);
 
-    vec3 position = texture(positions, vertex_uv).xyz;
-    vec3 N = texture(normals, vertex_uv).xyz;
+    vec3 position = reconstruct_position(vertex_uv, d, global.inverse_view_projection);
+    vec3 N = decode_normal(subpassLoad(normals).xy);
     vec3 V = normalize(global.camera_position - position);
 
     for (int i = 0; i < LIGHT_COUNT; ++i) {
@@ -78,16 +119,16 @@ void main() {
         vec3 L = -normalize(light.direction); // Directional light
 
         // Ambient
-        vec3 ambient_component = texture(ambient, vertex_uv).xyz;
+        vec3 ambient_component = m.ambient.rgb;
 
         // Diffuse
         float lambert = max(dot(N, L), 0.0f);
-        vec3 diffuse_component = light.color * texture(diffuse, vertex_uv).rgb * lambert;
+        vec3 diffuse_component = light.color * material.rgb * lambert;
 
         // Specular
         vec3 specular_component = vec3(0.0f);
         if (lambert > 0.0f) {
-            vec4 s = texture(specular, vertex_uv); // specular color.rgb, specular exponent
+            vec4 s = m.specular; // specular color.rgb, specular exponent
 
             // Specular highlights only happen with visible faces
             vec3 R = normalize(2 * lambert * N - L); // 2 N.L * N - L
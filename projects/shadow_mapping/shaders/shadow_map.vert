@@ -1,14 +1,38 @@
-
 #version 450
 
+// SHADOW_LAYER_COUNT is provided when the shader is compiled
+
 layout (location = 0) in vec3 vertex_position;
+layout (location = 1) in uint layer; // Per instance, one instance per shadow map layer (light + cascade) that can see the object
+
+layout (set = 0, binding = 7) uniform ShadowUniforms {
+    mat4 transforms[SHADOW_LAYER_COUNT]; // Light projection * view of each cascade, indexed by light * CASCADE_COUNT + cascade
+    vec4 slots[SHADOW_LAYER_COUNT]; // Slot of each cascade in the shadow atlas, in texture coordinates (x, y: origin, z: size)
+    vec4 splits; // View space far distance of each cascade
+} shadows;
 
 layout (set = 1, binding = 0) uniform ObjectTransforms {
     mat4 model;
     mat4 normal;
 } object;
 
+out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_ClipDistance[4];
+};
+
 void main() {
-    // Output vertices in world space
-    gl_Position = object.model * vec4(vertex_position, 1.0f);
+    vec4 position = shadows.transforms[layer] * object.model * vec4(vertex_position, 1.0f);
+    
+    // Geometry outside of the light frustum is clipped against the edges of the frustum (instead of the viewport, which covers the entire atlas) so that it does not bleed into neighboring slots
+    gl_ClipDistance[0] = position.w + position.x;
+    gl_ClipDistance[1] = position.w - position.x;
+    gl_ClipDistance[2] = position.w + position.y;
+    gl_ClipDistance[3] = position.w - position.y;
+    
+    // The shadow framebuffer has one depth attachment (the atlas), scale and offset the light frustum into the slot of the layer
+    // [-1, 1] maps to [origin, origin + size] in texture coordinates, which is [2 * origin - 1, 2 * (origin + size) - 1] in normalized device coordinates
+    vec2 origin = shadows.slots[layer].xy;
+    float size = shadows.slots[layer].z;
+    gl_Position = vec4(position.xy * size + position.w * (2.0f * origin + size - 1.0f), position.zw);
 }
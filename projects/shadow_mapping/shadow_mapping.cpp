@@ -2,17 +2,29 @@
 #include "sample.hpp"
 #include "helpers.hpp"
 #include "vulkan_initializers.hpp"
+#include "frustum_culling.hpp"
+#include "geometry_buffer.hpp"
+#include "shadow_atlas.hpp"
+#include "shadow_cache.hpp"
 #include "loaders/obj.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan requires depth values to range [0.0, 1.0], not the default [-1.0, 1.0] that OpenGL uses
 #include <glm/gtx/transform.hpp>
 #include <string> // std::string, std::to_string
+#include <algorithm> // std::min, std::max
+#include <cmath> // std::pow, std::floor, std::ceil, std::sqrt
+#include <limits> // std::numeric_limits
 
 class ShadowMapping final : public Sample {
     public:
-        ShadowMapping() : Sample("Shadow Mapping") {
-            enabled_physical_device_features.geometryShader = (VkBool32) true;
+        ShadowMapping() : Sample("Shadow Mapping"),
+                          cascade_count(4),
+                          cascade_split_lambda(0.75f),
+                          shadow_atlas(2048, 128),
+                          max_shadow_slot_size(1024) {
+            // Geometry rendered into a slot of the shadow atlas is clipped to the bounds of the slot
+            enabled_physical_device_features.shaderClipDistance = (VkBool32) true;
             
             camera.set_position(glm::vec3(0, 2, 6));
             camera.set_look_direction(glm::vec3(0.0f, 0.25f, -1.0f));
@@ -42,7 +54,6 @@ class ShadowMapping final : public Sample {
             
             // Custom structures must be aligned to a 16-byte boundary in uniform buffers
             struct alignas(16) Light {
-                glm::mat4 transform;
                 glm::vec3 position;
                 float outer;
                 glm::vec3 direction;
@@ -54,6 +65,12 @@ class ShadowMapping final : public Sample {
             std::vector<Object> objects;
             std::vector<Light> lights;
         } scene;
+
+        // Model-space bounds of each model, used to (re)compute the world-space bounding volumes of the objects that reference it
+        std::vector<std::pair<glm::vec3, glm::vec3>> model_bounds;
+        
+        FrustumCuller culler;
+        std::vector<unsigned> visible_objects; // Indices into scene.objects that intersect the camera frustum this frame
         
         // Geometry buffers
         VkBuffer vertex_buffer;
@@ -69,14 +86,50 @@ class ShadowMapping final : public Sample {
         };
         
         // Section: shadow map
+        
+        // Cascaded shadow maps
+        // The camera frustum is split into cascades, each rendered into its own shadow map (layer) with a projection fit tightly around it
+        // Layers are ordered by light, then cascade (light * cascade_count + cascade)
+        unsigned cascade_count; // Up to 4
+        float cascade_split_lambda; // Blend between logarithmic (1.0) and uniform (0.0) split distances
+        std::vector<glm::mat4> shadow_transforms; // Light projection * view of each layer
+        glm::vec4 cascade_splits; // View space far distance of each cascade
+        std::pair<glm::vec3, glm::vec3> scene_bounds; // World space bounds of all objects
+        std::vector<std::pair<glm::vec3, glm::vec3>> object_bounds; // World space bounds of each object
+        
+        // All layers are packed into a single depth texture (the shadow atlas)
+        // Every frame, each layer requests a slot sized by its importance (the fraction of the screen covered by visible objects inside the cascade), and the atlas is re-packed
+        // Shadow memory is fixed by the size of the atlas, regardless of the number of lights / cascades
+        ShadowAtlas shadow_atlas;
+        unsigned max_shadow_slot_size; // Slot size of a layer that covers the entire screen
+        std::vector<ShadowAtlas::Slot> shadow_slots; // Slot of each layer in the atlas (slots with a size of 0 were not allocated, and are not rendered)
+        
         FramebufferAttachment shadow_attachment;
         VkFramebuffer shadow_framebuffer;
         
+        // Static casters are rendered into a separate (cached) shadow map that is only re-rendered when its contents change (see ShadowCache)
+        // Lights with dynamic casters copy their cached slot into the shadow map and render only the dynamic casters on top of it
+        FramebufferAttachment shadow_cache_attachment;
+        VkFramebuffer shadow_cache_framebuffer;
+        
         VkPipeline shadow_pipeline;
         VkPipelineLayout shadow_pipeline_layout;
         
         VkRenderPass shadow_render_pass;
         
+        // Objects are drawn into the shadow map once for every layer (light + cascade) that can see them, using one instance per layer
+        // Each instance fetches the layer it renders to from a per-instance vertex attribute
+        // Layer indices for all instances of a frame are written to a region of this buffer (one region per frame in flight, each holding up to objects * layers indices for both the static and dynamic casters)
+        VkBuffer shadow_instance_buffer;
+        VkDeviceMemory shadow_instance_buffer_memory;
+        void* shadow_instance_buffer_mapped;
+        
+        // Shadow map layers are only re-rendered if their shadows changed (the light or cascade moved, or an object inside of its frustum moved)
+        ShadowCache shadow_cache;
+        std::vector<glm::mat4> shadow_cached_transforms; // Layer transforms of the last update
+        std::vector<ShadowAtlas::Slot> shadow_cached_slots; // Layer slots of the last update
+        std::vector<unsigned> moved_objects; // Objects with a dirty transform this frame
+        
         // Descriptor set for shader globals used across the shadow map and geometry buffer render passes
         VkDescriptorSetLayout global_descriptor_set_layout;
         VkDescriptorSet global_descriptor_set;
@@ -89,6 +142,7 @@ class ShadowMapping final : public Sample {
             glm::mat4 projection;
             glm::vec3 camera_position;
             int debug_view;
+            glm::mat4 inverse_view_projection; // For reconstructing world space positions from depth
         };
         
         struct ObjectUniforms {
@@ -97,56 +151,53 @@ class ShadowMapping final : public Sample {
         };
         
         struct PhongUniforms {
-            glm::vec3 ambient;
-            float specular_exponent;
             glm::vec3 diffuse;
+            unsigned material; // Index into the material table (ambient, specular)
             int flat_shaded;
-            alignas(16) glm::vec3 specular;
         };
 
         // Section: geometry buffer
         
-        // Position, normals, ambient, diffuse, specular
-        std::array<FramebufferAttachment, 5> geometry_framebuffer_attachments;
-        VkFramebuffer geometry_framebuffer;
+        // Normals, material (see geometry_buffer.hpp), depth comes from the depth buffer
+        // Geometry buffer attachments are only read by the composition subpass (as input attachments), so their contents never leave tile memory
+        // They are created as transient attachments backed by lazily allocated memory (where supported), which is (potentially) never committed
+        std::array<FramebufferAttachment, 2> geometry_framebuffer_attachments;
         
         VkPipeline geometry_pipeline;
         VkPipelineLayout geometry_pipeline_layout;
         
-        VkRenderPass geometry_render_pass;
-        
         // Composition
         VkPipelineLayout composition_pipeline_layout;
         VkPipeline composition_pipeline;
         
-        VkRenderPass composition_render_pass;
+        // Geometry buffer (subpass 0) and composition (subpass 1) are two subpasses of the same render pass, one framebuffer per swapchain image
+        VkRenderPass deferred_render_pass;
         
         // Uniform buffers
         VkBuffer uniform_buffer; // One uniform buffer for all uniforms, across both passes
         VkDeviceMemory uniform_buffer_memory;
         void* uniform_buffer_mapped;
 
-        VkSampler color_sampler;
         VkSampler depth_sampler;
         
         void initialize_resources() override {
             initialize_buffers();
             initialize_lights();
+            initialize_shadow_instance_buffer();
             
             initialize_samplers();
             
             initialize_shadow_map_render_pass();
-            initialize_geometry_render_pass();
-            initialize_composition_render_pass();
+            initialize_deferred_render_pass();
             
             initialize_shadow_map_framebuffer();
-            initialize_geometry_framebuffer();
-            initialize_composition_framebuffers();
+            initialize_geometry_buffer();
+            initialize_deferred_framebuffers();
 
-            // Two global descriptor sets (camera + lights)
+            // Four global uniform buffers (camera + lights + material table + shadow cascades)
             // Two descriptor sets per object (transforms + material properties)
-            // 7 image samplers (positions, normals, ambient, diffuse, specular, depth, shadow)
-            initialize_descriptor_pool(2 + scene.objects.size() * 2, 7);
+            // 2 image samplers (depth, shadow), 2 input attachments (normals, material)
+            initialize_descriptor_pool(4 + scene.objects.size() * 2, 2, 2);
             
             initialize_uniform_buffer();
             
@@ -163,6 +214,7 @@ class ShadowMapping final : public Sample {
             destroy_descriptor_sets();
             destroy_uniform_buffer();
             destroy_buffers();
+            destroy_shadow_instance_buffer();
             destroy_framebuffers();
             destroy_render_passes();
             destroy_samplers();
@@ -173,6 +225,15 @@ class ShadowMapping final : public Sample {
 //            Transform& transform = object.transform;
 //            transform.set_rotation(transform.get_rotation() + (float)dt * glm::vec3(0.0f, -10.0f, 0.0f));
             
+            culler.update_objects(scene.objects, model_bounds, &moved_objects);
+            culler.cull(camera.get_projection_matrix() * camera.get_view_matrix(), visible_objects);
+            
+            if (!moved_objects.empty()) {
+                update_scene_bounds();
+            }
+            
+            update_cascades();
+            update_shadow_draws();
             update_uniform_buffers();
         }
         
@@ -188,113 +249,321 @@ class ShadowMapping final : public Sample {
             }
         
             // Overview of a frame:
-            // 1. Generate shadow map
-            // 2. Generate geometry buffer
-            // 3. Composition pass
-            
-            VkRenderPass render_passes[3] = {
-                shadow_render_pass,
-                geometry_render_pass,
-                composition_render_pass
-            };
+            // 1. Update shadow maps (only for lights whose shadows changed)
+            // 2. Generate geometry buffer (subpass 0)
+            // 3. Composition (subpass 1 of the same render pass)
+            record_shadow_pass(command_buffer);
+            
+            VkClearValue clear_values[4] { };
+            clear_values[0].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Normals
+            clear_values[1].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Material
+            clear_values[2].depthStencil = { 1.0f, 0 }; // Depth
+            clear_values[3].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Output attachment
+            
+            VkRenderPassBeginInfo render_pass_info { };
+            render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_info.renderPass = deferred_render_pass;
+            render_pass_info.framebuffer = present_framebuffers[image_index];
+            render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
+            render_pass_info.clearValueCount = sizeof(clear_values) / sizeof(clear_values[0]);
+            render_pass_info.pClearValues = clear_values;
+            
+            vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+                // Subpass 0: geometry buffer
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline_layout, 0, 1, &global_descriptor_set, 0, nullptr);
+                
+                // The geometry pass only draws objects that passed frustum culling in update()
+                for (unsigned i : visible_objects) {
+                    const Scene::Object& object = scene.objects[i];
+                    const Model& model = models[object.model];
+                    
+                    // Bind vertex + index buffers buffer
+                    VkDeviceSize offsets[] = { object.vertex_offset };
+                    vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
+                    vkCmdBindIndexBuffer(command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
+                    
+                    // Bind per-object descriptor set
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_pipeline_layout, 1, 1, &object_descriptor_sets[i], 0, nullptr);
+                    
+                    vkCmdDrawIndexed(command_buffer, (unsigned) model.indices.size(), 1, 0, 0, 0);
+                }
+                
+                // Subpass 1: composition, reads the geometry buffer at the current pixel
+                vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+                
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline);
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composition_pipeline_layout, 0, 1, &global_descriptor_set, 0, nullptr);
+                
+                // Draw a full screen triangle
+                vkCmdDraw(command_buffer, 3, 1, 0, 0);
+            vkCmdEndRenderPass(command_buffer);
             
-            VkFramebuffer framebuffers[3] = {
-                shadow_framebuffer,
-                geometry_framebuffer,
-                present_framebuffers[image_index]
-            };
+            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record command buffer!");
+            }
+        }
+        
+        void update_scene_bounds() {
+            scene_bounds = std::make_pair(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()));
+            object_bounds.resize(scene.objects.size());
             
-            VkPipeline pipelines[3] = {
-                shadow_pipeline,
-                geometry_pipeline,
-                composition_pipeline
-            };
+            for (std::size_t o = 0u; o < scene.objects.size(); ++o) {
+                Scene::Object& object = scene.objects[o];
+                const std::pair<glm::vec3, glm::vec3>& bounds = model_bounds[object.model];
+                glm::mat4 transform = object.transform.get_matrix();
+                
+                glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+                glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+                for (int i = 0; i < 8; ++i) {
+                    glm::vec3 corner = glm::vec3(transform * glm::vec4((i & 1) ? bounds.second.x : bounds.first.x, (i & 2) ? bounds.second.y : bounds.first.y, (i & 4) ? bounds.second.z : bounds.first.z, 1.0f));
+                    min = glm::min(min, corner);
+                    max = glm::max(max, corner);
+                }
+                
+                object_bounds[o] = std::make_pair(min, max);
+                scene_bounds.first = glm::min(scene_bounds.first, min);
+                scene_bounds.second = glm::max(scene_bounds.second, max);
+            }
+        }
+        
+        void update_cascades() {
+            float near = camera.get_near_plane_distance();
+            float far = camera.get_far_plane_distance();
             
-            VkPipelineLayout pipeline_layouts[3] {
-                shadow_pipeline_layout,
-                geometry_pipeline_layout,
-                composition_pipeline_layout
-            };
+            // Corners of the camera frustum in world space (near plane, then far plane)
+            glm::mat4 inverse_view_projection = glm::inverse(camera.get_projection_matrix() * camera.get_view_matrix());
+            glm::vec3 corners[8];
+            for (int i = 0; i < 8; ++i) {
+                glm::vec4 corner = inverse_view_projection * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : 0.0f, 1.0f);
+                corners[i] = glm::vec3(corner) / corner.w;
+            }
             
-            for (std::size_t pass = 0u; pass < 3; ++pass) {
-                VkRenderPassBeginInfo render_pass_info { };
-                render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                render_pass_info.renderPass = render_passes[pass];
-                render_pass_info.framebuffer = framebuffers[pass];
-                render_pass_info.renderArea = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
+            for (unsigned c = 0u; c < cascade_count; ++c) {
+                // Practical split scheme (Zhang et al.), blends logarithmic split distances (even texel density along the view axis) with uniform split distances (which keep the first cascades from becoming too small)
+                float p = (float) (c + 1u) / (float) cascade_count;
+                cascade_splits[c] = cascade_split_lambda * near * std::pow(far / near, p) + (1.0f - cascade_split_lambda) * (near + (far - near) * p);
+            }
+            
+            // Slot sizes depend on the split distances, and projections are snapped to the texels of their slot
+            update_shadow_slots();
+            
+            float previous = near;
+            for (unsigned c = 0u; c < cascade_count; ++c) {
+                float split = cascade_splits[c];
                 
-                // TODO: this can be simplified
-                if (pass == 0) {
-                    // Shadow pass
-                    VkClearValue clear_value { };
-                    clear_value.depthStencil = { 1.0f, 0 }; // Shadow pass only uses depth information
-                    render_pass_info.clearValueCount = 1;
-                    render_pass_info.pClearValues = &clear_value;
+                // Slice of the camera frustum covered by this cascade (frustum edges are interpolated between the near and far planes)
+                glm::vec3 slice[8];
+                for (int i = 0; i < 4; ++i) {
+                    slice[i] = glm::mix(corners[i], corners[i + 4], (previous - near) / (far - near));
+                    slice[i + 4] = glm::mix(corners[i], corners[i + 4], (split - near) / (far - near));
                 }
-                else if (pass == 1) {
-                    // Geometry pass
-                    VkClearValue clear_values[6] { };
-                    clear_values[0].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Positions
-                    clear_values[1].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Normals
-                    clear_values[2].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Ambient
-                    clear_values[3].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Diffuse
-                    clear_values[4].color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Specular
-                    clear_values[5].depthStencil = { 1.0f, 0 }; // Depth
-                    
-                    render_pass_info.clearValueCount = sizeof(clear_values) / sizeof(clear_values[0]);
-                    render_pass_info.pClearValues = clear_values;
+                previous = split;
+                
+                // Fitting a bounding sphere (instead of a box) keeps the size of the projection constant as the camera rotates, which would otherwise cause shadow edges to shimmer
+                glm::vec3 center = glm::vec3(0.0f);
+                for (const glm::vec3& corner : slice) {
+                    center += corner / 8.0f;
                 }
-                else if (pass == 2) {
-                    // Composition pass
-                    VkClearValue clear_value { };
-                    clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }}; // Output attachment
-                    render_pass_info.clearValueCount = 1;
-                    render_pass_info.pClearValues = &clear_value;
+                
+                float radius = 0.0f;
+                for (const glm::vec3& corner : slice) {
+                    radius = std::max(radius, glm::length(corner - center));
                 }
+                radius = std::ceil(radius * 16.0f) / 16.0f;
                 
-                vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-                    // Bind graphics pipeline
-                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pass]);
-    
-                    // Bind global descriptor set
-                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layouts[pass], 0, 1, &global_descriptor_set, 0, nullptr);
-    
-                    if (pass == 2) {
-                        // Draw a full screen triangle
-                        vkCmdDraw(command_buffer, 3, 1, 0, 0);
+                for (std::size_t l = 0u; l < scene.lights.size(); ++l) {
+                    unsigned layer = (unsigned) l * cascade_count + c;
+                    if (shadow_slots[layer].size == 0u) {
+                        // Layer is not rendered this frame
+                        continue;
+                    }
+                    
+                    const Scene::Light& light = scene.lights[l];
+                    float texel_size = 2.0f * radius / (float) shadow_slots[layer].size;
+                    glm::vec3 up = std::abs(light.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), light.direction, up);
+                    
+                    // Snapping the projection to texel increments in light space keeps shadow map texels fixed in world space as the camera moves
+                    glm::vec3 origin = glm::vec3(view * glm::vec4(center, 1.0f));
+                    origin.x = std::floor(origin.x / texel_size) * texel_size;
+                    origin.y = std::floor(origin.y / texel_size) * texel_size;
+                    
+                    // The depth range does not follow the camera, both planes are taken from the scene bounds in light space (light space looks down -z)
+                    // This includes all casters between the light and the cascade, as well as all receivers inside of it
+                    // Planes are snapped outwards to increments of the cascade radius, so the projection only changes when the scene grows past them
+                    float min_z = std::numeric_limits<float>::max();
+                    float max_z = std::numeric_limits<float>::lowest();
+                    for (int i = 0; i < 8; ++i) {
+                        glm::vec3 corner = glm::vec3((i & 1) ? scene_bounds.second.x : scene_bounds.first.x, (i & 2) ? scene_bounds.second.y : scene_bounds.first.y, (i & 4) ? scene_bounds.second.z : scene_bounds.first.z);
+                        float z = (view * glm::vec4(corner, 1.0f)).z;
+                        min_z = std::min(min_z, z);
+                        max_z = std::max(max_z, z);
+                    }
+                    min_z = std::floor(min_z / radius) * radius;
+                    max_z = std::floor(max_z / radius) * radius + radius;
+                    
+                    glm::mat4 projection = glm::ortho(origin.x - radius, origin.x + radius, origin.y - radius, origin.y + radius, -max_z, -min_z);
+                    projection[1][1] *= -1;
+                    
+                    shadow_transforms[layer] = projection * view;
+                }
+            }
+        }
+        
+        void update_shadow_slots() {
+            glm::mat4 view = camera.get_view_matrix();
+            glm::mat4 view_projection = camera.get_projection_matrix() * view;
+            
+            // Importance of a cascade is the fraction of the screen covered by visible objects (shadow receivers) inside of it
+            // Objects are approximated by the screen space rectangle of their bounding box, and distributed across the cascades their depth range overlaps
+            glm::vec4 coverage = glm::vec4(0.0f);
+            
+            for (unsigned i : visible_objects) {
+                const std::pair<glm::vec3, glm::vec3>& bounds = object_bounds[i];
+                
+                glm::vec2 min = glm::vec2(1.0f);
+                glm::vec2 max = glm::vec2(-1.0f);
+                float near = std::numeric_limits<float>::max();
+                float far = 0.0f;
+                
+                for (int c = 0; c < 8; ++c) {
+                    glm::vec4 corner = glm::vec4((c & 1) ? bounds.second.x : bounds.first.x, (c & 2) ? bounds.second.y : bounds.first.y, (c & 4) ? bounds.second.z : bounds.first.z, 1.0f);
+                    glm::vec4 position = view_projection * corner;
+                    
+                    if (position.w <= 0.0f) {
+                        // Bounding box intersects the camera plane, conservatively assume it covers the entire screen
+                        min = glm::vec2(-1.0f);
+                        max = glm::vec2(1.0f);
                     }
                     else {
-                        for (std::size_t i = 0u; i < scene.objects.size(); ++i) {
-                            const Scene::Object& object = scene.objects[i];
-                            const Model& model = models[object.model];
+                        min = glm::min(min, glm::vec2(position) / position.w);
+                        max = glm::max(max, glm::vec2(position) / position.w);
+                    }
+                    
+                    float depth = -(view * corner).z;
+                    near = std::min(near, depth);
+                    far = std::max(far, depth);
+                }
+                
+                min = glm::clamp(min, glm::vec2(-1.0f), glm::vec2(1.0f));
+                max = glm::clamp(max, glm::vec2(-1.0f), glm::vec2(1.0f));
+                float area = std::max(max.x - min.x, 0.0f) * std::max(max.y - min.y, 0.0f) / 4.0f;
+                
+                float start = camera.get_near_plane_distance();
+                for (unsigned c = 0u; c < cascade_count; ++c) {
+                    float end = cascade_splits[c];
+                    float overlap = std::min(far, end) - std::max(near, start);
+                    if (overlap > 0.0f) {
+                        coverage[c] += area * std::min(overlap / std::max(far - near, 1e-4f), 1.0f);
+                    }
+                    start = end;
+                }
+            }
+            
+            // Slot resolution scales with the square root of the covered area (texel density on screen stays constant)
+            std::vector<unsigned> sizes(shadow_transforms.size());
+            for (std::size_t l = 0u; l < scene.lights.size(); ++l) {
+                for (unsigned c = 0u; c < cascade_count; ++c) {
+                    float importance = std::min(coverage[c], 1.0f);
+                    sizes[l * cascade_count + c] = importance > 0.0f ? (unsigned) ((float) max_shadow_slot_size * std::sqrt(importance)) : 0u;
+                }
+            }
+            
+            shadow_slots = shadow_atlas.pack(sizes);
+        }
         
-                            // Bind vertex + index buffers buffer
-                            VkDeviceSize offsets[] = { object.vertex_offset };
-                            vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
-                            vkCmdBindIndexBuffer(command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
+        void update_shadow_draws() {
+            std::size_t layer_count = shadow_transforms.size();
+            std::vector<unsigned> casters;
+            
+            shadow_cache.begin_update(moved_objects);
+            for (std::size_t l = 0u; l < layer_count; ++l) {
+                if (shadow_slots[l].size == 0u) {
+                    // Layers without a slot are not rendered, and are fully re-rendered once they receive a slot
+                    shadow_cache.skip_layer((unsigned) l);
+                    shadow_cached_slots[l] = shadow_slots[l];
+                    continue;
+                }
+                
+                // Per-layer culling against the light frustum of the cascade (casters outside of the camera frustum can still cast shadows into it)
+                culler.cull(shadow_transforms[l], casters);
+                
+                // The shadow cache is only invalidated when the light / cascade moves, its slot in the atlas changes (or its set of static casters shrinks)
+                // Cascades only move when the camera moves by at least one (snapped) texel, or the scene grows past the (snapped) depth range of the cascade
+                const ShadowAtlas::Slot& slot = shadow_slots[l];
+                const ShadowAtlas::Slot& cached_slot = shadow_cached_slots[l];
+                bool layer_moved = shadow_transforms[l] != shadow_cached_transforms[l] || slot.x != cached_slot.x || slot.y != cached_slot.y || slot.size != cached_slot.size;
+                shadow_cache.update_layer((unsigned) l, casters, layer_moved);
+                
+                shadow_cached_transforms[l] = shadow_transforms[l];
+                shadow_cached_slots[l] = slot;
+            }
+            
+            // Each frame in flight writes to its own region of the instance buffer
+            unsigned first_instance = (unsigned) (scene.objects.size() * layer_count * 2 * frame_index);
+            shadow_cache.end_update((unsigned*) shadow_instance_buffer_mapped + first_instance, first_instance);
+        }
         
-                            // Bind per-object descriptor set
-                            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layouts[pass], 1, 1, &object_descriptor_sets[i], 0, nullptr);
+        void record_shadow_pass(VkCommandBuffer command_buffer) {
+            unsigned atlas_size = shadow_atlas.get_size();
+            
+            ShadowCache::Pass pass { };
+            pass.render_pass = shadow_render_pass;
+            pass.render_area = create_region(0, 0, atlas_size, atlas_size);
+            pass.framebuffer = shadow_framebuffer;
+            pass.image = shadow_attachment.image;
+            pass.cache_framebuffer = shadow_cache_framebuffer;
+            pass.cache_image = shadow_cache_attachment.image;
+            pass.layer_count = 1;
+            pass.pipeline = shadow_pipeline;
+            pass.pipeline_layout = shadow_pipeline_layout;
+            pass.descriptor_set = global_descriptor_set;
+            
+            // Each layer occupies its slot of the atlas
+            shadow_cache.record(command_buffer, pass, [this](unsigned layer) {
+                const ShadowAtlas::Slot& slot = shadow_slots[layer];
+                
+                VkClearRect region { };
+                region.rect = create_region((int) slot.x, (int) slot.y, slot.size, slot.size);
+                region.baseArrayLayer = 0;
+                region.layerCount = 1;
+                return region;
+            }, [this](VkCommandBuffer command_buffer, const std::vector<ShadowCache::Draw>& draws) {
+                record_shadow_draws(command_buffer, draws);
+            });
+        }
         
-                            vkCmdDrawIndexed(command_buffer, (unsigned) model.indices.size(), 1, 0, 0, 0);
-                        }
-                    }
-                vkCmdEndRenderPass(command_buffer);
-            }
+        void record_shadow_draws(VkCommandBuffer command_buffer, const std::vector<ShadowCache::Draw>& draws) {
+            // Per-instance light indices
+            VkDeviceSize instance_offset = 0;
+            vkCmdBindVertexBuffers(command_buffer, 1, 1, &shadow_instance_buffer, &instance_offset);
             
-            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer!");
+            for (const ShadowCache::Draw& draw : draws) {
+                const Scene::Object& object = scene.objects[draw.object];
+                const Model& model = models[object.model];
+                
+                VkDeviceSize offsets[] = { object.vertex_offset };
+                vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, offsets);
+                vkCmdBindIndexBuffer(command_buffer, index_buffer, object.index_offset, VK_INDEX_TYPE_UINT32);
+                
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadow_pipeline_layout, 1, 1, &object_descriptor_sets[draw.object], 0, nullptr);
+                
+                // firstInstance offsets into the per-instance light indices of this object
+                vkCmdDrawIndexed(command_buffer, (unsigned) model.indices.size(), draw.instance_count, 0, 0, draw.first_instance);
             }
         }
         
         void initialize_shadow_map_pipeline() {
             VkVertexInputBindingDescription vertex_binding_descriptions[] {
-                create_vertex_binding_description(0, sizeof(glm::vec3) * 2, VK_VERTEX_INPUT_RATE_VERTEX) // One element is vertex position (vec3) + normal (vec3)
+                create_vertex_binding_description(0, sizeof(glm::vec3) * 2, VK_VERTEX_INPUT_RATE_VERTEX), // One element is vertex position (vec3) + normal (vec3)
+                create_vertex_binding_description(1, sizeof(unsigned), VK_VERTEX_INPUT_RATE_INSTANCE) // Shadow map layer of the instance
             };
 
             // The shadow map generation pipeline only uses vertex positions
             VkVertexInputAttributeDescription vertex_attribute_descriptions[] {
-                create_vertex_attribute_description(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0)
+                create_vertex_attribute_description(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+                create_vertex_attribute_description(1, 1, VK_FORMAT_R32_UINT, 0)
             };
             
             // Describe the format of the vertex data passed to the vertex shader
@@ -308,14 +577,15 @@ class ShadowMapping final : public Sample {
             // Bundle shader stages to assign to pipeline
             // A custom fragment shader stage is not necessary, since the only thing we care about is depth information and that gets written automatically
             VkPipelineShaderStageCreateInfo shader_stages[] = {
-                create_shader_stage(create_shader_module(device, "shaders/shadow_map.vert"), VK_SHADER_STAGE_VERTEX_BIT),
-                create_shader_stage(create_shader_module(device, "shaders/shadow_map.geom", { { "LIGHT_COUNT", std::to_string(scene.lights.size()) } }), VK_SHADER_STAGE_GEOMETRY_BIT),
+                create_shader_stage(create_shader_module(device, "shaders/shadow_map.vert", { { "SHADOW_LAYER_COUNT", std::to_string(shadow_transforms.size()) } }), VK_SHADER_STAGE_VERTEX_BIT),
             };
             
             VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = create_input_assembly_state(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
             
-            VkViewport viewport = create_viewport(0.0f, 0.0f, (float) swapchain_extent.width, (float) swapchain_extent.height, 0.0f, 1.0f);
-            VkRect2D scissor = create_region(0, 0, swapchain_extent.width, swapchain_extent.height);
+            // The viewport covers the entire atlas, geometry is offset / scaled into the slot of its layer in the vertex shader (and clipped to the slot with clip distances)
+            unsigned atlas_size = shadow_atlas.get_size();
+            VkViewport viewport = create_viewport(0.0f, 0.0f, (float) atlas_size, (float) atlas_size, 0.0f, 1.0f);
+            VkRect2D scissor = create_region(0, 0, atlas_size, atlas_size);
             
             VkPipelineViewportStateCreateInfo viewport_create_info { };
             viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -495,11 +765,8 @@ class ShadowMapping final : public Sample {
         
             // Needs one color blend attachment per color attachment, otherwise colorMask will be set to 0 and the attachment will not receive any color output
             VkPipelineColorBlendAttachmentState color_blend_attachment_states[] {
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Position
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Normal
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Ambient
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Diffuse
-                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Specular
+                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT, false), // Normal (octahedral)
+                create_color_blend_attachment_state(VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT, false), // Material
             };
         
             VkPipelineColorBlendStateCreateInfo color_blend_create_info { };
@@ -540,7 +807,7 @@ class ShadowMapping final : public Sample {
             pipeline_create_info.pColorBlendState = &color_blend_create_info;
             pipeline_create_info.pDynamicState = nullptr;
             pipeline_create_info.layout = geometry_pipeline_layout;
-            pipeline_create_info.renderPass = geometry_render_pass;
+            pipeline_create_info.renderPass = deferred_render_pass;
             pipeline_create_info.subpass = 0;
         
             // TODO: Allows for recreating a pipeline from an existing pipeline
@@ -580,7 +847,7 @@ class ShadowMapping final : public Sample {
             // Bundle shader stages to assign to pipeline
             VkPipelineShaderStageCreateInfo shader_stages[] = {
                 create_shader_stage(create_shader_module(device, "shaders/composition.vert"), VK_SHADER_STAGE_VERTEX_BIT),
-                create_shader_stage(create_shader_module(device, "shaders/composition.frag"), VK_SHADER_STAGE_FRAGMENT_BIT, &specialization_info),
+                create_shader_stage(create_shader_module(device, "shaders/composition.frag", { { "MATERIAL_COUNT", std::to_string(scene.objects.size()) }, { "CASCADE_COUNT", std::to_string(cascade_count) }, { "SHADOW_LAYER_COUNT", std::to_string(shadow_transforms.size()) } }), VK_SHADER_STAGE_FRAGMENT_BIT, &specialization_info),
             };
             
             // Input assembly describes the topology of the geometry being rendered
@@ -681,8 +948,8 @@ class ShadowMapping final : public Sample {
             pipeline_create_info.pColorBlendState = &color_blend_create_info;
             pipeline_create_info.pDynamicState = nullptr;
             pipeline_create_info.layout = composition_pipeline_layout;
-            pipeline_create_info.renderPass = composition_render_pass;
-            pipeline_create_info.subpass = 0;
+            pipeline_create_info.renderPass = deferred_render_pass;
+            pipeline_create_info.subpass = 1;
         
             // TODO: Allows for recreating a pipeline from an existing pipeline
             pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
@@ -711,7 +978,8 @@ class ShadowMapping final : public Sample {
         
         void initialize_shadow_map_render_pass() {
             // TODO: consolidate specifying attachment format into one place
-            VkAttachmentDescription attachment_description = create_attachment_description(depth_buffer_format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL);
+            // Shadow map layers are cached across frames (only the layers of lights whose shadows changed are cleared and re-rendered)
+            VkAttachmentDescription attachment_description = create_attachment_description(depth_buffer_format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL);
             VkAttachmentReference depth_attachment_reference = create_attachment_reference(0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
             
             VkSubpassDescription subpass_description { };
@@ -725,13 +993,13 @@ class ShadowMapping final : public Sample {
             
             // Define subpass dependencies
             VkSubpassDependency subpass_dependencies[] {
-                // Ensure that attachment read operations during the previous frame complete before resetting them for the new render pass
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+                // Ensure that shadow map reads by the composition pass of the previous frame complete before layers are cleared / rendered to
+                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                          0, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT),
                                           
                 // Write operations to fill attachments should complete before being read from
-                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT),
+                create_subpass_dependency(0, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT),
             };
             
             VkRenderPassCreateInfo render_pass_create_info { };
@@ -747,109 +1015,94 @@ class ShadowMapping final : public Sample {
             }
         }
         
-        void initialize_geometry_render_pass() {
+        void initialize_deferred_render_pass() {
             // TODO: consolidate specifying attachment format into one place
             VkAttachmentDescription attachment_descriptions[] {
-                // Positions
-                create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                // Normals
-                create_attachment_description(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                // Ambient
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                // Diffuse
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                // Specular
-                create_attachment_description(VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-                // Depth
-                create_attachment_description(depth_buffer_format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL),
+                // Normals (not stored, only read by the composition subpass)
+                create_attachment_description(GEOMETRY_BUFFER_NORMAL_FORMAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                // Material (not stored, only read by the composition subpass)
+                create_attachment_description(GEOMETRY_BUFFER_MATERIAL_FORMAT, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                // Depth (positions are reconstructed from depth in the composition subpass, not needed after the render pass)
+                create_attachment_description(depth_buffer_format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL),
+                // Output (swapchain image)
+                create_attachment_description(surface_format.format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR),
             };
             
-            VkAttachmentReference color_attachment_references[] {
+            // Subpass 0: geometry buffer
+            VkAttachmentReference geometry_color_attachment_references[] {
                 create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
                 create_attachment_reference(1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-                create_attachment_reference(4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
             };
-            VkAttachmentReference depth_stencil_attachment_reference = create_attachment_reference(5, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+            VkAttachmentReference geometry_depth_stencil_attachment_reference = create_attachment_reference(2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
             
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = sizeof(color_attachment_references) / sizeof(color_attachment_references[0]);
-            subpass_description.pColorAttachments = color_attachment_references;
-            subpass_description.pDepthStencilAttachment = &depth_stencil_attachment_reference;
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
-            
-            // Define subpass dependencies
-            VkSubpassDependency subpass_dependencies[] {
-                // Ensure that color attachment read operations during the previous frame complete before resetting them for the new render pass
-                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
-                                          
-                // Write operations to fill color attachments should complete before being read from
-                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                          VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT),
+            // Subpass 1: composition
+            // Depth remains bound (read-only) so that it can be sampled in the same layout, the composition pipeline does not enable depth testing
+            VkAttachmentReference composition_input_attachment_references[] {
+                create_attachment_reference(0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), // layout (input_attachment_index = 0)
+                create_attachment_reference(1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), // layout (input_attachment_index = 1)
             };
-            
-            VkRenderPassCreateInfo render_pass_create_info { };
-            render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = sizeof(attachment_descriptions) / sizeof(attachment_descriptions[0]);
-            render_pass_create_info.pAttachments = attachment_descriptions;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
-            render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
-            render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &geometry_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create geometry render pass!");
-            }
-        }
-        
-        void initialize_composition_render_pass() {
-            VkAttachmentDescription attachment_description = create_attachment_description(surface_format.format, VK_SAMPLE_COUNT_1_BIT, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-            VkAttachmentReference color_attachment_reference = create_attachment_reference(0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-            
-            VkSubpassDescription subpass_description { };
-            subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-            subpass_description.colorAttachmentCount = 1;
-            subpass_description.pColorAttachments = &color_attachment_reference;
-            subpass_description.pDepthStencilAttachment = nullptr; // Depth information is not used for rendering a FSQ
-            subpass_description.pResolveAttachments = nullptr; // Not used in this sample
-            subpass_description.pInputAttachments = nullptr; // Not used in this sample
-            subpass_description.pPreserveAttachments = nullptr; // Not used in this sample
+            VkAttachmentReference composition_color_attachment_reference = create_attachment_reference(3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+            VkAttachmentReference composition_depth_stencil_attachment_reference = create_attachment_reference(2, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL);
+            
+            VkSubpassDescription subpass_descriptions[2] { };
+            subpass_descriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass_descriptions[0].colorAttachmentCount = sizeof(geometry_color_attachment_references) / sizeof(geometry_color_attachment_references[0]);
+            subpass_descriptions[0].pColorAttachments = geometry_color_attachment_references;
+            subpass_descriptions[0].pDepthStencilAttachment = &geometry_depth_stencil_attachment_reference;
+            subpass_descriptions[0].pResolveAttachments = nullptr; // Not used in this sample
+            subpass_descriptions[0].pInputAttachments = nullptr;
+            subpass_descriptions[0].pPreserveAttachments = nullptr; // Not used in this sample
+            
+            subpass_descriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass_descriptions[1].colorAttachmentCount = 1;
+            subpass_descriptions[1].pColorAttachments = &composition_color_attachment_reference;
+            subpass_descriptions[1].pDepthStencilAttachment = &composition_depth_stencil_attachment_reference;
+            subpass_descriptions[1].pResolveAttachments = nullptr; // Not used in this sample
+            subpass_descriptions[1].inputAttachmentCount = sizeof(composition_input_attachment_references) / sizeof(composition_input_attachment_references[0]);
+            subpass_descriptions[1].pInputAttachments = composition_input_attachment_references;
+            subpass_descriptions[1].pPreserveAttachments = nullptr; // Not used in this sample
             
             // Define subpass dependencies
             VkSubpassDependency subpass_dependencies[] {
+                // Ensure that color / depth attachment read operations during the previous frame complete before resetting them for the new render pass
+                create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_MEMORY_READ_BIT,
+                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT),
+                
+                // Geometry buffer writes should complete before being read by the composition subpass (at the same pixel)
+                create_subpass_dependency(0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                          1, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT),
+                
                 // Dependency for ensuring that the color attachment (retrieved from the swapchain) is not transitioned to the VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL layout before it is available
                 // Color attachments are guaranteed to be available at the VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT pipeline stage, as that is where the color attachment LOAD operation happens
                 create_subpass_dependency(VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
-                                          0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+                                          1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
             };
             
+            // Input attachments are only read at the current pixel, so the dependency between the subpasses can be framebuffer-local
+            subpass_dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+            
             VkRenderPassCreateInfo render_pass_create_info { };
             render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_create_info.attachmentCount = 1;
-            render_pass_create_info.pAttachments = &attachment_description;
-            render_pass_create_info.subpassCount = 1;
-            render_pass_create_info.pSubpasses = &subpass_description;
+            render_pass_create_info.attachmentCount = sizeof(attachment_descriptions) / sizeof(attachment_descriptions[0]);
+            render_pass_create_info.pAttachments = attachment_descriptions;
+            render_pass_create_info.subpassCount = sizeof(subpass_descriptions) / sizeof(subpass_descriptions[0]);
+            render_pass_create_info.pSubpasses = subpass_descriptions;
             render_pass_create_info.dependencyCount = sizeof(subpass_dependencies) / sizeof(subpass_dependencies[0]);
             render_pass_create_info.pDependencies = subpass_dependencies;
-            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &composition_render_pass) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create composition render pass!");
+            if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &deferred_render_pass) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create deferred render pass!");
             }
         }
         
         void destroy_render_passes() {
             vkDestroyRenderPass(device, shadow_render_pass, nullptr);
-            vkDestroyRenderPass(device, geometry_render_pass, nullptr);
-            vkDestroyRenderPass(device, composition_render_pass, nullptr);
+            vkDestroyRenderPass(device, deferred_render_pass, nullptr);
         }
         
         void initialize_framebuffers() {
             initialize_shadow_map_framebuffer();
-            initialize_geometry_framebuffer();
-            initialize_composition_framebuffers();
+            initialize_geometry_buffer();
+            initialize_deferred_framebuffers();
         }
         
         void destroy_framebuffers() {
@@ -857,6 +1110,11 @@ class ShadowMapping final : public Sample {
             vkDestroyImageView(device, shadow_attachment.image_view, nullptr);
             vkFreeMemory(device, shadow_attachment.memory, nullptr);
             vkDestroyFramebuffer(device, shadow_framebuffer, nullptr);
+            
+            vkDestroyImage(device, shadow_cache_attachment.image, nullptr);
+            vkDestroyImageView(device, shadow_cache_attachment.image_view, nullptr);
+            vkFreeMemory(device, shadow_cache_attachment.memory, nullptr);
+            vkDestroyFramebuffer(device, shadow_cache_framebuffer, nullptr);
 
             // Geometry buffer
             for (std::size_t i = 0u; i < geometry_framebuffer_attachments.size(); ++i) {
@@ -864,96 +1122,114 @@ class ShadowMapping final : public Sample {
                 vkDestroyImageView(device, geometry_framebuffer_attachments[i].image_view, nullptr);
                 vkFreeMemory(device, geometry_framebuffer_attachments[i].memory, nullptr);
             }
-            vkDestroyFramebuffer(device, geometry_framebuffer, nullptr);
         }
         
         void initialize_shadow_map_framebuffer() {
             unsigned mip_levels = 1;
-            unsigned layers = scene.lights.size();
-            
-            // Create a layered depth attachment for rendering light depth maps to, one for each light
-            // Note: this will have to get recreated if the number of lights change
+            unsigned layers = 1;
+            unsigned atlas_size = shadow_atlas.get_size();
             
-            // Create an image with VK_IMAGE_CREATE_2D_ARRAY_COMPATIBLE_BIT enabled so that the image view can be of type VK_IMAGE_VIEW_TYPE_2D_ARRAY
+            // Create a single depth attachment (the shadow atlas) for rendering light depth maps to, each cascade of each light is rendered into its own slot of the atlas
+            // The size of the atlas does not depend on the number of lights / cascades, slots get smaller as more shadows compete for space
             create_image(physical_device, device,
-                         swapchain_extent.width, swapchain_extent.height, mip_levels, layers,
+                         atlas_size, atlas_size, mip_levels, layers,
                          VK_SAMPLE_COUNT_1_BIT,
                          depth_buffer_format, // Use the same format for the shadow map as what is used for the depth buffer
                          VK_IMAGE_TILING_OPTIMAL,
-                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // Cached slots are copied into the shadow map
                          0,
                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                          shadow_attachment.image, shadow_attachment.memory);
-            create_image_view(device, shadow_attachment.image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, depth_buffer_format, VK_IMAGE_ASPECT_DEPTH_BIT, mip_levels, layers, shadow_attachment.image_view);
-            
-            VkFramebufferCreateInfo framebuffer_create_info { };
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_create_info.renderPass = shadow_render_pass;
-            framebuffer_create_info.attachmentCount = 1;
-            framebuffer_create_info.pAttachments = &shadow_attachment.image_view;
-            framebuffer_create_info.width = swapchain_extent.width;
-            framebuffer_create_info.height = swapchain_extent.height;
-            framebuffer_create_info.layers = layers;
-            
-            if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &shadow_framebuffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
+            create_image_view(device, shadow_attachment.image, VK_IMAGE_VIEW_TYPE_2D, depth_buffer_format, VK_IMAGE_ASPECT_DEPTH_BIT, mip_levels, layers, shadow_attachment.image_view);
+            
+            // The shadow cache is never sampled, only rendered to and copied from
+            create_image(physical_device, device,
+                         atlas_size, atlas_size, mip_levels, layers,
+                         VK_SAMPLE_COUNT_1_BIT,
+                         depth_buffer_format,
+                         VK_IMAGE_TILING_OPTIMAL,
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                         0,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                         shadow_cache_attachment.image, shadow_cache_attachment.memory);
+            create_image_view(device, shadow_cache_attachment.image, VK_IMAGE_VIEW_TYPE_2D, depth_buffer_format, VK_IMAGE_ASPECT_DEPTH_BIT, mip_levels, layers, shadow_cache_attachment.image_view);
+            
+            // The shadow render pass loads its attachment (to keep the slots of lights that did not change), so both images need to be in the layout the render pass expects
+            VkCommandBuffer command_buffer = begin_transient_command_buffer();
+                transition_image(command_buffer, shadow_attachment.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, { VK_IMAGE_ASPECT_DEPTH_BIT, 0, mip_levels, 0, layers }, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+                transition_image(command_buffer, shadow_cache_attachment.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL, { VK_IMAGE_ASPECT_DEPTH_BIT, 0, mip_levels, 0, layers }, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+            submit_transient_command_buffer(command_buffer);
+            
+            // All slots need to be rendered before their first use
+            shadow_cache.invalidate();
+            
+            // The shadow map and cache share the same render pass
+            FramebufferAttachment* attachments[2] = { &shadow_attachment, &shadow_cache_attachment };
+            VkFramebuffer* framebuffers[2] = { &shadow_framebuffer, &shadow_cache_framebuffer };
+            
+            for (std::size_t i = 0u; i < 2; ++i) {
+                VkFramebufferCreateInfo framebuffer_create_info { };
+                framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+                framebuffer_create_info.renderPass = shadow_render_pass;
+                framebuffer_create_info.attachmentCount = 1;
+                framebuffer_create_info.pAttachments = &attachments[i]->image_view;
+                framebuffer_create_info.width = atlas_size;
+                framebuffer_create_info.height = atlas_size;
+                framebuffer_create_info.layers = layers;
+                
+                if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, framebuffers[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create framebuffer!");
+                }
             }
         }
         
-        void initialize_geometry_framebuffer() {
-            // Initialize color attachments
-            
-            // Format for position and normal attachments (can be negative)
-            VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        void initialize_geometry_buffer() {
+            // Initialize color attachments (octahedral normals + material)
+            VkFormat formats[2] = { GEOMETRY_BUFFER_NORMAL_FORMAT, GEOMETRY_BUFFER_MATERIAL_FORMAT };
             unsigned mip_levels = 1;
             unsigned layers = 1;
             
             for (std::size_t i = 0u; i < 2; ++i) {
-                create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, mip_levels, layers, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geometry_framebuffer_attachments[i].image, geometry_framebuffer_attachments[i].memory);
-                create_image_view(device, geometry_framebuffer_attachments[i].image, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels, layers, geometry_framebuffer_attachments[i].image_view);
-            }
-            
-            // Ambient, diffuse, and specular attachments
-            // Use an unsigned format as color cannot be negative
-            format = VK_FORMAT_R8G8B8A8_UNORM;
-            
-            for (std::size_t i = 2u; i < 5; ++i) {
-                create_image(physical_device, device, swapchain_extent.width, swapchain_extent.height, mip_levels, layers, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geometry_framebuffer_attachments[i].image, geometry_framebuffer_attachments[i].memory);
-                create_image_view(device, geometry_framebuffer_attachments[i].image, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels, layers, geometry_framebuffer_attachments[i].image_view);
-            }
-            
-            VkImageView attachments[] {
-                geometry_framebuffer_attachments[0].image_view, // Positions
-                geometry_framebuffer_attachments[1].image_view, // Normals
-                geometry_framebuffer_attachments[2].image_view, // Ambient
-                geometry_framebuffer_attachments[3].image_view, // Diffuse
-                geometry_framebuffer_attachments[4].image_view, // Specular
-                depth_buffer_view // Depth
-            };
-            
-            VkFramebufferCreateInfo framebuffer_create_info { };
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_create_info.renderPass = geometry_render_pass;
-            framebuffer_create_info.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-            framebuffer_create_info.pAttachments = attachments;
-            framebuffer_create_info.width = swapchain_extent.width;
-            framebuffer_create_info.height = swapchain_extent.height;
-            framebuffer_create_info.layers = layers;
-            
-            if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &geometry_framebuffer) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
+                geometry_framebuffer_attachments[i].format = formats[i];
+                create_image(device, swapchain_extent.width, swapchain_extent.height, mip_levels, layers, VK_SAMPLE_COUNT_1_BIT, formats[i], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, 0, geometry_framebuffer_attachments[i].image);
+                
+                VkMemoryRequirements memory_requirements { };
+                vkGetImageMemoryRequirements(device, geometry_framebuffer_attachments[i].image, &memory_requirements);
+                
+                // Fall back to regular device memory on devices without lazily allocated memory (most desktop GPUs)
+                VkMemoryPropertyFlags memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+                if (is_memory_type_supported(physical_device, memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+                    memory_properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+                }
+                
+                VkMemoryAllocateInfo memory_allocate_info { };
+                memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                memory_allocate_info.allocationSize = memory_requirements.size;
+                memory_allocate_info.memoryTypeIndex = get_memory_type_index(physical_device, memory_requirements, memory_properties);
+                if (vkAllocateMemory(device, &memory_allocate_info, nullptr, &geometry_framebuffer_attachments[i].memory) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate memory for geometry buffer!");
+                }
+                vkBindImageMemory(device, geometry_framebuffer_attachments[i].image, geometry_framebuffer_attachments[i].memory, 0);
+                
+                create_image_view(device, geometry_framebuffer_attachments[i].image, VK_IMAGE_VIEW_TYPE_2D, formats[i], VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, layers, geometry_framebuffer_attachments[i].image_view);
             }
         }
         
-        void initialize_composition_framebuffers() {
+        void initialize_deferred_framebuffers() {
             present_framebuffers.resize(NUM_FRAMES_IN_FLIGHT);
             
             for (std::size_t i = 0u; i < NUM_FRAMES_IN_FLIGHT; ++i) {
-                VkImageView attachments[] = { swapchain_image_views[i] };
+                // Geometry buffer attachments are shared between framebuffers, as only one frame uses them at a time
+                VkImageView attachments[] = {
+                    geometry_framebuffer_attachments[0].image_view, // Normals
+                    geometry_framebuffer_attachments[1].image_view, // Material
+                    depth_buffer_view, // Depth
+                    swapchain_image_views[i]
+                };
                 
                 VkFramebufferCreateInfo framebuffer_create_info { };
                 framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-                framebuffer_create_info.renderPass = composition_render_pass;
+                framebuffer_create_info.renderPass = deferred_render_pass;
                 framebuffer_create_info.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
                 framebuffer_create_info.pAttachments = attachments;
                 framebuffer_create_info.width = swapchain_extent.width;
@@ -970,28 +1246,28 @@ class ShadowMapping final : public Sample {
             // Descriptor set 0 is allocated for global uniforms that do not change between pipelines
             VkDescriptorSetLayoutBinding bindings[] {
                 // Global camera information
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
                 
                 // Light data
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1),
                 
-                // Positions
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+                // Normals (input attachment)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
                 
-                // Normals
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+                // Material (input attachment)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
                 
-                // Ambient
+                // Depth
                 create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
                 
-                // Diffuse
+                // Shadow map
                 create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
                 
-                // Specular
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+                // Material table
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
                 
-                // Shadow map
-                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
+                // Shadow cascades (layer transforms + split distances)
+                create_descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 7),
             };
             
             // Initialize the descriptor set layout
@@ -1014,7 +1290,7 @@ class ShadowMapping final : public Sample {
             }
             
             VkWriteDescriptorSet descriptor_writes[8] { };
-            VkDescriptorBufferInfo buffer_infos[2] { };
+            VkDescriptorBufferInfo buffer_infos[4] { };
             
             unsigned binding = 0u;
             std::size_t offset = 0u;
@@ -1049,12 +1325,18 @@ class ShadowMapping final : public Sample {
             descriptor_writes[binding].descriptorCount = 1;
             descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
             
-            VkDescriptorImageInfo image_infos[7] { };
+            // Shadow cascades follow the light data in the uniform buffer (written to binding 7, below)
+            buffer_infos[3].buffer = uniform_buffer;
+            buffer_infos[3].offset = offset;
+            buffer_infos[3].range = get_shadow_uniforms_size();
+            offset += align_to_device_boundary(physical_device, buffer_infos[3].range);
             
-            // Bindings 2 - 7
+            VkDescriptorImageInfo image_infos[4] { };
+            
+            // Bindings 2 - 5
             unsigned starting_binding = ++binding;
-            for (; binding < 8; ++binding) {
-                if (binding == 7) {
+            for (; binding < 6; ++binding) {
+                if (binding == 5) {
                     // Shadow map attachment
                     // Shadow map uses depth format
                     image_infos[binding - starting_binding].imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL;
@@ -1063,21 +1345,53 @@ class ShadowMapping final : public Sample {
                     image_infos[binding - starting_binding].imageView = shadow_attachment.image_view;
                     image_infos[binding - starting_binding].sampler = depth_sampler;
                 }
+                else if (binding == 4) {
+                    // Depth buffer (bound as a read-only depth attachment in the composition subpass)
+                    image_infos[binding - starting_binding].imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL;
+                    image_infos[binding - starting_binding].imageView = depth_buffer_view;
+                    image_infos[binding - starting_binding].sampler = depth_sampler;
+                }
                 else {
+                    // Geometry buffer attachments are read as input attachments in the composition subpass (input attachments are not sampled)
                     image_infos[binding - starting_binding].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                     image_infos[binding - starting_binding].imageView = geometry_framebuffer_attachments[binding - starting_binding].image_view;
-                    image_infos[binding - starting_binding].sampler = color_sampler;
+                    image_infos[binding - starting_binding].sampler = VK_NULL_HANDLE;
                 }
                 
                 descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
                 descriptor_writes[binding].dstSet = global_descriptor_set;
                 descriptor_writes[binding].dstBinding = binding;
                 descriptor_writes[binding].dstArrayElement = 0;
-                descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptor_writes[binding].descriptorType = binding < 4 ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
                 descriptor_writes[binding].descriptorCount = 1;
                 descriptor_writes[binding].pImageInfo = &image_infos[binding - starting_binding];
             }
             
+            // Binding 6
+            // Material table is located at the end of the uniform buffer, after the per-object uniforms
+            buffer_infos[2].buffer = uniform_buffer;
+            buffer_infos[2].offset = offset + (align_to_device_boundary(physical_device, sizeof(ObjectUniforms)) + align_to_device_boundary(physical_device, sizeof(PhongUniforms))) * scene.objects.size();
+            buffer_infos[2].range = sizeof(GeometryBufferMaterial) * scene.objects.size();
+            
+            descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[binding].dstSet = global_descriptor_set;
+            descriptor_writes[binding].dstBinding = binding;
+            descriptor_writes[binding].dstArrayElement = 0;
+            descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptor_writes[binding].descriptorCount = 1;
+            descriptor_writes[binding].pBufferInfo = &buffer_infos[2];
+            
+            ++binding;
+            
+            // Binding 7
+            descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[binding].dstSet = global_descriptor_set;
+            descriptor_writes[binding].dstBinding = binding;
+            descriptor_writes[binding].dstArrayElement = 0;
+            descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptor_writes[binding].descriptorCount = 1;
+            descriptor_writes[binding].pBufferInfo = &buffer_infos[3];
+            
             vkUpdateDescriptorSets(device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, nullptr);
         }
         
@@ -1101,7 +1415,7 @@ class ShadowMapping final : public Sample {
             }
             
             // Global camera uniforms + global light array
-            std::size_t offset = align_to_device_boundary(physical_device, sizeof(GlobalUniforms)) + align_to_device_boundary(physical_device, sizeof(Scene::Light) * scene.lights.size());
+            std::size_t offset = align_to_device_boundary(physical_device, sizeof(GlobalUniforms)) + align_to_device_boundary(physical_device, sizeof(Scene::Light) * scene.lights.size()) + align_to_device_boundary(physical_device, get_shadow_uniforms_size());
             
             std::size_t num_objects = scene.objects.size();
             object_descriptor_sets.resize(num_objects);
@@ -1220,6 +1534,12 @@ class ShadowMapping final : public Sample {
             knight.transform = Transform(glm::vec3(0, 0.5f, 0), glm::vec3(1.5f), glm::vec3(0.0f, -25.0f, 0.0f));
             knight.flat_shaded = true;
             
+            // Compute model-space bounds for frustum culling
+            for (const Model& model : models) {
+                model_bounds.emplace_back(compute_model_bounds(model));
+            }
+            culler.add_objects(scene.objects, model_bounds);
+            
             // This sample only uses vertex position and normal
             std::size_t vertex_buffer_size = 0u;
             std::size_t index_buffer_size = 0u;
@@ -1304,9 +1624,10 @@ class ShadowMapping final : public Sample {
         }
         
         void initialize_lights() {
-            // Use the same near / far plane distances as the main camera
-            glm::mat4 projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, camera.get_near_plane_distance(), camera.get_far_plane_distance());
-            projection[1][1] *= -1;
+            // Split distances of all cascades are packed into a single vec4
+            if (cascade_count == 0u || cascade_count > 4u) {
+                throw std::runtime_error("number of shadow cascades must be between 1 and 4!");
+            }
             
             float distance = 3.0f;
             float height = 5.0f;
@@ -1314,52 +1635,41 @@ class ShadowMapping final : public Sample {
             {
                 Scene::Light& light = scene.lights.emplace_back();
                 light.position = glm::vec3(distance, height, distance);
-                glm::mat4 view = glm::lookAt(light.position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-                light.transform = projection * view;
                 light.direction = glm::normalize(glm::vec3(0.0f) - light.position);
                 light.color = glm::vec3(0.6f);
             }
 //            {
 //                Scene::Light& light = scene.lights.emplace_back();
 //                light.position = glm::vec3(-distance, height, distance);
-//                glm::mat4 view = glm::lookAt(light.position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-//                light.transform = projection * view;
 //                light.direction = glm::normalize(glm::vec3(0.0f) - light.position);
 //                light.color = glm::vec3(0.2f);
 //            }
+            
+            // Cascade projections are fit to the camera every frame (update_cascades())
+            shadow_transforms.resize(scene.lights.size() * cascade_count, glm::mat4(1.0f));
+            cascade_splits = glm::vec4(camera.get_far_plane_distance());
+            update_scene_bounds();
         }
         
-        void initialize_samplers() {
-            VkSamplerCreateInfo color_sampler_create_info { };
-            color_sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-            color_sampler_create_info.magFilter = VK_FILTER_LINEAR;
-            color_sampler_create_info.minFilter = VK_FILTER_LINEAR;
-            color_sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            color_sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            color_sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        void initialize_shadow_instance_buffer() {
+            // Static + dynamic casters
+            std::size_t capacity = scene.objects.size() * shadow_transforms.size() * 2;
+            std::size_t size = sizeof(unsigned) * capacity * NUM_FRAMES_IN_FLIGHT;
             
-            if (enabled_physical_device_features.samplerAnisotropy) {
-                color_sampler_create_info.anisotropyEnable = VK_TRUE;
-                color_sampler_create_info.maxAnisotropy = physical_device_properties.limits.maxSamplerAnisotropy;
-            }
-            else {
-                color_sampler_create_info.anisotropyEnable = VK_FALSE;
-                color_sampler_create_info.maxAnisotropy = 1.0f;
-            }
-        
-            color_sampler_create_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
-            color_sampler_create_info.unnormalizedCoordinates = VK_FALSE;
-            color_sampler_create_info.compareEnable = VK_FALSE;
-            color_sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
-            color_sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-            color_sampler_create_info.mipLodBias = 0.0f;
-            color_sampler_create_info.minLod = 0.0f;
-            color_sampler_create_info.maxLod = 1.0f;
-            
-            if (vkCreateSampler(device, &color_sampler_create_info, nullptr, &color_sampler) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create color sampler!");
-            }
+            create_buffer(physical_device, device, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, shadow_instance_buffer, shadow_instance_buffer_memory);
+            vkMapMemory(device, shadow_instance_buffer_memory, 0, size, 0, &shadow_instance_buffer_mapped);
             
+            shadow_cache.initialize(scene.objects.size(), shadow_transforms.size());
+            shadow_cached_transforms.resize(shadow_transforms.size());
+            shadow_cached_slots.resize(shadow_transforms.size(), ShadowAtlas::Slot { 0u, 0u, 0u });
+        }
+        
+        void destroy_shadow_instance_buffer() {
+            vkFreeMemory(device, shadow_instance_buffer_memory, nullptr);
+            vkDestroyBuffer(device, shadow_instance_buffer, nullptr);
+        }
+        
+        void initialize_samplers() {
             VkSamplerCreateInfo depth_sampler_create_info { };
             depth_sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
             depth_sampler_create_info.magFilter = VK_FILTER_LINEAR;
@@ -1393,12 +1703,16 @@ class ShadowMapping final : public Sample {
         
         void destroy_samplers() {
             vkDestroySampler(device, depth_sampler, nullptr);
-            vkDestroySampler(device, color_sampler, nullptr);
         }
         
         void initialize_uniform_buffer() {
-            // Globals (camera + lights) + per object (transform + material) * num objects
-            std::size_t uniform_buffer_size = align_to_device_boundary(physical_device, sizeof(GlobalUniforms)) + align_to_device_boundary(physical_device, sizeof(Scene::Light) * scene.lights.size()) + (align_to_device_boundary(physical_device, sizeof(ObjectUniforms)) + align_to_device_boundary(physical_device, sizeof(PhongUniforms))) * scene.objects.size();
+            // Material indices stored in the geometry buffer are 8 bits (one material per object)
+            if (scene.objects.size() > MAX_GEOMETRY_BUFFER_MATERIALS) {
+                throw std::runtime_error("scene contains more materials than can be indexed by the geometry buffer!");
+            }
+            
+            // Globals (camera + lights + shadow cascades) + per object (transform + material) * num objects + material table
+            std::size_t uniform_buffer_size = align_to_device_boundary(physical_device, sizeof(GlobalUniforms)) + align_to_device_boundary(physical_device, sizeof(Scene::Light) * scene.lights.size()) + align_to_device_boundary(physical_device, get_shadow_uniforms_size()) + (align_to_device_boundary(physical_device, sizeof(ObjectUniforms)) + align_to_device_boundary(physical_device, sizeof(PhongUniforms))) * scene.objects.size() + sizeof(GeometryBufferMaterial) * scene.objects.size();
             
             create_buffer(physical_device, device, uniform_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniform_buffer, uniform_buffer_memory);
             vkMapMemory(device, uniform_buffer_memory, 0, uniform_buffer_size, 0, &uniform_buffer_mapped);
@@ -1446,6 +1760,7 @@ class ShadowMapping final : public Sample {
                 uniforms.projection = camera.get_projection_matrix();
                 uniforms.camera_position = camera.get_position();
                 uniforms.debug_view = 0;
+                uniforms.inverse_view_projection = glm::inverse(uniforms.projection * uniforms.view);
                 
                 memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &uniforms, sizeof(uniforms));
                 offset += align_to_device_boundary(physical_device, sizeof(GlobalUniforms));
@@ -1461,7 +1776,26 @@ class ShadowMapping final : public Sample {
                 offset += align_to_device_boundary(physical_device, light_uniform_block_size * scene.lights.size());
             }
             
-            for (Scene::Object& object : scene.objects) {
+            // set 0 binding 7
+            {
+                std::size_t transforms_size = sizeof(glm::mat4) * shadow_transforms.size();
+                memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), shadow_transforms.data(), transforms_size);
+                
+                // Slots are uploaded in texture coordinates of the atlas (x, y: origin, z: size, w: unused)
+                std::vector<glm::vec4> slots(shadow_slots.size());
+                float atlas_size = (float) shadow_atlas.get_size();
+                for (std::size_t l = 0u; l < shadow_slots.size(); ++l) {
+                    slots[l] = glm::vec4((float) shadow_slots[l].x, (float) shadow_slots[l].y, (float) shadow_slots[l].size, 0.0f) / atlas_size;
+                }
+                
+                std::size_t slots_size = sizeof(glm::vec4) * slots.size();
+                memcpy((void*)(((const char*) uniform_buffer_mapped) + offset + transforms_size), slots.data(), slots_size);
+                memcpy((void*)(((const char*) uniform_buffer_mapped) + offset + transforms_size + slots_size), &cascade_splits, sizeof(glm::vec4));
+                offset += align_to_device_boundary(physical_device, get_shadow_uniforms_size());
+            }
+            
+            for (std::size_t i = 0u; i < scene.objects.size(); ++i) {
+                Scene::Object& object = scene.objects[i];
                 Transform& transform = object.transform;
                 
                 // Vertex
@@ -1476,15 +1810,29 @@ class ShadowMapping final : public Sample {
                 // Fragment
                 // set 1 binding 1
                 PhongUniforms fragment { };
-                fragment.ambient = glm::vec4(object.ambient, 1.0f);
-                fragment.diffuse = glm::vec4(object.diffuse, 1.0f);
-                fragment.specular = glm::vec4(object.specular, 1.0f);
-                fragment.specular_exponent = object.specular_exponent;
+                fragment.diffuse = object.diffuse;
+                fragment.material = (unsigned) i;
                 fragment.flat_shaded = (int) object.flat_shaded;
                 
                 memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &fragment, sizeof(PhongUniforms));
                 offset += align_to_device_boundary(physical_device, sizeof(PhongUniforms));
             }
+            
+            // set 0 binding 6
+            for (const Scene::Object& object : scene.objects) {
+                GeometryBufferMaterial material { };
+                material.ambient = glm::vec4(object.ambient, 1.0f);
+                material.specular = glm::vec4(object.specular, object.specular_exponent);
+                
+                memcpy((void*)(((const char*) uniform_buffer_mapped) + offset), &material, sizeof(GeometryBufferMaterial));
+                offset += sizeof(GeometryBufferMaterial);
+            }
+        }
+        
+        // Matches ShadowUniforms (std140) in shaders/shadow_map.vert and shaders/composition.frag
+        std::size_t get_shadow_uniforms_size() const {
+            // Transform + slot of each layer, cascade split distances
+            return (sizeof(glm::mat4) + sizeof(glm::vec4)) * shadow_transforms.size() + sizeof(glm::vec4);
         }
         
         void destroy_uniform_buffer() {
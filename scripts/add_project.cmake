@@ -86,6 +86,13 @@ function(add_project)
     )
     add_dependencies(${PROJECT_NAME} ${PROJECT_NAME}_copy_shaders)
 
+    # Copy shaders shared between projects (included as "common/<file>")
+    add_custom_target(${PROJECT_NAME}_copy_common_shaders ALL
+        COMMAND "${CMAKE_COMMAND}" -E copy_directory "${CMAKE_SOURCE_DIR}/framework/shaders" "${PROJECT_BINARY_DIR}/shaders/common"
+        COMMENT "Copying framework shaders into binary directory"
+    )
+    add_dependencies(${PROJECT_NAME} ${PROJECT_NAME}_copy_common_shaders)
+
     # Copy shared project assets
     add_custom_target(${PROJECT_NAME}_copy_assets ALL
         COMMAND "${CMAKE_COMMAND}" -E copy_directory "${CMAKE_SOURCE_DIR}/assets" "${PROJECT_BINARY_DIR}/assets"